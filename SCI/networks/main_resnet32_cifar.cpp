@@ -2266,6 +2266,9 @@ int main(int argc, char **argv) {
   amap.arg("ip", address, "IP Address of server (ALICE)");
   amap.arg("nt", num_threads, "Number of Threads");
   amap.arg("ell", bitlength, "Uniform Bitwidth");
+  amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+  amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+  amap.arg("async", async_send, "Send from a dedicated thread per channel");
   amap.parse(argc, argv);
 
   assert(party == SERVER || party == CLIENT);
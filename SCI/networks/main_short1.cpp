@@ -7640,6 +7640,9 @@ amap.arg("ell", bitlength, "Uniform Bitwidth");
 // Add
 amap.arg("k", kScale, "scaling factor");
 
+amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+amap.arg("async", async_send, "Send from a dedicated thread per channel");
 amap.parse(argc, argv);
 
 assert(party==SERVER || party==CLIENT);
@@ -7741,26 +7744,18 @@ Conv2DWrapper( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)1,  (int32_t)5,
 ClearMemSecret4( (int32_t)5,  (int32_t)5,  (int32_t)1,  (int32_t)20, tmp5);
 ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)1, tmp0);
 
-uint64_t* tmp9 = make_array<uint64_t>( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20);
-MaxPool( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6, tmp9);
-ClearMemSecret4( (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6);
-
 uint64_t* tmp11 = make_array<uint64_t>( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20);
-Relu4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20, tmp9, tmp11,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20, tmp9);
+MaxPoolRelu( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6, tmp11,  (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6);
 
 uint64_t* tmp13 = make_array<uint64_t>( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20);
 Conv2DWrapper( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)5,  (int32_t)5,  (int32_t)20,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)1,  (int32_t)1, tmp11, tmp4, tmp13);
 ClearMemSecret4( (int32_t)5,  (int32_t)5,  (int32_t)20,  (int32_t)20, tmp4);
 ClearMemSecret4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20, tmp11);
 
-uint64_t* tmp16 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20);
-MaxPool( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13, tmp16);
-ClearMemSecret4( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13);
-
 uint64_t* tmp18 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20);
-Relu4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20, tmp16, tmp18,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20, tmp16);
+MaxPoolRelu( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13, tmp18,  (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13);
 
 uint64_t* tmp20 = make_array<uint64_t>( (int32_t)1,  (int32_t)320);
 
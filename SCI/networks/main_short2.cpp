@@ -7639,6 +7639,9 @@ amap.arg("ell", bitlength, "Uniform Bitwidth");
 // Add
 amap.arg("k", kScale, "scaling factor"); // same as sf here, also 12
 
+amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+amap.arg("async", async_send, "Send from a dedicated thread per channel");
 amap.parse(argc, argv);
 
 assert(party==SERVER || party==CLIENT);
@@ -7761,39 +7764,27 @@ Conv2DWrapper( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)1,  (int32_t)5,
 ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)1, tmp0);
 ClearMemSecret4( (int32_t)5,  (int32_t)5,  (int32_t)1,  (int32_t)25, tmp2);
 
-uint64_t* tmp10 = make_array<uint64_t>( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25);
-MaxPool( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)25, tmp7, tmp10);
-ClearMemSecret4( (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)25, tmp7);
-
 uint64_t* tmp12 = make_array<uint64_t>( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25);
-Relu4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25, tmp10, tmp12,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25, tmp10);
+MaxPoolRelu( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)25, tmp7, tmp12,  (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)25, tmp7);
 
 uint64_t* tmp14 = make_array<uint64_t>( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)25);
 Conv2DWrapper( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25,  (int32_t)5,  (int32_t)5,  (int32_t)25,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)1,  (int32_t)1, tmp12, tmp3, tmp14);
 ClearMemSecret4( (int32_t)5,  (int32_t)5,  (int32_t)25,  (int32_t)25, tmp3);
 ClearMemSecret4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)25, tmp12);
 
-uint64_t* tmp17 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25);
-MaxPool( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)25, tmp14, tmp17);
-ClearMemSecret4( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)25, tmp14);
-
 uint64_t* tmp19 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25);
-Relu4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25, tmp17, tmp19,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25, tmp17);
+MaxPoolRelu( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)25, tmp14, tmp19,  (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)25, tmp14);
 
 uint64_t* tmp21 = make_array<uint64_t>( (int32_t)1,  (int32_t)3,  (int32_t)3,  (int32_t)50);
 Conv2DWrapper( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25,  (int32_t)2,  (int32_t)2,  (int32_t)50,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)1,  (int32_t)1, tmp19, tmp5, tmp21);
 ClearMemSecret4( (int32_t)2,  (int32_t)2,  (int32_t)25,  (int32_t)50, tmp5);
 ClearMemSecret4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)25, tmp19);
 
-uint64_t* tmp24 = make_array<uint64_t>( (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)50);
-MaxPool( (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)50,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)3,  (int32_t)3,  (int32_t)50, tmp21, tmp24);
-ClearMemSecret4( (int32_t)1,  (int32_t)3,  (int32_t)3,  (int32_t)50, tmp21);
-
 uint64_t* tmp26 = make_array<uint64_t>( (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)50);
-Relu4( (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)50, tmp24, tmp26,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)50, tmp24);
+MaxPoolRelu( (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)50,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)3,  (int32_t)3,  (int32_t)50, tmp21, tmp26,  (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)3,  (int32_t)3,  (int32_t)50, tmp21);
 
 uint64_t* tmp28 = make_array<uint64_t>( (int32_t)1,  (int32_t)50);
 
@@ -2285,6 +2285,9 @@ int main(int argc, char **argv) {
   amap.arg("nt", num_threads, "Number of Threads");
   amap.arg("ell", bitlength, "Uniform Bitwidth");
   amap.arg("k", kScale, "scaling factor");
+  amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+  amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+  amap.arg("async", async_send, "Send from a dedicated thread per channel");
   amap.parse(argc, argv);
 
   assert(party == SERVER || party == CLIENT);
@@ -3128,19 +3131,13 @@ int main(int argc, char **argv) {
   ClearMemSecret1((int32_t)64, tmp2);
   ClearMemSecret4((int32_t)1, (int32_t)113, (int32_t)113, (int32_t)64, tmp53);
 
-  uint64_t *tmp59 =
-      make_array<uint64_t>((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)64);
-  MaxPool((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)64, (int32_t)3,
-          (int32_t)3, (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)0,
-          (int32_t)2, (int32_t)2, (int32_t)1, (int32_t)113, (int32_t)113,
-          (int32_t)64, tmp56, tmp59);
-  ClearMemSecret4((int32_t)1, (int32_t)113, (int32_t)113, (int32_t)64, tmp56);
-
   uint64_t *tmp61 =
       make_array<uint64_t>((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)64);
-  Relu4((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)64, tmp59, tmp61,
-        kScale, 1);
-  ClearMemSecret4((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)64, tmp59);
+  MaxPoolRelu((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)64, (int32_t)3,
+              (int32_t)3, (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)0,
+              (int32_t)2, (int32_t)2, (int32_t)1, (int32_t)113, (int32_t)113,
+              (int32_t)64, tmp56, tmp61, kScale, 1);
+  ClearMemSecret4((int32_t)1, (int32_t)113, (int32_t)113, (int32_t)64, tmp56);
 
   uint64_t *tmp63 =
       make_array<uint64_t>((int32_t)1, (int32_t)56, (int32_t)56, (int32_t)16);
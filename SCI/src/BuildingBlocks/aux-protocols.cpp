@@ -65,9 +65,10 @@ void AuxProtocols::multiplexer(uint8_t *sel, uint64_t *x, uint64_t *y,
   uint64_t mask_x = (bw_x == 64 ? -1 : ((1ULL << bw_x) - 1));
   uint64_t mask_y = (bw_y == 64 ? -1 : ((1ULL << bw_y) - 1));
 
-  uint64_t *corr_data = new uint64_t[size];
-  uint64_t *data_S = new uint64_t[size];
-  uint64_t *data_R = new uint64_t[size];
+  sci::Arena::Scope scratch(arena);
+  uint64_t *corr_data = arena.alloc<uint64_t>(size);
+  uint64_t *data_S = arena.alloc<uint64_t>(size);
+  uint64_t *data_R = arena.alloc<uint64_t>(size);
 
   // y = (sel_0 \xor sel_1) * (x_0 + x_1)
   // y = (sel_0 + sel_1 - 2*sel_0*sel_1)*x_0 + (sel_0 + sel_1 -
@@ -86,10 +87,6 @@ void AuxProtocols::multiplexer(uint8_t *sel, uint64_t *x, uint64_t *y,
   for (int i = 0; i < size; i++) {
     y[i] = ((x[i] * uint64_t(sel[i]) + data_R[i] - data_S[i]) & mask_y);
   }
-
-  delete[] corr_data;
-  delete[] data_S;
-  delete[] data_R;
 }
 
 void AuxProtocols::B2A(uint8_t *x, uint64_t *y, int32_t size, int32_t bw_y) {
@@ -122,6 +119,68 @@ void AuxProtocols::B2A(uint8_t *x, uint64_t *y, int32_t size, int32_t bw_y) {
   }
 }
 
+void AuxProtocols::B2A_batched(uint8_t **x, uint64_t **y, int32_t size,
+                               const std::vector<int32_t> &bw_y) {
+  // 1-bit conversions are local, the rest share one batched COT
+  std::vector<int32_t> ot_vec;
+  std::vector<int> msg_len;
+  for (size_t k = 0; k < bw_y.size(); k++) {
+    assert(bw_y[k] <= 64 && bw_y[k] >= 1);
+    if (bw_y[k] == 1) {
+      B2A(x[k], y[k], size, 1);
+    } else {
+      ot_vec.push_back(k);
+      msg_len.push_back(bw_y[k]);
+    }
+  }
+  int32_t num_vec = ot_vec.size();
+  if (num_vec == 0) {
+    return;
+  }
+
+  uint64_t *data = new uint64_t[num_vec * size];
+  if (party == sci::ALICE) {
+    uint64_t *corr_data = new uint64_t[num_vec * size];
+    for (int j = 0; j < num_vec; j++) {
+      uint64_t mask = (msg_len[j] == 64 ? -1 : ((1ULL << msg_len[j]) - 1));
+      uint8_t *x_j = x[ot_vec[j]];
+      for (int i = 0; i < size; i++) {
+        corr_data[j * size + i] = (-2 * uint64_t(x_j[i])) & mask;
+      }
+    }
+    otpack->iknp_straight->send_batched_cot(data, corr_data, msg_len,
+                                            num_vec * size);
+
+    for (int j = 0; j < num_vec; j++) {
+      uint64_t mask = (msg_len[j] == 64 ? -1 : ((1ULL << msg_len[j]) - 1));
+      uint8_t *x_j = x[ot_vec[j]];
+      uint64_t *y_j = y[ot_vec[j]];
+      for (int i = 0; i < size; i++) {
+        y_j[i] = (uint64_t(x_j[i]) - data[j * size + i]) & mask;
+      }
+    }
+    delete[] corr_data;
+  } else {  // party == sci::BOB
+    uint8_t *choice = new uint8_t[num_vec * size];
+    for (int j = 0; j < num_vec; j++) {
+      memcpy(choice + j * size, x[ot_vec[j]], size * sizeof(uint8_t));
+    }
+    otpack->iknp_straight->recv_batched_cot(data, (bool *)choice, msg_len,
+                                            num_vec * size);
+
+    for (int j = 0; j < num_vec; j++) {
+      uint64_t mask = (msg_len[j] == 64 ? -1 : ((1ULL << msg_len[j]) - 1));
+      uint8_t *x_j = x[ot_vec[j]];
+      uint64_t *y_j = y[ot_vec[j]];
+      for (int i = 0; i < size; i++) {
+        y_j[i] = (uint64_t(x_j[i]) + data[j * size + i]) & mask;
+      }
+    }
+    delete[] choice;
+  }
+  delete[] data;
+}
+
 template <typename T>
 void AuxProtocols::lookup_table(T **spec, T *x, T *y, int32_t size,
                                 int32_t bw_x, int32_t bw_y) {
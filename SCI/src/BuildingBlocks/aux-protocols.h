@@ -25,6 +25,7 @@ SOFTWARE.
 #include "Millionaire/millionaire.h"
 #include "Millionaire/millionaire_with_equality.h"
 #include "OT/emp-ot.h"
+#include "utils/arena.h"
 
 class AuxProtocols {
 public:
@@ -33,6 +34,8 @@ public:
   sci::OTPack<sci::NetIO> *otpack;
   MillionaireProtocol<sci::NetIO> *mill;
   MillionaireWithEquality<sci::NetIO> *mill_and_eq;
+  // Scratch buffers of multiplexer(), released at the end of each call
+  sci::Arena arena;
 
   AuxProtocols(int party, sci::NetIO *io, sci::OTPack<sci::NetIO> *otpack);
 
@@ -74,6 +77,17 @@ public:
       // bitwidth of y
       int32_t bw_y);
 
+  // B2A of several vectors of the same size in one batched COT
+  void B2A_batched(
+      // input (boolean) vectors
+      uint8_t **x,
+      // output vectors
+      uint64_t **y,
+      // size of each vector
+      int32_t size,
+      // bitwidth of each y
+      const std::vector<int32_t> &bw_y);
+
   template <typename T>
   void lookup_table(
       // table specification
@@ -138,9 +138,10 @@ void Truncation::div_pow2(int32_t dim, uint64_t *inA, uint64_t *outB,
   uint64_t *arith_wrap_upper = new uint64_t[dim];
   uint64_t *arith_wrap_lower = new uint64_t[dim];
   uint64_t *arith_div_correction = new uint64_t[dim];
-  this->aux->B2A(wrap_upper, arith_wrap_upper, dim, shift);
-  this->aux->B2A(wrap_lower, arith_wrap_lower, dim, bw);
-  this->aux->B2A(div_correction, arith_div_correction, dim, bw);
+  uint8_t *b2a_in[3] = {wrap_upper, wrap_lower, div_correction};
+  uint64_t *b2a_out[3] = {arith_wrap_upper, arith_wrap_lower,
+                          arith_div_correction};
+  this->aux->B2A_batched(b2a_in, b2a_out, dim, {shift, bw, bw});
 
   for (int i = 0; i < dim; i++) {
     outB[i] =
@@ -235,8 +236,9 @@ void Truncation::truncate(int32_t dim, uint64_t *inA, uint64_t *outB,
 
   uint64_t *arith_wrap_upper = new uint64_t[dim];
   uint64_t *arith_wrap_lower = new uint64_t[dim];
-  this->aux->B2A(wrap_upper, arith_wrap_upper, dim, shift);
-  this->aux->B2A(wrap_lower, arith_wrap_lower, dim, bw);
+  uint8_t *b2a_in[2] = {wrap_upper, wrap_lower};
+  uint64_t *b2a_out[2] = {arith_wrap_upper, arith_wrap_lower};
+  this->aux->B2A_batched(b2a_in, b2a_out, dim, {shift, bw});
 
   for (int i = 0; i < dim; i++) {
     outB[i] = (((inA[i] >> shift) & mask_upper) + arith_wrap_lower[i] -
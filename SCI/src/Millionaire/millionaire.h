@@ -25,7 +25,10 @@ SOFTWARE.
 #define MILLIONAIRE_H__
 #include "Millionaire/bit-triple-generator.h"
 #include "OT/emp-ot.h"
+#include "utils/arena.h"
 #include "utils/emp-tool.h"
+#include "utils/simd_kernels.h"
+#include <chrono>
 #include <cmath>
 
 #define MILL_PARAM 4
@@ -40,6 +43,12 @@ public:
   int num_digits, num_triples_corr, num_triples_std, log_num_digits;
   int num_triples;
   uint8_t mask_beta, mask_r;
+  // Round-reduced mode, see set_link_profile()
+  bool round_reduced = false;
+  int max_fan_in = 2, fan_in = 2;
+  double rtt_ms = 0, bandwidth_mbps = 0;
+  // Scratch buffers of compare(), released at the end of each call
+  sci::Arena arena;
 
   MillionaireProtocol(int party, IO *io, sci::OTPack<IO> *otpack,
                       int bitlength = 32, int radix_base = MILL_PARAM) {
@@ -73,22 +82,113 @@ public:
 
   ~MillionaireProtocol() { delete triple_gen; }
 
+  // Round-reduced mode for links where latency dominates. Each compare() then
+  // picks the radix and the fan-in of the AND tree from the bit-length, the
+  // number of comparisons and this link profile, and evaluates every node of
+  // the tree with one 1-out-of-2^(2 * fan-in) OT, without bit triples. Up to
+  // log2(max_fan_in) AND levels are fused into one round. Both parties should
+  // set the same profile.
+  void set_link_profile(double rtt_ms, double bandwidth_mbps,
+                        int max_fan_in = 4) {
+    assert(rtt_ms >= 0 && bandwidth_mbps > 0);
+    assert(max_fan_in >= 2 && max_fan_in <= 4);
+    this->rtt_ms = rtt_ms;
+    this->bandwidth_mbps = bandwidth_mbps;
+    this->max_fan_in = max_fan_in;
+    this->round_reduced = true;
+  }
+
+  void disable_round_reduction() {
+    round_reduced = false;
+    fan_in = 2;
+  }
+
+  // Round-trip time of io in milliseconds, averaged over `reps` ping-pongs.
+  // BOB adopts ALICE's measurement so that both parties agree on it.
+  double measure_rtt(int reps = 8) {
+    uint8_t ping = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < reps; i++) {
+      if (party == sci::ALICE) {
+        io->send_data(&ping, 1);
+        io->flush();
+        io->recv_data(&ping, 1);
+      } else {
+        io->recv_data(&ping, 1);
+        io->send_data(&ping, 1);
+        io->flush();
+      }
+    }
+    double rtt = std::chrono::duration<double, std::milli>(
+                     std::chrono::high_resolution_clock::now() - start)
+                     .count() /
+                 reps;
+    if (party == sci::ALICE) {
+      io->send_data(&rtt, sizeof(double));
+      io->flush();
+    } else {
+      io->recv_data(&rtt, sizeof(double));
+    }
+    return rtt;
+  }
+
+  // Estimated latency in ms of num_cmps comparisons in the round-reduced
+  // mode: one round for the leaf OTs and one per fused AND level, plus the
+  // bits of the OT tables and choice corrections at the link bandwidth.
+  double estimate_latency(int bitlength, int num_cmps, int radix,
+                          int k) const {
+    int digits = (bitlength + radix - 1) / radix;
+    double bits = digits * ((2.0 * (1 << radix)) + radix);
+    int rounds = 1;
+    for (int c = digits; c > 1; c = (c + k - 1) / k, rounds++) {
+      int m = std::min(k, c);
+      int nodes = c / k + (c % k > 1 ? 1 : 0);
+      bits += nodes * (2.0 * (1 << (2 * m)) + 2 * m);
+    }
+    return rounds * rtt_ms + bits * num_cmps / (bandwidth_mbps * 1e3);
+  }
+
+  // The (radix, fan-in) pair with the lowest estimated latency. Ties go to
+  // the smaller radix and fan-in.
+  void pick_parameters(int bitlength, int num_cmps, int &best_radix,
+                       int &best_fan_in) const {
+    double best = -1;
+    for (int b = 1; b <= std::min(bitlength, 8); b++) {
+      for (int k = 2; k <= max_fan_in; k++) {
+        double t = estimate_latency(bitlength, num_cmps, b, k);
+        if (best < 0 || t < best) {
+          best = t;
+          best_radix = b;
+          best_fan_in = k;
+        }
+      }
+    }
+  }
+
+  // If num_short > 0, the last num_short comparisons only take the lower
+  // short_bitlength bits of data (the upper bits are zero for both parties).
+  // Their upper digits are public leaves which skip the leaf OTs and the tree
+  // nodes above them, while the rounds are shared with the other comparisons.
   void compare(uint8_t *res, uint64_t *data, int num_cmps, int bitlength,
                bool greater_than = true, bool equality = false,
-               int radix_base = MILL_PARAM) {
-    
+               int radix_base = MILL_PARAM, int num_short = 0,
+               int short_bitlength = 0) {
+    sci::Arena::Scope scratch(arena);
+    if (round_reduced)
+      pick_parameters(bitlength, num_cmps, radix_base, fan_in);
     configure(bitlength, radix_base);
 
     if (bitlength <= beta) {
-      uint8_t N = 1 << bitlength;
+      int N = 1 << bitlength;
       uint8_t mask = N - 1;
       if (party == sci::ALICE) {
         sci::PRG128 prg;
         prg.random_data(res, num_cmps * sizeof(uint8_t));
-        uint8_t **leaf_messages = new uint8_t *[num_cmps];
+        uint8_t **leaf_messages = arena.alloc<uint8_t *>(num_cmps);
+        uint8_t *leaf_messages_data = arena.alloc<uint8_t>(num_cmps * N);
         for (int i = 0; i < num_cmps; i++) {
           res[i] &= 1;
-          leaf_messages[i] = new uint8_t[N];
+          leaf_messages[i] = leaf_messages_data + i * N;
           for (int j = 0; j < N; j++) {
             if (greater_than) {
               leaf_messages[i][j] = ((uint8_t(data[i] & mask) > j) ^ res[i]);
@@ -102,12 +202,8 @@ public:
         } else {
           otpack->iknp_straight->send(leaf_messages, num_cmps, 1);
         }
-
-        for (int i = 0; i < num_cmps; i++)
-          delete[] leaf_messages[i];
-        delete[] leaf_messages;
       } else { // party == BOB
-        uint8_t *choice = new uint8_t[num_cmps];
+        uint8_t *choice = arena.alloc<uint8_t>(num_cmps);
         for (int i = 0; i < num_cmps; i++) {
           choice[i] = data[i] & mask;
         }
@@ -116,8 +212,6 @@ public:
         } else {
           otpack->iknp_straight->recv(res, choice, num_cmps, 1);
         }
-
-        delete[] choice;
       }
       return;
     }
@@ -130,7 +224,7 @@ public:
     if (old_num_cmps == num_cmps)
       data_ext = data;
     else {
-      data_ext = new uint64_t[num_cmps];
+      data_ext = arena.alloc<uint64_t>(num_cmps);
       memcpy(data_ext, data, old_num_cmps * sizeof(uint64_t));
       memset(data_ext + old_num_cmps, 0,
              (num_cmps - old_num_cmps) * sizeof(uint64_t));
@@ -140,168 +234,108 @@ public:
     uint8_t *leaf_res_cmp; // num_digits * num_cmps
     uint8_t *leaf_res_eq;  // num_digits * num_cmps
 
-    digits = new uint8_t[num_digits * num_cmps];
-    leaf_res_cmp = new uint8_t[num_digits * num_cmps];
-    leaf_res_eq = new uint8_t[num_digits * num_cmps];
+    digits = arena.alloc<uint8_t>(num_digits * num_cmps);
+    leaf_res_cmp = arena.alloc<uint8_t>(num_digits * num_cmps);
+    leaf_res_eq = arena.alloc<uint8_t>(num_digits * num_cmps);
 
     // Extract radix-digits from data
     for (int i = 0; i < num_digits; i++) // Stored from LSB to MSB
-      for (int j = 0; j < num_cmps; j++)
-        if ((i == num_digits - 1) && (r != 0))
-          digits[i * num_cmps + j] =
-              (uint8_t)(data_ext[j] >> i * beta) & mask_r;
-        else
-          digits[i * num_cmps + j] =
-              (uint8_t)(data_ext[j] >> i * beta) & mask_beta;
-
+      sci::kernels::extract_digits(
+          digits + i * num_cmps, data_ext, num_cmps, i * beta,
+          ((i == num_digits - 1) && (r != 0)) ? mask_r : mask_beta);
+
+    // The digits of the short comparisons are in the columns past num_long,
+    // with the padding, and in the rows below short_digits
+    int num_long = old_num_cmps - num_short;
+    int short_digits = num_digits;
+    if (num_short > 0) {
+      short_digits = std::max(1, std::min(num_digits,
+                                          (short_bitlength + beta - 1) / beta));
+    }
+    auto row_width = [&](int i) {
+      return i < short_digits ? num_cmps : num_long;
+    };
 
+    uint8_t **leaf_ot_messages = nullptr; // (num_digits * num_cmps) X beta_pow
     if (party == sci::ALICE) {
-      uint8_t *
-          *leaf_ot_messages; // (num_digits * num_cmps) X beta_pow (=2^beta)
-      leaf_ot_messages = new uint8_t *[num_digits * num_cmps];
+      leaf_ot_messages = arena.alloc<uint8_t *>(num_digits * num_cmps);
+      uint8_t *leaf_ot_messages_data =
+          arena.alloc<uint8_t>(num_digits * num_cmps * beta_pow);
       for (int i = 0; i < num_digits * num_cmps; i++)
-        leaf_ot_messages[i] = new uint8_t[beta_pow];
+        leaf_ot_messages[i] = leaf_ot_messages_data + i * beta_pow;
 
       // Set Leaf OT messages
       triple_gen->prg->random_bool((bool *)leaf_res_cmp, num_digits * num_cmps);
       triple_gen->prg->random_bool((bool *)leaf_res_eq, num_digits * num_cmps);
 
       for (int i = 0; i < num_digits; i++) {
-        for (int j = 0; j < num_cmps; j++) {
-          if (i == 0) {
-            set_leaf_ot_messages(leaf_ot_messages[i * num_cmps + j],
-                                 digits[i * num_cmps + j], beta_pow,
-                                 leaf_res_cmp[i * num_cmps + j], 0,
-                                 greater_than, false);
-          } else if (i == (num_digits - 1) && (r > 0)) {
-#if defined(WAN_EXEC) || USE_CHEETAH
-            set_leaf_ot_messages(leaf_ot_messages[i * num_cmps + j],
-                                 digits[i * num_cmps + j], beta_pow,
-                                 leaf_res_cmp[i * num_cmps + j],
-                                 leaf_res_eq[i * num_cmps + j], greater_than);
-#else
-            set_leaf_ot_messages(leaf_ot_messages[i * num_cmps + j],
-                                 digits[i * num_cmps + j], 1 << r,
-                                 leaf_res_cmp[i * num_cmps + j],
-                                 leaf_res_eq[i * num_cmps + j], greater_than);
+        int N = beta_pow;
+#if !defined(WAN_EXEC) && !USE_CHEETAH
+        if (i == (num_digits - 1) && (r > 0)) N = 1 << r;
 #endif
-          } else {
-            set_leaf_ot_messages(leaf_ot_messages[i * num_cmps + j],
-                                 digits[i * num_cmps + j], beta_pow,
-                                 leaf_res_cmp[i * num_cmps + j],
-                                 leaf_res_eq[i * num_cmps + j], greater_than);
-          }
-        }
+        sci::kernels::leaf_ot_messages(
+            leaf_ot_messages_data + i * num_cmps * beta_pow, beta_pow,
+            digits + i * num_cmps, leaf_res_cmp + i * num_cmps,
+            leaf_res_eq + i * num_cmps, num_cmps, N, greater_than, i != 0);
       }
+    }
 
-      // Perform Leaf OTs
-#if defined(WAN_EXEC) || USE_CHEETAH
-      // otpack->kkot_beta->send(leaf_ot_messages, num_cmps*(num_digits), 2);
-      otpack->kkot[beta - 1]->send(leaf_ot_messages, num_cmps * (num_digits),
-                                   2);
-#else
-      // otpack->kkot_beta->send(leaf_ot_messages, num_cmps, 1);
-      otpack->kkot[beta - 1]->send(leaf_ot_messages, num_cmps, 1);
-      if (r == 1) {
-        // otpack->kkot_beta->send(leaf_ot_messages+num_cmps,
-        // num_cmps*(num_digits-2), 2);
-        otpack->kkot[beta - 1]->send(leaf_ot_messages + num_cmps,
-                                     num_cmps * (num_digits - 2), 2);
-        otpack->iknp_straight->send(
-            leaf_ot_messages + num_cmps * (num_digits - 1), num_cmps, 2);
-      } else if (r != 0) {
-        // otpack->kkot_beta->send(leaf_ot_messages+num_cmps,
-        // num_cmps*(num_digits-2), 2);
-        otpack->kkot[beta - 1]->send(leaf_ot_messages + num_cmps,
-                                     num_cmps * (num_digits - 2), 2);
-        otpack->kkot[r - 1]->send(
-            leaf_ot_messages + num_cmps * (num_digits - 1), num_cmps, 2);
-        /*
-                            if(r == 2){
-                                    otpack->kkot_4->send(leaf_ot_messages+num_cmps*(num_digits-1),
-           num_cmps, 2);
-                            }
-                            else if(r == 3){
-                                    otpack->kkot_8->send(leaf_ot_messages+num_cmps*(num_digits-1),
-           num_cmps, 2);
-                            }
-                            else if(r == 4){
-                                    otpack->kkot_16->send(leaf_ot_messages+num_cmps*(num_digits-1),
-           num_cmps, 2);
-                            }
-                            else{
-                                    throw std::invalid_argument("Not yet
-           implemented!");
-                            }
-        */
+    // Leaf OTs of the digits in rows [row_begin, row_end), one batch. The
+    // public leaves are left out of the batch.
+    auto leaf_ots = [&](auto *ot, int row_begin, int row_end, int msg_len) {
+      int64_t n = 0;
+      for (int i = row_begin; i < row_end; i++) n += row_width(i);
+      if (n == 0) return;
+      if (n == (int64_t)(row_end - row_begin) * num_cmps) {
+        if (party == sci::ALICE) {
+          ot->send(leaf_ot_messages + row_begin * num_cmps, n, msg_len);
+        } else {
+          ot->recv(leaf_res_cmp + row_begin * num_cmps,
+                   digits + row_begin * num_cmps, n, msg_len);
+        }
+        return;
+      }
+      sci::Arena::Scope ot_scratch(arena);
+      if (party == sci::ALICE) {
+        uint8_t **messages = arena.alloc<uint8_t *>(n);
+        for (int i = row_begin, k = 0; i < row_end; i++) {
+          memcpy(messages + k, leaf_ot_messages + i * num_cmps,
+                 row_width(i) * sizeof(uint8_t *));
+          k += row_width(i);
+        }
+        ot->send(messages, n, msg_len);
       } else {
-        // otpack->kkot_beta->send(leaf_ot_messages+num_cmps,
-        // num_cmps*(num_digits-1), 2);
-        otpack->kkot[beta - 1]->send(leaf_ot_messages + num_cmps,
-                                     num_cmps * (num_digits - 1), 2);
+        uint8_t *choice = arena.alloc<uint8_t>(n);
+        uint8_t *out = arena.alloc<uint8_t>(n);
+        for (int i = row_begin, k = 0; i < row_end; i++) {
+          memcpy(choice + k, digits + i * num_cmps, row_width(i));
+          k += row_width(i);
+        }
+        ot->recv(out, choice, n, msg_len);
+        for (int i = row_begin, k = 0; i < row_end; i++) {
+          memcpy(leaf_res_cmp + i * num_cmps, out + k, row_width(i));
+          k += row_width(i);
+        }
       }
-#endif
+    };
 
-      // Cleanup
-      for (int i = 0; i < num_digits * num_cmps; i++)
-        delete[] leaf_ot_messages[i];
-      delete[] leaf_ot_messages;
-    } else // party = sci::BOB
-    {
-      // Perform Leaf OTs
+    // Perform Leaf OTs
 #if defined(WAN_EXEC) || USE_CHEETAH
-      // otpack->kkot_beta->recv(leaf_res_cmp, digits, num_cmps*(num_digits),
-      // 2);
-      otpack->kkot[beta - 1]->recv(leaf_res_cmp, digits,
-                                   num_cmps * (num_digits), 2);
+    leaf_ots(otpack->kkot[beta - 1], 0, num_digits, 2);
 #else
-      // otpack->kkot_beta->recv(leaf_res_cmp, digits, num_cmps, 1);
-      otpack->kkot[beta - 1]->recv(leaf_res_cmp, digits, num_cmps, 1);
-      if (r == 1) {
-        // otpack->kkot_beta->recv(leaf_res_cmp+num_cmps, digits+num_cmps,
-        // num_cmps*(num_digits-2), 2);
-        otpack->kkot[beta - 1]->recv(leaf_res_cmp + num_cmps, digits + num_cmps,
-                                     num_cmps * (num_digits - 2), 2);
-        otpack->iknp_straight->recv(leaf_res_cmp + num_cmps * (num_digits - 1),
-                                    digits + num_cmps * (num_digits - 1),
-                                    num_cmps, 2);
-      } else if (r != 0) {
-        // otpack->kkot_beta->recv(leaf_res_cmp+num_cmps, digits+num_cmps,
-        // num_cmps*(num_digits-2), 2);
-        otpack->kkot[beta - 1]->recv(leaf_res_cmp + num_cmps, digits + num_cmps,
-                                     num_cmps * (num_digits - 2), 2);
-        otpack->kkot[r - 1]->recv(leaf_res_cmp + num_cmps * (num_digits - 1),
-                                  digits + num_cmps * (num_digits - 1),
-                                  num_cmps, 2);
-        /*
-                            if(r == 2){
-                                    otpack->kkot_4->recv(leaf_res_cmp+num_cmps*(num_digits-1),
-                                                    digits+num_cmps*(num_digits-1),
-           num_cmps, 2);
-                            }
-                            else if(r == 3){
-                                    otpack->kkot_8->recv(leaf_res_cmp+num_cmps*(num_digits-1),
-                                                    digits+num_cmps*(num_digits-1),
-           num_cmps, 2);
-                            }
-                            else if(r == 4){
-                                    otpack->kkot_16->recv(leaf_res_cmp+num_cmps*(num_digits-1),
-                                                    digits+num_cmps*(num_digits-1),
-           num_cmps, 2);
-                            }
-                            else{
-                                    throw std::invalid_argument("Not yet
-           implemented!");
-                            }
-        */
-      } else {
-        // otpack->kkot_beta->recv(leaf_res_cmp+num_cmps, digits+num_cmps,
-        // num_cmps*(num_digits-1), 2);
-        otpack->kkot[beta - 1]->recv(leaf_res_cmp + num_cmps, digits + num_cmps,
-                                     num_cmps * (num_digits - 1), 2);
-      }
+    leaf_ots(otpack->kkot[beta - 1], 0, 1, 1);
+    if (r == 1) {
+      leaf_ots(otpack->kkot[beta - 1], 1, num_digits - 1, 2);
+      leaf_ots(otpack->iknp_straight, num_digits - 1, num_digits, 2);
+    } else if (r != 0) {
+      leaf_ots(otpack->kkot[beta - 1], 1, num_digits - 1, 2);
+      leaf_ots(otpack->kkot[r - 1], num_digits - 1, num_digits, 2);
+    } else {
+      leaf_ots(otpack->kkot[beta - 1], 1, num_digits, 2);
+    }
 #endif
 
+    if (party == sci::BOB) {
       // Extract equality result from leaf_res_cmp
       for (int i = num_cmps; i < num_digits * num_cmps; i++) {
         leaf_res_eq[i] = leaf_res_cmp[i] & 1;
@@ -309,17 +343,25 @@ public:
       }
     }
 
-    traverse_and_compute_ANDs(num_cmps, leaf_res_eq, leaf_res_cmp);
+    // The upper digits of the short comparisons are zero on both sides:
+    // shares of lt = 0 and eq = 1
+    for (int i = short_digits; i < num_digits; i++) {
+      memset(leaf_res_cmp + i * num_cmps + num_long, 0, num_cmps - num_long);
+      memset(leaf_res_eq + i * num_cmps + num_long,
+             party == sci::ALICE ? 1 : 0, num_cmps - num_long);
+    }
+
+    if (round_reduced) {
+      traverse_fused(num_cmps, leaf_res_eq, leaf_res_cmp, num_long,
+                     short_digits);
+    } else {
+      // The ANDs are packed, so only whole bytes of public leaves are skipped
+      traverse_and_compute_ANDs(num_cmps, leaf_res_eq, leaf_res_cmp,
+                                ceil(num_long / 8.0) * 8, short_digits);
+    }
 
     for (int i = 0; i < old_num_cmps; i++)
       res[i] = leaf_res_cmp[i];
-
-    // Cleanup
-    if (old_num_cmps != num_cmps)
-      delete[] data_ext;
-    delete[] digits;
-    delete[] leaf_res_cmp;
-    delete[] leaf_res_eq;
   }
 
   void set_leaf_ot_messages(uint8_t *ot_messages, uint8_t digit, int N,
@@ -337,257 +379,294 @@ public:
     }
   }
 
+  /**************************************************************************************************
+   *                         Fused AND tree (round-reduced mode)
+   **************************************************************************************************/
+
+  // (lt, eq) of a node from the packed (lt_t, eq_t) of its m children, least
+  // significant child first: bit 2t is lt_t and bit 2t+1 is eq_t.
+  static uint8_t fused_node(uint32_t x, int m) {
+    uint8_t lt = 0, eq = 1;
+    for (int t = 0; t < m; t++) {
+      uint8_t lt_t = (x >> (2 * t)) & 1;
+      uint8_t eq_t = (x >> (2 * t + 1)) & 1;
+      lt = lt_t ^ (eq_t & lt);
+      eq &= eq_t;
+    }
+    return (lt << 1) | eq;
+  }
+
+  // Combines the num_digits leaves of each comparison with fan_in-ary nodes.
+  // BOB's packed shares of a node's children are the choice of a 1-out-of-N
+  // OT in which ALICE's table maps them to the node output masked by her
+  // random output shares. There are only N * 4 distinct tables per level, so
+  // the OT messages point into a bank of precomputed tables. The output of
+  // node g overwrites row g of leaf_res_cmp and leaf_res_eq. In the columns
+  // past num_long, the rows from short_digits up are public leaves, and a node
+  // with only one private child passes it through without an OT.
+  void traverse_fused(int num_cmps, uint8_t *leaf_res_eq,
+                      uint8_t *leaf_res_cmp, int num_long = -1,
+                      int short_digits = 0) {
+    sci::Arena::Scope scratch(arena);
+    if (num_long < 0) num_long = num_cmps;
+    int short_rows = short_digits > 0 ? short_digits : num_digits;
+    // The lowest digit has no equality bit, and the equality output of the
+    // lowest node is never used.
+    memset(leaf_res_eq, 0, num_cmps);
+    for (int c = num_digits; c > 1; c = (c + fan_in - 1) / fan_in) {
+      int m_max = std::min(fan_in, c);
+      int num_nodes = (c + fan_in - 1) / fan_in;
+      int m_last = c - (num_nodes - 1) * fan_in;
+      // A lone last child passes through to the next level
+      int num_ot_nodes = num_nodes - (m_last == 1 ? 1 : 0);
+      int bits = 2 * m_max;
+      int N = 1 << bits;
+      // Node g only takes OTs in the columns where its second child is private
+      int64_t *node_begin = arena.alloc<int64_t>(num_ot_nodes + 1);
+      auto node_width = [&](int g) {
+        return g * fan_in + 1 < short_rows ? num_cmps : num_long;
+      };
+      node_begin[0] = 0;
+      for (int g = 0; g < num_ot_nodes; g++)
+        node_begin[g + 1] = node_begin[g] + node_width(g);
+      int64_t num_ots = node_begin[num_ot_nodes];
+
+      // Packs the shares of node g's children for comparison j
+      auto pack_shares = [&](int g, int j) {
+        int m = (g == num_nodes - 1) ? m_last : m_max;
+        uint32_t x = 0;
+        for (int t = 0; t < m; t++) {
+          int row = g * fan_in + t;
+          x |= (uint32_t)(leaf_res_cmp[row * num_cmps + j] & 1) << (2 * t);
+          x |= (uint32_t)(leaf_res_eq[row * num_cmps + j] & 1) << (2 * t + 1);
+        }
+        return x;
+      };
+
+      uint8_t *out = arena.alloc<uint8_t>(num_ots);
+      if (party == sci::ALICE) {
+        // bank[m][(a << 2) | r][x] = fused_node(x ^ a, m) ^ r
+        uint8_t *bank[2];
+        int bank_m[2] = {m_max, m_last};
+        for (int v = 0; v < 2; v++) {
+          if (v == 1 && (m_last == m_max || m_last == 1)) {
+            bank[1] = bank[0];
+            continue;
+          }
+          bank[v] = arena.alloc<uint8_t>((size_t)N * 4 * N);
+          for (int a = 0; a < N; a++)
+            for (int r = 0; r < 4; r++)
+              for (int x = 0; x < N; x++)
+                bank[v][((size_t)a * 4 + r) * N + x] =
+                    fused_node(x ^ a, bank_m[v]) ^ r;
+        }
+        triple_gen->prg->random_data(out, num_ots);
+        uint8_t **ot_messages = arena.alloc<uint8_t *>(num_ots);
+        for (int g = 0; g < num_ot_nodes; g++) {
+          uint8_t *node_bank = bank[g == num_nodes - 1 ? 1 : 0];
+          for (int j = 0; j < node_width(g); j++) {
+            int64_t idx = node_begin[g] + j;
+            out[idx] &= 3;
+            ot_messages[idx] =
+                node_bank + ((size_t)pack_shares(g, j) * 4 + out[idx]) * N;
+          }
+        }
+        otpack->kkot[bits - 1]->send(ot_messages, num_ots, 2);
+      } else { // party == sci::BOB
+        uint8_t *choice = arena.alloc<uint8_t>(num_ots);
+        for (int g = 0; g < num_ot_nodes; g++)
+          for (int j = 0; j < node_width(g); j++)
+            choice[node_begin[g] + j] = pack_shares(g, j);
+        otpack->kkot[bits - 1]->recv(out, choice, num_ots, 2);
+      }
+
+      for (int g = 0; g < num_ot_nodes; g++) {
+        int w = node_width(g);
+        for (int j = 0; j < w; j++) {
+          uint8_t v = out[node_begin[g] + j];
+          leaf_res_cmp[g * num_cmps + j] = v >> 1;
+          leaf_res_eq[g * num_cmps + j] = v & 1;
+        }
+        if (g > 0 && w < num_cmps) {
+          memmove(leaf_res_cmp + g * num_cmps + w,
+                  leaf_res_cmp + g * fan_in * num_cmps + w, num_cmps - w);
+          memmove(leaf_res_eq + g * num_cmps + w,
+                  leaf_res_eq + g * fan_in * num_cmps + w, num_cmps - w);
+        }
+      }
+      if (num_ot_nodes < num_nodes) {
+        int g = num_nodes - 1;
+        memmove(leaf_res_cmp + g * num_cmps,
+                leaf_res_cmp + g * fan_in * num_cmps, num_cmps);
+        memmove(leaf_res_eq + g * num_cmps,
+                leaf_res_eq + g * fan_in * num_cmps, num_cmps);
+      }
+      short_rows = (short_rows + fan_in - 1) / fan_in;
+    }
+  }
+
   /**************************************************************************************************
    *                         AND computation related functions
    **************************************************************************************************/
 
+  // Combines the leaves in a binary tree of AND gates. Node (j, i) merges
+  // rows j and j + i; in the columns past num_long its upper child is a public
+  // leaf (lt = 0, eq = 1) when j + i >= short_digits, so the node passes its
+  // lower child through without ANDs. num_long is a multiple of 8.
   void traverse_and_compute_ANDs(int num_cmps, uint8_t *leaf_res_eq,
-                                 uint8_t *leaf_res_cmp) {
+                                 uint8_t *leaf_res_cmp, int num_long = -1,
+                                 int short_digits = 0) {
+    if (num_long < 0) num_long = num_cmps;
+    auto node_width = [&](int j, int i) {
+      return j + i < short_digits ? num_cmps : num_long;
+    };
+    int num_std = 0, num_corr = 0;
+    for (int i = 1; i < num_digits; i *= 2) {
+      for (int j = 0; j < num_digits and j + i < num_digits; j += 2 * i) {
+        if (j == 0)
+          num_std += node_width(j, i);
+        else
+          num_corr += node_width(j, i);
+      }
+    }
+
+    // (a, b, c) of the ANDs of the nodes with j == 0, and of the first and
+    // second of the two ANDs of the other nodes
+    sci::Arena::Scope scratch(arena);
+    uint8_t *t_std[3], *t_corr[2][3];
 #if defined(WAN_EXEC) || USE_CHEETAH
-    Triple triples_std((num_triples)*num_cmps, true);
+    Triple triples_std(num_std + 2 * num_corr, true);
 #else
-    Triple triples_corr(num_triples_corr * num_cmps, true, num_cmps);
-    Triple triples_std(num_triples_std * num_cmps, true);
+    // With an offset of 8, the correlated pairs are in alternate bytes
+    Triple triples_corr(2 * num_corr, true, 8);
+    Triple triples_std(num_std, true);
 #endif
     // Generate required Bit-Triples
 #if USE_CHEETAH
     triple_gen->generate(party, &triples_std, _2ROT);
 #elif defined(WAN_EXEC)
-    // std::cout<<"Running on WAN_EXEC; Skipping correlated triples"<<std::endl;
     triple_gen->generate(party, &triples_std, _16KKOT_to_4OT);
 #else
     triple_gen->generate(party, &triples_corr, _8KKOT);
     triple_gen->generate(party, &triples_std, _16KKOT_to_4OT);
 #endif
-    // std::cout << "Bit Triples Generated" << std::endl;
+    uint8_t *std_abc[3] = {triples_std.ai, triples_std.bi, triples_std.ci};
+#if defined(WAN_EXEC) || USE_CHEETAH
+    for (int t = 0; t < 3; t++) {
+      t_std[t] = std_abc[t];
+      t_corr[0][t] = std_abc[t] + num_std / 8;
+      t_corr[1][t] = std_abc[t] + (num_std + num_corr) / 8;
+    }
+#else
+    uint8_t *corr_abc[3] = {triples_corr.ai, triples_corr.bi, triples_corr.ci};
+    for (int t = 0; t < 3; t++) {
+      t_std[t] = std_abc[t];
+      t_corr[0][t] = arena.alloc<uint8_t>(num_corr / 8);
+      t_corr[1][t] = arena.alloc<uint8_t>(num_corr / 8);
+      for (int m = 0; m < num_corr / 8; m++) {
+        t_corr[0][t][m] = corr_abc[t][2 * m];
+        t_corr[1][t][m] = corr_abc[t][2 * m + 1];
+      }
+    }
+#endif
 
-    // Combine leaf OT results in a bottom-up fashion
-    int counter_std = 0, old_counter_std = 0;
-    int counter_corr = 0, old_counter_corr = 0;
-    int counter_combined = 0, old_counter_combined = 0;
-    uint8_t *ei = new uint8_t[(num_triples * num_cmps) / 8];
-    uint8_t *fi = new uint8_t[(num_triples * num_cmps) / 8];
-    uint8_t *e = new uint8_t[(num_triples * num_cmps) / 8];
-    uint8_t *f = new uint8_t[(num_triples * num_cmps) / 8];
+    // Combine leaf OT results in a bottom-up fashion. The ANDs of a level are
+    // contiguous in ei and fi, and the triples are used in order.
+    int max_bytes = (num_std + 2 * num_corr) / 8;
+    uint8_t *ei = arena.alloc<uint8_t>(max_bytes);
+    uint8_t *fi = arena.alloc<uint8_t>(max_bytes);
+    uint8_t *e = arena.alloc<uint8_t>(max_bytes);
+    uint8_t *f = arena.alloc<uint8_t>(max_bytes);
+    int counter_std = 0, counter_corr = 0;
 
     for (int i = 1; i < num_digits; i *= 2) {
+      int pos = 0, s = counter_std, c = counter_corr;
       for (int j = 0; j < num_digits and j + i < num_digits; j += 2 * i) {
+        int w = node_width(j, i);
         if (j == 0) {
-#if defined(WAN_EXEC) || USE_CHEETAH
-          AND_step_1(
-              ei + (counter_std * num_cmps) / 8,
-              fi + (counter_std * num_cmps) / 8, leaf_res_cmp + j * num_cmps,
-              leaf_res_eq + (j + i) * num_cmps,
-              (triples_std.ai) + (counter_combined * num_cmps) / 8,
-              (triples_std.bi) + (counter_combined * num_cmps) / 8, num_cmps);
-          counter_std++;
-          counter_combined++;
-#else
-          AND_step_1(ei + (counter_std * num_cmps) / 8,
-                     fi + (counter_std * num_cmps) / 8,
-                     leaf_res_cmp + j * num_cmps,
-                     leaf_res_eq + (j + i) * num_cmps,
-                     (triples_std.ai) + (counter_std * num_cmps) / 8,
-                     (triples_std.bi) + (counter_std * num_cmps) / 8, num_cmps);
-          counter_std++;
-#endif
+          AND_step_1(ei + pos / 8, fi + pos / 8, leaf_res_cmp + j * num_cmps,
+                     leaf_res_eq + (j + i) * num_cmps, t_std[0] + s / 8,
+                     t_std[1] + s / 8, w);
+          pos += w;
+          s += w;
         } else {
-#if defined(WAN_EXEC) || USE_CHEETAH
-          AND_step_1(
-              ei + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-              fi + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-              leaf_res_cmp + j * num_cmps, leaf_res_eq + (j + i) * num_cmps,
-              (triples_std.ai) + (counter_combined * num_cmps) / 8,
-              (triples_std.bi) + (counter_combined * num_cmps) / 8, num_cmps);
-          counter_combined++;
-          AND_step_1(
-              ei + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              fi + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              leaf_res_eq + j * num_cmps, leaf_res_eq + (j + i) * num_cmps,
-              (triples_std.ai) + (counter_combined * num_cmps) / 8,
-              (triples_std.bi) + (counter_combined * num_cmps) / 8, num_cmps);
-          counter_combined++;
-          counter_corr++;
-#else
-          AND_step_1(
-              ei + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-              fi + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-              leaf_res_cmp + j * num_cmps, leaf_res_eq + (j + i) * num_cmps,
-              (triples_corr.ai) + (2 * counter_corr * num_cmps) / 8,
-              (triples_corr.bi) + (2 * counter_corr * num_cmps) / 8, num_cmps);
-          AND_step_1(
-              ei + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              fi + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              leaf_res_eq + j * num_cmps, leaf_res_eq + (j + i) * num_cmps,
-              (triples_corr.ai) + ((2 * counter_corr + 1) * num_cmps) / 8,
-              (triples_corr.bi) + ((2 * counter_corr + 1) * num_cmps) / 8,
-              num_cmps);
-          counter_corr++;
-#endif
+          AND_step_1(ei + pos / 8, fi + pos / 8, leaf_res_cmp + j * num_cmps,
+                     leaf_res_eq + (j + i) * num_cmps, t_corr[0][0] + c / 8,
+                     t_corr[0][1] + c / 8, w);
+          pos += w;
+          AND_step_1(ei + pos / 8, fi + pos / 8, leaf_res_eq + j * num_cmps,
+                     leaf_res_eq + (j + i) * num_cmps, t_corr[1][0] + c / 8,
+                     t_corr[1][1] + c / 8, w);
+          pos += w;
+          c += w;
         }
       }
-      int offset_std = (old_counter_std * num_cmps) / 8;
-      int size_std = ((counter_std - old_counter_std) * num_cmps) / 8;
-      int offset_corr =
-          ((num_triples_std + 2 * old_counter_corr) * num_cmps) / 8;
-      int size_corr = (2 * (counter_corr - old_counter_corr) * num_cmps) / 8;
+      int size = pos / 8;
 
       if (party == sci::ALICE) {
-        io->send_data(ei + offset_std, size_std);
-        io->send_data(ei + offset_corr, size_corr);
-        io->send_data(fi + offset_std, size_std);
-        io->send_data(fi + offset_corr, size_corr);
-        io->recv_data(e + offset_std, size_std);
-        io->recv_data(e + offset_corr, size_corr);
-        io->recv_data(f + offset_std, size_std);
-        io->recv_data(f + offset_corr, size_corr);
+        io->send_data(ei, size);
+        io->send_data(fi, size);
+        io->recv_data(e, size);
+        io->recv_data(f, size);
       } else // party = sci::BOB
       {
-        io->recv_data(e + offset_std, size_std);
-        io->recv_data(e + offset_corr, size_corr);
-        io->recv_data(f + offset_std, size_std);
-        io->recv_data(f + offset_corr, size_corr);
-        io->send_data(ei + offset_std, size_std);
-        io->send_data(ei + offset_corr, size_corr);
-        io->send_data(fi + offset_std, size_std);
-        io->send_data(fi + offset_corr, size_corr);
-      }
-      for (int i = 0; i < size_std; i++) {
-        e[i + offset_std] ^= ei[i + offset_std];
-        f[i + offset_std] ^= fi[i + offset_std];
+        io->recv_data(e, size);
+        io->recv_data(f, size);
+        io->send_data(ei, size);
+        io->send_data(fi, size);
       }
-      for (int i = 0; i < size_corr; i++) {
-        e[i + offset_corr] ^= ei[i + offset_corr];
-        f[i + offset_corr] ^= fi[i + offset_corr];
+      for (int k = 0; k < size; k++) {
+        e[k] ^= ei[k];
+        f[k] ^= fi[k];
       }
 
-      counter_std = old_counter_std;
-      counter_corr = old_counter_corr;
-#if defined(WAN_EXEC) || USE_CHEETAH
-      counter_combined = old_counter_combined;
-#endif
+      pos = 0;
       for (int j = 0; j < num_digits and j + i < num_digits; j += 2 * i) {
+        int w = node_width(j, i);
         if (j == 0) {
-#if defined(WAN_EXEC) || USE_CHEETAH
-          AND_step_2(
-              leaf_res_cmp + j * num_cmps, e + (counter_std * num_cmps) / 8,
-              f + (counter_std * num_cmps) / 8,
-              ei + (counter_std * num_cmps) / 8,
-              fi + (counter_std * num_cmps) / 8,
-              (triples_std.ai) + (counter_combined * num_cmps) / 8,
-              (triples_std.bi) + (counter_combined * num_cmps) / 8,
-              (triples_std.ci) + (counter_combined * num_cmps) / 8, num_cmps);
-          counter_combined++;
-#else
-          AND_step_2(leaf_res_cmp + j * num_cmps,
-                     e + (counter_std * num_cmps) / 8,
-                     f + (counter_std * num_cmps) / 8,
-                     ei + (counter_std * num_cmps) / 8,
-                     fi + (counter_std * num_cmps) / 8,
-                     (triples_std.ai) + (counter_std * num_cmps) / 8,
-                     (triples_std.bi) + (counter_std * num_cmps) / 8,
-                     (triples_std.ci) + (counter_std * num_cmps) / 8, num_cmps);
-#endif
-          for (int k = 0; k < num_cmps; k++)
-            leaf_res_cmp[j * num_cmps + k] ^=
-                leaf_res_cmp[(j + i) * num_cmps + k];
-          counter_std++;
+          AND_step_2(leaf_res_cmp + j * num_cmps, e + pos / 8, f + pos / 8,
+                     ei + pos / 8, fi + pos / 8, t_std[0] + counter_std / 8,
+                     t_std[1] + counter_std / 8, t_std[2] + counter_std / 8,
+                     w);
+          pos += w;
+          counter_std += w;
         } else {
-#if defined(WAN_EXEC) || USE_CHEETAH
-          AND_step_2(leaf_res_cmp + j * num_cmps,
-                     e + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     f + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     ei + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     fi + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     (triples_std.ai) + (counter_combined * num_cmps) / 8,
-                     (triples_std.bi) + (counter_combined * num_cmps) / 8,
-                     (triples_std.ci) + (counter_combined * num_cmps) / 8,
-                     num_cmps);
-          counter_combined++;
-          AND_step_2(
-              leaf_res_eq + j * num_cmps,
-              e + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              f + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              ei + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              fi + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              (triples_std.ai) + (counter_combined * num_cmps) / 8,
-              (triples_std.bi) + (counter_combined * num_cmps) / 8,
-              (triples_std.ci) + (counter_combined * num_cmps) / 8, num_cmps);
-          counter_combined++;
-#else
-          AND_step_2(leaf_res_cmp + j * num_cmps,
-                     e + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     f + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     ei + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     fi + ((num_triples_std + 2 * counter_corr) * num_cmps) / 8,
-                     (triples_corr.ai) + (2 * counter_corr * num_cmps) / 8,
-                     (triples_corr.bi) + (2 * counter_corr * num_cmps) / 8,
-                     (triples_corr.ci) + (2 * counter_corr * num_cmps) / 8,
-                     num_cmps);
-          AND_step_2(
-              leaf_res_eq + j * num_cmps,
-              e + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              f + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              ei + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              fi + ((num_triples_std + (2 * counter_corr + 1)) * num_cmps) / 8,
-              (triples_corr.ai) + ((2 * counter_corr + 1) * num_cmps) / 8,
-              (triples_corr.bi) + ((2 * counter_corr + 1) * num_cmps) / 8,
-              (triples_corr.ci) + ((2 * counter_corr + 1) * num_cmps) / 8,
-              num_cmps);
-#endif
-          for (int k = 0; k < num_cmps; k++)
-            leaf_res_cmp[j * num_cmps + k] ^=
-                leaf_res_cmp[(j + i) * num_cmps + k];
-          counter_corr++;
+          AND_step_2(leaf_res_cmp + j * num_cmps, e + pos / 8, f + pos / 8,
+                     ei + pos / 8, fi + pos / 8,
+                     t_corr[0][0] + counter_corr / 8,
+                     t_corr[0][1] + counter_corr / 8,
+                     t_corr[0][2] + counter_corr / 8, w);
+          pos += w;
+          AND_step_2(leaf_res_eq + j * num_cmps, e + pos / 8, f + pos / 8,
+                     ei + pos / 8, fi + pos / 8,
+                     t_corr[1][0] + counter_corr / 8,
+                     t_corr[1][1] + counter_corr / 8,
+                     t_corr[1][2] + counter_corr / 8, w);
+          pos += w;
+          counter_corr += w;
         }
+        for (int k = 0; k < w; k++)
+          leaf_res_cmp[j * num_cmps + k] ^=
+              leaf_res_cmp[(j + i) * num_cmps + k];
       }
-      old_counter_std = counter_std;
-      old_counter_corr = counter_corr;
-#if defined(WAN_EXEC) || USE_CHEETAH
-      old_counter_combined = counter_combined;
-#endif
     }
 
-#if defined(WAN_EXEC) || USE_CHEETAH
-    assert(counter_combined == num_triples);
-#else
-    assert(counter_std == num_triples_std);
-    assert(2 * counter_corr == num_triples_corr);
-#endif
-
-    // cleanup
-    delete[] ei;
-    delete[] fi;
-    delete[] e;
-    delete[] f;
+    assert(counter_std == num_std);
+    assert(counter_corr == num_corr);
   }
 
   void AND_step_1(uint8_t *ei, // evaluates batch of 8 ANDs
                   uint8_t *fi, uint8_t *xi, uint8_t *yi, uint8_t *ai,
                   uint8_t *bi, int num_ANDs) {
     assert(num_ANDs % 8 == 0);
-    for (int i = 0; i < num_ANDs; i += 8) {
-      ei[i / 8] = ai[i / 8];
-      fi[i / 8] = bi[i / 8];
-      ei[i / 8] ^= sci::bool_to_uint8(xi + i, 8);
-      fi[i / 8] ^= sci::bool_to_uint8(yi + i, 8);
-    }
+    sci::kernels::and_step_1(ei, fi, xi, yi, ai, bi, num_ANDs);
   }
   void AND_step_2(uint8_t *zi, // evaluates batch of 8 ANDs
                   uint8_t *e, uint8_t *f, uint8_t *ei, uint8_t *fi, uint8_t *ai,
                   uint8_t *bi, uint8_t *ci, int num_ANDs) {
     assert(num_ANDs % 8 == 0);
-    for (int i = 0; i < num_ANDs; i += 8) {
-      uint8_t temp_z;
-      if (party == sci::ALICE)
-        temp_z = e[i / 8] & f[i / 8];
-      else
-        temp_z = 0;
-      temp_z ^= f[i / 8] & ai[i / 8];
-      temp_z ^= e[i / 8] & bi[i / 8];
-      temp_z ^= ci[i / 8];
-      sci::uint8_to_bool(zi + i, temp_z, 8);
-    }
+    sci::kernels::and_step_2(zi, e, f, ai, bi, ci, num_ANDs,
+                             party == sci::ALICE);
   }
 };
 
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "NonLinear/relu-field.h"
 #include "NonLinear/relu-ring.h"
+#include <algorithm>
+#include <vector>
 
 template <typename IO, typename type> class ArgMaxProtocol {
 public:
@@ -42,6 +44,8 @@ public:
   uint64_t mask_upper, mask_lower;
   bool createdReluObj = false;
   type mask_l;
+  // Scratch buffers of ArgMaxMPC(), released at the end of each call
+  sci::Arena arena;
 
   // Constructor
   ArgMaxProtocol(int party, int algeb_str, IO *io, int l, int b, uint64_t prime,
@@ -105,114 +109,258 @@ public:
   }
 
   void ArgMaxMPC(int size, type *inpArr, type *maxi, bool get_max_too = false, type *max_val = nullptr) {
+    ArgMaxRowsMPC(1, size, inpArr, maxi, get_max_too ? max_val : nullptr);
+  }
 
-    type *input_temp = new type[size + 16];
-    type *input_argmax_temp = new type[size + 16];
+  // Arg max of each row of the rows x size matrix inpArr, with the indices
+  // counted from idx_offset. The max is also written if max_val is not null.
+  void ArgMaxRowsMPC(int rows, int size, const type *inpArr, type *maxi,
+                     type *max_val = nullptr, int idx_offset = 0) {
+    sci::Arena::Scope scratch(arena);
+    type *idx = arena.alloc<type>((size_t)rows * size);
+    type *val = arena.alloc<type>(rows);
+    public_indices(rows, size, idx_offset, idx);
+    SelectMaxMPC(rows, size, inpArr, idx, val, maxi);
+    if (max_val != nullptr) {
+      memcpy(max_val, val, sizeof(type) * rows);
+    }
+  }
 
-    for (int i = 0; i < size; i++) {
-      input_temp[i] = inpArr[i];
-      input_argmax_temp[i] = 0;
+  // Secret shares of the public indices idx_offset + c of the columns c
+  void public_indices(int rows, int size, int idx_offset, type *idx) {
+    for (int r = 0; r < rows; r++) {
+      for (int c = 0; c < size; c++) {
+        idx[r * size + c] = (party == sci::ALICE) ? (type)(idx_offset + c) : 0;
+      }
     }
+  }
 
-    if (party == sci::ALICE) {
-      for (type i = 0; i < (type)size; i++) {
-        input_argmax_temp[i] = i;
+  // For each row of the rows x size candidates (val, idx), the pair with the
+  // largest val. The candidates are reduced as a tournament in which every
+  // level is one compare_and_select() batch over all the rows, so there are
+  // ceil(log2(size)) levels, each taking the rounds of one Millionaire and one
+  // select_pairs() whatever rows and size. If wins is not null, it receives
+  // the rows * (size - 1) comparison bits, level by level (see
+  // onehot_of_max()).
+  void SelectMaxMPC(int rows, int size, const type *val, const type *idx,
+                    type *out_val, type *out_idx, uint8_t *wins = nullptr) {
+    sci::Arena::Scope scratch(arena);
+    type *cur_val = arena.alloc<type>((size_t)rows * size);
+    type *cur_idx = arena.alloc<type>((size_t)rows * size);
+    memcpy(cur_val, val, sizeof(type) * rows * size);
+    memcpy(cur_idx, idx, sizeof(type) * rows * size);
+    int half_max = size / 2;
+    type *lhs_val = arena.alloc<type>((size_t)rows * half_max);
+    type *lhs_idx = arena.alloc<type>((size_t)rows * half_max);
+    type *rhs_val = arena.alloc<type>((size_t)rows * half_max);
+    type *rhs_idx = arena.alloc<type>((size_t)rows * half_max);
+    for (int n = size; n > 1; n = (n + 1) / 2) {
+      int half = n / 2;
+      for (int r = 0; r < rows; r++) {
+        for (int i = 0; i < half; i++) {
+          lhs_val[r * half + i] = cur_val[r * n + 2 * i];
+          lhs_idx[r * half + i] = cur_idx[r * n + 2 * i];
+          rhs_val[r * half + i] = cur_val[r * n + 2 * i + 1];
+          rhs_idx[r * half + i] = cur_idx[r * n + 2 * i + 1];
+        }
+      }
+      compare_and_select(rows * half, lhs_val, lhs_idx, rhs_val, rhs_idx,
+                         lhs_val, lhs_idx, wins);
+      if (wins != nullptr) wins += (size_t)rows * half;
+      // Row r of the next level: the pair winners, then the odd one out
+      int next = (n + 1) / 2;
+      for (int r = 0; r < rows; r++) {
+        type carry_val = cur_val[r * n + n - 1];
+        type carry_idx = cur_idx[r * n + n - 1];
+        memcpy(cur_val + r * next, lhs_val + r * half, sizeof(type) * half);
+        memcpy(cur_idx + r * next, lhs_idx + r * half, sizeof(type) * half);
+        if (n & 1) {
+          cur_val[r * next + half] = carry_val;
+          cur_idx[r * next + half] = carry_idx;
+        }
+      }
+    }
+    for (int r = 0; r < rows; r++) {
+      out_val[r] = cur_val[r];
+      out_idx[r] = cur_idx[r];
+      if (this->algeb_str == RING) {
+        out_val[r] &= mask_l;
+        out_idx[r] &= mask_l;
       }
     }
+    io->flush();
+  }
 
-    if (size & 1) {
-      input_temp[size] = input_temp[size - 1];
-      input_argmax_temp[size] = input_argmax_temp[size - 1];
-      size += 1;
-    }
-
-    type *compare_with = new type[size + 16];
-    type *compare_with_argmax = new type[size + 16];
-    type *relu_res = new type[size + 16];
-    type *argmax_res = new type[size + 16];
-    int no_of_nodes = size;
-    int no_of_nodes_child;
-    int pad1, pad2;
-    int times_stuck_on_8 = 0;
-
-    while (no_of_nodes > 1) {
-      // std::cout<<"#nodes = "<<no_of_nodes<<std::endl;
-      no_of_nodes_child = (int)ceil((float)no_of_nodes / (float)2);
-      pad1 = next_eight_multiple(no_of_nodes_child);
-      pad1 = pad1 - no_of_nodes_child;
-      pad2 = no_of_nodes + 2 * pad1;
-      no_of_nodes_child += pad1;
-      if (no_of_nodes_child == 8) {
-        times_stuck_on_8++;
+  // The k largest elements of each row of the rows x size matrix inpArr, in
+  // decreasing order: topIdx and topVal are rows x k. After each tournament,
+  // the winner is pushed below all the other elements, which requires the
+  // inputs to lie in [-2^(l-3), 2^(l-3)). Ring only.
+  void TopKMPC(int rows, int size, int k, const type *inpArr, type *topIdx,
+               type *topVal = nullptr) {
+    assert(this->algeb_str == RING && "TopKMPC supports the ring only");
+    assert(k >= 1 && k <= size);
+    sci::Arena::Scope scratch(arena);
+    type *val = arena.alloc<type>((size_t)rows * size);
+    type *idx = arena.alloc<type>((size_t)rows * size);
+    type *max_val = arena.alloc<type>(rows);
+    type *max_idx = arena.alloc<type>(rows);
+    uint8_t *wins = arena.alloc<uint8_t>((size_t)rows * (size - 1) + 1);
+    uint8_t *onehot = arena.alloc<uint8_t>((size_t)rows * size);
+    uint64_t *onehot_ring = arena.alloc<uint64_t>((size_t)rows * size);
+    memcpy(val, inpArr, sizeof(type) * rows * size);
+    public_indices(rows, size, 0, idx);
+
+    for (int j = 0; j < k; j++) {
+      SelectMaxMPC(rows, size, val, idx, max_val, max_idx,
+                   (j + 1 < k) ? wins : nullptr);
+      for (int r = 0; r < rows; r++) {
+        topIdx[r * k + j] = max_idx[r];
+        if (topVal != nullptr) topVal[r * k + j] = max_val[r];
       }
+      if (j + 1 == k) break;
 
-      if (times_stuck_on_8 >= 5) {
-        // The backend code only supports a minimum batch size of 8
-        // So, whenever we have less than 8 child nodes, we pad it to get 8
-        // nodes. The child nodes are = 8 in the following cases: #parentnodes =
-        // 16, 8, 4, 2, 1. We will get the argmax result when parent nodes = 1.
-        // So, times_stuck_on_8 >= 5.
-        break;
+      // val -= 2^(l-2) * onehot; two bits of the arithmetic share suffice
+      onehot_of_max(rows, size, wins, onehot);
+      relu_oracle->aux->B2A(onehot, onehot_ring, rows * size, 2);
+      for (int i = 0; i < rows * size; i++) {
+        val[i] = (val[i] - (type)(onehot_ring[i] << (this->l - 2))) & mask_l;
       }
+    }
+  }
 
-      for (int i = no_of_nodes; i < pad2; i++) {
-        input_temp[i] = input_temp[no_of_nodes - 1];
-        input_argmax_temp[i] = input_argmax_temp[no_of_nodes - 1];
+  // XOR shares of the indicator of the winner of each row of SelectMaxMPC(),
+  // from its comparison bits wins. The tournament is walked back from the
+  // root, one batch of ANDs per level.
+  void onehot_of_max(int rows, int size, const uint8_t *wins,
+                     uint8_t *onehot) {
+    sci::Arena::Scope scratch(arena);
+    std::vector<int> level_size{size};
+    std::vector<size_t> wins_offset{0};
+    while (level_size.back() > 1) {
+      wins_offset.push_back(wins_offset.back() +
+                            (size_t)rows * (level_size.back() / 2));
+      level_size.push_back((level_size.back() + 1) / 2);
+    }
+    uint8_t *cur = arena.alloc<uint8_t>((size_t)rows * size);
+    uint8_t *next = arena.alloc<uint8_t>((size_t)rows * size);
+    uint8_t *parent = arena.alloc<uint8_t>((size_t)rows * size);
+    uint8_t *left = arena.alloc<uint8_t>((size_t)rows * size);
+    for (int r = 0; r < rows; r++) {
+      cur[r] = (party == sci::ALICE) ? 1 : 0;
+    }
+    for (int j = (int)level_size.size() - 2; j >= 0; j--) {
+      int n = level_size[j];
+      int half = n / 2;
+      int up = level_size[j + 1];
+      for (int r = 0; r < rows; r++) {
+        memcpy(parent + r * half, cur + r * up, half);
       }
+      // The left child of a pair is the winner iff its parent is and it
+      // won the comparison, the right one iff its parent is and it lost
+      relu_oracle->aux->AND(parent, (uint8_t *)wins + wins_offset[j], left,
+                            rows * half);
+      for (int r = 0; r < rows; r++) {
+        for (int i = 0; i < half; i++) {
+          next[r * n + 2 * i] = left[r * half + i];
+          next[r * n + 2 * i + 1] = cur[r * up + i] ^ left[r * half + i];
+        }
+        if (n & 1) next[r * n + n - 1] = cur[r * up + half];
+      }
+      std::swap(cur, next);
+    }
+    memcpy(onehot, cur, (size_t)rows * size);
+  }
 
+  // Fused compare-and-select for n pairs of candidates:
+  // (out_val, out_idx) = (a_val >= b_val) ? (a_val, a_idx) : (b_val, b_idx).
+  // In the ring, value and index are selected by one multiplexer on the
+  // comparison bit, whose correlated OTs carry both differences under the
+  // same choice bit. The outputs may alias the inputs. a_wins receives the
+  // XOR shares of the comparison bits if not null.
+  void compare_and_select(int n, const type *a_val, const type *a_idx,
+                          const type *b_val, const type *b_idx,
+                          type *out_val, type *out_idx,
+                          uint8_t *a_wins = nullptr) {
+    if (n == 0) return;
+    sci::Arena::Scope scratch(arena);
+    // The backend needs batches of multiples of 8
+    int n_pad = next_eight_multiple(n);
+    type *diff_val = arena.alloc<type>(n_pad);
+    type *diff_idx = arena.alloc<type>(n_pad);
+    type *sel_val = arena.alloc<type>(n_pad);
+    type *sel_idx = arena.alloc<type>(n_pad);
+    for (int i = 0; i < n; i++) {
       if (this->algeb_str == FIELD) {
-        for (int i = 0; i < (pad2); i += 2) {
-          compare_with[i / 2] = sci::neg_mod(
-              (int64_t)(input_temp[i] - input_temp[i + 1]), this->prime_mod);
-          compare_with_argmax[i / 2] = sci::neg_mod(
-              (int64_t)(input_argmax_temp[i] - input_argmax_temp[i + 1]),
-              this->prime_mod);
-        }
-      } else { // RING
-        for (int i = 0; i < (pad2); i += 2) {
-          compare_with[i / 2] = (input_temp[i] - input_temp[i + 1]);
-          compare_with_argmax[i / 2] = (input_argmax_temp[i] - input_argmax_temp[i + 1]);
-        }
+        diff_val[i] = sci::neg_mod((int64_t)a_val[i] - (int64_t)b_val[i],
+                                   this->prime_mod);
+        diff_idx[i] = sci::neg_mod((int64_t)a_idx[i] - (int64_t)b_idx[i],
+                                   this->prime_mod);
+      } else {
+        diff_val[i] = a_val[i] - b_val[i];
+        diff_idx[i] = a_idx[i] - b_idx[i];
       }
+    }
+    std::fill(diff_val + n, diff_val + n_pad, 0);
+    std::fill(diff_idx + n, diff_idx + n_pad, 0);
 
+    if (this->algeb_str == FIELD) {
       if (this->l > 32) {
-        argmax_this_level_super_32(argmax_res, relu_res, compare_with_argmax, compare_with, no_of_nodes_child);
+        argmax_this_level_super_32(sel_idx, sel_val, diff_idx, diff_val,
+                                   n_pad);
       } else {
-        argmax_this_level_sub_32(argmax_res, relu_res, compare_with_argmax, compare_with, no_of_nodes_child);
+        argmax_this_level_sub_32(sel_idx, sel_val, diff_idx, diff_val, n_pad);
       }
-
-      if (this->algeb_str == FIELD) {
-        for (int i = 0; i < (no_of_nodes_child); i++) {
-          input_temp[i] = (relu_res[i] + input_temp[2 * i + 1]) % this->prime_mod;
-          input_argmax_temp[i] = (argmax_res[i] + input_argmax_temp[2 * i + 1]) % this->prime_mod;
-        }
-      } else { // RING
-        for (int i = 0; i < (no_of_nodes_child); i++) {
-          input_temp[i] = (relu_res[i] + input_temp[2 * i + 1]) & mask_l;
-          input_argmax_temp[i] = (argmax_res[i] + input_argmax_temp[2 * i + 1]) & mask_l;
-        }
+      for (int i = 0; i < n; i++) {
+        out_val[i] = (sel_val[i] + b_val[i]) % this->prime_mod;
+        out_idx[i] = (sel_idx[i] + b_idx[i]) % this->prime_mod;
       }
-      no_of_nodes = no_of_nodes_child;
-    } // number of nodes > 1
-
-    maxi[0] = input_argmax_temp[0];
+      assert(a_wins == nullptr && "Comparison bits are not kept in the field");
+      return;
+    }
 
-    if (get_max_too) {
-      max_val[0] = input_temp[0];
+    uint8_t *drelu = arena.alloc<uint8_t>(n_pad);
+    // relu() returns the shares of the MSB, flip them to a_val >= b_val
+    relu_oracle->relu(sel_val, diff_val, n_pad, drelu, true);
+    if (party == sci::ALICE) {
+      for (int i = 0; i < n_pad; i++) drelu[i] ^= 1;
     }
-    if (this->algeb_str == RING) {
-      maxi[0] &= mask_l;
-      if (get_max_too) {
-        max_val[0] &= mask_l;
-      }
+    select_pairs(n_pad, drelu, diff_val, diff_idx, sel_val, sel_idx);
+    for (int i = 0; i < n; i++) {
+      out_val[i] = (sel_val[i] + b_val[i]) & mask_l;
+      out_idx[i] = (sel_idx[i] + b_idx[i]) & mask_l;
+    }
+    if (a_wins != nullptr) {
+      memcpy(a_wins, drelu, n);
     }
+  }
 
-    delete[] argmax_res;
-    delete[] relu_res;
-    delete[] compare_with_argmax;
-    delete[] compare_with;
-    delete[] input_temp;
-    delete[] input_argmax_temp;
+  // (sel_val, sel_idx) = sel * (x_val, x_idx) for XOR shared sel, as in
+  // AuxProtocols::multiplexer, with two correlations per choice bit.
+  void select_pairs(int n, const uint8_t *sel, const type *x_val,
+                    const type *x_idx, type *sel_val, type *sel_idx) {
+    sci::Arena::Scope scratch(arena);
+    uint64_t *corr = arena.alloc<uint64_t>(2 * n);
+    uint64_t *data_S = arena.alloc<uint64_t>(2 * n);
+    uint64_t *data_R = arena.alloc<uint64_t>(2 * n);
+    for (int i = 0; i < n; i++) {
+      uint64_t sign = 1 - 2 * uint64_t(sel[i]);
+      corr[2 * i] = (uint64_t(x_val[i]) * sign) & mask_l;
+      corr[2 * i + 1] = (uint64_t(x_idx[i]) * sign) & mask_l;
+    }
+    std::vector<int> msg_len{this->l};
+    sci::OTPack<IO> *ots = relu_oracle->otpack;
+    if (party == sci::ALICE) {
+      ots->iknp_straight->send_batched_cot(data_S, corr, msg_len, n, 2);
+      ots->iknp_reversed->recv_batched_cot(data_R, (bool *)sel, msg_len, n, 2);
+    } else { // party == sci::BOB
+      ots->iknp_straight->recv_batched_cot(data_R, (bool *)sel, msg_len, n, 2);
+      ots->iknp_reversed->send_batched_cot(data_S, corr, msg_len, n, 2);
+    }
+    for (int i = 0; i < n; i++) {
+      sel_val[i] = (x_val[i] * sel[i] + data_R[2 * i] - data_S[2 * i]) & mask_l;
+      sel_idx[i] =
+          (x_idx[i] * sel[i] + data_R[2 * i + 1] - data_S[2 * i + 1]) & mask_l;
+    }
   }
 
   /**************************************************************************************************
@@ -220,7 +368,8 @@ public:
    **************************************************************************************************/
 
   void argmax_this_level_super_32(type *argmax, type *result, type *indexshare, type *share, int num_relu) {
-    uint8_t *drelu_ans = new uint8_t[num_relu];
+    sci::Arena::Scope scratch(arena);
+    uint8_t *drelu_ans = arena.alloc<uint8_t>(num_relu);
 
     if (this->algeb_str == FIELD) {
       relu_field_oracle->relu(result, share, num_relu, drelu_ans, true);
@@ -230,13 +379,13 @@ public:
 
     // Now perform x.msb(x)
     // 2 OTs required with reversed roles
-    sci::block128 *ot_messages_0 = new sci::block128[num_relu];
-    sci::block128 *ot_messages_1 = new sci::block128[num_relu];
+    sci::block128 *ot_messages_0 = arena.alloc<sci::block128>(num_relu);
+    sci::block128 *ot_messages_1 = arena.alloc<sci::block128>(num_relu);
 
-    uint64_t *additive_masks = new uint64_t[num_relu * 2];
-    sci::block128 *received_shares = new sci::block128[num_relu];
-    uint64_t *received_shares_0 = new uint64_t[num_relu];
-    uint64_t *received_shares_1 = new uint64_t[num_relu];
+    uint64_t *additive_masks = arena.alloc<uint64_t>(num_relu * 2);
+    sci::block128 *received_shares = arena.alloc<sci::block128>(num_relu);
+    uint64_t *received_shares_0 = arena.alloc<uint64_t>(num_relu);
+    uint64_t *received_shares_1 = arena.alloc<uint64_t>(num_relu);
 
     if (this->algeb_str == FIELD) {
       this->relu_field_oracle->triple_gen->prg->template random_mod_p<type>(
@@ -290,14 +439,6 @@ public:
         argmax[i] %= this->prime_mod;
       }
     }
-
-    delete[] additive_masks;
-    delete[] received_shares;
-    delete[] received_shares_0;
-    delete[] received_shares_1;
-    delete[] ot_messages_0;
-    delete[] ot_messages_1;
-    delete[] drelu_ans;
   }
 
   void set_argmax_end_ot_messages_super_32(sci::block128 *ot_messages_0,
@@ -333,7 +474,8 @@ public:
 
   void argmax_this_level_sub_32(type *argmax, type *result, type *indexshare,
                                 type *share, int num_relu) {
-    uint8_t *drelu_ans = new uint8_t[num_relu];
+    sci::Arena::Scope scratch(arena);
+    uint8_t *drelu_ans = arena.alloc<uint8_t>(num_relu);
 
     if (this->algeb_str == FIELD) {
       relu_field_oracle->relu(result, share, num_relu, drelu_ans, true);
@@ -343,15 +485,16 @@ public:
 
     // Now perform x.msb(x)
     // 2 OTs required with reversed roles
-    uint64_t **ot_messages = new uint64_t *[num_relu];
+    uint64_t **ot_messages = arena.alloc<uint64_t *>(num_relu);
+    uint64_t *ot_messages_data = arena.alloc<uint64_t>(2 * num_relu);
     for (int i = 0; i < num_relu; i++) {
-      ot_messages[i] = new uint64_t[2];
+      ot_messages[i] = ot_messages_data + 2 * i;
     }
-    uint64_t *additive_masks = new uint64_t[2 * num_relu];
+    uint64_t *additive_masks = arena.alloc<uint64_t>(2 * num_relu);
 
-    uint64_t *received_shares = new uint64_t[num_relu];
-    uint64_t *received_shares_0 = new uint64_t[num_relu];
-    uint64_t *received_shares_1 = new uint64_t[num_relu];
+    uint64_t *received_shares = arena.alloc<uint64_t>(num_relu);
+    uint64_t *received_shares_0 = arena.alloc<uint64_t>(num_relu);
+    uint64_t *received_shares_1 = arena.alloc<uint64_t>(num_relu);
 
     if (this->algeb_str == FIELD) {
       this->relu_field_oracle->triple_gen->prg->template random_mod_p<type>(
@@ -418,15 +561,6 @@ public:
         argmax[i] %= this->prime_mod;
       }
     }
-    delete[] additive_masks;
-    delete[] received_shares;
-    delete[] received_shares_0;
-    delete[] received_shares_1;
-    delete[] drelu_ans;
-    for (int i = 0; i < num_relu; i++) {
-      delete[] ot_messages[i];
-    }
-    delete[] ot_messages;
   }
 
   void set_argmax_end_ot_messages_sub_32(uint64_t *ot_messages,
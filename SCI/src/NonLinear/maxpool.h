@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "NonLinear/relu-field.h"
 #include "NonLinear/relu-ring.h"
+#include <algorithm>
+#include <vector>
 
 template <typename IO, typename type> class MaxPoolProtocol {
 public:
@@ -38,6 +40,8 @@ public:
   int num_cmps;
   uint64_t prime_mod;
   type mask_l;
+  // Scratch buffers of funcMaxMPC(), released at the end of each call
+  sci::Arena arena;
 
   // Constructor
   MaxPoolProtocol(int party, int algeb_str, IO *io, int l, int b,
@@ -83,44 +87,260 @@ public:
     }
   }
 
+  // out[i] = max(a[i], b[i]) = ReLU(a[i] - b[i]) + b[i] for all i in one
+  // batch of comparisons. out may alias a or b.
+  void max_pairs(int n, const type *a, const type *b, type *out) {
+    if (n == 0) return;
+    sci::Arena::Scope scratch(arena);
+    int n_pad = ((n + 7) / 8) * 8;
+    type *diff = arena.alloc<type>(n_pad);
+    type *relu_out = arena.alloc<type>(n_pad);
+    if (this->algeb_str == FIELD) {
+      for (int i = 0; i < n; i++) {
+        diff[i] = sci::neg_mod((int64_t)((int64_t)a[i] - (int64_t)b[i]),
+                               this->prime_mod);
+      }
+      std::fill(diff + n, diff + n_pad, 0);
+      relu_field_oracle->relu(relu_out, diff, n_pad);
+      for (int i = 0; i < n; i++) {
+        out[i] = (relu_out[i] + b[i]) % this->prime_mod;
+      }
+    } else { // RING
+      for (int i = 0; i < n; i++) {
+        diff[i] = a[i] - b[i];
+      }
+      std::fill(diff + n, diff + n_pad, 0);
+      relu_oracle->relu(relu_out, diff, n_pad);
+      for (int i = 0; i < n; i++) {
+        out[i] = (relu_out[i] + b[i]) & mask_l;
+      }
+    }
+  }
+
+  // Max of each row of the rows x cols matrix inpArr. The columns are reduced
+  // as a tournament: every level compares disjoint pairs of all the rows in
+  // one batch, so there are ceil(log2(cols)) rounds of comparisons instead of
+  // cols - 1, with the same cols - 1 comparisons per row.
   void funcMaxMPC(int rows, int cols, type *inpArr, type *maxi, type *maxiIdx,
                   bool computeMaxIdx = false) {
-    type *max_temp = new type[rows];
-    type *compare_with = new type[rows];
-    if (this->algeb_str == FIELD) {
+    sci::Arena::Scope scratch(arena);
+    type *cur = arena.alloc<type>((size_t)rows * cols);
+    type *lhs = arena.alloc<type>((size_t)rows * (cols / 2));
+    type *rhs = arena.alloc<type>((size_t)rows * (cols / 2));
+    memcpy(cur, inpArr, sizeof(type) * rows * cols);
+    for (int n = cols; n > 1; n = (n + 1) / 2) {
+      int half = n / 2;
       for (int r = 0; r < rows; r++) {
-        max_temp[r] = inpArr[r * cols];
+        for (int i = 0; i < half; i++) {
+          lhs[r * half + i] = cur[r * n + 2 * i];
+          rhs[r * half + i] = cur[r * n + 2 * i + 1];
+        }
       }
-      for (int c = 1; c < cols; c++) {
-        for (int r = 0; r < rows; r++) {
-          compare_with[r] = sci::neg_mod(
-              (int64_t)((int64_t)max_temp[r] - (int64_t)inpArr[r * cols + c]),
-              this->prime_mod);
+      max_pairs(rows * half, lhs, rhs, lhs);
+      // Row r of the next level: the pair maxima, then the odd one out
+      int next = (n + 1) / 2;
+      for (int r = 0; r < rows; r++) {
+        type carry = cur[r * n + n - 1];
+        memcpy(cur + r * next, lhs + r * half, sizeof(type) * half);
+        if (n & 1) cur[r * next + half] = carry;
+      }
+    }
+    for (int r = 0; r < rows; r++) {
+      maxi[r] = (this->algeb_str == FIELD) ? cur[r] : (cur[r] & mask_l);
+    }
+    io->flush();
+  }
+
+  static int ceil_log2(int k) {
+    int K = 0;
+    while ((1 << K) < k) K++;
+    return K;
+  }
+
+  // Marks in need[j * len + i] the maxima over [i, i + 2^j) that the
+  // doubling scheme of sliding_max() builds, and returns its number of
+  // comparisons per row.
+  static int64_t mark_range_maxima(int len, int k, int stride, uint8_t *need) {
+    int num_out = (len - k) / stride + 1;
+    int K = 0;
+    while ((2 << K) <= k) K++;
+    int p = 1 << K;
+    memset(need, 0, (size_t)(K + 1) * len);
+    for (int o = 0; o < num_out; o++) {
+      need[K * len + o * stride] = 1;
+      need[K * len + o * stride + k - p] = 1;
+    }
+    int64_t cmps = (k != p) ? num_out : 0;
+    for (int j = K; j > 0; j--) {
+      for (int i = 0; i < len; i++) {
+        if (need[j * len + i]) {
+          need[(j - 1) * len + i] = 1;
+          need[(j - 1) * len + i + (1 << (j - 1))] = 1;
+          cmps++;
         }
-        relu_field_oracle->relu(max_temp, compare_with, rows);
-        for (int r = 0; r < rows; r++) {
-          max_temp[r] = (max_temp[r] + inpArr[r * cols + c]) % this->prime_mod;
+      }
+    }
+    return cmps;
+  }
+
+  // Comparisons per row of sliding_max()
+  static int64_t sliding_max_cmps(int len, int k, int stride) {
+    int num_out = (len - k) / stride + 1;
+    std::vector<uint8_t> need((size_t)(ceil_log2(k) + 1) * len);
+    return std::min<int64_t>(mark_range_maxima(len, k, stride, need.data()),
+                             (int64_t)num_out * (k - 1));
+  }
+
+  // out[r][o] = max(in[r][o * stride .. o * stride + k)) for the num_rows x
+  // len matrix in, in ceil(log2(k)) rounds. When windows overlap enough, a
+  // window is covered by two maxima over 2^K elements with
+  // 2^K <= k < 2^(K+1), built by doubling, so that overlapping windows share
+  // their comparisons. Otherwise each window is a tournament of its own.
+  void sliding_max(int num_rows, int len, int k, int stride, const type *in,
+                   type *out) {
+    int num_out = (len - k) / stride + 1;
+    int K = 0;
+    while ((2 << K) <= k) K++;
+    int p = 1 << K;
+
+    sci::Arena::Scope scratch(arena);
+    uint8_t *need = arena.alloc<uint8_t>((size_t)(K + 1) * len);
+    if (mark_range_maxima(len, k, stride, need) >= (int64_t)num_out * (k - 1)) {
+      type *windows = arena.alloc<type>((size_t)num_rows * num_out * k);
+      for (int r = 0; r < num_rows; r++) {
+        for (int o = 0; o < num_out; o++) {
+          memcpy(windows + ((size_t)r * num_out + o) * k,
+                 in + (size_t)r * len + o * stride, sizeof(type) * k);
         }
       }
-      for (int r = 0; r < rows; r++) {
-        maxi[r] = max_temp[r];
+      funcMaxMPC(num_rows * num_out, k, windows, out, nullptr);
+      return;
+    }
+
+    type *range_max = arena.alloc<type>((size_t)num_rows * len);
+    memcpy(range_max, in, sizeof(type) * num_rows * len);
+    int *pos = arena.alloc<int>(len);
+    type *lhs = arena.alloc<type>((size_t)num_rows * len);
+    type *rhs = arena.alloc<type>((size_t)num_rows * len);
+    for (int j = 1; j <= K; j++) {
+      int num_pos = 0;
+      for (int i = 0; i < len; i++) {
+        if (need[j * len + i]) pos[num_pos++] = i;
       }
-    } else { // RING
-      for (int r = 0; r < rows; r++) {
-        max_temp[r] = inpArr[r * cols];
+      int half = 1 << (j - 1);
+      for (int r = 0; r < num_rows; r++) {
+        for (int t = 0; t < num_pos; t++) {
+          lhs[r * num_pos + t] = range_max[r * len + pos[t]];
+          rhs[r * num_pos + t] = range_max[r * len + pos[t] + half];
+        }
       }
-      for (int c = 1; c < cols; c++) {
-        for (int r = 0; r < rows; r++) {
-          compare_with[r] = max_temp[r] - inpArr[r * cols + c];
+      max_pairs(num_rows * num_pos, lhs, rhs, lhs);
+      for (int r = 0; r < num_rows; r++) {
+        for (int t = 0; t < num_pos; t++) {
+          range_max[r * len + pos[t]] = lhs[r * num_pos + t];
         }
-        relu_oracle->relu(max_temp, compare_with, rows);
-        for (int r = 0; r < rows; r++) {
-          max_temp[r] += inpArr[r * cols + c];
+      }
+    }
+
+    for (int r = 0; r < num_rows; r++) {
+      for (int o = 0; o < num_out; o++) {
+        out[r * num_out + o] = range_max[r * len + o * stride];
+        lhs[r * num_out + o] = range_max[r * len + o * stride + k - p];
+      }
+    }
+    if (k != p) {
+      max_pairs(num_rows * num_out, out, lhs, out);
+    }
+  }
+
+  // Max pooling of num_planes zero-padded imgH x imgW planes, each stored
+  // row-major and one after another. The output planes are
+  // outH = (imgH + zPadHLeft + zPadHRight - ksizeH) / strideH + 1 by outW.
+  // The window max is separable: the row maxima of every input row that some
+  // window covers are computed once and shared by the vertically overlapping
+  // windows, and each pass shares comparisons between overlapping windows,
+  // see sliding_max(). A 3x3 pool with stride 1 takes 4 comparisons per
+  // output instead of 8. If the separable passes need more rounds or
+  // comparisons, e.g., for 5x5 windows, every window is a tournament of its
+  // own instead.
+  void funcMaxPool2D(int num_planes, int imgH, int imgW, int ksizeH,
+                     int ksizeW, int zPadHLeft, int zPadHRight, int zPadWLeft,
+                     int zPadWRight, int strideH, int strideW, const type *inp,
+                     type *outp) {
+    int padH = imgH + zPadHLeft + zPadHRight;
+    int padW = imgW + zPadWLeft + zPadWRight;
+    int outH = (padH - ksizeH) / strideH + 1;
+    int outW = (padW - ksizeW) / strideW + 1;
+
+    sci::Arena::Scope scratch(arena);
+    // Padded rows covered by some window
+    int *rows_used = arena.alloc<int>(padH);
+    int num_rows_used = 0;
+    for (int h = 0; h < padH; h++) {
+      int first = h >= ksizeH ? (h - ksizeH) / strideH + 1 : 0;
+      if (first < outH && first * strideH <= h) rows_used[num_rows_used++] = h;
+    }
+    auto pixel = [&](int c, int h, int w) -> type {
+      h -= zPadHLeft;
+      w -= zPadWLeft;
+      return (h < 0 || h >= imgH || w < 0 || w >= imgW)
+                 ? 0
+                 : inp[((size_t)c * imgH + h) * imgW + w];
+    };
+
+    int64_t direct_cmps = (int64_t)outH * outW * (ksizeH * ksizeW - 1);
+    int64_t separable_cmps =
+        num_rows_used * sliding_max_cmps(padW, ksizeW, strideW) +
+        outW * sliding_max_cmps(padH, ksizeH, strideH);
+    bool separable =
+        separable_cmps < direct_cmps &&
+        ceil_log2(ksizeH) + ceil_log2(ksizeW) <= ceil_log2(ksizeH * ksizeW);
+    if (!separable) {
+      int cols = ksizeH * ksizeW;
+      type *windows = arena.alloc<type>((size_t)num_planes * outH * outW * cols);
+      type *w_ptr = windows;
+      for (int c = 0; c < num_planes; c++)
+        for (int oh = 0; oh < outH; oh++)
+          for (int ow = 0; ow < outW; ow++)
+            for (int fh = 0; fh < ksizeH; fh++)
+              for (int fw = 0; fw < ksizeW; fw++)
+                *w_ptr++ = pixel(c, oh * strideH + fh, ow * strideW + fw);
+      funcMaxMPC(num_planes * outH * outW, cols, windows, outp, nullptr);
+      return;
+    }
+
+    type *padded = arena.alloc<type>((size_t)num_planes * num_rows_used * padW);
+    for (int c = 0; c < num_planes; c++) {
+      for (int t = 0; t < num_rows_used; t++) {
+        type *row = padded + ((size_t)c * num_rows_used + t) * padW;
+        for (int w = 0; w < padW; w++) row[w] = pixel(c, rows_used[t], w);
+      }
+    }
+    type *row_max = arena.alloc<type>((size_t)num_planes * num_rows_used * outW);
+    sliding_max(num_planes * num_rows_used, padW, ksizeW, strideW, padded,
+                row_max);
+
+    // Columns of the row maxima over all the padded rows; unused rows are
+    // never covered by a window
+    type *cols = arena.alloc<type>((size_t)num_planes * outW * padH);
+    memset(cols, 0, sizeof(type) * num_planes * outW * padH);
+    for (int c = 0; c < num_planes; c++) {
+      for (int t = 0; t < num_rows_used; t++) {
+        for (int w = 0; w < outW; w++) {
+          cols[((size_t)c * outW + w) * padH + rows_used[t]] =
+              row_max[((size_t)c * num_rows_used + t) * outW + w];
         }
       }
-      for (int r = 0; r < rows; r++) {
-        maxi[r] = max_temp[r];
-        maxi[r] &= mask_l;
+    }
+    type *col_max = arena.alloc<type>((size_t)num_planes * outW * outH);
+    sliding_max(num_planes * outW, padH, ksizeH, strideH, cols, col_max);
+
+    for (int c = 0; c < num_planes; c++) {
+      for (int h = 0; h < outH; h++) {
+        for (int w = 0; w < outW; w++) {
+          outp[((size_t)c * outH + h) * outW + w] =
+              col_max[((size_t)c * outW + w) * outH + h];
+        }
       }
     }
     io->flush();
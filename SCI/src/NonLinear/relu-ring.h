@@ -26,6 +26,9 @@ SOFTWARE.
 #include "BuildingBlocks/aux-protocols.h"
 #include "Millionaire/millionaire.h"
 #include "NonLinear/relu-interface.h"
+#include "utils/arena.h"
+#include "utils/simd_kernels.h"
+#include <vector>
 
 #define RING 0
 #define OFF_PLACE
@@ -52,6 +55,14 @@ class ReLURingProtocol : public ReLUProtocol<IO, type> {
   type relu_comparison_rhs_type;
   type cut_mask_type;
   type msb_one_type;
+  // Scratch buffers of relu(), released at the end of each call
+  sci::Arena arena;
+  // Default of relu_truncate(): Cheetah truncates approximately throughout
+#if USE_CHEETAH
+  static constexpr bool kExactTruncation = false;
+#else
+  static constexpr bool kExactTruncation = true;
+#endif
 
   // Constructor
   ReLURingProtocol(int party, int algeb_str, IO *io, int l, int b,
@@ -136,46 +147,24 @@ class ReLURingProtocol : public ReLUProtocol<IO, type> {
 
   void relu(type *result, type *share, int num_relu,
             uint8_t *drelu_res = nullptr, bool skip_ot = false) {
-    uint8_t *msb_local_share = new uint8_t[num_relu];
-    uint64_t *array64;
-    type *array_type;
-    array64 = new uint64_t[num_relu];
-    array_type = new type[num_relu];
+    sci::Arena::Scope scratch(arena);
+    uint8_t *msb_local_share = arena.alloc<uint8_t>(num_relu);
+    uint64_t *array64 = arena.alloc<uint64_t>(num_relu);
 
     if (this->algeb_str == RING) {
       this->num_cmps = num_relu;
     } else {
       abort();
     }
-    uint8_t *wrap = new uint8_t[num_cmps];
-    for (int i = 0; i < num_relu; i++) {
-      msb_local_share[i] = (uint8_t)(share[i] >> (l - 1));
-      array_type[i] = share[i] & cut_mask_type;
-    }
-
-    type temp;
-
-    switch (this->party) {
-      case sci::ALICE: {
-        for (int i = 0; i < num_relu; i++) {
-          array64[i] = array_type[i] + 0ULL;
-        }
-        break;
-      }
-      case sci::BOB: {
-        for (int i = 0; i < num_relu; i++) {
-          temp = this->relu_comparison_rhs_type -
-                 array_type[i];  // This value is never negative.
-          array64[i] = 0ULL + temp;
-        }
-        break;
-      }
-    }
+    uint8_t *wrap = arena.alloc<uint8_t>(num_cmps);
+    // BOB compares rhs - (share & cut_mask); this value is never negative.
+    sci::kernels::relu_prepare<type>(msb_local_share, array64, share, num_relu,
+                                     l, cut_mask_type,
+                                     this->relu_comparison_rhs_type,
+                                     this->party == sci::BOB);
 
     this->millionaire->compare(wrap, array64, num_cmps, l - 1, true, false, b);
-    for (int i = 0; i < num_relu; i++) {
-      msb_local_share[i] = (msb_local_share[i] + wrap[i]) % two_small;
-    }
+    sci::kernels::add_mod2(msb_local_share, wrap, num_relu);
 
     if (drelu_res != nullptr) {
       for (int i = 0; i < num_relu; i++) {
@@ -184,20 +173,102 @@ class ReLURingProtocol : public ReLUProtocol<IO, type> {
     }
 
     if (skip_ot) {
-      delete[] msb_local_share;
-      delete[] array64;
-      delete[] array_type;
       return;
     }
+    msb_select(result, share, msb_local_share, num_relu);
+  }
+
+  // ReLU(x) >> shift for the num_relu elements of share, which is
+  // ReLU(x >> shift). The truncation reuses the DReLU: where msb(x) = 0, the
+  // shares x_0 + x_1 wrap around 2^l iff msb(x_0) or msb(x_1) is set, so one
+  // COT on these local bits replaces the wrap comparison of a separate
+  // truncation, and the ReLU multiplexer selects the truncated shares. If
+  // exact, the carry of the lower shift bits is compared at shift bits in the
+  // rounds of the DReLU comparison (see MillionaireProtocol::compare), and the
+  // result is floor(ReLU(x) / 2^shift); otherwise it may be one smaller, as
+  // with Truncation::truncate_msb0.
+  void relu_truncate(type *result, type *share, int num_relu, int shift,
+                     bool exact = kExactTruncation) {
+    assert(this->algeb_str == RING);
+    assert(shift > 0 && shift < this->l - 1);
+    sci::Arena::Scope scratch(arena);
+    int num_cmp = exact ? 2 * num_relu : num_relu;
+    uint8_t *msb_local_share = arena.alloc<uint8_t>(num_relu);
+    uint64_t *array64 = arena.alloc<uint64_t>(num_cmp);
+    uint8_t *wrap = arena.alloc<uint8_t>(num_cmp);
+    uint64_t mask_shift = (1ULL << shift) - 1;
+    sci::kernels::relu_prepare<type>(msb_local_share, array64, share, num_relu,
+                                     l, cut_mask_type,
+                                     this->relu_comparison_rhs_type,
+                                     this->party == sci::BOB);
+    if (exact) {
+      // Carry of the lower bits: x_0 mod 2^shift > 2^shift - 1 - x_1 mod
+      // 2^shift
+      for (int i = 0; i < num_relu; i++) {
+        uint64_t lower = uint64_t(share[i]) & mask_shift;
+        array64[num_relu + i] =
+            (this->party == sci::ALICE) ? lower : mask_shift - lower;
+      }
+    }
+    this->millionaire->compare(wrap, array64, num_cmp, l - 1, true, false, b,
+                               exact ? num_relu : 0, shift);
+
+    // Until the wrap is added, msb_local_share holds the MSB of the own share
+    uint8_t *choice = arena.alloc<uint8_t>(num_cmp);
+    uint64_t *corr = arena.alloc<uint64_t>(num_cmp);
+    uint64_t *data = arena.alloc<uint64_t>(num_cmp);
+    for (int i = 0; i < num_relu; i++) {
+      choice[i] = msb_local_share[i];
+      corr[i] = msb_local_share[i];
+      if (exact) {
+        choice[num_relu + i] = wrap[num_relu + i];
+        corr[num_relu + i] = (-2 * uint64_t(wrap[num_relu + i])) & mask_l;
+      }
+    }
+    sci::kernels::add_mod2(msb_local_share, wrap, num_relu);
+
+    // msb(x_0) * msb(x_1) mod 2^shift, and the lower carry in Z_{2^l}
+    std::vector<int> msg_len{shift};
+    if (exact) msg_len.push_back(this->l);
+    if (this->party == sci::ALICE) {
+      otpack->iknp_straight->send_batched_cot(data, corr, msg_len, num_cmp);
+    } else {
+      otpack->iknp_straight->recv_batched_cot(data, (bool *)choice, msg_len,
+                                              num_cmp);
+    }
+    type *trunc = arena.alloc<type>(num_relu);
+    for (int i = 0; i < num_relu; i++) {
+      // Shares of the wrap msb(x_0) + msb(x_1) - msb(x_0) * msb(x_1)
+      uint64_t wrap_upper =
+          (this->party == sci::ALICE) ? choice[i] + data[i] : choice[i] - data[i];
+      uint64_t t = (uint64_t(share[i]) & mask_l) >> shift;
+      t -= (wrap_upper & mask_shift) << (this->l - shift);
+      if (exact) {
+        uint64_t carry = (this->party == sci::ALICE)
+                             ? choice[num_relu + i] - data[num_relu + i]
+                             : choice[num_relu + i] + data[num_relu + i];
+        t += carry;
+      }
+      trunc[i] = (type)(t & mask_l);
+    }
+    msb_select(result, trunc, msb_local_share, num_relu);
+  }
+
+  // result = share * (1 - msb), with msb_local_share the XOR shares of the
+  // MSB of the ReLU input. Overwrites msb_local_share in the Cheetah build.
+  void msb_select(type *result, type *share, uint8_t *msb_local_share,
+                  int num_relu) {
+    sci::Arena::Scope scratch(arena);
 
 #if !USE_CHEETAH
     // Now perform x.msb(x)
-    uint64_t **ot_messages = new uint64_t *[num_relu];
+    uint64_t **ot_messages = arena.alloc<uint64_t *>(num_relu);
+    uint64_t *ot_messages_data = arena.alloc<uint64_t>(2 * num_relu);
     for (int i = 0; i < num_relu; i++) {
-      ot_messages[i] = new uint64_t[2];
+      ot_messages[i] = ot_messages_data + 2 * i;
     }
-    uint64_t *additive_masks = new uint64_t[num_relu];
-    uint64_t *received_shares = new uint64_t[num_relu];
+    uint64_t *additive_masks = arena.alloc<uint64_t>(num_relu);
+    uint64_t *received_shares = arena.alloc<uint64_t>(num_relu);
     this->triple_gen->prg->random_data(additive_masks, num_relu * sizeof(type));
     switch (this->party) {
       case sci::ALICE: {
@@ -228,16 +299,6 @@ class ReLURingProtocol : public ReLUProtocol<IO, type> {
                   ((type *)received_shares)[(8 / sizeof(type)) * i];
       result[i] &= mask_l;
     }
-    delete[] msb_local_share;
-    delete[] array64;
-    delete[] array_type;
-    delete[] additive_masks;
-    delete[] received_shares;
-    for (int i = 0; i < num_relu; i++) {
-      delete[] ot_messages[i];
-    }
-    delete[] ot_messages;
-    delete[] wrap;
 #else
     if (party == sci::ALICE) {
       for (int i = 0; i < num_relu; i++)
@@ -245,10 +306,6 @@ class ReLURingProtocol : public ReLUProtocol<IO, type> {
     }
     aux->multiplexer(msb_local_share, share, result, num_relu, this->l,
                      this->l);
-    delete[] msb_local_share;
-    delete[] array64;
-    delete[] array_type;
-    delete[] wrap;
 #endif
     io->flush();
   }
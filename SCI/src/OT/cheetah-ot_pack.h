@@ -2,6 +2,8 @@
 #ifndef CHEETAH_OT_PACK_H__
 #define CHEETAH_OT_PACK_H__
 
+#include <thread>
+
 #include "OT/emp-ot.h"
 #include "OT/ferret/silent_ot.h"
 #include "OT/split-kkot.h"
@@ -34,7 +36,11 @@ class OTPack {
 
   T *ios[1];
 
-  OTPack(T *io, int party, bool do_setup = true) {
+  // The silent OTs bootstrap from the pre-OT files if both parties have them,
+  // and write the unused correlations back when destroyed. `pre_ot_prefix`
+  // gives the files of this pack, e.g., one per thread.
+  OTPack(T *io, int party, bool do_setup = true,
+         const std::string &pre_ot_prefix = "") {
     std::cout << "using silent ot pack" << std::endl;
 
     this->party = party;
@@ -42,14 +48,16 @@ class OTPack {
     this->io = io;
 
     ios[0] = io;
-    silent_ot = new cheetah::SilentOT<T>(party, 1, ios, false, true,
-                                         party == sci::ALICE
-                                             ? PRE_OT_DATA_REG_SEND_FILE_ALICE
-                                             : PRE_OT_DATA_REG_RECV_FILE_BOB);
+    silent_ot = new cheetah::SilentOT<T>(
+        party, 1, ios, false, true,
+        !pre_ot_prefix.empty() ? pre_ot_prefix + "_straight"
+        : party == sci::ALICE  ? PRE_OT_DATA_REG_SEND_FILE_ALICE
+                               : PRE_OT_DATA_REG_RECV_FILE_BOB);
     silent_ot_reversed = new cheetah::SilentOT<T>(
         3 - party, 1, ios, false, true,
-        party == sci::ALICE ? PRE_OT_DATA_REG_RECV_FILE_ALICE
-                            : PRE_OT_DATA_REG_SEND_FILE_BOB);
+        !pre_ot_prefix.empty() ? pre_ot_prefix + "_reversed"
+        : party == sci::ALICE  ? PRE_OT_DATA_REG_RECV_FILE_ALICE
+                               : PRE_OT_DATA_REG_SEND_FILE_BOB);
 
     for (int i = 0; i < KKOT_TYPES; i++) {
       kkot[i] = new cheetah::SilentOTN<T>(silent_ot, 1 << (i + 1));
@@ -60,6 +68,7 @@ class OTPack {
   }
 
   ~OTPack() {
+    wait_refill_ot_pool();
     delete silent_ot;
     for (int i = 0; i < KKOT_TYPES; i++) delete kkot[i];
     delete iknp_reversed;
@@ -67,6 +76,50 @@ class OTPack {
 
   void SetupBaseOTs() {}
 
+  // Pre-generate `capacity` silent OT correlations per direction. The two
+  // parties should reserve and refill the pools of their packs in the same
+  // order.
+  void reserve_ot_pool(size_t capacity) {
+    wait_refill_ot_pool();
+    silent_ot->set_pool_capacity(capacity);
+    silent_ot_reversed->set_pool_capacity(capacity);
+    refill_ot_pool();
+  }
+
+  size_t refill_ot_pool() {
+    size_t n = silent_ot->refill_pool();
+    n += silent_ot_reversed->refill_pool();
+    io->flush();
+    return n;
+  }
+
+  // Refill on a background thread, e.g., while the channel of this pack is
+  // idle. The pack must not be used until wait_refill_ot_pool() returns.
+  void start_refill_ot_pool() {
+    wait_refill_ot_pool();
+    refill_thread_ = std::thread([this]() { refill_ot_pool(); });
+  }
+
+  void wait_refill_ot_pool() {
+    if (refill_thread_.joinable()) refill_thread_.join();
+  }
+
+  size_t ot_pool_size() const {
+    return silent_ot->pool_size() + silent_ot_reversed->pool_size();
+  }
+
+  size_t ot_pool_capacity() const {
+    return silent_ot->pool_capacity() + silent_ot_reversed->pool_capacity();
+  }
+
+  uint64_t num_pooled_cots() const {
+    return silent_ot->num_pooled_cots() + silent_ot_reversed->num_pooled_cots();
+  }
+
+  uint64_t num_online_cots() const {
+    return silent_ot->num_online_cots() + silent_ot_reversed->num_online_cots();
+  }
+
   /*
    * DISCLAIMER:
    * OTPack copy method avoids computing setup keys for each OT instance by
@@ -101,6 +154,9 @@ class OTPack {
   // this->do_setup = true;
   // return;
   //}
+
+ private:
+  std::thread refill_thread_;
 };
 
 }  // namespace sci
@@ -7,7 +7,9 @@
 #include <math.h>
 
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <vector>
 
 #include "OT/ot-utils.h"
 #include "OT/ot.h"
@@ -34,6 +36,55 @@ class SilentOT : public sci::OT<SilentOT<IO>> {
 
   ~SilentOT() { delete ferret; }
 
+  // Pool of random COTs that are generated ahead of use, e.g., in an offline
+  // phase. rcot() drains the pool first and then falls back to the on-demand
+  // extension. The peer SilentOT must set the same capacity and refill at the
+  // same points so that the two pools stay aligned.
+  void set_pool_capacity(size_t capacity) {
+    capacity = std::max(capacity, pool_size());
+    std::vector<block> pool(capacity);
+    std::copy(pool_.begin() + pool_head_, pool_.begin() + pool_tail_,
+              pool.begin());
+    pool_tail_ -= pool_head_;
+    pool_head_ = 0;
+    pool_.swap(pool);
+  }
+
+  // Top up the pool to its capacity. Return the number of generated COTs.
+  size_t refill_pool() {
+    const size_t n = pool_.size() - pool_size();
+    if (n == 0) return 0;
+    std::copy(pool_.begin() + pool_head_, pool_.begin() + pool_tail_,
+              pool_.begin());
+    pool_tail_ -= pool_head_;
+    pool_head_ = 0;
+    ferret->rcot(pool_.data() + pool_tail_, n);
+    pool_tail_ += n;
+    return n;
+  }
+
+  size_t pool_size() const { return pool_tail_ - pool_head_; }
+
+  size_t pool_capacity() const { return pool_.size(); }
+
+  // Number of COTs taken from the pool and from the on-demand extension.
+  uint64_t num_pooled_cots() const { return num_pooled_cots_; }
+
+  uint64_t num_online_cots() const { return num_online_cots_; }
+
+  void rcot(block* data, int64_t length) {
+    const int64_t from_pool = std::min<int64_t>(length, pool_size());
+    if (from_pool > 0) {
+      std::memcpy(data, pool_.data() + pool_head_, from_pool * sizeof(block));
+      pool_head_ += from_pool;
+      num_pooled_cots_ += from_pool;
+    }
+    if (length > from_pool) {
+      ferret->rcot(data + from_pool, length - from_pool);
+      num_online_cots_ += length - from_pool;
+    }
+  }
+
   void send_impl(const block* data0, const block* data1, int64_t length) {
     send_ot_cm_cc(data0, data1, length);
   }
@@ -297,13 +348,27 @@ class SilentOT : public sci::OT<SilentOT<IO>> {
   }
 
   // random correlated message, chosen choice
+  // Same as ferret->send_cot but on top of the pooled rcot.
   void send_ot_rcm_cc(block* data0, int64_t length) {
-    ferret->send_cot(data0, length);
+    rcot(data0, length);
+    bool* bo = new bool[length];
+    ferret->io->recv_bool(bo, length);
+    for (int64_t i = 0; i < length; ++i) {
+      if (bo[i]) data0[i] = data0[i] ^ ferret->Delta;
+    }
+    delete[] bo;
   }
 
   // random correlated message, chosen choice
+  // Same as ferret->recv_cot but on top of the pooled rcot.
   void recv_ot_rcm_cc(block* data, const bool* b, int64_t length) {
-    ferret->recv_cot(data, b, length);
+    rcot(data, length);
+    bool* bo = new bool[length];
+    for (int64_t i = 0; i < length; ++i) {
+      bo[i] = b[i] ^ getLSB(data[i]);
+    }
+    ferret->io->send_bool(bo, length);
+    delete[] bo;
   }
 
   // random message, chosen choice
@@ -346,7 +411,7 @@ class SilentOT : public sci::OT<SilentOT<IO>> {
 
   // random message, random choice
   void send_ot_rm_rc(block* data0, block* data1, int64_t length) {
-    ferret->rcot(data0, length);
+    rcot(data0, length);
 
     block s;
     ferret->prg.random_block(&s, 1);
@@ -370,7 +435,7 @@ class SilentOT : public sci::OT<SilentOT<IO>> {
 
   // random message, random choice
   void recv_ot_rm_rc(block* data, bool* r, int64_t length) {
-    ferret->rcot(data, length);
+    rcot(data, length);
     for (int64_t i = 0; i < length; i++) {
       r[i] = getLSB(data[i]);
     }
@@ -541,26 +606,223 @@ class SilentOT : public sci::OT<SilentOT<IO>> {
     delete[] b_choices;
   }
 
+  // General OT with l-bit messages, where msgs_per_ot message pairs share the
+  // same choice bit. data[2 * msg_idx + b] is the b-th message of msg_idx =
+  // ot_idx * msgs_per_ot + h. Same API as sci::SplitIKNP. The payloads of all
+  // OTs are tightly bit-packed and sent in one message after the choice bits.
   void send_batched_got(uint64_t* data, int num_ot, int l,
                         int msgs_per_ot = 1) {
-    throw std::logic_error("Not implemented");
+    block* rcm_data = new block[num_ot];
+    send_ot_rcm_cc(rcm_data, num_ot);
+
+    const int num_hashes = (l * msgs_per_ot + 127) / 128;
+    const int64_t ysize_per_ot = (msgs_per_ot * l + 7) / 8;
+    // One extra block for the 64-bit accesses of writeToPackedArr.
+    block* pad = new block[2 * ot_bsize * num_hashes + 1];
+    block* y0_per_ot = new block[num_hashes + 1];
+    block* y1_per_ot = new block[num_hashes + 1];
+    uint8_t* y = new uint8_t[2 * ysize_per_ot * num_ot];
+
+    for (int64_t i = 0; i < num_ot; i += ot_bsize) {
+      const int64_t n = std::min<int64_t>(ot_bsize, num_ot - i);
+      hash_batched_pads(pad, rcm_data + i, n, num_hashes, true);
+      for (int64_t j = 0; j < n; ++j) {
+        const block* pad0_ptr = pad + j * num_hashes;
+        const block* pad1_ptr = pad + (n + j) * num_hashes;
+        for (int h = 0; h < msgs_per_ot; ++h) {
+          int64_t msg_idx = (i + j) * msgs_per_ot + h;
+          sci::writeToPackedArr((uint8_t*)y0_per_ot, ysize_per_ot, h * l, l,
+                                data[2 * msg_idx]);
+          sci::writeToPackedArr((uint8_t*)y1_per_ot, ysize_per_ot, h * l, l,
+                                data[2 * msg_idx + 1]);
+        }
+        for (int h = 0; h < num_hashes; ++h) {
+          y0_per_ot[h] = y0_per_ot[h] ^ pad0_ptr[h];
+          y1_per_ot[h] = y1_per_ot[h] ^ pad1_ptr[h];
+        }
+        std::memcpy(y + 2 * (i + j) * ysize_per_ot, y0_per_ot, ysize_per_ot);
+        std::memcpy(y + (2 * (i + j) + 1) * ysize_per_ot, y1_per_ot,
+                    ysize_per_ot);
+      }
+    }
+    ferret->io->send_data(y, 2 * ysize_per_ot * num_ot);
+
+    delete[] y;
+    delete[] y0_per_ot;
+    delete[] y1_per_ot;
+    delete[] pad;
+    delete[] rcm_data;
   }
 
+  // General OT receiver. data[ot_idx * msgs_per_ot + h] is the h-th message
+  // chosen by r[ot_idx].
   void recv_batched_got(uint64_t* data, const uint8_t* r, int num_ot, int l,
                         int msgs_per_ot = 1) {
-    throw std::logic_error("Not implemented");
+    block* rcm_data = new block[num_ot];
+    recv_ot_rcm_cc(rcm_data, (const bool*)r, num_ot);
+
+    const int num_hashes = (l * msgs_per_ot + 127) / 128;
+    const int64_t ysize_per_ot = (msgs_per_ot * l + 7) / 8;
+    // One extra block for the unaligned loads and readFromPackedArr.
+    block* pad = new block[ot_bsize * num_hashes + 1];
+    uint8_t* y = new uint8_t[2 * ysize_per_ot * num_ot + sizeof(block)];
+    ferret->io->recv_data(y, 2 * ysize_per_ot * num_ot);
+
+    for (int64_t i = 0; i < num_ot; i += ot_bsize) {
+      const int64_t n = std::min<int64_t>(ot_bsize, num_ot - i);
+      hash_batched_pads(pad, rcm_data + i, n, num_hashes, false);
+      for (int64_t j = 0; j < n; ++j) {
+        block* pad_ptr = pad + j * num_hashes;
+        const block* y_ptr =
+            (const block*)(y + (2 * (i + j) + (r[i + j] & 1)) * ysize_per_ot);
+        for (int h = 0; h < num_hashes; ++h) {
+          pad_ptr[h] = pad_ptr[h] ^ _mm_loadu_si128(y_ptr + h);
+        }
+        for (int h = 0; h < msgs_per_ot; ++h) {
+          data[(i + j) * msgs_per_ot + h] =
+              sci::readFromPackedArr((uint8_t*)pad_ptr, num_hashes, h * l, l);
+        }
+      }
+    }
+
+    delete[] y;
+    delete[] pad;
+    delete[] rcm_data;
   }
 
+  // Batched COT with messages of different bitlengths. The num_ot OTs are
+  // split into msg_len.size() equal groups and the i-th group uses
+  // msg_len[i]-bit messages. msgs_per_ot correlations share the same choice
+  // bit. Same API as sci::SplitIKNP. The payloads of all groups are sent in
+  // one message after the choice bits.
   void send_batched_cot(uint64_t* data0, uint64_t* corr,
                         std::vector<int> msg_len, int num_ot,
                         int msgs_per_ot = 1) {
-    throw std::logic_error("Not implemented");
+    block* rcm_data = new block[num_ot];
+    send_ot_rcm_cc(rcm_data, num_ot);
+
+    const int num_msg_len = msg_len.size();
+    const int dim = num_ot / num_msg_len;
+    int64_t total_ysize = 0;
+    for (int i = 0; i < num_msg_len; ++i) {
+      total_ysize += dim * ((msgs_per_ot * msg_len[i] + 7) / 8);
+    }
+    const int max_num_hashes = (64 * msgs_per_ot + 127) / 128;
+    block* pad = new block[2 * ot_bsize * max_num_hashes + 1];
+    block* y_per_ot = new block[max_num_hashes + 1];
+    uint8_t* y = new uint8_t[total_ysize];
+
+    uint8_t* y_ptr = y;
+    for (int i = 0; i < num_msg_len; ++i) {
+      const int lmsg_len = msg_len[i];
+      const uint64_t modulo_mask =
+          (lmsg_len == 64 ? -1 : ((1ULL << lmsg_len) - 1));
+      const int num_hashes = (lmsg_len * msgs_per_ot + 127) / 128;
+      const int64_t ysize_per_ot = (msgs_per_ot * lmsg_len + 7) / 8;
+      for (int64_t j = 0; j < dim; j += ot_bsize) {
+        const int64_t n = std::min<int64_t>(ot_bsize, dim - j);
+        const int64_t ot_idx = i * (int64_t)dim + j;
+        hash_batched_pads(pad, rcm_data + ot_idx, n, num_hashes, true);
+        for (int64_t k = 0; k < n; ++k) {
+          block* pad0_ptr = pad + k * num_hashes;
+          const block* pad1_ptr = pad + (n + k) * num_hashes;
+          for (int h = 0; h < msgs_per_ot; ++h) {
+            int64_t msg_idx = (ot_idx + k) * msgs_per_ot + h;
+            uint64_t unpacked_pad0 = sci::readFromPackedArr(
+                (uint8_t*)pad0_ptr, num_hashes, h * lmsg_len, lmsg_len);
+            data0[msg_idx] = unpacked_pad0;
+            sci::writeToPackedArr((uint8_t*)y_per_ot, ysize_per_ot,
+                                  h * lmsg_len, lmsg_len,
+                                  (corr[msg_idx] + unpacked_pad0) & modulo_mask);
+          }
+          for (int h = 0; h < num_hashes; ++h) {
+            y_per_ot[h] = y_per_ot[h] ^ pad1_ptr[h];
+          }
+          std::memcpy(y_ptr, y_per_ot, ysize_per_ot);
+          y_ptr += ysize_per_ot;
+        }
+      }
+    }
+    ferret->io->send_data(y, total_ysize);
+
+    delete[] y;
+    delete[] y_per_ot;
+    delete[] pad;
+    delete[] rcm_data;
   }
 
+  // Batched COT receiver. data = x + b * corr where x is the sender's output.
   void recv_batched_cot(uint64_t* data, bool* b, std::vector<int> msg_len,
                         int num_ot, int msgs_per_ot = 1) {
-    throw std::logic_error("Not implemented");
+    block* rcm_data = new block[num_ot];
+    recv_ot_rcm_cc(rcm_data, b, num_ot);
+
+    const int num_msg_len = msg_len.size();
+    const int dim = num_ot / num_msg_len;
+    int64_t total_ysize = 0;
+    for (int i = 0; i < num_msg_len; ++i) {
+      total_ysize += dim * ((msgs_per_ot * msg_len[i] + 7) / 8);
+    }
+    const int max_num_hashes = (64 * msgs_per_ot + 127) / 128;
+    block* pad = new block[ot_bsize * max_num_hashes + 1];
+    uint8_t* y = new uint8_t[total_ysize + sizeof(block)];
+    ferret->io->recv_data(y, total_ysize);
+
+    const uint8_t* y_ptr = y;
+    for (int i = 0; i < num_msg_len; ++i) {
+      const int lmsg_len = msg_len[i];
+      const int num_hashes = (lmsg_len * msgs_per_ot + 127) / 128;
+      const int64_t ysize_per_ot = (msgs_per_ot * lmsg_len + 7) / 8;
+      for (int64_t j = 0; j < dim; j += ot_bsize) {
+        const int64_t n = std::min<int64_t>(ot_bsize, dim - j);
+        const int64_t ot_idx = i * (int64_t)dim + j;
+        hash_batched_pads(pad, rcm_data + ot_idx, n, num_hashes, false);
+        for (int64_t k = 0; k < n; ++k) {
+          block* pad_ptr = pad + k * num_hashes;
+          if (b[ot_idx + k]) {
+            for (int h = 0; h < num_hashes; ++h) {
+              pad_ptr[h] =
+                  pad_ptr[h] ^ _mm_loadu_si128((const block*)y_ptr + h);
+            }
+          }
+          for (int h = 0; h < msgs_per_ot; ++h) {
+            data[(ot_idx + k) * msgs_per_ot + h] = sci::readFromPackedArr(
+                (uint8_t*)pad_ptr, num_hashes, h * lmsg_len, lmsg_len);
+          }
+          y_ptr += ysize_per_ot;
+        }
+      }
+    }
+
+    delete[] y;
+    delete[] pad;
+    delete[] rcm_data;
+  }
+
+ private:
+  // Expand each of the n COTs K into num_hashes pads H(K ^ h). On the sender
+  // side, the pads H(K ^ Delta ^ h) of the other message follow the first n *
+  // num_hashes pads.
+  void hash_batched_pads(block* pad, const block* rcm_data, int64_t n,
+                         int num_hashes, bool sender) {
+    for (int64_t j = 0; j < n; ++j) {
+      for (int h = 0; h < num_hashes; ++h) {
+        pad[j * num_hashes + h] = rcm_data[j] ^ makeBlock(0, h);
+        if (sender) {
+          pad[(n + j) * num_hashes + h] =
+              pad[j * num_hashes + h] ^ ferret->Delta;
+        }
+      }
+    }
+    crh_.Hn(pad, pad, (sender ? 2 : 1) * n * num_hashes);
   }
+
+  sci::CRH crh_;
+  std::vector<block> pool_;
+  size_t pool_head_{0};
+  size_t pool_tail_{0};
+  uint64_t num_pooled_cots_{0};
+  uint64_t num_online_cots_{0};
 };
 
 template <typename IO>
@@ -0,0 +1,48 @@
+#ifndef OT_BUDGET_H__
+#define OT_BUDGET_H__
+
+#include <cstdint>
+
+namespace sci {
+
+// Upper-bound estimates of the random COTs consumed by the nonlinear layers,
+// summed over the two OT directions. A 1-out-of-2^r OT consumes r COTs and a
+// bit triple consumes at most 2 COTs.
+inline uint64_t EstimateMillionaireCOTs(uint64_t num_cmps, int bitlength,
+                                        int radix) {
+  const uint64_t num_digits = (bitlength + radix - 1) / radix;
+  const uint64_t num_triples = num_digits > 1 ? 2 * num_digits - 2 : 0;
+  return num_cmps * (num_digits * radix + 2 * num_triples);
+}
+
+// DReLU on the lower bits then one MUX.
+inline uint64_t EstimateReLUCOTs(uint64_t num_relu, int bitlength, int radix) {
+  return EstimateMillionaireCOTs(num_relu, bitlength - 1, radix) + 2 * num_relu;
+}
+
+// One ReLU per element of the pooling window except the first.
+inline uint64_t EstimateMaxPoolCOTs(uint64_t num_out, int window_size,
+                                    int bitlength, int radix) {
+  return window_size > 1 ? (window_size - 1) *
+                               EstimateReLUCOTs(num_out, bitlength, radix)
+                         : 0;
+}
+
+// Wrap computation then one B2A.
+inline uint64_t EstimateTruncationCOTs(uint64_t num_trunc, int bitlength,
+                                       int radix) {
+  return EstimateMillionaireCOTs(num_trunc, bitlength, radix) + num_trunc;
+}
+
+// Estimated COTs of one network run, tallied layer by layer.
+struct OTBudget {
+  uint64_t relu{0};
+  uint64_t maxpool{0};
+  uint64_t truncation{0};
+
+  uint64_t total() const { return relu + maxpool + truncation; }
+};
+
+}  // namespace sci
+
+#endif  // OT_BUDGET_H__
@@ -1,39 +1,50 @@
 // Author: Wen-jie Lu on 2021/9/14.
 #include "cheetah/cheetah-api.h"
 
+#include <fcntl.h>
 #include <seal/seal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 #include "gemini/cheetah/shape_inference.h"
 #include "gemini/cheetah/tensor_encoder.h"
+#include "gemini/core/util/seal.h"
 #include "utils/constants.h"  // ALICE & BOB
 #include "utils/net_io_channel.h"
 
 template <class CtType>
-void send_ciphertext(sci::NetIO *io, const CtType &ct) {
-  std::stringstream os;
-  uint64_t ct_size;
-  ct.save(os);
-  ct_size = os.tellp();
-  string ct_ser = os.str();
-  io->send_data(&ct_size, sizeof(uint64_t));
-  io->send_data(ct_ser.c_str(), ct_ser.size());
+void send_ciphertext(sci::NetIO *io, const CtType &ct,
+                     const gemini::CtCompression &compr,
+                     gemini::CtIOStats *stats) {
+  gemini::send_seal_object(io, ct, compr, stats);
 }
 
 template <class EncVecCtType>
-static void send_encrypted_vector(sci::NetIO *io, const EncVecCtType &ct_vec) {
+static void send_encrypted_vector(sci::NetIO *io, const EncVecCtType &ct_vec,
+                                  const gemini::CtCompression &compr,
+                                  gemini::CtIOStats *stats) {
   uint32_t ncts = ct_vec.size();
   io->send_data(&ncts, sizeof(uint32_t));
   for (size_t i = 0; i < ncts; ++i) {
-    send_ciphertext(io, ct_vec.at(i));
+    send_ciphertext(io, ct_vec.at(i), compr, stats);
   }
 }
 
 static void recv_encrypted_vector(sci::NetIO *io,
                                   const seal::SEALContext &context,
                                   std::vector<seal::Ciphertext> &ct_vec,
-                                  bool is_truncated = false);
+                                  bool is_truncated = false,
+                                  gemini::CtIOStats *stats = nullptr);
 static void recv_ciphertext(sci::NetIO *io, const seal::SEALContext &context,
-                            seal::Ciphertext &ct, bool is_truncated = false);
+                            seal::Ciphertext &ct, bool is_truncated = false,
+                            gemini::CtIOStats *stats = nullptr);
 
 namespace gemini {
 
@@ -48,6 +59,298 @@ TensorShape GetConv2DOutShape(const HomConv2DSS::Meta &meta) {
   return *o;
 }
 
+// FNV-1a over the 64-bit words rather than the bytes, to keep up with the
+// size of the conv filters.
+uint64_t WeightsFingerprint(const uint64_t *data, size_t n) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ n;
+  for (size_t i = 0; i < n; ++i) {
+    h = (h ^ data[i]) * 0x100000001b3ULL;
+    h ^= h >> 32;
+  }
+  return h == 0 ? 1 : h;
+}
+
+ConvFilterCache::Key ConvFilterCache::MakeKey(
+    size_t layer, const HomConv2DSS::Meta &meta, uint64_t plain_mod,
+    const seal::parms_id_type &parms_id) {
+  Key key;
+  key.push_back(static_cast<int64_t>(layer));
+  key.push_back(static_cast<int64_t>(plain_mod));
+  for (uint64_t u : parms_id) {
+    key.push_back(static_cast<int64_t>(u));
+  }
+  for (const TensorShape *shape : {&meta.ishape, &meta.fshape}) {
+    key.push_back(shape->dims());
+    for (int d = 0; d < shape->dims(); ++d) {
+      key.push_back(shape->dim_size(d));
+    }
+  }
+  key.push_back(static_cast<int64_t>(meta.n_filters));
+  key.push_back(static_cast<int64_t>(meta.padding));
+  key.push_back(static_cast<int64_t>(meta.stride));
+  return key;
+}
+
+std::shared_ptr<const ConvFilterCache::Encoded> ConvFilterCache::find(
+    size_t layer, const HomConv2DSS::Meta &meta, uint64_t plain_mod,
+    const seal::parms_id_type &parms_id, uint64_t filters_fingerprint) const {
+  auto key = MakeKey(layer, meta, plain_mod, parms_id);
+  std::lock_guard<std::mutex> guard(lock_);
+  auto kv = entries_.find(key);
+  if (kv == entries_.end() ||
+      kv->second.filters_fingerprint != filters_fingerprint) {
+    misses_.fetch_add(1);
+    return nullptr;
+  }
+  hits_.fetch_add(1);
+  lru_.splice(lru_.begin(), lru_, kv->second.lru_pos);
+  return kv->second.filters;
+}
+
+std::shared_ptr<const ConvFilterCache::Encoded> ConvFilterCache::insert(
+    size_t layer, const HomConv2DSS::Meta &meta, uint64_t plain_mod,
+    const seal::parms_id_type &parms_id, uint64_t filters_fingerprint,
+    Encoded &&encoded_filters) {
+  size_t nbytes = 0;
+  for (const auto &pts : encoded_filters) {
+    for (const auto &pt : pts) {
+      nbytes += pt.coeff_count() * sizeof(uint64_t);
+    }
+  }
+
+  auto key = MakeKey(layer, meta, plain_mod, parms_id);
+  auto value = std::make_shared<const Encoded>(std::move(encoded_filters));
+  std::lock_guard<std::mutex> guard(lock_);
+  auto kv = entries_.find(key);
+  if (kv != entries_.end()) {
+    nbytes_ -= kv->second.nbytes;
+    lru_.erase(kv->second.lru_pos);
+    entries_.erase(kv);
+  }
+
+  if (nbytes > max_nbytes_) {
+    LOG(WARNING) << "ConvFilterCache: the filters of conv layer " << layer
+                 << " take " << nbytes << " bytes, more than the whole cache";
+    return value;
+  }
+
+  evict_until(max_nbytes_ - nbytes);
+  lru_.push_front(key);
+  entries_.emplace(std::move(key),
+                   Entry{filters_fingerprint, value, nbytes, lru_.begin()});
+  nbytes_ += nbytes;
+  return value;
+}
+
+void ConvFilterCache::evict_until(size_t nbytes) {
+  while (nbytes_ > nbytes && !lru_.empty()) {
+    auto kv = entries_.find(lru_.back());
+    nbytes_ -= kv->second.nbytes;
+    entries_.erase(kv);
+    lru_.pop_back();
+  }
+}
+
+void ConvFilterCache::clear() {
+  std::lock_guard<std::mutex> guard(lock_);
+  entries_.clear();
+  lru_.clear();
+  nbytes_ = 0;
+  hits_ = 0;
+  misses_ = 0;
+}
+
+size_t ConvFilterCache::size() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return entries_.size();
+}
+
+size_t ConvFilterCache::nbytes() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return nbytes_;
+}
+
+// "CHTFCW02"
+static constexpr uint64_t kFCWeightStoreMagic = 0x3230574346544843ULL;
+
+FCWeightStore::Key FCWeightStore::MakeKey(size_t layer,
+                                          const HomFCSS::Meta &meta,
+                                          size_t batch, uint64_t plain_mod) {
+  Key key;
+  key.push_back(static_cast<int64_t>(layer));
+  key.push_back(static_cast<int64_t>(batch));
+  key.push_back(static_cast<int64_t>(plain_mod));
+  key.push_back(meta.weight_shape.dims());
+  for (int d = 0; d < meta.weight_shape.dims(); ++d) {
+    key.push_back(meta.weight_shape.dim_size(d));
+  }
+  return key;
+}
+
+std::shared_ptr<const FCWeightStore::Encoded> FCWeightStore::find(
+    size_t layer, const HomFCSS::Meta &meta, size_t batch, uint64_t plain_mod,
+    uint64_t weights_fingerprint) const {
+  auto key = MakeKey(layer, meta, batch, plain_mod);
+  std::lock_guard<std::mutex> guard(lock_);
+  auto kv = entries_.find(key);
+  if (kv == entries_.end()) {
+    return nullptr;
+  }
+  if (kv->second.weights_fingerprint != weights_fingerprint) {
+    LOG(WARNING) << "FCWeightStore: the weights of FC layer " << layer
+                 << " changed, re-encoding";
+    return nullptr;
+  }
+  return kv->second.matrix;
+}
+
+std::shared_ptr<const FCWeightStore::Encoded> FCWeightStore::insert(
+    size_t layer, const HomFCSS::Meta &meta, size_t batch, uint64_t plain_mod,
+    uint64_t weights_fingerprint, Encoded &&encoded_matrix) {
+  auto key = MakeKey(layer, meta, batch, plain_mod);
+  auto value = std::make_shared<const Encoded>(std::move(encoded_matrix));
+  std::lock_guard<std::mutex> guard(lock_);
+  entries_[key] = Entry{weights_fingerprint, value};
+  is_dirty_ = true;
+  return value;
+}
+
+size_t FCWeightStore::size() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return entries_.size();
+}
+
+// Layout (all in uint64_t):
+//   magic, parms_id[4], #entries,
+//   { key_len, key[key_len], weights_fingerprint, n_row_blks, n_col_blks,
+//     n_coeffs, coeffs[n_row_blks * n_col_blks * n_coeffs] } x #entries
+bool FCWeightStore::save(const std::string &path) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    LOG(WARNING) << "FCWeightStore::save can not open " << path;
+    return false;
+  }
+
+  auto put = [&fout](uint64_t u) {
+    fout.write(reinterpret_cast<const char *>(&u), sizeof(uint64_t));
+  };
+
+  put(kFCWeightStoreMagic);
+  for (uint64_t u : parms_id_) put(u);
+  put(entries_.size());
+  for (const auto &kv : entries_) {
+    const Encoded &matrix = *kv.second.matrix;
+    const size_t n_row_blks = matrix.size();
+    const size_t n_col_blks = n_row_blks > 0 ? matrix[0].size() : 0;
+    const size_t n_coeffs = n_col_blks > 0 ? matrix[0][0].coeff_count() : 0;
+    for (const auto &row : matrix) {
+      if (row.size() != n_col_blks) return false;
+      for (const auto &pt : row) {
+        // Only the coefficient-form plaintexts (i.e., BFV) are supported.
+        if (pt.coeff_count() != n_coeffs ||
+            pt.parms_id() != seal::parms_id_zero) {
+          LOG(WARNING) << "FCWeightStore::save unsupported plaintext";
+          return false;
+        }
+      }
+    }
+
+    put(kv.first.size());
+    for (int64_t k : kv.first) put(static_cast<uint64_t>(k));
+    put(kv.second.weights_fingerprint);
+    put(n_row_blks);
+    put(n_col_blks);
+    put(n_coeffs);
+    for (const auto &row : matrix) {
+      for (const auto &pt : row) {
+        fout.write(reinterpret_cast<const char *>(pt.data()),
+                   sizeof(uint64_t) * n_coeffs);
+      }
+    }
+  }
+
+  return fout.good();
+}
+
+bool FCWeightStore::load(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size < 6 * (off_t)sizeof(uint64_t)) {
+    ::close(fd);
+    return false;
+  }
+
+  const size_t file_size = static_cast<size_t>(st.st_size);
+  void *addr = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(WARNING) << "FCWeightStore::load mmap failed " << path;
+    return false;
+  }
+
+  const uint64_t *ptr = reinterpret_cast<const uint64_t *>(addr);
+  const uint64_t *end = ptr + file_size / sizeof(uint64_t);
+  auto avail = [&ptr, end](uint64_t n) {
+    return n <= static_cast<uint64_t>(end - ptr);
+  };
+
+  std::map<Key, Entry> entries;
+  bool ok = *ptr++ == kFCWeightStoreMagic;
+  if (ok && !std::equal(parms_id_.begin(), parms_id_.end(), ptr)) {
+    ::munmap(addr, file_size);
+    LOG(WARNING) << "FCWeightStore::load " << path
+                 << " is encoded for other SEAL parameters, ignored";
+    return false;
+  }
+  ptr += parms_id_.size();
+  const uint64_t n_entries = ok ? *ptr++ : 0;
+  for (uint64_t e = 0; ok && e < n_entries; ++e) {
+    if (!(ok = avail(1))) break;
+    const uint64_t key_len = *ptr++;
+    if (!(ok = avail(key_len + 4))) break;
+    Key key(ptr, ptr + key_len);
+    ptr += key_len;
+    const uint64_t weights_fingerprint = *ptr++;
+    const uint64_t n_row_blks = *ptr++;
+    const uint64_t n_col_blks = *ptr++;
+    const uint64_t n_coeffs = *ptr++;
+    if (!(ok = n_col_blks > 0 && n_coeffs > 0 &&
+               avail(n_row_blks * n_col_blks * n_coeffs))) {
+      break;
+    }
+
+    Encoded matrix(n_row_blks, std::vector<seal::Plaintext>(n_col_blks));
+    for (auto &row : matrix) {
+      for (auto &pt : row) {
+        pt.parms_id() = seal::parms_id_zero;
+        pt.resize(n_coeffs);
+        std::memcpy(pt.data(), ptr, sizeof(uint64_t) * n_coeffs);
+        ptr += n_coeffs;
+      }
+    }
+    entries[key] = Entry{weights_fingerprint,
+                         std::make_shared<const Encoded>(std::move(matrix))};
+  }
+
+  ::munmap(addr, file_size);
+  if (!ok) {
+    LOG(WARNING) << "FCWeightStore::load malformed file " << path;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  for (auto &kv : entries) {
+    entries_[kv.first] = std::move(kv.second);
+  }
+  is_dirty_ = false;
+  return true;
+}
+
 uint64_t CheetahLinear::io_counter() const { return io_ ? io_->counter : 0; }
 
 int64_t CheetahLinear::get_signed(uint64_t x) const {
@@ -71,7 +374,7 @@ uint64_t CheetahLinear::reduce(uint64_t x) const {
 }
 
 CheetahLinear::CheetahLinear(int party, sci::NetIO *io, uint64_t base_mod,
-                             size_t nthreads)
+                             size_t nthreads, const KeyResume *resume)
     : party_(party), io_(io), nthreads_(nthreads), base_mod_(base_mod) {
   if (base_mod < 2ULL || (int)std::log2(base_mod) >= 45) {
     throw std::logic_error("CheetahLinear: base_mod out-of-bound [2, 2^45)");
@@ -104,37 +407,22 @@ CheetahLinear::CheetahLinear(int party, sci::NetIO *io, uint64_t base_mod,
   context_ =
       std::make_shared<SEALContext>(seal_parms, true, sec_level_type::tc128);
 
-  if (party == sci::BOB) {
-    // Bob generate keys
-    KeyGenerator keygen(*context_);
-    // Keep secret key
-    sk_ = std::make_shared<SecretKey>(keygen.secret_key());
-    // Send public key
-    Serializable<PublicKey> s_pk = keygen.create_public_key();
-
-    std::stringstream os;
-    s_pk.save(os);
-    uint64_t pk_sze = static_cast<uint64_t>(os.tellp());
-    const std::string &keys_str = os.str();
+  if (is_mod_2k) {
+    setUpBNContexts();
+  }
 
-    io_->send_data(&pk_sze, sizeof(uint64_t));
-    io_->send_data(keys_str.c_str(), pk_sze);
+  if (resume) {
+    keys_resumed_ = resumeKeys(*resume);
+  } else {
+    std::vector<std::string> pk_blobs;
+    exchangeKeys(pk_blobs);
+  }
 
+  if (party == sci::BOB) {
     conv2d_impl_.setUp(*context_, *sk_);
     fc_impl_.setUp(*context_, *sk_);
     bn_impl_.setUp(base_mod, *context_, *sk_);
   } else {
-    pk_ = std::make_shared<PublicKey>();
-
-    uint64_t pk_sze{0};
-    io_->recv_data(&pk_sze, sizeof(uint64_t));
-    char *key_buf = new char[pk_sze];
-    io_->recv_data(key_buf, pk_sze);
-    std::stringstream is;
-    is.write(key_buf, pk_sze);
-    pk_->load(*context_, is);
-    delete[] key_buf;
-
     conv2d_impl_.setUp(*context_, std::nullopt, pk_);
     fc_impl_.setUp(*context_, std::nullopt, pk_);
     bn_impl_.setUp(base_mod, *context_, std::nullopt, pk_);
@@ -157,9 +445,271 @@ CheetahLinear::CheetahLinear(int party, sci::NetIO *io, uint64_t base_mod,
       throw std::runtime_error("BN setUP failed " + CodeMessage(ok));
     }
   }
+
+  set_thread_pool(nthreads_);
 }
 
-void CheetahLinear::setUpForBN() {
+void CheetahLinear::set_thread_pool(size_t nthreads,
+                                    const std::vector<int> &cpus) {
+  nthreads_ = std::max<size_t>(1, nthreads);
+  tpool_ = nthreads_ > 1 ? std::make_shared<ThreadPool>(nthreads_, cpus)
+                         : nullptr;
+  conv2d_impl_.set_thread_pool(tpool_);
+  fc_impl_.set_thread_pool(tpool_);
+  bn_impl_.set_thread_pool(tpool_);
+}
+
+void CheetahLinear::exchangeKeys(std::vector<std::string> &pk_blobs) {
+  using namespace seal;
+  const size_t n_keys = 1 + bn_contexts_.size();
+  auto key_context = [&](size_t i) -> const SEALContext & {
+    return i == 0 ? *context_ : *bn_contexts_[i - 1];
+  };
+
+  pk_blobs.resize(n_keys);
+  if (party_ == sci::BOB) {
+    bn_sks_.resize(bn_contexts_.size());
+    for (size_t i = 0; i < n_keys; ++i) {
+      // Bob generate keys
+      KeyGenerator keygen(key_context(i));
+      // Keep secret key
+      auto sk = std::make_shared<SecretKey>(keygen.secret_key());
+      (i == 0 ? sk_ : bn_sks_[i - 1]) = sk;
+      // Send public key
+      Serializable<PublicKey> s_pk = keygen.create_public_key();
+
+      std::stringstream os;
+      s_pk.save(os);
+      pk_blobs[i] = os.str();
+      uint64_t pk_sze = static_cast<uint64_t>(pk_blobs[i].size());
+
+      io_->send_data(&pk_sze, sizeof(uint64_t));
+      io_->send_data(pk_blobs[i].c_str(), pk_sze);
+    }
+  } else {
+    bn_pks_.resize(bn_contexts_.size());
+    for (size_t i = 0; i < n_keys; ++i) {
+      auto pk = std::make_shared<PublicKey>();
+      uint64_t pk_sze{0};
+      io_->recv_data(&pk_sze, sizeof(uint64_t));
+      pk_blobs[i].resize(pk_sze);
+      io_->recv_data(&pk_blobs[i][0], pk_sze);
+      std::stringstream is(pk_blobs[i]);
+      pk->load(key_context(i), is);
+      (i == 0 ? pk_ : bn_pks_[i - 1]) = pk;
+    }
+  }
+}
+
+static constexpr uint64_t kKeyFileMagic = 0x5945'4b48'5443'4843ULL;
+
+// FNV-1a over the public keys. Stable across the machines.
+static uint64_t KeysFingerprint(const std::vector<std::string> &pk_blobs) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  auto feed = [&h](const void *data, size_t n) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < n; ++i) {
+      h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+  };
+  for (const auto &blob : pk_blobs) {
+    uint64_t sze = blob.size();
+    feed(&sze, sizeof(sze));
+    feed(blob.data(), blob.size());
+  }
+  return h;
+}
+
+static void safe_erase_string(std::string &str) {
+  if (!str.empty()) {
+    seal::util::seal_memzero(&str[0], str.size());
+  }
+  str.clear();
+}
+
+static bool IsValidClientId(const std::string &id) {
+  if (id.empty() || id.size() > 128) return false;
+  return std::all_of(id.cbegin(), id.cend(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' ||
+           c == '_' || c == '.';
+  }) && id[0] != '.';
+}
+
+// The file is written to a temporary then renamed, and is readable by the
+// owner only since it might carry secret keys.
+static bool WriteKeyFile(const std::string &path, uint64_t fingerprint,
+                         const std::vector<std::string> &blobs) {
+  const std::string tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    LOG(WARNING) << "WriteKeyFile can not open " << tmp;
+    return false;
+  }
+
+  std::string buf;
+  auto put = [&buf](uint64_t u) {
+    buf.append(reinterpret_cast<const char *>(&u), sizeof(uint64_t));
+  };
+  put(kKeyFileMagic);
+  put(fingerprint);
+  put(blobs.size());
+  for (const auto &blob : blobs) {
+    put(blob.size());
+    buf.append(blob);
+  }
+
+  bool ok = true;
+  for (size_t off = 0; ok && off < buf.size();) {
+    ssize_t n = ::write(fd, buf.data() + off, buf.size() - off);
+    ok = n > 0;
+    off += ok ? n : 0;
+  }
+  safe_erase_string(buf);
+  ok = (::close(fd) == 0) && ok;
+  if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "WriteKeyFile failed " << path;
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+static bool ReadKeyFile(const std::string &path, size_t n_keys,
+                        uint64_t &fingerprint,
+                        std::vector<std::string> &blobs) {
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin.is_open()) {
+    return false;
+  }
+
+  auto get = [&fin]() {
+    uint64_t u{0};
+    fin.read(reinterpret_cast<char *>(&u), sizeof(uint64_t));
+    return u;
+  };
+
+  constexpr uint64_t kMaxKeyBytes = 1ULL << 24;
+  bool ok = get() == kKeyFileMagic;
+  fingerprint = get();
+  ok &= get() == n_keys && fin.good();
+  blobs.resize(ok ? n_keys : 0);
+  for (auto &blob : blobs) {
+    const uint64_t sze = get();
+    if (!(ok = fin.good() && sze <= kMaxKeyBytes)) break;
+    blob.resize(sze);
+    fin.read(&blob[0], sze);
+    if (!(ok = fin.good())) break;
+  }
+
+  if (!ok) {
+    LOG(WARNING) << "ReadKeyFile malformed file " << path;
+    fingerprint = 0;
+    for (auto &blob : blobs) safe_erase_string(blob);
+    blobs.clear();
+  }
+  return ok;
+}
+
+bool CheetahLinear::resumeKeys(const KeyResume &resume) {
+  using namespace seal;
+  const size_t n_keys = 1 + bn_contexts_.size();
+  auto key_context = [&](size_t i) -> const SEALContext & {
+    return i == 0 ? *context_ : *bn_contexts_[i - 1];
+  };
+
+  // Bob -> Alice: client id and the fingerprint of the stored keys (0 if none)
+  // Alice -> Bob: 1 if Alice has the keys of the same fingerprint
+  std::string client_id;
+  uint64_t fingerprint{0};
+  uint8_t accept{0};
+  std::vector<std::string> blobs;
+
+  if (party_ == sci::BOB) {
+    client_id = resume.client_id;
+    if (!resume.rotate && IsValidClientId(client_id) &&
+        ReadKeyFile(resume.dir + "/" + client_id + ".sk", n_keys, fingerprint,
+                    blobs)) {
+      try {
+        bn_sks_.resize(bn_contexts_.size());
+        for (size_t i = 0; i < n_keys; ++i) {
+          auto sk = std::make_shared<SecretKey>();
+          std::stringstream is(blobs[i]);
+          sk->load(key_context(i), is);
+          (i == 0 ? sk_ : bn_sks_[i - 1]) = sk;
+        }
+      } catch (const std::exception &e) {
+        LOG(WARNING) << "resumeKeys: invalid secret key " << e.what();
+        fingerprint = 0;
+      }
+      for (auto &blob : blobs) safe_erase_string(blob);
+    }
+
+    uint64_t id_len = client_id.size();
+    io_->send_data(&id_len, sizeof(uint64_t));
+    io_->send_data(client_id.data(), id_len);
+    io_->send_data(&fingerprint, sizeof(uint64_t));
+    io_->recv_data(&accept, sizeof(uint8_t));
+  } else {
+    uint64_t id_len{0};
+    io_->recv_data(&id_len, sizeof(uint64_t));
+    if (id_len > 1024) {
+      throw std::runtime_error("resumeKeys: client id too long");
+    }
+    client_id.resize(id_len);
+    io_->recv_data(&client_id[0], id_len);
+    io_->recv_data(&fingerprint, sizeof(uint64_t));
+
+    uint64_t stored_fingerprint{0};
+    if (fingerprint != 0 && IsValidClientId(client_id) &&
+        ReadKeyFile(resume.dir + "/" + client_id + ".pk", n_keys,
+                    stored_fingerprint, blobs) &&
+        stored_fingerprint == fingerprint &&
+        KeysFingerprint(blobs) == fingerprint) {
+      try {
+        bn_pks_.resize(bn_contexts_.size());
+        for (size_t i = 0; i < n_keys; ++i) {
+          auto pk = std::make_shared<PublicKey>();
+          std::stringstream is(blobs[i]);
+          pk->load(key_context(i), is);
+          (i == 0 ? pk_ : bn_pks_[i - 1]) = pk;
+        }
+        accept = 1;
+      } catch (const std::exception &e) {
+        LOG(WARNING) << "resumeKeys: invalid public key " << e.what();
+      }
+    }
+    io_->send_data(&accept, sizeof(uint8_t));
+  }
+
+  if (accept) {
+    return true;
+  }
+
+  // Fresh keys, then store them for the next session.
+  std::vector<std::string> pk_blobs;
+  exchangeKeys(pk_blobs);
+  if (!IsValidClientId(client_id)) {
+    LOG(WARNING) << "resumeKeys: invalid client id \"" << client_id << "\"";
+    return false;
+  }
+
+  fingerprint = KeysFingerprint(pk_blobs);
+  if (party_ == sci::BOB) {
+    std::vector<std::string> sk_blobs(n_keys);
+    for (size_t i = 0; i < n_keys; ++i) {
+      std::stringstream os;
+      (i == 0 ? sk_ : bn_sks_[i - 1])->save(os, compr_mode_type::none);
+      sk_blobs[i] = os.str();
+    }
+    WriteKeyFile(resume.dir + "/" + client_id + ".sk", fingerprint, sk_blobs);
+    for (auto &blob : sk_blobs) safe_erase_string(blob);
+  } else {
+    WriteKeyFile(resume.dir + "/" + client_id + ".pk", fingerprint, pk_blobs);
+  }
+  return false;
+}
+
+void CheetahLinear::setUpBNContexts() {
   using namespace seal;
   size_t ntarget_bits = std::ceil(std::log2(base_mod_));
   size_t crt_bits = 2 * ntarget_bits + 1 + HomBNSS::kStatBits;
@@ -190,26 +740,19 @@ void CheetahLinear::setUpForBN() {
     bn_contexts_[i] =
         std::make_shared<SEALContext>(seal_parms, true, sec_level_type::tc128);
   }
+}
 
+void CheetahLinear::setUpForBN() {
+  using namespace seal;
+  const size_t nCRT = bn_contexts_.size();
   std::vector<seal::SEALContext> contexts;
   std::vector<std::optional<SecretKey>> opt_sks;
+  for (size_t i = 0; i < nCRT; ++i) {
+    contexts.emplace_back(*bn_contexts_[i]);
+  }
+
   if (party_ == sci::BOB) {
-    bn_sks_.resize(nCRT);
     for (size_t i = 0; i < nCRT; ++i) {
-      KeyGenerator keygen(*bn_contexts_[i]);
-      // Keep secret key
-      bn_sks_[i] = std::make_shared<SecretKey>(keygen.secret_key());
-      // Send public key
-      Serializable<PublicKey> s_pk = keygen.create_public_key();
-
-      std::stringstream os;
-      s_pk.save(os);
-      uint64_t pk_sze = static_cast<uint64_t>(os.tellp());
-      const std::string &keys_str = os.str();
-
-      io_->send_data(&pk_sze, sizeof(uint64_t));
-      io_->send_data(keys_str.c_str(), pk_sze);
-      contexts.emplace_back(*bn_contexts_[i]);
       opt_sks.emplace_back(*bn_sks_[i]);
     }
     auto code = bn_impl_.setUp(base_mod_, contexts, opt_sks, {});
@@ -217,20 +760,6 @@ void CheetahLinear::setUpForBN() {
       throw std::runtime_error("BN setUp failed [" + CodeMessage(code) + "]");
     }
   } else {
-    bn_pks_.resize(nCRT);
-    for (size_t i = 0; i < nCRT; ++i) {
-      bn_pks_[i] = std::make_shared<PublicKey>();
-      uint64_t pk_sze{0};
-      io_->recv_data(&pk_sze, sizeof(uint64_t));
-      char *key_buf = new char[pk_sze];
-      io_->recv_data(key_buf, pk_sze);
-      std::stringstream is;
-      is.write(key_buf, pk_sze);
-      bn_pks_[i]->load(*bn_contexts_[i], is);
-      delete[] key_buf;
-      contexts.emplace_back(*bn_contexts_[i]);
-    }
-
     auto code = bn_impl_.setUp(base_mod_, contexts, opt_sks, bn_pks_);
     if (code != Code::OK) {
       throw std::runtime_error("BN setUp failed [" + CodeMessage(code) + "]");
@@ -337,18 +866,50 @@ bool CheetahLinear::verify(const Tensor<uint64_t> &in_tensor_share,
   return true;
 }
 
+FCWeightStore::Encoded CheetahLinear::encodeFCWeights(
+    const Tensor<uint64_t> &weight_matrix, const FCMeta &meta,
+    size_t batch) const {
+  if (party_ != sci::ALICE) {
+    throw std::logic_error("CheetahLinear::encodeFCWeights server only");
+  }
+  if (!weight_matrix.shape().IsSameSize(meta.weight_shape)) {
+    throw std::invalid_argument(
+        "CheetahLinear::encodeFCWeights weight shape mismatch");
+  }
+
+  FCWeightStore::Encoded encoded_matrix;
+  Code code = fc_impl_.encodeWeightMatrix(weight_matrix, meta, batch,
+                                          encoded_matrix, nthreads_);
+  if (code != Code::OK) {
+    throw std::runtime_error("CheetahLinear::fc encodeWeightMatrix error [" +
+                             CodeMessage(code) + "]");
+  }
+  return encoded_matrix;
+}
+
 void CheetahLinear::fc(const Tensor<uint64_t> &input_vector,
                        const Tensor<uint64_t> &weight_matrix,
                        const FCMeta &meta,
                        Tensor<uint64_t> &out_vec_share) const {
+  if (party_ == sci::ALICE) {
+    auto encoded_matrix = encodeFCWeights(weight_matrix, meta);
+    fc(input_vector, &encoded_matrix, meta, out_vec_share);
+  } else {
+    fc(input_vector, nullptr, meta, out_vec_share);
+  }
+}
+
+void CheetahLinear::fc(const Tensor<uint64_t> &input_vector,
+                       const FCWeightStore::Encoded *encoded_matrix,
+                       const FCMeta &meta,
+                       Tensor<uint64_t> &out_vec_share) const {
   // out_matrix = input_matrix * weight_matrix
   if (!input_vector.shape().IsSameSize(meta.input_shape)) {
     throw std::invalid_argument("CheetahLinear::fc input shape mismatch");
   }
 
-  if (party_ == sci::ALICE &&
-      !weight_matrix.shape().IsSameSize(meta.weight_shape)) {
-    throw std::invalid_argument("CheetahLinear::fc weight shape mismatch");
+  if (party_ == sci::ALICE && !encoded_matrix) {
+    throw std::invalid_argument("CheetahLinear::fc no weight matrix");
   }
 
   TensorShape out_shape({meta.weight_shape.dim_size(0)});
@@ -370,11 +931,11 @@ void CheetahLinear::fc(const Tensor<uint64_t> &input_vector,
         throw std::runtime_error("CheetahLinear::fc encryptInputVector [" +
                                  CodeMessage(code) + "]");
       }
-      send_encrypted_vector(io_, ct_buff);
+      send_encrypted_vector(io_, ct_buff, compression_, &io_stats_);
     }
 
     std::vector<seal::Ciphertext> ct_buff;
-    recv_encrypted_vector(io_, *context_, ct_buff);
+    recv_encrypted_vector(io_, *context_, ct_buff, false, &io_stats_);
     code = impl.decryptToVector(ct_buff, meta, out_vec_share, nthreads);
 
     if (code != Code::OK) {
@@ -382,13 +943,6 @@ void CheetahLinear::fc(const Tensor<uint64_t> &input_vector,
                                CodeMessage(code) + "]");
     }
   } else {
-    std::vector<std::vector<seal::Plaintext>> encoded_matrix;
-    code =
-        impl.encodeWeightMatrix(weight_matrix, meta, encoded_matrix, nthreads);
-    if (code != Code::OK) {
-      throw std::runtime_error("CheetahLinear::fc encodeWeightMatrix error [" +
-                               CodeMessage(code) + "]");
-    }
     std::vector<seal::Plaintext> vec_share1;
     if (meta.is_shared_input) {
       code = impl.encodeInputVector(input_vector, meta, vec_share1, nthreads);
@@ -402,41 +956,138 @@ void CheetahLinear::fc(const Tensor<uint64_t> &input_vector,
     io_->recv_data(&ncts, sizeof(uint32_t));
     std::vector<seal::Ciphertext> vec_share0(ncts);
     for (size_t i = 0; i < ncts; ++i) {
-      recv_ciphertext(io_, *context_, vec_share0[i]);
+      recv_ciphertext(io_, *context_, vec_share0[i], false, &io_stats_);
     }
 
     std::vector<seal::Ciphertext> out_vec_share0;
-    auto code = impl.matVecMul(encoded_matrix, vec_share0, vec_share1, meta,
+    auto code = impl.matVecMul(*encoded_matrix, vec_share0, vec_share1, meta,
                                out_vec_share0, out_vec_share, nthreads);
     if (code != Code::OK) {
       throw std::runtime_error("CheetahLinear::fc matmul2D error [" +
                                CodeMessage(code) + "]");
     }
-    send_encrypted_vector(io_, out_vec_share0);
+    send_encrypted_vector(io_, out_vec_share0, compression_, &io_stats_);
   }
 }
 
-void CheetahLinear::conv2d(const Tensor<uint64_t> &in_tensor,
-                           const std::vector<Tensor<uint64_t>> &filters,
-                           const ConvMeta &meta,
-                           Tensor<uint64_t> &out_tensor) const {
-  if (!meta.ishape.IsSameSize(in_tensor.shape())) {
-    throw std::invalid_argument("CheetahLinear::conv2d meta.ishape mismatch");
+void CheetahLinear::matmul(const Tensor<uint64_t> &input_matrix,
+                           const FCWeightStore::Encoded *encoded_matrix,
+                           const FCMeta &meta,
+                           Tensor<uint64_t> &out_matrix) const {
+  if (input_matrix.dims() != 2 ||
+      input_matrix.cols() != meta.input_shape.num_elements()) {
+    throw std::invalid_argument("CheetahLinear::matmul input shape mismatch");
+  }
+
+  if (party_ == sci::ALICE && !encoded_matrix) {
+    throw std::invalid_argument("CheetahLinear::matmul no weight matrix");
+  }
+
+  const size_t batch = input_matrix.rows();
+  const auto &impl = fc_impl_;
+
+  Code code;
+  if (party_ == sci::BOB) {
+    {
+      std::vector<seal::Serializable<seal::Ciphertext>> ct_buff;
+      code = impl.encryptInputMatrix(input_matrix, meta, ct_buff, nthreads_);
+      if (code != Code::OK) {
+        throw std::runtime_error("CheetahLinear::matmul encryptInputMatrix [" +
+                                 CodeMessage(code) + "]");
+      }
+      send_encrypted_vector(io_, ct_buff, compression_, &io_stats_);
+    }
+
+    std::vector<seal::Ciphertext> ct_buff;
+    recv_encrypted_vector(io_, *context_, ct_buff, false, &io_stats_);
+    code = impl.decryptToMatrix(ct_buff, meta, batch, out_matrix, nthreads_);
+    if (code != Code::OK) {
+      throw std::runtime_error("CheetahLinear::matmul decryptToMatrix [" +
+                               CodeMessage(code) + "]");
+    }
+  } else {
+    std::vector<seal::Plaintext> mat_share1;
+    if (meta.is_shared_input) {
+      code = impl.encodeInputMatrix(input_matrix, meta, mat_share1, nthreads_);
+      if (code != Code::OK) {
+        throw std::runtime_error(
+            "CheetahLinear::matmul encodeInputMatrix error [" +
+            CodeMessage(code) + "]");
+      }
+    }
+
+    std::vector<seal::Ciphertext> mat_share0;
+    recv_encrypted_vector(io_, *context_, mat_share0, false, &io_stats_);
+
+    std::vector<seal::Ciphertext> out_mat_share0;
+    code = impl.matMatMul(*encoded_matrix, mat_share0, mat_share1, meta, batch,
+                          out_mat_share0, out_matrix, nthreads_);
+    if (code != Code::OK) {
+      throw std::runtime_error("CheetahLinear::matmul matMatMul error [" +
+                               CodeMessage(code) + "]");
+    }
+    send_encrypted_vector(io_, out_mat_share0, compression_, &io_stats_);
+  }
+}
+
+ConvFilterCache::Encoded CheetahLinear::encodeConvFilters(
+    const std::vector<Tensor<uint64_t>> &filters, const ConvMeta &meta) const {
+  if (party_ != sci::ALICE) {
+    throw std::logic_error("CheetahLinear::encodeConvFilters server only");
   }
   if (meta.n_filters != filters.size()) {
     throw std::invalid_argument(
-        "CheetahLinear::conv2d meta.n_filters mismatch");
+        "CheetahLinear::encodeConvFilters meta.n_filters mismatch");
   }
   for (const auto &f : filters) {
     if (!meta.fshape.IsSameSize(f.shape())) {
-      throw std::invalid_argument("CheetahLinear::conv2d meta.fshape mismatch");
+      throw std::invalid_argument(
+          "CheetahLinear::encodeConvFilters meta.fshape mismatch");
     }
   }
 
+  ConvFilterCache::Encoded encoded_filters;
+  Code code =
+      conv2d_impl_.encodeFilters(filters, meta, encoded_filters, nthreads_);
+  if (code != Code::OK) {
+    throw std::runtime_error("CheetahLinear::conv2d ecnodeFilters " +
+                             CodeMessage(code));
+  }
+  return encoded_filters;
+}
+
+void CheetahLinear::conv2d(const Tensor<uint64_t> &in_tensor,
+                           const std::vector<Tensor<uint64_t>> &filters,
+                           const ConvMeta &meta,
+                           Tensor<uint64_t> &out_tensor) const {
+  if (party_ == sci::ALICE) {
+    auto encoded_filters = encodeConvFilters(filters, meta);
+    conv2d(in_tensor, &encoded_filters, meta, out_tensor);
+  } else {
+    conv2d(in_tensor, nullptr, meta, out_tensor);
+  }
+}
+
+void CheetahLinear::conv2d(const Tensor<uint64_t> &in_tensor,
+                           const ConvFilterCache::Encoded *encoded_filters,
+                           const ConvMeta &meta,
+                           Tensor<uint64_t> &out_tensor) const {
+  if (!meta.ishape.IsSameSize(in_tensor.shape())) {
+    throw std::invalid_argument("CheetahLinear::conv2d meta.ishape mismatch");
+  }
+  if (party_ == sci::ALICE && !encoded_filters) {
+    throw std::invalid_argument("CheetahLinear::conv2d no filters");
+  }
+
   const auto &impl = conv2d_impl_;
 
   Code code;
   if (party_ == sci::BOB) {
+    if (conv_streaming_) {
+      conv2dStreamedClient(in_tensor, meta, out_tensor);
+      return;
+    }
+
     {
       std::vector<seal::Serializable<seal::Ciphertext>> ct_buff;
       code = impl.encryptImage(in_tensor, meta, ct_buff, nthreads_);
@@ -444,12 +1095,12 @@ void CheetahLinear::conv2d(const Tensor<uint64_t> &in_tensor,
         throw std::runtime_error("CheetahLinear::conv2d encryptImage " +
                                  CodeMessage(code));
       }
-      send_encrypted_vector(io_, ct_buff);
+      send_encrypted_vector(io_, ct_buff, compression_, &io_stats_);
     }
 
     // Wait for result
     std::vector<seal::Ciphertext> ct_buff;
-    recv_encrypted_vector(io_, *context_, ct_buff, true);
+    recv_encrypted_vector(io_, *context_, ct_buff, true, &io_stats_);
 
     code = impl.decryptToTensor(ct_buff, meta, out_tensor, nthreads_);
     if (code != Code::OK) {
@@ -457,11 +1108,9 @@ void CheetahLinear::conv2d(const Tensor<uint64_t> &in_tensor,
                                CodeMessage(code));
     }
   } else {
-    std::vector<std::vector<seal::Plaintext>> encoded_filters;
-    code = impl.encodeFilters(filters, meta, encoded_filters, nthreads_);
-    if (code != Code::OK) {
-      throw std::runtime_error("CheetahLinear::conv2d ecnodeFilters " +
-                               CodeMessage(code));
+    if (conv_streaming_) {
+      conv2dStreamedServer(in_tensor, *encoded_filters, meta, out_tensor);
+      return;
     }
 
     std::vector<seal::Plaintext> encoded_share;
@@ -474,16 +1123,109 @@ void CheetahLinear::conv2d(const Tensor<uint64_t> &in_tensor,
     }
 
     std::vector<seal::Ciphertext> ct_buff;
-    recv_encrypted_vector(io_, *context_, ct_buff, false);
+    recv_encrypted_vector(io_, *context_, ct_buff, false, &io_stats_);
 
     std::vector<seal::Ciphertext> out_ct;
-    auto code = impl.conv2DSS(ct_buff, encoded_share, encoded_filters, meta,
+    auto code = impl.conv2DSS(ct_buff, encoded_share, *encoded_filters, meta,
                               out_ct, out_tensor, nthreads_);
     if (code != Code::OK) {
       throw std::runtime_error("CheetahLinear::conv2d conv2DSS: " +
                                CodeMessage(code));
     }
-    send_encrypted_vector(io_, out_ct);
+    send_encrypted_vector(io_, out_ct, compression_, &io_stats_);
+  }
+}
+
+// Bob sends the (sid+1)-th input slice before receiving the sid-th output
+// slice, and Alice receives the (sid+1)-th input slice before sending the
+// sid-th output slice. Thus at most one slice is in flight in each direction
+// and the two parties never block on send at the same time.
+void CheetahLinear::conv2dStreamedClient(const Tensor<uint64_t> &in_tensor,
+                                         const ConvMeta &meta,
+                                         Tensor<uint64_t> &out_tensor) const {
+  const auto &impl = conv2d_impl_;
+  std::vector<seal::Plaintext> encoded_share;
+  Code code = impl.encodeImageToEncrypt(in_tensor, meta, encoded_share);
+  if (code != Code::OK) {
+    throw std::runtime_error("CheetahLinear::conv2d encodeImageToEncrypt " +
+                             CodeMessage(code));
+  }
+
+  auto encrypt_and_send = [&](size_t sid) {
+    std::vector<seal::Serializable<seal::Ciphertext>> ct_buff;
+    Code c =
+        impl.encryptImageSlice(encoded_share, meta, sid, ct_buff, nthreads_);
+    if (c != Code::OK) {
+      throw std::runtime_error("CheetahLinear::conv2d encryptImageSlice " +
+                               CodeMessage(c));
+    }
+    send_encrypted_vector(io_, ct_buff, compression_, &io_stats_);
+    io_->flush();
+  };
+
+  const size_t n_slices = impl.numSlices(meta);
+  encrypt_and_send(0);
+  for (size_t sid = 0; sid < n_slices; ++sid) {
+    // Encrypt the next slice while Alice is working on this one.
+    if (sid + 1 < n_slices) {
+      encrypt_and_send(sid + 1);
+    }
+
+    std::vector<seal::Ciphertext> ct_buff;
+    recv_encrypted_vector(io_, *context_, ct_buff, true, &io_stats_);
+    code =
+        impl.decryptSliceToTensor(ct_buff, meta, sid, out_tensor, nthreads_);
+    if (code != Code::OK) {
+      throw std::runtime_error("CheetahLinear::conv2d decryptSliceToTensor " +
+                               CodeMessage(code));
+    }
+  }
+}
+
+void CheetahLinear::conv2dStreamedServer(
+    const Tensor<uint64_t> &in_tensor,
+    const ConvFilterCache::Encoded &encoded_filters, const ConvMeta &meta,
+    Tensor<uint64_t> &out_tensor) const {
+  const auto &impl = conv2d_impl_;
+  const size_t n_slices = impl.numSlices(meta);
+
+  std::vector<seal::Plaintext> encoded_share;
+  if (meta.is_shared_input) {
+    Code code = impl.encodeImage(in_tensor, meta, encoded_share, nthreads_);
+    if (code != Code::OK) {
+      throw std::runtime_error("CheetahLinear::conv2d encodeImage " +
+                               CodeMessage(code));
+    }
+    if (n_slices == 0 || encoded_share.size() % n_slices != 0) {
+      throw std::runtime_error("CheetahLinear::conv2d #slices mismatch");
+    }
+  }
+
+  std::vector<seal::Ciphertext> this_slice, next_slice;
+  recv_encrypted_vector(io_, *context_, this_slice, false, &io_stats_);
+  for (size_t sid = 0; sid < n_slices; ++sid) {
+    std::vector<seal::Plaintext> share_slice;
+    if (meta.is_shared_input) {
+      const size_t n_groups = encoded_share.size() / n_slices;
+      for (size_t c = 0; c < n_groups; ++c) {
+        share_slice.push_back(encoded_share[c * n_slices + sid]);
+      }
+    }
+
+    std::vector<seal::Ciphertext> out_ct;
+    Code code = impl.conv2DSSSlice(this_slice, share_slice, encoded_filters,
+                                   meta, sid, out_ct, out_tensor, nthreads_);
+    if (code != Code::OK) {
+      throw std::runtime_error("CheetahLinear::conv2d conv2DSSSlice: " +
+                               CodeMessage(code));
+    }
+
+    if (sid + 1 < n_slices) {
+      recv_encrypted_vector(io_, *context_, next_slice, false, &io_stats_);
+    }
+    send_encrypted_vector(io_, out_ct, compression_, &io_stats_);
+    io_->flush();
+    std::swap(this_slice, next_slice);
   }
 }
 
@@ -503,7 +1245,8 @@ void CheetahLinear::bn(const Tensor<uint64_t> &input_vector,
         throw std::runtime_error("bn encryptVector [" + CodeMessage(code) +
                                  "]");
       }
-      code = bn_impl_.sendEncryptVector(io_, ct_buff, meta);
+      code = bn_impl_.sendEncryptVector(io_, ct_buff, meta, compression_,
+                                         &io_stats_);
       if (code != Code::OK) {
         throw std::runtime_error("bn sendEncryptVector [" + CodeMessage(code) +
                                  "]");
@@ -511,7 +1254,7 @@ void CheetahLinear::bn(const Tensor<uint64_t> &input_vector,
     }
 
     std::vector<seal::Ciphertext> ct_buff;
-    code = bn_impl_.recvEncryptVector(io_, ct_buff, meta);
+    code = bn_impl_.recvEncryptVector(io_, ct_buff, meta, &io_stats_);
     if (code != Code::OK) {
       throw std::runtime_error("bn recvEncryptVector [" + CodeMessage(code) +
                                "]");
@@ -543,7 +1286,8 @@ void CheetahLinear::bn(const Tensor<uint64_t> &input_vector,
     }
 
     std::vector<seal::Ciphertext> encrypted_vector;
-    code = bn_impl_.recvEncryptVector(io_, encrypted_vector, meta);
+    code =
+        bn_impl_.recvEncryptVector(io_, encrypted_vector, meta, &io_stats_);
     if (code != Code::OK) {
       throw std::runtime_error("bn recvEncryptVector [" + CodeMessage(code) +
                                "]");
@@ -558,7 +1302,8 @@ void CheetahLinear::bn(const Tensor<uint64_t> &input_vector,
       throw std::runtime_error("bn failed [" + CodeMessage(code) + "]");
     }
 
-    code = bn_impl_.sendEncryptVector(io_, out_ct, meta);
+    code = bn_impl_.sendEncryptVector(io_, out_ct, meta, compression_,
+                                         &io_stats_);
     if (code != Code::OK) {
       throw std::runtime_error("bn sendEncryptVector [" + CodeMessage(code) +
                                "]");
@@ -582,11 +1327,11 @@ void CheetahLinear::bn_direct(const Tensor<uint64_t> &input_tensor,
         throw std::runtime_error("bn_direct encryptVector [" +
                                  CodeMessage(code) + "]");
       }
-      send_encrypted_vector(io_, ct_buff);
+      send_encrypted_vector(io_, ct_buff, compression_, &io_stats_);
     }
 
     std::vector<seal::Ciphertext> ct_buff;
-    recv_encrypted_vector(io_, *context_, ct_buff);
+    recv_encrypted_vector(io_, *context_, ct_buff, false, &io_stats_);
 
     code = bn_impl_.decryptToTensor(ct_buff, meta, out_tensor, nthreads_);
     if (code != Code::OK) {
@@ -610,7 +1355,8 @@ void CheetahLinear::bn_direct(const Tensor<uint64_t> &input_tensor,
     }
 
     std::vector<seal::Ciphertext> encrypted_tensor;
-    recv_encrypted_vector(io_, *context_, encrypted_tensor);
+    recv_encrypted_vector(io_, *context_, encrypted_tensor, false,
+                          &io_stats_);
 
     std::vector<seal::Ciphertext> out_ct;
     code = bn_impl_.bn_direct(encrypted_tensor, encoded_tensor, scale_vector,
@@ -618,7 +1364,7 @@ void CheetahLinear::bn_direct(const Tensor<uint64_t> &input_tensor,
     if (code != Code::OK) {
       throw std::runtime_error("bn_direct failed [" + CodeMessage(code) + "]");
     }
-    send_encrypted_vector(io_, out_ct);
+    send_encrypted_vector(io_, out_ct, compression_, &io_stats_);
   }
 }
 
@@ -626,29 +1372,19 @@ void CheetahLinear::bn_direct(const Tensor<uint64_t> &input_tensor,
 
 void recv_encrypted_vector(sci::NetIO *io, const seal::SEALContext &context,
                            std::vector<seal::Ciphertext> &ct_vec,
-                           bool is_truncated) {
+                           bool is_truncated, gemini::CtIOStats *stats) {
   uint32_t ncts{0};
   io->recv_data(&ncts, sizeof(uint32_t));
   if (ncts > 0) {
     ct_vec.resize(ncts);
     for (size_t i = 0; i < ncts; ++i) {
-      recv_ciphertext(io, context, ct_vec[i], is_truncated);
+      recv_ciphertext(io, context, ct_vec[i], is_truncated, stats);
     }
   }
 }
 
 void recv_ciphertext(sci::NetIO *io, const seal::SEALContext &context,
-                     seal::Ciphertext &ct, bool is_truncated) {
-  std::stringstream is;
-  uint64_t ct_size;
-  io->recv_data(&ct_size, sizeof(uint64_t));
-  char *c_enc_result = new char[ct_size];
-  io->recv_data(c_enc_result, ct_size);
-  is.write(c_enc_result, ct_size);
-  if (is_truncated) {
-    ct.unsafe_load(context, is);
-  } else {
-    ct.load(context, is);
-  }
-  delete[] c_enc_result;
+                     seal::Ciphertext &ct, bool is_truncated,
+                     gemini::CtIOStats *stats) {
+  gemini::recv_ciphertext(io, context, ct, is_truncated, stats);
 }
@@ -5,6 +5,13 @@
 #include "gemini/cheetah/hom_bn_ss.h"
 #include "gemini/cheetah/hom_conv2d_ss.h"
 #include "gemini/cheetah/hom_fc_ss.h"
+#include "gemini/core/util/ThreadPool.h"
+#include "gemini/core/util/seal.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
 
 namespace sci {
 class NetIO;
@@ -12,6 +19,156 @@ class NetIO;
 
 namespace gemini {
 
+// Fingerprint of the plaintext weights of a layer. Never zero, so zero can
+// stand for "no fingerprint".
+uint64_t WeightsFingerprint(const uint64_t *data, size_t n);
+
+// Server-side cache of the encoded conv filters which lives as long as the
+// model, so that the filters are encoded once rather than on every inference.
+// The layers are identified by their ordinal, the shapes and the SEAL
+// parameters. Each entry carries the WeightsFingerprint of the plaintext
+// filters which is checked on a lookup, and thus a layer whose filters change
+// (or a temporary buffer of another content) is re-encoded rather than served
+// from the cache. The cache is bounded by the total size of the encoded
+// filters, and the least recently used layers are dropped first.
+class ConvFilterCache {
+ public:
+  using Encoded = std::vector<std::vector<seal::Plaintext>>;
+
+  static constexpr size_t kDefaultMaxBytes = 4ULL << 30;
+
+  explicit ConvFilterCache(size_t max_nbytes = kDefaultMaxBytes)
+      : max_nbytes_(max_nbytes) {}
+
+  ConvFilterCache(const ConvFilterCache &oth) = delete;
+
+  ConvFilterCache &operator=(const ConvFilterCache &oth) = delete;
+
+  // Count as a hit or a miss. Miss if the cached filters are encoded from
+  // other weights.
+  std::shared_ptr<const Encoded> find(size_t layer,
+                                      const HomConv2DSS::Meta &meta,
+                                      uint64_t plain_mod,
+                                      const seal::parms_id_type &parms_id,
+                                      uint64_t filters_fingerprint) const;
+
+  // Replace the existing entry of the layer. Filters larger than the whole
+  // cache are returned without being kept.
+  std::shared_ptr<const Encoded> insert(size_t layer,
+                                        const HomConv2DSS::Meta &meta,
+                                        uint64_t plain_mod,
+                                        const seal::parms_id_type &parms_id,
+                                        uint64_t filters_fingerprint,
+                                        Encoded &&encoded_filters);
+
+  void clear();
+
+  size_t size() const;
+
+  size_t nbytes() const;
+
+  size_t hits() const { return hits_.load(); }
+
+  size_t misses() const { return misses_.load(); }
+
+ private:
+  using Key = std::vector<int64_t>;
+
+  struct Entry {
+    uint64_t filters_fingerprint;
+    std::shared_ptr<const Encoded> filters;
+    size_t nbytes;
+    std::list<Key>::iterator lru_pos;
+  };
+
+  static Key MakeKey(size_t layer, const HomConv2DSS::Meta &meta,
+                     uint64_t plain_mod, const seal::parms_id_type &parms_id);
+
+  void evict_until(size_t nbytes);
+
+  size_t max_nbytes_;
+  mutable std::mutex lock_;
+  std::map<Key, Entry> entries_;
+  // Most recently used first.
+  mutable std::list<Key> lru_;
+  size_t nbytes_{0};
+  mutable std::atomic<size_t> hits_{0};
+  mutable std::atomic<size_t> misses_{0};
+};
+  mutable std::atomic<size_t> misses_{0};
+};
+
+// Server-side store of the encoded FC weight matrices. The store is filled by
+// an offline pass and saved as a flat file of the raw plaintext coefficients,
+// which is mmap-ed by the online runs so that no encoding work is needed.
+// The layers are identified by their ordinal which is stable across runs of
+// the same network. Each entry carries the WeightsFingerprint of the plaintext
+// weights, and the file carries the parms id of the SEAL parameters, so that a
+// file of another model or parameter set is not used.
+class FCWeightStore {
+ public:
+  using Encoded = std::vector<std::vector<seal::Plaintext>>;
+
+  explicit FCWeightStore(const seal::parms_id_type &parms_id)
+      : parms_id_(parms_id) {}
+
+  FCWeightStore(const FCWeightStore &oth) = delete;
+
+  FCWeightStore &operator=(const FCWeightStore &oth) = delete;
+
+  // The encoding depends on the number of packed input rows `batch`. Miss if
+  // the stored matrix is encoded from other weights.
+  std::shared_ptr<const Encoded> find(size_t layer, const HomFCSS::Meta &meta,
+                                      size_t batch, uint64_t plain_mod,
+                                      uint64_t weights_fingerprint) const;
+
+  std::shared_ptr<const Encoded> insert(size_t layer,
+                                        const HomFCSS::Meta &meta,
+                                        size_t batch, uint64_t plain_mod,
+                                        uint64_t weights_fingerprint,
+                                        Encoded &&encoded_matrix);
+
+  // Return false if the file is absent, malformed, or encoded for other SEAL
+  // parameters.
+  bool load(const std::string &path);
+
+  bool save(const std::string &path) const;
+
+  size_t size() const;
+
+  // Whether new matrices are inserted since the last load/save.
+  bool is_dirty() const { return is_dirty_; }
+
+ private:
+  using Key = std::vector<int64_t>;
+
+  struct Entry {
+    uint64_t weights_fingerprint;
+    std::shared_ptr<const Encoded> matrix;
+  };
+
+  static Key MakeKey(size_t layer, const HomFCSS::Meta &meta, size_t batch,
+                     uint64_t plain_mod);
+
+  seal::parms_id_type parms_id_;
+  mutable std::mutex lock_;
+  std::map<Key, Entry> entries_;
+  bool is_dirty_{false};
+};
+
+// Persistent key material so that a reconnecting client skips the key
+// generation and the public key transfer. Bob keeps his secret keys in
+// `dir`/<client_id>.sk and Alice keeps the received public keys in
+// `dir`/<client_id>.pk. Both files carry the fingerprint of the public keys,
+// and the stored keys are reused only if the two fingerprints match. Alice
+// takes the client id from Bob. Both parties should agree on using it.
+struct KeyResume {
+  std::string dir;
+  std::string client_id;
+  // Discard the stored keys (if any) and persist freshly generated ones.
+  bool rotate{false};
+};
+
 // The set of the linear protocols in the Cheetah's paper.
 class CheetahLinear {
  public:
@@ -19,7 +176,8 @@ class CheetahLinear {
   using FCMeta = HomFCSS::Meta;
   using BNMeta = HomBNSS::Meta;
 
-  CheetahLinear(int party, sci::NetIO *io, uint64_t base_mod, size_t nthreads = 1);
+  CheetahLinear(int party, sci::NetIO *io, uint64_t base_mod, size_t nthreads = 1,
+                const KeyResume *resume = nullptr);
 
   ~CheetahLinear() = default;
 
@@ -28,11 +186,54 @@ class CheetahLinear {
               const std::vector<Tensor<uint64_t>> &filters,
               const ConvMeta &meta, Tensor<uint64_t> &out_tensor) const;
 
+  // HomConv with the filters already encoded by encodeConvFilters. The client
+  // passes nullptr.
+  void conv2d(const Tensor<uint64_t> &in_tensor,
+              const ConvFilterCache::Encoded *encoded_filters,
+              const ConvMeta &meta, Tensor<uint64_t> &out_tensor) const;
+
+  // Server only.
+  ConvFilterCache::Encoded encodeConvFilters(
+      const std::vector<Tensor<uint64_t>> &filters, const ConvMeta &meta) const;
+
+  // Streaming HomConv: the input and the output ciphertexts are exchanged
+  // slice by slice, so that the client's encryption, the server's evaluation
+  // and the client's decryption of different slices overlap. Both parties
+  // should use the same setting.
+  void set_conv_streaming(bool on) { conv_streaming_ = on; }
+
+  bool conv_streaming() const { return conv_streaming_; }
+
   // HomFC
   void fc(const Tensor<uint64_t> &input_matrix,
           const Tensor<uint64_t> &weight_matrix, const FCMeta &meta,
           Tensor<uint64_t> &out_matrix) const;
 
+  // HomFC with the weight matrix already encoded by encodeFCWeights. The
+  // client passes nullptr.
+  void fc(const Tensor<uint64_t> &input_vector,
+          const FCWeightStore::Encoded *encoded_matrix, const FCMeta &meta,
+          Tensor<uint64_t> &out_vector) const;
+
+  // Batched HomFC: the rows of the input matrix are packed together and the
+  // whole matrix product is evaluated in one exchange. `meta.input_shape` is
+  // the shape of one row, and the server's matrix should be encoded with
+  // batch = input_matrix.rows(). The client passes nullptr.
+  void matmul(const Tensor<uint64_t> &input_matrix,
+              const FCWeightStore::Encoded *encoded_matrix, const FCMeta &meta,
+              Tensor<uint64_t> &out_matrix) const;
+
+  // Server only.
+  FCWeightStore::Encoded encodeFCWeights(const Tensor<uint64_t> &weight_matrix,
+                                         const FCMeta &meta,
+                                         size_t batch = 1) const;
+
+  uint64_t plain_modulus() const { return base_mod_; }
+
+  // Identifies the SEAL parameters that the FC weights and the conv filters
+  // are encoded for.
+  seal::parms_id_type fc_parms_id() const { return context_->key_parms_id(); }
+
   // The CrypTFlow2's like BN protocol.
   // Need element-wise multiplication.
   void bn(const Tensor<uint64_t> &input_vector,
@@ -46,8 +247,31 @@ class CheetahLinear {
 
   uint64_t io_counter() const;
 
+  // The HomConv, HomFC and HomBN share one pool of `nthreads` workers that
+  // lives as long as this object. `nthreads` is also the number of threads of
+  // every HE call, which is not bounded by SCI's MAX_THREADS. The i-th worker
+  // is pinned to cpus[i % cpus.size()] when `cpus` is given.
+  void set_thread_pool(size_t nthreads, const std::vector<int> &cpus = {});
+
+  std::shared_ptr<ThreadPool> thread_pool() const { return tpool_; }
+
+  // Compression of the ciphertexts sent by this party. The receiver detects
+  // the format by itself, so the two parties can use different settings.
+  void set_compression(const CtCompression &compr) { compression_ = compr; }
+
+  const CtCompression &compression() const { return compression_; }
+
+  // Raw v.s. compressed ciphertext bytes and the (de)compression time
+  // accumulated since the last reset.
+  const CtIOStats &io_stats() const { return io_stats_; }
+
+  void reset_io_stats() const { io_stats_ = CtIOStats(); }
+
   int party() const { return party_; }
 
+  // Whether the keys are taken from the KeyResume store.
+  bool keys_resumed() const { return keys_resumed_; }
+
   bool verify(const Tensor<uint64_t> &int_tensor,
               const std::vector<Tensor<uint64_t>> &filters,
               const ConvMeta &meta, const Tensor<uint64_t> &computed_tensor,
@@ -65,8 +289,27 @@ class CheetahLinear {
   uint64_t reduce(uint64_t v) const;
 
  private:
+  void setUpBNContexts();
+
   void setUpForBN();
 
+  // Generate (Bob) or receive (Alice) the keys of context_ and bn_contexts_.
+  // The serialized public keys are put to `pk_blobs`.
+  void exchangeKeys(std::vector<std::string> &pk_blobs);
+
+  // Return true if the stored keys are taken. Otherwise, the keys are
+  // exchanged and then stored.
+  bool resumeKeys(const KeyResume &resume);
+
+  void conv2dStreamedClient(const Tensor<uint64_t> &in_tensor,
+                            const ConvMeta &meta,
+                            Tensor<uint64_t> &out_tensor) const;
+
+  void conv2dStreamedServer(const Tensor<uint64_t> &in_tensor,
+                            const ConvFilterCache::Encoded &encoded_filters,
+                            const ConvMeta &meta,
+                            Tensor<uint64_t> &out_tensor) const;
+
   int party_{-1};
   sci::NetIO *io_{nullptr};
   size_t nthreads_{1};
@@ -84,10 +327,18 @@ class CheetahLinear {
   std::vector<std::shared_ptr<seal::SEALContext>> bn_contexts_;
   std::vector<std::shared_ptr<seal::SecretKey>> bn_sks_;  // Bob only
   std::vector<std::shared_ptr<seal::PublicKey>> bn_pks_;  // Alice only
+  bool keys_resumed_{false};
 
   HomFCSS fc_impl_;
   HomConv2DSS conv2d_impl_;
   HomBNSS bn_impl_;
+
+  bool conv_streaming_{false};
+
+  std::shared_ptr<ThreadPool> tpool_{nullptr};
+
+  CtCompression compression_;
+  mutable CtIOStats io_stats_;
 };
 
 }  // namespace gemini
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "globals.h"
 #include <cmath>
+#include <thread>
+#include <vector>
 
 void funcLocalTruncate(int s, intType *arr, int consSF) {
   if (party == SERVER) {
@@ -191,15 +193,77 @@ intType funcSigendDivIdeal(intType x, uint32_t y) {
   }
 }
 
+struct WorkChunk {
+  int offset;
+  int size;
+};
+
+// Splits size elements over at most num_threads threads. Every chunk but the
+// last is a multiple of align and no two chunks differ by more than align
+// elements. Empty chunks are dropped, so both parties derive the same chunks
+// (and hence the same ioArr[tid]) from size alone.
+std::vector<WorkChunk> partitionWork(int size, int align = 1) {
+  std::vector<WorkChunk> chunks;
+  int units = (size + align - 1) / align;
+  int parts = std::min(num_threads, units);
+  int offset = 0;
+  for (int i = 0; i < parts; i++) {
+    int len = (units / parts + (i < units % parts ? 1 : 0)) * align;
+    len = std::min(len, size - offset);
+    chunks.push_back({offset, len});
+    offset += len;
+  }
+  return chunks;
+}
+
+// Runs fn(tid, offset, size) on every chunk of partitionWork(size, align),
+// chunk i on thread i with the protocol instances of that thread. A single
+// chunk runs on the calling thread.
+template <typename Fn>
+void runPartitioned(int size, int align, Fn fn) {
+  std::vector<WorkChunk> chunks = partitionWork(size, align);
+  if (chunks.size() == 1) {
+    fn(0, chunks[0].offset, chunks[0].size);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    threads.emplace_back(fn, (int)i, chunks[i].offset, chunks[i].size);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
 void funcReLUThread(int tid, intType *outp, intType *inp, int numRelu,
                     uint8_t *drelu_res = nullptr, bool skip_ot = false) {
   reluArr[tid]->relu(outp, inp, numRelu, drelu_res, skip_ot);
 }
 
+void funcReLUTruncateFusedThread(int tid, intType *outp, intType *inp,
+                                 int numRelu, int sf) {
+  static_cast<ReLURingProtocol<sci::NetIO, intType> *>(reluArr[tid])
+      ->relu_truncate(outp, inp, numRelu, sf);
+}
+
 void funcMaxpoolThread(int tid, int rows, int cols, intType *inpArr, intType *maxi, intType *maxiIdx) {
   maxpoolArr[tid]->funcMaxMPC(rows, cols, inpArr, maxi, maxiIdx);
 }
 
+void funcMaxPool2DThread(int tid, int num_planes, int imgH, int imgW,
+                         int ksizeH, int ksizeW, int zPadHLeft, int zPadHRight,
+                         int zPadWLeft, int zPadWRight, int strideH,
+                         int strideW, intType *inpArr, intType *outArr) {
+  maxpoolArr[tid]->funcMaxPool2D(num_planes, imgH, imgW, ksizeH, ksizeW,
+                                 zPadHLeft, zPadHRight, zPadWLeft, zPadWRight,
+                                 strideH, strideW, inpArr, outArr);
+}
+
+void funcArgMaxThread(int tid, int rows, int cols, int idxOffset,
+                      intType *inpArr, intType *maxiIdx, intType *maxi) {
+  argmaxArr[tid]->ArgMaxRowsMPC(rows, cols, inpArr, maxiIdx, maxi, idxOffset);
+}
+
 #ifdef SCI_OT
 void funcTruncateThread(int tid, int32_t size, intType *inpArr, intType *outpArr, int32_t scalingF, int32_t bw, bool isSigned, uint8_t *msb) {
   truncationArr[tid]->truncate(size, inpArr, outpArr, scalingF, bw, isSigned, msb);
@@ -474,31 +538,15 @@ void funcTruncateTwoPowerRing(int curParty, sci::NetIO *curio,
 void funcTruncateTwoPowerRingWrapper(int size, intType *inp, intType *outp, int consSF, int bw, bool isSigned, uint8_t *msbShare) {
   assert(size % 8 == 0);
 #ifdef MULTITHREADED_TRUNC
-  std::thread truncThreads[num_threads];
-  int chunk_size = (size / (8 * num_threads)) * 8;
-  for (int i = 0; i < num_threads; i++) {
-    int offset = i * chunk_size;
-    int curSize;
-    if (i == (num_threads - 1)) {
-      curSize = size - offset;
-    } else {
-      curSize = chunk_size;
-    }
-    int curParty = party;
-    if (i & 1)
-      curParty = 3 - curParty;
-
+  runPartitioned(size, 8, [&](int tid, int offset, int curSize) {
     uint8_t *msbShareArg = msbShare;
     if (msbShare != nullptr)
       msbShareArg = msbShareArg + offset;
-
-    truncThreads[i] = std::thread(funcTruncateThread, i, curSize, inp + offset, outp + offset, consSF, bw, isSigned, msbShareArg);
-  }
-  for (int i = 0; i < num_threads; ++i) {
-    truncThreads[i].join();
-  }
+    funcTruncateThread(tid, curSize, inp + offset, outp + offset, consSF, bw,
+                       isSigned, msbShareArg);
+  });
 #else
-  funcTruncateThread(0, size, inp, outp, consSF, bw, isSigned, msgShare);
+  funcTruncateThread(0, size, inp, outp, consSF, bw, isSigned, msbShare);
 #endif
 }
 #endif
@@ -508,25 +556,10 @@ void funcTruncateTwoPowerRingWrapper(int size, intType *inp, intType *outp, int
 void funcReLUTruncateTwoPowerRingWrapper(int size, intType *inp, intType *outp, int consSF, int32_t bw, bool isSigned) {
   assert(size % 8 == 0);
 #ifdef MULTITHREADED_TRUNC
-  std::thread truncThreads[num_threads];
-  int chunk_size = (size / (8 * num_threads)) * 8;
-  for (int i = 0; i < num_threads; i++) {
-    int offset = i * chunk_size;
-    int curSize;
-    if (i == (num_threads - 1)) {
-      curSize = size - offset;
-    } else {
-      curSize = chunk_size;
-    }
-    int curParty = party;
-    if (i & 1)
-      curParty = 3 - curParty;
-
-    truncThreads[i] = std::thread(funcReLUTruncateThread, i, curSize, inp + offset, outp + offset, consSF, bw, isSigned);
-  }
-  for (int i = 0; i < num_threads; ++i) {
-    truncThreads[i].join();
-  }
+  runPartitioned(size, 8, [&](int tid, int offset, int curSize) {
+    funcReLUTruncateThread(tid, curSize, inp + offset, outp + offset, consSF,
+                           bw, isSigned);
+  });
 #else
   funcReLUTruncateThread(0, size, inp, outp, consSF, bw, isSigned);
 #endif
@@ -813,27 +846,13 @@ void funcAvgPoolTwoPowerRingWrapper(int size, intType *inp, intType *outp,
                                     intType divisor) {
   assert(size % 8 == 0);
 #ifdef MULTITHREADED_TRUNC
-  std::thread truncThreads[num_threads];
-  int chunk_size = (size / (8 * num_threads)) * 8;
-  for (int i = 0; i < num_threads; i++) {
-    int offset = i * chunk_size;
-    int curSize;
-    if (i == (num_threads - 1)) {
-      curSize = size - offset;
-    } else {
-      curSize = chunk_size;
-    }
-    int curParty = party;
-    if (i & 1)
-      curParty = 3 - curParty;
-    truncThreads[i] = std::thread(
-        funcAvgPoolTwoPowerRing, curParty, ioArr[i], otpackArr[i],
-        otInstanceArr[i], kkotInstanceArr[i], reluArr[i], prgInstanceArr[i],
-        curSize, inp + offset, outp + offset, divisor);
-  }
-  for (int i = 0; i < num_threads; ++i) {
-    truncThreads[i].join();
-  }
+  runPartitioned(size, 8, [&](int tid, int offset, int curSize) {
+    int curParty = (tid & 1) ? 3 - party : party;
+    funcAvgPoolTwoPowerRing(curParty, ioArr[tid], otpackArr[tid],
+                            otInstanceArr[tid], kkotInstanceArr[tid],
+                            reluArr[tid], prgInstanceArr[tid], curSize,
+                            inp + offset, outp + offset, divisor);
+  });
 #else
   funcAvgPoolTwoPowerRing(party, io, otpack, iknpOT, kkot, relu, prg128Instance,
                           size, inp, outp, divisor);
@@ -1125,30 +1144,16 @@ void funcFieldDivWrapper(int size, intType *inp, intType *outp, intType divisor,
                          uint8_t *msbShare) {
   assert(size % 8 == 0);
 #ifdef MULTITHREADED_TRUNC
-  std::thread truncThreads[num_threads];
-  int chunk_size = (size / (8 * num_threads)) * 8;
-  for (int i = 0; i < num_threads; i++) {
-    int offset = i * chunk_size;
-    int curSize;
-    if (i == (num_threads - 1)) {
-      curSize = size - offset;
-    } else {
-      curSize = chunk_size;
-    }
-    int curParty = party;
-    if (i & 1)
-      curParty = 3 - curParty;
+  runPartitioned(size, 8, [&](int tid, int offset, int curSize) {
+    int curParty = (tid & 1) ? 3 - party : party;
     uint8_t *msbShareArg = msbShare;
     if (msbShare != nullptr)
       msbShareArg = msbShareArg + offset;
-    truncThreads[i] = std::thread(
-        funcFieldDiv<intType>, curParty, ioArr[i], otpackArr[i],
-        otInstanceArr[i], kkotInstanceArr[i], reluArr[i], prgInstanceArr[i],
-        curSize, inp + offset, outp + offset, divisor, msbShareArg);
-  }
-  for (int i = 0; i < num_threads; ++i) {
-    truncThreads[i].join();
-  }
+    funcFieldDiv<intType>(curParty, ioArr[tid], otpackArr[tid],
+                          otInstanceArr[tid], kkotInstanceArr[tid],
+                          reluArr[tid], prgInstanceArr[tid], curSize,
+                          inp + offset, outp + offset, divisor, msbShareArg);
+  });
 #else
   funcFieldDiv<intType>(party, io, otpack, iknpOT, kkot, relu, prg128Instance,
                         size, inp, outp, divisor, msbShare);
@@ -21,9 +21,16 @@ SOFTWARE.
 
 #include "globals.h"
 #include "csv_writer.hpp"
+#include <algorithm>
+#include <iostream>
+#include <memory>
 
 sci::NetIO *io;
 sci::OTPack<sci::NetIO> *otpack;
+int mux_sockets = 0;
+sci::MuxConnection *mux = nullptr;
+bool async_send = false;
+bool use_shm = false;
 
 #ifdef SCI_OT
 LinearOT *mult;
@@ -47,6 +54,24 @@ ElemWiseProdField *he_prod;
 
 #if USE_CHEETAH
 gemini::CheetahLinear *cheetah_linear;
+std::shared_ptr<gemini::ConvFilterCache> conv_filter_cache;
+std::shared_ptr<gemini::FCWeightStore> fc_weight_store;
+std::string fc_weight_store_path;
+size_t fc_layer_counter = 0;
+size_t conv_layer_counter = 0;
+bool conv_streaming = false;
+std::string ct_compression;
+std::string cheetah_cpu_affinity;
+int cheetah_he_threads = 0;
+std::string cheetah_key_dir;
+std::string cheetah_client_id;
+bool cheetah_rotate_keys = false;
+std::string warm_start_dir;
+int ot_pool_size = 0;
+sci::OTBudget ot_budget;
+int mill_fan_in = 0;
+double mill_rtt_ms = -1;
+double mill_bandwidth_mbps = 1000;
 bool kIsSharedInput;
 #elif defined(SCI_HE)
 ConvField *he_conv;
@@ -57,29 +82,124 @@ sci::IKNP<sci::NetIO> *iknpOTRoleReversed;
 sci::KKOT<sci::NetIO> *kkot;
 sci::PRG128 *prg128Instance;
 
-sci::NetIO *ioArr[MAX_THREADS];
-sci::OTPack<sci::NetIO> *otpackArr[MAX_THREADS];
+std::vector<sci::NetIO *> ioArr;
+std::vector<sci::OTPack<sci::NetIO> *> otpackArr;
 #ifdef SCI_OT
-LinearOT *multArr[MAX_THREADS];
-AuxProtocols *auxArr[MAX_THREADS];
-Truncation *truncationArr[MAX_THREADS];
-XTProtocol *xtArr[MAX_THREADS];
-MathFunctions *mathArr[MAX_THREADS];
+std::vector<LinearOT *> multArr;
+std::vector<AuxProtocols *> auxArr;
+std::vector<Truncation *> truncationArr;
+std::vector<XTProtocol *> xtArr;
+std::vector<MathFunctions *> mathArr;
 #endif
-ReLUProtocol<sci::NetIO, intType> *reluArr[MAX_THREADS];
-MaxPoolProtocol<sci::NetIO, intType> *maxpoolArr[MAX_THREADS];
+std::vector<ReLUProtocol<sci::NetIO, intType> *> reluArr;
+std::vector<MaxPoolProtocol<sci::NetIO, intType> *> maxpoolArr;
+std::vector<ArgMaxProtocol<sci::NetIO, intType> *> argmaxArr;
 // Additional classes for Athos
 #ifdef SCI_OT
-MatMulUniform<sci::NetIO, intType, sci::IKNP<sci::NetIO>> *multUniformArr[MAX_THREADS];
+std::vector<MatMulUniform<sci::NetIO, intType, sci::IKNP<sci::NetIO>> *> multUniformArr;
 #endif
-sci::IKNP<sci::NetIO> *otInstanceArr[MAX_THREADS];
-sci::KKOT<sci::NetIO> *kkotInstanceArr[MAX_THREADS];
-sci::PRG128 *prgInstanceArr[MAX_THREADS];
+std::vector<sci::IKNP<sci::NetIO> *> otInstanceArr;
+std::vector<sci::KKOT<sci::NetIO> *> kkotInstanceArr;
+std::vector<sci::PRG128 *> prgInstanceArr;
 
 std::chrono::time_point<std::chrono::high_resolution_clock> start_time;
-uint64_t comm_threads[MAX_THREADS];
+std::vector<uint64_t> comm_threads;
 uint64_t num_rounds;
 
+void ResizeThreadArrays() {
+  ioArr.resize(num_threads, nullptr);
+  otpackArr.resize(num_threads, nullptr);
+#ifdef SCI_OT
+  multArr.resize(num_threads, nullptr);
+  auxArr.resize(num_threads, nullptr);
+  truncationArr.resize(num_threads, nullptr);
+  xtArr.resize(num_threads, nullptr);
+  mathArr.resize(num_threads, nullptr);
+  multUniformArr.resize(num_threads, nullptr);
+#endif
+  reluArr.resize(num_threads, nullptr);
+  maxpoolArr.resize(num_threads, nullptr);
+  argmaxArr.resize(num_threads, nullptr);
+  otInstanceArr.resize(num_threads, nullptr);
+  kkotInstanceArr.resize(num_threads, nullptr);
+  prgInstanceArr.resize(num_threads, nullptr);
+  comm_threads.resize(num_threads, 0);
+}
+
+std::map<std::string, IOScopeStats> io_scope_stats;
+std::string IOScopeOutputFile = "io_scopes";
+// Labels of the open scopes, outermost first.
+static std::vector<std::string> io_scope_labels;
+
+IOScope::IOScope(const std::string &label) {
+  io_scope_labels.push_back(label);
+  for (int i = 0; i < num_threads && i < (int)ioArr.size(); i++) {
+    start.push_back(ioArr[i] ? ioArr[i]->stats() : sci::IOStats());
+  }
+  start_time = std::chrono::steady_clock::now();
+}
+
+IOScope::~IOScope() {
+  std::string path;
+  for (auto &label : io_scope_labels) {
+    path += (path.empty() ? "" : "/") + label;
+  }
+  io_scope_labels.pop_back();
+
+  IOScopeStats &total = io_scope_stats[path];
+  total.calls++;
+  total.wall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+  sci::IOStats cur;
+  for (size_t i = 0; i < start.size(); i++) {
+    if (!ioArr[i]) continue;
+    sci::IOStats now = ioArr[i]->stats();
+    cur.bytes_sent += now.bytes_sent - start[i].bytes_sent;
+    cur.bytes_recv += now.bytes_recv - start[i].bytes_recv;
+    cur.rounds = std::max(cur.rounds, now.rounds - start[i].rounds);
+    cur.send_ns = std::max(cur.send_ns, now.send_ns - start[i].send_ns);
+    cur.recv_ns = std::max(cur.recv_ns, now.recv_ns - start[i].recv_ns);
+  }
+  total.io.bytes_sent += cur.bytes_sent;
+  total.io.bytes_recv += cur.bytes_recv;
+  total.io.rounds += cur.rounds;
+  total.io.send_ns += cur.send_ns;
+  total.io.recv_ns += cur.recv_ns;
+}
+
+void ReportIOScopes(const std::string &csv_file) {
+  if (io_scope_stats.empty()) return;
+  std::unique_ptr<WriteToCSV> csv;
+  if (!csv_file.empty()) {
+    csv.reset(new WriteToCSV(
+        csv_file, {"scope", "calls", "wall_ms", "sent_bytes", "recv_bytes",
+                   "rounds", "send_ms", "recv_ms"}));
+  }
+  std::cout << "------------------------------------------------------\n";
+  std::cout << "IO per scope (wall ms, sent MiB, received MiB, rounds, "
+               "ms in send, ms in recv):\n";
+  for (auto &it : io_scope_stats) {
+    const IOScopeStats &st = it.second;
+    double wall_ms = st.wall_ns / 1e6;
+    double send_ms = st.io.send_ns / 1e6;
+    double recv_ms = st.io.recv_ns / 1e6;
+    std::cout << it.first << " x" << st.calls << ": " << wall_ms << ", "
+              << st.io.bytes_sent / (1.0 * (1ULL << 20)) << ", "
+              << st.io.bytes_recv / (1.0 * (1ULL << 20)) << ", "
+              << st.io.rounds << ", " << send_ms << ", " << recv_ms
+              << std::endl;
+    if (csv) {
+      csv->insertDataRow({it.first, (int64_t)st.calls, wall_ms,
+                          (int64_t)st.io.bytes_sent, (int64_t)st.io.bytes_recv,
+                          (int64_t)st.io.rounds, send_ms, recv_ms});
+    }
+  }
+  if (csv) {
+    std::cout << "Wrote the IO per scope to " << csv_file << std::endl;
+  }
+}
+
 #ifdef LOG_LAYERWISE
 uint64_t ConvTimeInMilliSec = 0;
 uint64_t MatAddTimeInMilliSec = 0;
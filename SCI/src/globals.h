@@ -32,8 +32,12 @@ SOFTWARE.
 #include "defines_uniform.h"
 #include <chrono>
 #include <cstdint>
+#include <map>
+#include <string>
 #include <thread>
+#include <vector>
 #include "OT/kkot.h"
+#include "OT/ot_budget.h"
 #ifdef SCI_OT
 #include "BuildingBlocks/aux-protocols.h"
 #include "BuildingBlocks/truncation.h"
@@ -54,10 +58,19 @@ SOFTWARE.
 
 // #define MULTI_THREADING
 
-#define MAX_THREADS 4
-
 extern sci::NetIO *io;
 extern sci::OTPack<sci::NetIO> *otpack;
+// Carry the channels of all threads over mux_sockets connections (on port,
+// port + 1, ...) instead of one connection per thread on port + i. 0 opens
+// one connection per thread. Both parties should agree.
+extern int mux_sockets;
+extern sci::MuxConnection *mux;
+// Write the outgoing data of each thread's channel on a dedicated thread, so
+// that protocols keep computing while their messages are sent.
+extern bool async_send;
+// Talk to the other party through shared memory instead of TCP; both parties
+// have to run on the same host. Takes precedence over mux_sockets.
+extern bool use_shm;
 
 #ifdef SCI_OT
 extern LinearOT *mult;
@@ -80,6 +93,45 @@ extern ElemWiseProdField *he_prod;
 
 #if USE_CHEETAH
 extern gemini::CheetahLinear *cheetah_linear;
+// Server-side encoded conv filters. Outlives the sessions of one process.
+// Filled by Conv2DCacheFilters at model load, or by the first inference.
+extern std::shared_ptr<gemini::ConvFilterCache> conv_filter_cache;
+// Server-side encoded FC weights. Loaded from (or saved to, if new weights are
+// encoded) fc_weight_store_path when the path is not empty.
+extern std::shared_ptr<gemini::FCWeightStore> fc_weight_store;
+extern std::string fc_weight_store_path;
+// Ordinal of the next MatMul2D call, used to identify the FC layers.
+extern size_t fc_layer_counter;
+// Ordinal of the next Conv2DWrapper call, used to identify the conv layers.
+extern size_t conv_layer_counter;
+// Exchange the HomConv ciphertexts slice by slice. Both parties should agree.
+extern bool conv_streaming;
+// Ciphertext compression, see gemini::parse_ct_compression. Empty for SEAL's.
+extern std::string ct_compression;
+// CPUs to pin the HomConv/FC/BN worker threads to, e.g., "0-7" or "0,2,4,6".
+extern std::string cheetah_cpu_affinity;
+// Number of threads for the HE layers. 0 for num_threads.
+extern int cheetah_he_threads;
+// Reuse the SEAL keys across sessions, see gemini::KeyResume. Disabled if the
+// directory is empty. Both parties should agree.
+extern std::string cheetah_key_dir;
+extern std::string cheetah_client_id;
+extern bool cheetah_rotate_keys;
+// Snapshot of the silent OT correlations (and the SEAL keys, unless
+// cheetah_key_dir is given) to skip the base OTs on the next start. Disabled
+// if empty. Both parties should agree.
+extern std::string warm_start_dir;
+// Silent OT correlations pre-generated per thread and direction. 0 disables
+// the pool and -1 sizes it by the ot_budget of the previous run.
+extern int ot_pool_size;
+// Estimated OT consumption of the nonlinear layers of this run.
+extern sci::OTBudget ot_budget;
+// Round-reduced Millionaire in the ReLU layers, see
+// MillionaireProtocol::set_link_profile. Disabled if mill_fan_in is 0. A
+// negative mill_rtt_ms is measured at start. Both parties should agree.
+extern int mill_fan_in;
+extern double mill_rtt_ms;
+extern double mill_bandwidth_mbps;
 extern bool kIsSharedInput;
 #elif defined(SCI_HE)
 extern ConvField *he_conv;
@@ -90,30 +142,62 @@ extern sci::IKNP<sci::NetIO> *iknpOTRoleReversed;
 extern sci::KKOT<sci::NetIO> *kkot;
 extern sci::PRG128 *prg128Instance;
 
-extern sci::NetIO *ioArr[MAX_THREADS];
-extern sci::OTPack<sci::NetIO> *otpackArr[MAX_THREADS];
+// Per-thread channels and protocol instances, see ResizeThreadArrays.
+extern std::vector<sci::NetIO *> ioArr;
+extern std::vector<sci::OTPack<sci::NetIO> *> otpackArr;
 #ifdef SCI_OT
-extern LinearOT *multArr[MAX_THREADS];
-extern AuxProtocols *auxArr[MAX_THREADS];
-extern Truncation *truncationArr[MAX_THREADS];
-extern XTProtocol *xtArr[MAX_THREADS];
-extern MathFunctions *mathArr[MAX_THREADS];
+extern std::vector<LinearOT *> multArr;
+extern std::vector<AuxProtocols *> auxArr;
+extern std::vector<Truncation *> truncationArr;
+extern std::vector<XTProtocol *> xtArr;
+extern std::vector<MathFunctions *> mathArr;
 #endif
-extern ReLUProtocol<sci::NetIO, intType> *reluArr[MAX_THREADS];
-extern MaxPoolProtocol<sci::NetIO, intType> *maxpoolArr[MAX_THREADS];
+extern std::vector<ReLUProtocol<sci::NetIO, intType> *> reluArr;
+extern std::vector<MaxPoolProtocol<sci::NetIO, intType> *> maxpoolArr;
+extern std::vector<ArgMaxProtocol<sci::NetIO, intType> *> argmaxArr;
 // Additional classes for Athos
 #ifdef SCI_OT
-extern MatMulUniform<sci::NetIO, intType, sci::IKNP<sci::NetIO>>
-    *multUniformArr[MAX_THREADS];
+extern std::vector<MatMulUniform<sci::NetIO, intType, sci::IKNP<sci::NetIO>> *>
+    multUniformArr;
 #endif
-extern sci::IKNP<sci::NetIO> *otInstanceArr[MAX_THREADS];
-extern sci::KKOT<sci::NetIO> *kkotInstanceArr[MAX_THREADS];
-extern sci::PRG128 *prgInstanceArr[MAX_THREADS];
+extern std::vector<sci::IKNP<sci::NetIO> *> otInstanceArr;
+extern std::vector<sci::KKOT<sci::NetIO> *> kkotInstanceArr;
+extern std::vector<sci::PRG128 *> prgInstanceArr;
 
 extern std::chrono::time_point<std::chrono::high_resolution_clock> start_time;
-extern uint64_t comm_threads[MAX_THREADS];
+extern std::vector<uint64_t> comm_threads;
+// Sizes the per-thread arrays to num_threads entries.
+void ResizeThreadArrays();
 extern uint64_t num_rounds;
 
+// Charges the traffic of all ioArr channels during its lifetime to a label,
+// e.g. a layer or a protocol. Scopes nest: a nested scope is recorded under
+// the path of labels from the outermost one, like "Relu/Truncation", and its
+// traffic also counts towards the enclosing scopes. Scopes are opened by the
+// thread that drives the layers, around the worker threads.
+class IOScope {
+public:
+  explicit IOScope(const std::string &label);
+  ~IOScope();
+
+private:
+  std::vector<sci::IOStats> start;
+  std::chrono::steady_clock::time_point start_time;
+};
+
+// Totals per scope path. Bytes are summed over the threads; rounds and the
+// time in send and receive are the maximum over the threads, since those run
+// in parallel.
+struct IOScopeStats {
+  uint64_t calls = 0;
+  uint64_t wall_ns = 0;
+  sci::IOStats io;
+};
+extern std::map<std::string, IOScopeStats> io_scope_stats;
+// Prints io_scope_stats and writes them to csv_file unless it is empty.
+void ReportIOScopes(const std::string &csv_file);
+extern std::string IOScopeOutputFile;
+
 #ifdef LOG_LAYERWISE
 extern uint64_t ConvTimeInMilliSec;
 extern uint64_t MatAddTimeInMilliSec;
@@ -27,11 +27,25 @@ SOFTWARE.
 using namespace sci;
 
 void initialize() {
-  assert(num_threads <= MAX_THREADS);
+  ResizeThreadArrays();
+  if (mux_sockets > 0 && !use_shm) {
+    mux = new sci::MuxConnection(party == sci::ALICE ? nullptr : address.c_str(),
+                                 port, mux_sockets);
+  }
 
   for (int i = 0; i < num_threads; i++) {
-    ioArr[i] =
-        new sci::NetIO(party == sci::ALICE ? nullptr : address.c_str(), port + i);
+    if (use_shm) {
+      ioArr[i] = new sci::NetIO(new sci::ShmIO(
+          party == sci::ALICE ? nullptr : address.c_str(), port + i));
+    } else if (mux != nullptr) {
+      ioArr[i] = new sci::NetIO(mux, i);
+    } else {
+      ioArr[i] = new sci::NetIO(party == sci::ALICE ? nullptr : address.c_str(),
+                                port + i);
+    }
+    if (async_send) {
+      ioArr[i]->start_async_send();
+    }
     if (i & 1) {
       otpackArr[i] = new OTPack<sci::NetIO>(ioArr[i], 3 - party);
     } else {
@@ -70,10 +84,19 @@ void initialize() {
   for (int i = 0; i < num_threads; i++) {
     auto temp = ioArr[i]->counter;
     comm_threads[i] = temp;
+#ifdef LOG_LAYERWISE
+    ioArr[i]->track_time = true;
+#endif
   }
 }
 
 void finalize() {
+#ifdef LOG_LAYERWISE
+  ReportIOScopes(IOScopeOutputFile.empty()
+                     ? ""
+                     : IOScopeOutputFile +
+                           (party == sci::ALICE ? "_server.csv" : "_client.csv"));
+#endif
   for (int i = 0; i < num_threads; i++) {
     delete ioArr[i];
 #if !USE_CHEETAH
@@ -93,6 +116,8 @@ void finalize() {
 #if USE_CHEETAH
   delete cheetah_linear;
 #endif
+  delete mux;
+  mux = nullptr;
 }
 
 void reconstruct(int64_t *A, int64_t *B, int32_t I, int32_t J, int bwA) {
@@ -154,6 +179,7 @@ void AdjustScaleShr(uint64_t *A, uint64_t *B, int32_t I, int32_t J, int32_t bwA,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MatAdd");
 #endif
 
   int32_t dim = I * J;
@@ -180,6 +206,7 @@ void MatAdd(uint64_t *A, uint64_t *B, uint64_t *C, int32_t I, int32_t J,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MatAdd");
 #endif
   assert(bwTemp <= 64);
   assert(bwA <= bwTemp);
@@ -239,6 +266,7 @@ void MatAddBroadCast(uint64_t *A, uint64_t *B, uint64_t *C, int32_t I,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MatAddBroadCast");
 #endif
   int32_t dim = I * J;
 
@@ -293,6 +321,7 @@ void AddOrSubCir(uint64_t *A, uint64_t *B, uint64_t *C, int32_t I, int32_t J,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("AddOrSubCir");
 #endif
   int32_t dim = I * J;
 
@@ -335,6 +364,7 @@ void ScalarMul(uint64_t *A, uint64_t *B, uint64_t *C, int32_t I, int32_t J,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("ScalarMul");
 #endif
   int32_t shift = shrA + shrB + demote;
 
@@ -402,6 +432,7 @@ void MulCir(int64_t I, int64_t J, int64_t shrA, int64_t shrB, int64_t demote,
   std::cout << ctr++ << ". MulCir (" << I << " x " << J << ")" << std::endl;
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MulCir");
 #endif
 
   int32_t shiftA = log2(shrA);
@@ -514,6 +545,7 @@ void MatMul(int64_t I, int64_t K, int64_t J, int64_t shrA, int64_t shrB,
               << std::endl;
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MatMul");
 #endif
   if (party == CLIENT) {
     for (int i = 0; i < K * J; i++) {
@@ -654,6 +686,7 @@ void Sigmoid(int64_t I, int64_t J, int64_t scale_in, int64_t scale_out,
   std::cout << ctr++ << ". Sigmoid (" << I << " x " << J << ")" << std::endl;
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Sigmoid");
 #endif
   int32_t s_A = log2(scale_in);
   int32_t s_B = log2(scale_out);
@@ -727,6 +760,7 @@ void TanH(int64_t I, int64_t J, int64_t scale_in, int64_t scale_out,
   std::cout << ctr++ << ". TanH (" << I << " x " << J << ")" << std::endl;
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Tanh");
 #endif
 
   int32_t s_A = log2(scale_in);
@@ -798,6 +832,7 @@ void Sqrt(int64_t I, int64_t J, int64_t scale_in, int64_t scale_out,
   std::cout << ctr++ << ". Sqrt (" << I << " x " << J << ")" << std::endl;
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Sqrt");
 #endif
 
   int32_t s_A = log2(scale_in);
@@ -871,6 +906,7 @@ void ArgMax(uint64_t *A, int32_t I, int32_t J, int32_t bwA, int32_t bw_index,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("ArgMax");
 #endif
   argmax = new ArgMaxProtocol<sci::NetIO, uint64_t>(party, RING, io, bwA, MILL_PARAM,
                                                0, otpack);
@@ -898,6 +934,7 @@ void MaxPool2D(uint64_t *A, int32_t I, int32_t J, int32_t bwA, int32_t bwB,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MaxPool");
 #endif
 
   maxpool = new MaxPoolProtocol<sci::NetIO, uint64_t>(party, RING, io, bwA,
@@ -998,6 +1035,7 @@ void Convolution(int32_t N, int32_t H, int32_t W, int32_t CIN, int32_t HF,
             << std::endl;
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Conv");
 #endif
 
   if (party == CLIENT) {
@@ -1128,6 +1166,7 @@ void ReLU(uint64_t *A, uint64_t *B, int32_t I, int32_t J, int32_t bwA,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Relu");
 #endif
 
   assert(bwA >= bwB);
@@ -1168,6 +1207,7 @@ void BNorm(uint64_t *A, uint64_t *BNW, uint64_t *BNB, uint64_t *B, int32_t I,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("BatchNorm");
 #endif
   uint64_t maskTemp = (bwTemp == 64 ? -1 : ((1ULL << bwTemp) - 1));
 
@@ -1245,6 +1285,7 @@ void NormaliseL2(uint64_t *A, uint64_t *B, int32_t I, int32_t J, int32_t bwA,
 #ifdef LOG_LAYERWISE
   INIT_TIMER;
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("NormaliseL2");
 #endif
   int32_t scale_in = -1 * scaleA;
   int32_t scale_out = -1 * (scaleA + 1);
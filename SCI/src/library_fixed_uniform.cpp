@@ -26,6 +26,10 @@ SOFTWARE.
 #include "functionalities_uniform.h"
 #include "library_fixed_common.h"
 
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 #include "energy_consumption.hpp"
 #include "csv_writer.hpp" // Added by Tanjina for writing the measurement values into a csv file
 
@@ -47,6 +51,7 @@ void MatMul2D(int32_t s1, int32_t s2, int32_t s3, const intType *A,
               const intType *B, intType *C, bool modelIsA) {
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MatMul");
   INIT_TIMER;
 #endif
 
@@ -317,6 +322,7 @@ void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
 // static bool monitor_power = false; // Added by Tanjina                  
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Conv");
   INIT_TIMER;
 
   // Add by Eloise
@@ -620,6 +626,7 @@ void Conv2DGroupWrapper(signedIntType N, signedIntType H, signedIntType W,
                         intType *outArr) {
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Conv");
   INIT_TIMER;
 #endif
 
@@ -660,6 +667,7 @@ void ElemWiseActModelVectorMult(int32_t size, intType *inArr,
                                 intType *multArrVec, intType *outputArr) {
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("BatchNorm");
   INIT_TIMER;
 #endif
 
@@ -807,6 +815,7 @@ void ArgMax(int32_t s1, int32_t s2, intType *inArr, intType *outArr) {
 // static bool monitor_power = false; // Added by Tanjina  
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("ArgMax");
   INIT_TIMER;
   // Add by Eloise >> Tanjina-Note: I moved them here. I could still found them in the log before when it was residing outside of this #ifdef LOG_LAYERWISE block, but to be consistent I placed them here!
   std::cout << "*******************" << std::endl;
@@ -871,8 +880,52 @@ void ArgMax(int32_t s1, int32_t s2, intType *inArr, intType *outArr) {
             << std::endl;
   ctr++;
 
-  assert(s1 == 1 && "ArgMax impl right now assumes s1==1");
-  argmax->ArgMaxMPC(s2, inArr, outArr);
+#ifndef MULTITHREADED_NONLIN
+  argmax->ArgMaxRowsMPC(s1, s2, inArr, outArr);
+#else
+  // Each thread reduces a range of the classes of all the rows, then the
+  // winners of the threads are reduced on the main instance.
+  int numChunks = partitionWork(s2).size();
+  intType *chunkInp = new intType[s1 * s2];
+  intType *chunkIdx = new intType[s1 * numChunks];
+  intType *chunkMax = new intType[s1 * numChunks];
+  {
+#ifdef LOG_LAYERWISE
+    IOScope io_scope("ChunkMax");
+#endif
+    runPartitioned(s2, 1, [&](int tid, int offset, int lnum_cols) {
+      intType *linp = chunkInp + s1 * offset;
+      for (int r = 0; r < s1; r++) {
+        for (int c = 0; c < lnum_cols; c++) {
+          linp[r * lnum_cols + c] = Arr2DIdxRowM(inArr, s1, s2, r, offset + c);
+        }
+      }
+      funcArgMaxThread(tid, s1, lnum_cols, offset, linp, chunkIdx + tid * s1,
+                       chunkMax + tid * s1);
+    });
+  }
+  intType *candIdx = new intType[s1 * numChunks];
+  intType *candMax = new intType[s1 * numChunks];
+  intType *maxi = new intType[s1];
+  for (int r = 0; r < s1; r++) {
+    for (int i = 0; i < numChunks; i++) {
+      candIdx[r * numChunks + i] = chunkIdx[i * s1 + r];
+      candMax[r * numChunks + i] = chunkMax[i * s1 + r];
+    }
+  }
+  {
+#ifdef LOG_LAYERWISE
+    IOScope io_scope("SelectMax");
+#endif
+    argmax->SelectMaxMPC(s1, numChunks, candMax, candIdx, maxi, outArr);
+  }
+  delete[] chunkInp;
+  delete[] chunkIdx;
+  delete[] chunkMax;
+  delete[] candIdx;
+  delete[] candMax;
+  delete[] maxi;
+#endif
 
 
 #ifdef LOG_LAYERWISE
@@ -961,6 +1014,7 @@ void Relu(int32_t size, intType *inArr, intType *outArr, int sf, bool doTruncati
 // static bool monitor_power = false; // Added by Tanjina
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Relu");
   INIT_TIMER;
 
   // Add by Eloise
@@ -1019,6 +1073,18 @@ void Relu(int32_t size, intType *inArr, intType *outArr, int sf, bool doTruncati
   static int ctr = 1;
   printf("Relu #%d on %d points, truncate=%d by %d bits\n", ctr++, size, doTruncation, sf);
   ctr++;
+#ifdef SCI_OT
+  // The truncation reuses the DReLU, see ReLURingProtocol::relu_truncate
+  bool fusedTrunc = doTruncation && sf > 0;
+#else
+  bool fusedTrunc = false;
+#endif
+#if USE_CHEETAH
+  ot_budget.relu += sci::EstimateReLUCOTs(size, bitlength, MILL_PARAM);
+  if (fusedTrunc) {
+    ot_budget.truncation += size;
+  }
+#endif
 
   intType moduloMask = sci::all1Mask(bitlength);
   int eightDivElemts = ((size + 8 - 1) / 8) * 8;  //(ceil of s1*s2/8.0)*8
@@ -1027,25 +1093,29 @@ void Relu(int32_t size, intType *inArr, intType *outArr, int sf, bool doTruncati
   intType *tempOutp = new intType[eightDivElemts];
   sci::copyElemWisePadded(size, inArr, eightDivElemts, tempInp, 0);
 
+  {
+#ifdef LOG_LAYERWISE
+    IOScope io_scope(fusedTrunc ? "ReluTruncate" : "DReLU+Select");
+#endif
 #ifndef MULTITHREADED_NONLIN
-  relu->relu(tempOutp, tempInp, eightDivElemts, nullptr);
-#else
-  std::thread relu_threads[num_threads];
-  int chunk_size = (eightDivElemts / (8 * num_threads)) * 8;
-  for (int i = 0; i < num_threads; ++i) {
-    int offset = i * chunk_size;
-    int lnum_relu;
-    if (i == (num_threads - 1)) {
-      lnum_relu = eightDivElemts - offset;
+    if (fusedTrunc) {
+      static_cast<ReLURingProtocol<sci::NetIO, intType> *>(relu)->relu_truncate(
+          tempOutp, tempInp, eightDivElemts, sf);
     } else {
-      lnum_relu = chunk_size;
+      relu->relu(tempOutp, tempInp, eightDivElemts, nullptr);
     }
-    relu_threads[i] = std::thread(funcReLUThread, i, tempOutp + offset, tempInp + offset, lnum_relu, nullptr, false);
-  }
-  for (int i = 0; i < num_threads; ++i) {
-    relu_threads[i].join();
-  }
+#else
+    runPartitioned(eightDivElemts, 8, [&](int tid, int offset, int lnum_relu) {
+      if (fusedTrunc) {
+        funcReLUTruncateFusedThread(tid, tempOutp + offset, tempInp + offset,
+                                    lnum_relu, sf);
+      } else {
+        funcReLUThread(tid, tempOutp + offset, tempInp + offset, lnum_relu,
+                       nullptr, false);
+      }
+    });
 #endif
+  }
 
 #ifdef LOG_LAYERWISE
   auto temp = TIMER_TILL_NOW;
@@ -1062,9 +1132,10 @@ void Relu(int32_t size, intType *inArr, intType *outArr, int sf, bool doTruncati
 
 #endif
 
-  if (doTruncation) {
+  if (doTruncation && !fusedTrunc) {
 #ifdef LOG_LAYERWISE
     INIT_ALL_IO_DATA_SENT;
+    IOScope io_scope("Truncation");
     INIT_TIMER;
 #endif
     for (int i = 0; i < eightDivElemts; i++) {
@@ -1141,15 +1212,18 @@ void Relu(int32_t size, intType *inArr, intType *outArr, int sf, bool doTruncati
     Relu_pt(size, VinVec, VoutVec, 0, false);  // sf = 0
 
     bool pass = true;
-    for (int i = 0; i < size; i++) {
-      if (VtempOutpArr[i] != getSignedVal(VoutVec[i])) {
-        pass = false;
+    // The fused protocol has no ReLU output before the truncation
+    if (!fusedTrunc) {
+      for (int i = 0; i < size; i++) {
+        if (VtempOutpArr[i] != getSignedVal(VoutVec[i])) {
+          pass = false;
+        }
       }
+      if (pass == true)
+        std::cout << GREEN << "ReLU Output Matches" << RESET << std::endl;
+      else
+        std::cout << RED << "ReLU Output Mismatch" << RESET << std::endl;
     }
-    if (pass == true)
-      std::cout << GREEN << "ReLU Output Matches" << RESET << std::endl;
-    else
-      std::cout << RED << "ReLU Output Mismatch" << RESET << std::endl;
 
     ScaleDown_pt(size, VoutVec, sf);
 
@@ -1231,6 +1305,7 @@ void MaxPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
 // static bool monitor_power = false; // Added by Tanjina
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MaxPool");
   INIT_TIMER;
 
   // Add by Eloise
@@ -1296,78 +1371,49 @@ void MaxPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
 
   uint64_t moduloMask = sci::all1Mask(bitlength);
   int rowsOrig = N * H * W * C;
-  int rows = ((rowsOrig + 8 - 1) / 8) * 8;  //(ceil of rows/8.0)*8
-  int cols = ksizeH * ksizeW;
-
-  intType *reInpArr = new intType[rows * cols];
-  intType *maxi = new intType[rows];
-  intType *maxiIdx = new intType[rows];
+#if USE_CHEETAH
+  ot_budget.maxpool += sci::EstimateMaxPoolCOTs(rowsOrig, ksizeH * ksizeW,
+                                                bitlength, MILL_PARAM);
+#endif
+  assert(H == (imgH + zPadHLeft + zPadHRight - ksizeH) / strideH + 1);
+  assert(W == (imgW + zPadWLeft + zPadWRight - ksizeW) / strideW + 1);
 
-  int rowIdx = 0;
+  // One imgH x imgW plane per (n, c). The overlapping windows of a plane
+  // share their comparisons, see MaxPoolProtocol::funcMaxPool2D.
+  int numPlanes = N * C;
+  intType *planes = new intType[numPlanes * imgH * imgW];
+  intType *maxi = new intType[rowsOrig];
   for (int n = 0; n < N; n++) {
     for (int c = 0; c < C; c++) {
-      int32_t leftTopCornerH = -zPadHLeft;
-      int32_t extremeRightBottomCornerH = imgH - 1 + zPadHRight;
-      while ((leftTopCornerH + ksizeH - 1) <= extremeRightBottomCornerH) {
-        int32_t leftTopCornerW = -zPadWLeft;
-        int32_t extremeRightBottomCornerW = imgW - 1 + zPadWRight;
-        while ((leftTopCornerW + ksizeW - 1) <= extremeRightBottomCornerW) {
-          for (int fh = 0; fh < ksizeH; fh++) {
-            for (int fw = 0; fw < ksizeW; fw++) {
-              int32_t colIdx = fh * ksizeW + fw;
-              int32_t finalIdx = rowIdx * (ksizeH * ksizeW) + colIdx;
-
-              int32_t curPosH = leftTopCornerH + fh;
-              int32_t curPosW = leftTopCornerW + fw;
-
-              intType temp = 0;
-              if ((((curPosH < 0) || (curPosH >= imgH)) ||
-                   ((curPosW < 0) || (curPosW >= imgW)))) {
-                temp = 0;
-              } else {
-                temp = Arr4DIdxRowM(inArr, N, imgH, imgW, C, n, curPosH,
-                                    curPosW, c);
-              }
-              reInpArr[finalIdx] = temp;
-            }
-          }
-
-          rowIdx += 1;
-          leftTopCornerW = leftTopCornerW + strideW;
+      intType *plane = planes + (n * C + c) * imgH * imgW;
+      for (int h = 0; h < imgH; h++) {
+        for (int w = 0; w < imgW; w++) {
+          plane[h * imgW + w] =
+              Arr4DIdxRowM(inArr, N, imgH, imgW, C, n, h, w, c);
         }
-
-        leftTopCornerH = leftTopCornerH + strideH;
       }
     }
   }
 
-  for (int i = rowsOrig; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      reInpArr[i * cols + j] = 0;  // The extra padded values
-    }
-  }
-
+  // The row and column passes run inside each thread's funcMaxPool2D, so the
+  // comparisons share one scope; the rest of the layer only moves shares.
+  {
+#ifdef LOG_LAYERWISE
+    IOScope io_scope("SlidingMax");
+#endif
 #ifndef MULTITHREADED_NONLIN
-  maxpool->funcMaxMPC(rows, cols, reInpArr, maxi, maxiIdx);
+    maxpool->funcMaxPool2D(numPlanes, imgH, imgW, ksizeH, ksizeW, zPadHLeft,
+                           zPadHRight, zPadWLeft, zPadWRight, strideH, strideW,
+                           planes, maxi);
 #else
-  std::thread maxpool_threads[num_threads];
-  int chunk_size = (rows / (8 * num_threads)) * 8;
-  for (int i = 0; i < num_threads; ++i) {
-    int offset = i * chunk_size;
-    int lnum_rows;
-    if (i == (num_threads - 1)) {
-      lnum_rows = rows - offset;
-    } else {
-      lnum_rows = chunk_size;
-    }
-    maxpool_threads[i] =
-        std::thread(funcMaxpoolThread, i, lnum_rows, cols,
-                    reInpArr + offset * cols, maxi + offset, maxiIdx + offset);
-  }
-  for (int i = 0; i < num_threads; ++i) {
-    maxpool_threads[i].join();
-  }
+    runPartitioned(numPlanes, 1, [&](int tid, int offset, int lnum_planes) {
+      funcMaxPool2DThread(tid, lnum_planes, imgH, imgW, ksizeH, ksizeW,
+                          zPadHLeft, zPadHRight, zPadWLeft, zPadWRight, strideH,
+                          strideW, planes + offset * imgH * imgW,
+                          maxi + offset * H * W);
+    });
 #endif
+  }
 
   for (int n = 0; n < N; n++) {
     for (int c = 0; c < C; c++) {
@@ -1380,9 +1426,8 @@ void MaxPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
     }
   }
 
-  delete[] reInpArr;
+  delete[] planes;
   delete[] maxi;
-  delete[] maxiIdx;
 
 #ifdef LOG_LAYERWISE
   auto temp = TIMER_TILL_NOW;
@@ -1521,6 +1566,26 @@ void MaxPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
 
 }
 
+// Relu(MaxPool(x)) == MaxPool(Relu(x)) since ReLU is monotone, so either
+// order of the two layers can be served by pooling first and running the
+// ReLU (and its optional truncation) on the N*H*W*C pooled outputs only.
+void MaxPoolRelu(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
+                 int32_t ksizeW, int32_t zPadHLeft, int32_t zPadHRight,
+                 int32_t zPadWLeft, int32_t zPadWRight, int32_t strideH,
+                 int32_t strideW, int32_t N1, int32_t imgH, int32_t imgW,
+                 int32_t C1, intType *inArr, intType *outArr, int sf,
+                 bool doTruncation) {
+#ifdef LOG_LAYERWISE
+  IOScope io_scope("MaxPoolRelu");
+#endif
+  int size = N * H * W * C;
+  intType *pooled = new intType[size];
+  MaxPool(N, H, W, C, ksizeH, ksizeW, zPadHLeft, zPadHRight, zPadWLeft,
+          zPadWRight, strideH, strideW, N1, imgH, imgW, C1, inArr, pooled);
+  Relu(size, pooled, outArr, sf, doTruncation);
+  delete[] pooled;
+}
+
 void AvgPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
              int32_t ksizeW, int32_t zPadHLeft, int32_t zPadHRight,
              int32_t zPadWLeft, int32_t zPadWRight, int32_t strideH,
@@ -1533,6 +1598,7 @@ void AvgPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
 // static bool monitor_power = false; // Added by Tanjina
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("AvgPool");
   INIT_TIMER;
 
   // Add by Eloise
@@ -1791,10 +1857,15 @@ void AvgPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
 void ScaleDown(int32_t size, intType *inArr, int32_t sf) {
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Truncation");
   INIT_TIMER;
 #endif
   static int ctr = 1;
   printf("Truncate #%d on %d points by %d bits\n", ctr++, size, sf);
+#if USE_CHEETAH
+  ot_budget.truncation +=
+      sci::EstimateTruncationCOTs(size, bitlength, MILL_PARAM);
+#endif
 
   int eightDivElemts = ((size + 8 - 1) / 8) * 8; //(ceil of s1*s2/8.0)*8
   intType *tempInp;
@@ -1890,11 +1961,216 @@ void ScaleUp(int32_t size, intType *arr, int32_t sf) {
   }
 }
 
+#if USE_CHEETAH
+// "0-3,8,10" -> {0, 1, 2, 3, 8, 10}
+static std::vector<int> ParseCPUList(const std::string &spec) {
+  std::vector<int> cpus;
+  std::stringstream ss(spec);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) continue;
+    size_t dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last =
+        dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+    for (int c = first; c <= last; ++c) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+// The OT budget of the last run, used to size the pools when ot_pool_size < 0.
+static std::string OTBudgetPath() {
+  return "./data/ot_budget_p" + std::to_string(party);
+}
+
+// Bounded to 64 MiB of correlations per thread and direction.
+static constexpr size_t kMaxOTPoolSize = 1ULL << 22;
+
+// Offline phase: fill the OT pools of all the threads in parallel.
+static void ReserveOTPools() {
+  size_t capacity = ot_pool_size > 0 ? ot_pool_size : 0;
+  if (ot_pool_size < 0) {
+    uint64_t total{0};
+    std::ifstream fin(OTBudgetPath(), std::ios::binary);
+    if (fin.read(reinterpret_cast<char *>(&total), sizeof(uint64_t))) {
+      capacity = (total + num_threads - 1) / num_threads;
+    }
+  }
+  // Both parties should agree on the capacity.
+  uint64_t peer_capacity{0};
+  uint64_t my_capacity = std::min(capacity, kMaxOTPoolSize);
+  ioArr[0]->send_data(&my_capacity, sizeof(uint64_t));
+  ioArr[0]->recv_data(&peer_capacity, sizeof(uint64_t));
+  capacity = std::min<uint64_t>(my_capacity, peer_capacity);
+  if (capacity == 0) {
+    return;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<std::thread> fill_threads;
+  for (int i = 0; i < num_threads; i++) {
+    fill_threads.emplace_back(
+        [capacity](int tid) { otpackArr[tid]->reserve_ot_pool(capacity); }, i);
+  }
+  for (auto &t : fill_threads) {
+    t.join();
+  }
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - start)
+                .count();
+  std::cout << "Offline OT pools: " << capacity
+            << " correlations per thread and direction in " << ms << " ms"
+            << std::endl;
+}
+
+static void PrintOTPools() {
+  uint64_t used{0};
+  for (int i = 0; i < num_threads; i++) {
+    const auto *pack = otpackArr[i];
+    uint64_t pooled = pack->num_pooled_cots();
+    uint64_t online = pack->num_online_cots();
+    used += pooled + online;
+    if (pack->ot_pool_capacity() == 0) continue;
+    std::cout << "OT pool of thread " << i << ": " << pack->ot_pool_size()
+              << "/" << pack->ot_pool_capacity() << " full, " << pooled
+              << " COTs from the pool, " << online << " COTs online"
+              << std::endl;
+  }
+  std::cout << "Estimated COTs: ReLU " << ot_budget.relu << ", MaxPool "
+            << ot_budget.maxpool << ", truncation " << ot_budget.truncation
+            << ", total " << ot_budget.total() << " (used " << used << ")"
+            << std::endl;
+
+  uint64_t total = ot_budget.total();
+  std::ofstream fout(OTBudgetPath(), std::ios::binary | std::ios::trunc);
+  fout.write(reinterpret_cast<const char *>(&total), sizeof(uint64_t));
+}
+
+// Round-reduced Millionaire in the ReLU layers, which MaxPool and ArgMax share.
+static void SetMillionaireLinkProfile() {
+  if (mill_fan_in <= 0) {
+    return;
+  }
+  std::vector<ReLUProtocol<sci::NetIO, intType> *> relus = {relu};
+#ifdef MULTITHREADED_NONLIN
+  relus.insert(relus.end(), reluArr.begin(), reluArr.begin() + num_threads);
+#endif
+  int fan_in = std::min(std::max(mill_fan_in, 2), 4);
+  double rtt_ms = mill_rtt_ms;
+  for (auto *r : relus) {
+    auto *relu_ring = dynamic_cast<ReLURingProtocol<sci::NetIO, intType> *>(r);
+    if (relu_ring == nullptr) continue;
+    if (rtt_ms < 0) {
+      rtt_ms = relu_ring->millionaire->measure_rtt();
+    }
+    relu_ring->millionaire->set_link_profile(rtt_ms, mill_bandwidth_mbps,
+                                             fan_in);
+  }
+  std::cout << "Round-reduced Millionaire: RTT " << rtt_ms << " ms, "
+            << mill_bandwidth_mbps << " Mbps, fan-in up to " << fan_in
+            << std::endl;
+}
+
+// Warm-start snapshot in warm_start_dir. The manifest carries a tag shared by
+// both parties and the setup time of the last cold start. The manifest is
+// removed once loaded so that the OT correlations of one snapshot are never
+// used twice, e.g., after a crash.
+struct WarmStartManifest {
+  uint64_t magic;
+  uint64_t tag;
+  uint64_t party;
+  uint64_t num_threads;
+  uint64_t bitlength;
+  uint64_t cold_setup_ms;
+};
+
+static constexpr uint64_t kWarmStartMagic = 0x5452'4154'5357'524fULL;
+static uint64_t cold_setup_ms = 0;
+
+static std::string WarmStartManifestPath() {
+  return warm_start_dir + "/manifest_p" + std::to_string(party);
+}
+
+static std::string WarmStartPreOTPrefix(int tid) {
+  return warm_start_dir + "/pre_ot_p" + std::to_string(party) + "_t" +
+         std::to_string(tid);
+}
+
+// Return true if both parties hold the snapshot of the same session.
+// Otherwise, the stale pre-OT files are removed so that the silent OTs
+// bootstrap from the base OTs.
+static bool LoadWarmStart(sci::NetIO *io) {
+  WarmStartManifest mf{};
+  std::ifstream fin(WarmStartManifestPath(), std::ios::binary);
+  bool ok = fin.is_open() &&
+            fin.read(reinterpret_cast<char *>(&mf), sizeof(mf)).good() &&
+            mf.magic == kWarmStartMagic && mf.party == (uint64_t)party &&
+            mf.num_threads == (uint64_t)num_threads &&
+            mf.bitlength == (uint64_t)bitlength;
+  fin.close();
+  std::remove(WarmStartManifestPath().c_str());
+
+  uint64_t tag = ok ? mf.tag : 0;
+  uint64_t peer_tag{0};
+  io->send_data(&tag, sizeof(uint64_t));
+  io->recv_data(&peer_tag, sizeof(uint64_t));
+  ok &= (tag != 0 && tag == peer_tag);
+
+  if (!ok) {
+    // The snapshot may come from a run with more threads.
+    uint64_t max_threads = std::max<uint64_t>(num_threads, mf.num_threads);
+    for (uint64_t i = 0; i < max_threads; i++) {
+      std::remove((WarmStartPreOTPrefix(i) + "_straight").c_str());
+      std::remove((WarmStartPreOTPrefix(i) + "_reversed").c_str());
+    }
+  }
+  cold_setup_ms = ok ? mf.cold_setup_ms : 0;
+  return ok;
+}
+
+// The silent OTs write back their unused correlations when destroyed. Thus
+// the OT packs are released here and must not be used afterwards.
+static void SaveWarmStart(sci::NetIO *io) {
+  uint64_t tag{0};
+  if (party == sci::ALICE) {
+    sci::PRG128 prg;
+    while (tag == 0) prg.random_data(&tag, sizeof(uint64_t));
+    io->send_data(&tag, sizeof(uint64_t));
+    io->flush();
+  } else {
+    io->recv_data(&tag, sizeof(uint64_t));
+  }
+
+  for (int i = 0; i < num_threads; i++) {
+    delete otpackArr[i];
+    otpackArr[i] = nullptr;
+  }
+  otpack = nullptr;
+
+  WarmStartManifest mf{kWarmStartMagic,      tag,
+                       (uint64_t)party,      (uint64_t)num_threads,
+                       (uint64_t)bitlength,  cold_setup_ms};
+  std::ofstream fout(WarmStartManifestPath(),
+                     std::ios::binary | std::ios::trunc);
+  fout.write(reinterpret_cast<const char *>(&mf), sizeof(mf));
+  if (fout.good()) {
+    std::cout << "Saved the warm-start snapshot to " << warm_start_dir
+              << std::endl;
+  } else {
+    std::cerr << "Failed to save the warm-start snapshot to "
+              << warm_start_dir << std::endl;
+  }
+}
+#endif
+
 void StartComputation() {
   assert(bitlength < 64 && bitlength > 0);
-  assert(num_threads <= MAX_THREADS);
+  ResizeThreadArrays();
 
   std::string backend;
+  auto setup_start = std::chrono::high_resolution_clock::now();
 
 #ifdef SCI_HE
   backend = "PrimeField";
@@ -1919,9 +2195,32 @@ void StartComputation() {
 #endif
 
   checkIfUsingEigen();
+  if (mux_sockets > 0 && !use_shm) {
+    mux = new sci::MuxConnection(party == sci::ALICE ? nullptr : address.c_str(),
+                                 port, mux_sockets);
+  }
+  for (int i = 0; i < num_threads; i++) {
+    if (use_shm) {
+      ioArr[i] = new sci::NetIO(new sci::ShmIO(
+          party == sci::ALICE ? nullptr : address.c_str(), port + i, true));
+    } else if (mux != nullptr) {
+      ioArr[i] = new sci::NetIO(mux, i);
+    } else {
+      ioArr[i] = new sci::NetIO(party == sci::ALICE ? nullptr : address.c_str(), port + i, /*quit*/true);
+    }
+    if (async_send) {
+      ioArr[i]->start_async_send();
+    }
+  }
+
+#if USE_CHEETAH
+  const bool is_warm_start = !warm_start_dir.empty() && LoadWarmStart(ioArr[0]);
+  printf(is_warm_start ? "Loading the warm-start snapshot ...\n"
+                       : "Doing BaseOT ...\n");
+#else
   printf("Doing BaseOT ...\n");
+#endif
   for (int i = 0; i < num_threads; i++) {
-    ioArr[i] = new sci::NetIO(party == sci::ALICE ? nullptr : address.c_str(), port + i, /*quit*/true);
     otInstanceArr[i] = new sci::IKNP<sci::NetIO>(ioArr[i]);
     prgInstanceArr[i] = new sci::PRG128();
     kkotInstanceArr[i] = new sci::KKOT<sci::NetIO>(ioArr[i]);
@@ -1930,13 +2229,25 @@ void StartComputation() {
         new MatMulUniform<sci::NetIO, intType, sci::IKNP<sci::NetIO>>(
             party, bitlength, ioArr[i], otInstanceArr[i], nullptr);
 #endif
+#if USE_CHEETAH
+    std::string pre_ot_prefix =
+        warm_start_dir.empty() ? "" : WarmStartPreOTPrefix(i);
+    otpackArr[i] = new sci::OTPack<sci::NetIO>(
+        ioArr[i], (i & 1) ? 3 - party : party, true, pre_ot_prefix);
+#else
     if (i & 1) {
       otpackArr[i] = new sci::OTPack<sci::NetIO>(ioArr[i], 3 - party);
     } else {
       otpackArr[i] = new sci::OTPack<sci::NetIO>(ioArr[i], party);
     }
+#endif
   }
 
+#if USE_CHEETAH
+  ot_budget = sci::OTBudget();
+  ReserveOTPools();
+#endif
+
   io = ioArr[0];
   otpack = otpackArr[0];
   iknpOT = new sci::IKNP<sci::NetIO>(io);
@@ -1960,7 +2271,58 @@ void StartComputation() {
 
 #if USE_CHEETAH
   backend += "-Cheetah";
-  cheetah_linear = new gemini::CheetahLinear(party, io, prime_mod, num_threads);
+  // The warm-start snapshot also keeps the SEAL keys.
+  const std::string &key_dir =
+      cheetah_key_dir.empty() ? warm_start_dir : cheetah_key_dir;
+  if (key_dir.empty()) {
+    cheetah_linear =
+        new gemini::CheetahLinear(party, io, prime_mod, num_threads);
+  } else {
+    gemini::KeyResume resume;
+    resume.dir = key_dir;
+    resume.client_id = cheetah_client_id.empty() && cheetah_key_dir.empty()
+                           ? "warm_start"
+                           : cheetah_client_id;
+    resume.rotate = cheetah_rotate_keys;
+    cheetah_linear =
+        new gemini::CheetahLinear(party, io, prime_mod, num_threads, &resume);
+    std::cout << (cheetah_linear->keys_resumed() ? "Resumed" : "Stored")
+              << " the keys in " << key_dir << std::endl;
+  }
+  cheetah_linear->set_conv_streaming(conv_streaming);
+  {
+    gemini::CtCompression compr;
+    if (!gemini::parse_ct_compression(ct_compression, compr)) {
+      std::cerr << "Invalid ciphertext compression \"" << ct_compression
+                << "\", using SEAL's default" << std::endl;
+    }
+    cheetah_linear->set_compression(compr);
+  }
+  {
+    std::vector<int> cpus;
+    if (!cheetah_cpu_affinity.empty()) {
+      cpus = ParseCPUList(cheetah_cpu_affinity);
+    }
+    size_t he_threads = cheetah_he_threads > 0 ? cheetah_he_threads
+                                               : num_threads;
+    cheetah_linear->set_thread_pool(he_threads, cpus);
+  }
+  if (party == SERVER && !conv_filter_cache) {
+    conv_filter_cache = std::make_shared<gemini::ConvFilterCache>();
+  }
+  if (party == SERVER && !fc_weight_store) {
+    fc_weight_store =
+        std::make_shared<gemini::FCWeightStore>(cheetah_linear->fc_parms_id());
+    if (!fc_weight_store_path.empty()) {
+      if (fc_weight_store->load(fc_weight_store_path)) {
+        std::cout << "Loaded " << fc_weight_store->size()
+                  << " encoded FC weights from " << fc_weight_store_path
+                  << std::endl;
+      }
+    }
+  }
+  fc_layer_counter = 0;
+  conv_layer_counter = 0;
 #elif defined(SCI_HE)
   backend += "-SCI_HE";
   he_conv = new ConvField(party, io);
@@ -1989,6 +2351,9 @@ void StartComputation() {
       maxpoolArr[i] = new MaxPoolProtocol<sci::NetIO, intType>(
           3 - party, RING, ioArr[i], bitlength, MILL_PARAM, 0, otpackArr[i],
           reluArr[i]);
+      argmaxArr[i] = new ArgMaxProtocol<sci::NetIO, intType>(
+          3 - party, RING, ioArr[i], bitlength, MILL_PARAM, 0, otpackArr[i],
+          reluArr[i]);
       multArr[i] = new LinearOT(3 - party, ioArr[i], otpackArr[i]);
       truncationArr[i] = new Truncation(3 - party, ioArr[i], otpackArr[i]);
     } else {
@@ -1997,12 +2362,19 @@ void StartComputation() {
       maxpoolArr[i] = new MaxPoolProtocol<sci::NetIO, intType>(
           party, RING, ioArr[i], bitlength, MILL_PARAM, 0, otpackArr[i],
           reluArr[i]);
+      argmaxArr[i] = new ArgMaxProtocol<sci::NetIO, intType>(
+          party, RING, ioArr[i], bitlength, MILL_PARAM, 0, otpackArr[i],
+          reluArr[i]);
       multArr[i] = new LinearOT(party, ioArr[i], otpackArr[i]);
       truncationArr[i] = new Truncation(party, ioArr[i], otpackArr[i]);
     }
   }
 #endif
 
+#if USE_CHEETAH
+  SetMillionaireLinkProfile();
+#endif
+
 #ifdef SCI_HE
   for (int i = 0; i < num_threads; i++) {
     if (i & 1) {
@@ -2010,11 +2382,15 @@ void StartComputation() {
           3 - party, FIELD, ioArr[i], bitlength, MILL_PARAM, prime_mod, otpackArr[i]);
       maxpoolArr[i] = new MaxPoolProtocol<sci::NetIO, intType>(
           3 - party, FIELD, ioArr[i], bitlength, MILL_PARAM, prime_mod, otpackArr[i], reluArr[i]);
+      argmaxArr[i] = new ArgMaxProtocol<sci::NetIO, intType>(
+          3 - party, FIELD, ioArr[i], bitlength, MILL_PARAM, prime_mod, otpackArr[i], reluArr[i]);
     } else {
       reluArr[i] = new ReLUFieldProtocol<sci::NetIO, intType>(
           party, FIELD, ioArr[i], bitlength, MILL_PARAM, prime_mod, otpackArr[i]);
       maxpoolArr[i] = new MaxPoolProtocol<sci::NetIO, intType>(
           party, FIELD, ioArr[i], bitlength, MILL_PARAM, prime_mod, otpackArr[i], reluArr[i]);
+      argmaxArr[i] = new ArgMaxProtocol<sci::NetIO, intType>(
+          party, FIELD, ioArr[i], bitlength, MILL_PARAM, prime_mod, otpackArr[i], reluArr[i]);
     }
   }
 #endif
@@ -2051,6 +2427,20 @@ void StartComputation() {
     iknpOTRoleReversed->setup_send();
   }
 
+  auto setup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - setup_start)
+                      .count();
+  std::cout << "One-time setup took " << setup_ms << " ms" << std::endl;
+#if USE_CHEETAH
+  if (is_warm_start) {
+    std::cout << "Warm start saved " << ((int64_t)cold_setup_ms - setup_ms)
+              << " ms over the cold start of " << cold_setup_ms << " ms"
+              << std::endl;
+  } else {
+    cold_setup_ms = setup_ms;
+  }
+#endif
+
   std::cout << "After one-time setup, communication" << std::endl;
   start_time = std::chrono::high_resolution_clock::now();
   for (int i = 0; i < num_threads; i++) {
@@ -2058,6 +2448,9 @@ void StartComputation() {
     comm_threads[i] = temp;
     std::cout << "Thread i = " << i << ", total data sent till now = " << temp
               << std::endl;
+#ifdef LOG_LAYERWISE
+    ioArr[i]->track_time = true;
+#endif
   }
   std::cout << "-----------Syncronizing-----------" << std::endl;
   io->sync();
@@ -2091,6 +2484,28 @@ void EndComputation() {
             << " MiB." << std::endl;
   std::cout << "Number of rounds = " << ioArr[0]->num_rounds - num_rounds
             << std::endl;
+#if USE_CHEETAH
+  if (party == SERVER && fc_weight_store && fc_weight_store->is_dirty() &&
+      !fc_weight_store_path.empty()) {
+    if (fc_weight_store->save(fc_weight_store_path)) {
+      std::cout << "Saved " << fc_weight_store->size()
+                << " encoded FC weights to " << fc_weight_store_path
+                << std::endl;
+    }
+  }
+  if (party == SERVER && conv_filter_cache) {
+    std::cout << "Conv filter cache: " << conv_filter_cache->size()
+              << " layers, "
+              << (conv_filter_cache->nbytes() / (1.0 * (1ULL << 20)))
+              << " MiB, " << conv_filter_cache->hits() << " hits, "
+              << conv_filter_cache->misses() << " misses" << std::endl;
+  }
+  if (auto tpool = cheetah_linear->thread_pool()) {
+    std::cout << "Cheetah thread pool: " << tpool->pool_size() << " threads, "
+              << tpool->num_enqueued() << " tasks, max queue depth "
+              << tpool->max_queue_depth() << std::endl;
+  }
+#endif
   if (party == SERVER) {
     io->recv_data(&totalCommClient, sizeof(uint64_t));
     std::cout << "Total comm (sent+received) = "
@@ -2101,9 +2516,19 @@ void EndComputation() {
     std::cout << "Total comm (sent+received) = (see SERVER OUTPUT)"
               << std::endl;
   }
+#if USE_CHEETAH
+  PrintOTPools();
+  if (!warm_start_dir.empty()) {
+    SaveWarmStart(io);
+  }
+#endif
   std::cout << "------------------------------------------------------\n";
 
 #ifdef LOG_LAYERWISE
+  ReportIOScopes(IOScopeOutputFile.empty()
+                     ? ""
+                     : IOScopeOutputFile +
+                           (party == SERVER ? "_server.csv" : "_client.csv"));
   std::cout << "Total time in Conv = " << (ConvTimeInMilliSec / 1000.0)
             << " seconds." << std::endl;
   std::cout << "Total time in MatMul = " << (MatMulTimeInMilliSec / 1000.0)
@@ -2447,6 +2872,7 @@ void ElemWiseSecretSharedVectorMult(int32_t size, intType *inArr,
                                     intType *multArrVec, intType *outputArr) {
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("BatchNorm");
   INIT_TIMER;
 #endif
   static int batchNormCtr = 1;
@@ -67,6 +67,16 @@ void ElemWiseActModelVectorMult(int32_t size, intType *inArr,
                                 intType *multArrVec, intType *outputArr);
 
 #if USE_CHEETAH 
+// Encode the filters of the `layer`-th Conv2DWrapper call into
+// conv_filter_cache ahead of the inference, e.g., right after the model is
+// loaded. Takes the shape arguments of that call. No-op on the client.
+void Conv2DCacheFilters(signedIntType layer, signedIntType H, signedIntType W,
+                        signedIntType CI, signedIntType FH, signedIntType FW,
+                        signedIntType CO, signedIntType zPadHLeft,
+                        signedIntType zPadHRight, signedIntType zPadWLeft,
+                        signedIntType zPadWRight, signedIntType strideH,
+                        signedIntType strideW, const intType *filterArr);
+
 void BatchNorm(int32_t B, int32_t H, int32_t W, int32_t C, 
                const intType *inputAr, const intType *scales, const intType *bias, 
                intType *outArr);
@@ -83,6 +93,13 @@ void MaxPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
              int32_t strideW, int32_t N1, int32_t imgH, int32_t imgW,
              int32_t C1, intType *inArr, intType *outArr);
 
+void MaxPoolRelu(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
+                 int32_t ksizeW, int32_t zPadHLeft, int32_t zPadHRight,
+                 int32_t zPadWLeft, int32_t zPadWRight, int32_t strideH,
+                 int32_t strideW, int32_t N1, int32_t imgH, int32_t imgW,
+                 int32_t C1, intType *inArr, intType *outArr, int sf,
+                 bool doTruncation);
+
 void AvgPool(int32_t N, int32_t H, int32_t W, int32_t C, int32_t ksizeH,
              int32_t ksizeW, int32_t zPadHLeft, int32_t zPadHRight,
              int32_t zPadWLeft, int32_t zPadWRight, int32_t strideH,
@@ -37,6 +37,26 @@ static inline uint64_t getRingElt(int64_t x) {
 
 extern uint64_t SecretAdd(uint64_t x, uint64_t y);
 
+// The HE layers only talk on the channel of thread 0. Meanwhile, the OT pools
+// of the other threads are refilled in the background. Both parties open the
+// scope at the same layers so that the pools stay aligned, whatever the
+// logging options.
+struct OTPoolRefillScope {
+  OTPoolRefillScope() {
+    for (int i = 1; i < num_threads; i++) {
+      if (otpackArr[i] && otpackArr[i]->ot_pool_capacity() > 0) {
+        otpackArr[i]->start_refill_ot_pool();
+      }
+    }
+  }
+
+  ~OTPoolRefillScope() {
+    for (int i = 1; i < num_threads; i++) {
+      if (otpackArr[i]) otpackArr[i]->wait_refill_ot_pool();
+    }
+  }
+};
+
 #ifdef LOG_LAYERWISE
 #include <vector>
 
@@ -47,6 +67,15 @@ typedef std::vector<std::vector<std::vector<std::vector<uint64_t>>>> uint64_4D;
 
 extern void funcReconstruct2PCCons(signedIntType *y, const intType *x, int len);
 
+// Ciphertext bytes before/after compression and the time spent on it.
+static void PrintCtIOStats(const gemini::CtIOStats &stats) {
+  std::cout << "Ciphertexts raw [" << (stats.raw_bytes / 1024. / 1024.)
+            << "] MB sent [" << (stats.sent_bytes / 1024. / 1024.)
+            << "] MB recv [" << (stats.recv_bytes / 1024. / 1024.)
+            << "] MB compress [" << stats.compress_ms << "] ms decompress ["
+            << stats.decompress_ms << "] ms" << std::endl;
+}
+
 // Helper functions for computing the ground truth
 // See `cleartext_library_fixed_uniform.h`
 extern void Conv2DWrapper_pt(uint64_t N, uint64_t H, uint64_t W, uint64_t CI,
@@ -71,8 +100,10 @@ void MatMul2D(int32_t d0, int32_t d1, int32_t d2, const intType *mat_A,
   * false: stop collecting the power usage
 **/
 // static bool monitor_power = false; // Added by Tanjina
+  OTPoolRefillScope refill_ot_pools;
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("MatMul");
   INIT_TIMER;
 
   // Add by Eloise
@@ -80,6 +111,7 @@ void MatMul2D(int32_t d0, int32_t d1, int32_t d2, const intType *mat_A,
   auto cur_start = CURRENT_TIME;
   std::cout << "Current time of start for current matmul = " << cur_start
             << std::endl;
+  const gemini::CtIOStats ct_stats_start = cheetah_linear->io_stats();
   MatMulStartTime = cur_start; // Added by Tanjina to calculate the duration/execution time
 #endif
 /** 
@@ -149,45 +181,69 @@ void MatMul2D(int32_t d0, int32_t d1, int32_t d2, const intType *mat_A,
   auto weight_mat = is_A_weight_matrix ? mat_A : mat_B;
   auto input_mat = is_A_weight_matrix ? mat_B : mat_A;
 
-  Tensor<intType> weight_matrix;
+  // All the rows of the input are evaluated together by the batched HomFC.
+  // Encode the weight matrix once for all the rows. The encoded matrix is
+  // taken from the store if it has been encoded offline.
+  const size_t batch = input_shape.rows();
+  const size_t layer = fc_layer_counter++;
+  std::shared_ptr<const FCWeightStore::Encoded> encoded_matrix;
   if (cheetah_linear->party() == SERVER) {
-    // Transpose the weight matrix and convert the uint64_t to ring element
-    weight_matrix.Reshape(meta.weight_shape);
-    const size_t nrows = weight_shape.dim_size(0);
-    const size_t ncols = weight_shape.dim_size(1);
-    for (long r = 0; r < nrows; ++r) {
-      for (long c = 0; c < ncols; ++c) {
-        Arr2DIdxRowM(weight_matrix.data(), ncols, nrows, c, r) =
-            getRingElt(Arr2DIdxRowM(weight_mat, nrows, ncols, r, c));
-      }
+    const uint64_t plain_mod = cheetah_linear->plain_modulus();
+    uint64_t weights_fingerprint = 0;
+    if (fc_weight_store) {
+      weights_fingerprint = gemini::WeightsFingerprint(
+          weight_mat, weight_shape.num_elements());
+      encoded_matrix = fc_weight_store->find(layer, meta, batch, plain_mod,
+                                             weights_fingerprint);
     }
-  }
 
-  for (long r = 0; r < input_shape.rows(); ++r) {
-    // row-major
-    const intType *input_row = input_mat + r * input_shape.cols();
+    if (!encoded_matrix) {
+      // Transpose the weight matrix and convert the uint64_t to ring element
+      Tensor<intType> weight_matrix(meta.weight_shape);
+      const size_t nrows = weight_shape.dim_size(0);
+      const size_t ncols = weight_shape.dim_size(1);
+      for (long r = 0; r < nrows; ++r) {
+        for (long c = 0; c < ncols; ++c) {
+          Arr2DIdxRowM(weight_matrix.data(), ncols, nrows, c, r) =
+              getRingElt(Arr2DIdxRowM(weight_mat, nrows, ncols, r, c));
+        }
+      }
 
-    Tensor<intType> input_vector;
-    if (meta.is_shared_input) {
-      input_vector = Tensor<intType>::Wrap(const_cast<intType *>(input_row),
-                                           meta.input_shape);
-    } else {
-      input_vector.Reshape(meta.input_shape);
-      std::transform(input_row, input_row + meta.input_shape.num_elements(),
-                     input_vector.data(),
-                     [](uint64_t v) { return getRingElt(v); });
+      auto encoded =
+          cheetah_linear->encodeFCWeights(weight_matrix, meta, batch);
+      cheetah_linear->safe_erase(weight_matrix.data(),
+                                 meta.weight_shape.num_elements());
+      if (fc_weight_store) {
+        encoded_matrix =
+            fc_weight_store->insert(layer, meta, batch, plain_mod,
+                                    weights_fingerprint, std::move(encoded));
+      } else {
+        encoded_matrix =
+            std::make_shared<const FCWeightStore::Encoded>(
+                std::move(encoded));
+      }
     }
+  }
 
-    Tensor<uint64_t> out_vec;
-    cheetah_linear->fc(input_vector, weight_matrix, meta, out_vec);
-    std::copy_n(out_vec.data(), out_vec.shape().num_elements(),
-                mat_C + r * input_shape.cols());
+  // row-major
+  Tensor<intType> input_matrix;
+  if (meta.is_shared_input) {
+    input_matrix =
+        Tensor<intType>::Wrap(const_cast<intType *>(input_mat), input_shape);
+  } else {
+    input_matrix.Reshape(input_shape);
+    std::transform(input_mat, input_mat + input_shape.num_elements(),
+                   input_matrix.data(),
+                   [](uint64_t v) { return getRingElt(v); });
   }
 
-  if (cheetah_linear->party() == SERVER) {
-    cheetah_linear->safe_erase(weight_matrix.data(),
-                               meta.weight_shape.num_elements());
+  Tensor<uint64_t> out_matrix;
+  cheetah_linear->matmul(input_matrix, encoded_matrix.get(), meta, out_matrix);
+  for (long r = 0; r < input_shape.rows(); ++r) {
+    std::copy_n(out_matrix.data() + r * out_matrix.cols(), out_matrix.cols(),
+                mat_C + r * out_matrix.cols());
   }
+
 #ifdef LOG_LAYERWISE
   auto temp = TIMER_TILL_NOW;
   MatMulTimeInMilliSec += temp;
@@ -203,6 +259,7 @@ void MatMul2D(int32_t d0, int32_t d1, int32_t d2, const intType *mat_A,
   uint64_t curComm;
   FIND_ALL_IO_TILL_NOW(curComm);
   MatMulCommSent += curComm;
+  PrintCtIOStats(cheetah_linear->io_stats() - ct_stats_start);
 #endif
 /** 
   * Code block for power measurement in MatMul layer ends
@@ -296,6 +353,85 @@ void MatMul2D(int32_t d0, int32_t d1, int32_t d2, const intType *mat_A,
 #endif
 }
 
+static gemini::CheetahLinear::ConvMeta MakeConv2DMeta(
+    signedIntType H, signedIntType W, signedIntType CI, signedIntType FH,
+    signedIntType FW, signedIntType CO, signedIntType zPadHLeft,
+    signedIntType zPadHRight, signedIntType zPadWLeft, signedIntType zPadWRight,
+    signedIntType strideH) {
+  gemini::CheetahLinear::ConvMeta meta;
+  meta.ishape = gemini::TensorShape({CI, H, W});
+  meta.fshape = gemini::TensorShape({CI, FH, FW});
+  meta.n_filters = CO;
+
+  const int npads = zPadHLeft + zPadHRight + zPadWLeft + zPadWRight;
+  meta.padding = npads == 0 ? gemini::Padding::VALID : gemini::Padding::SAME;
+  meta.stride = strideH;
+  meta.is_shared_input = kIsSharedInput;
+  return meta;
+}
+
+// Server only. Take the encoded filters of the `layer`-th conv from the
+// cache, or encode (and cache) them. The fingerprint of the filters guards
+// against a layer whose filters differ from the cached ones, e.g., FusedBN
+// passes a temporary buffer of the scaled filters.
+static std::shared_ptr<const gemini::ConvFilterCache::Encoded>
+GetConv2DFilters(size_t layer, const gemini::CheetahLinear::ConvMeta &meta,
+                 const intType *filterArr) {
+  const signedIntType CI = meta.fshape.channels();
+  const signedIntType FH = meta.fshape.height();
+  const signedIntType FW = meta.fshape.width();
+  const signedIntType CO = meta.n_filters;
+  const uint64_t plain_mod = cheetah_linear->plain_modulus();
+  const auto parms_id = cheetah_linear->fc_parms_id();
+  const uint64_t filters_fingerprint =
+      gemini::WeightsFingerprint(filterArr, FH * FW * CI * CO);
+  if (conv_filter_cache) {
+    auto encoded_filters = conv_filter_cache->find(
+        layer, meta, plain_mod, parms_id, filters_fingerprint);
+    if (encoded_filters) {
+      return encoded_filters;
+    }
+  }
+
+  std::vector<gemini::Tensor<intType>> filters(CO);
+  for (auto &f : filters) {
+    f.Reshape(meta.fshape);
+  }
+  for (int i = 0; i < FH; i++) {
+    for (int j = 0; j < FW; j++) {
+      for (int k = 0; k < CI; k++) {
+        for (int p = 0; p < CO; p++) {
+          filters.at(p)(k, i, j) =
+              getRingElt(Arr4DIdxRowM(filterArr, FH, FW, CI, CO, i, j, k, p));
+        }
+      }
+    }
+  }
+
+  auto encoded = cheetah_linear->encodeConvFilters(filters, meta);
+  if (conv_filter_cache) {
+    return conv_filter_cache->insert(layer, meta, plain_mod, parms_id,
+                                     filters_fingerprint, std::move(encoded));
+  }
+  return std::make_shared<const gemini::ConvFilterCache::Encoded>(
+      std::move(encoded));
+}
+
+void Conv2DCacheFilters(signedIntType layer, signedIntType H, signedIntType W,
+                        signedIntType CI, signedIntType FH, signedIntType FW,
+                        signedIntType CO, signedIntType zPadHLeft,
+                        signedIntType zPadHRight, signedIntType zPadWLeft,
+                        signedIntType zPadWRight, signedIntType strideH,
+                        signedIntType strideW, const intType *filterArr) {
+  if (cheetah_linear->party() != SERVER) {
+    return;
+  }
+  const auto meta =
+      MakeConv2DMeta(H, W, CI, FH, FW, CO, zPadHLeft, zPadHRight, zPadWLeft,
+                     zPadWRight, strideH);
+  GetConv2DFilters(layer, meta, filterArr);
+}
+
 void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
                    signedIntType CI, signedIntType FH, signedIntType FW,
                    signedIntType CO, signedIntType zPadHLeft,
@@ -310,8 +446,10 @@ void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
   * false: stop collecting the power usage
 **/
 // static bool monitor_power = false; // Added by Tanjina
+  OTPoolRefillScope refill_ot_pools;
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("Conv");
   INIT_TIMER;
 
   // Add by Eloise
@@ -319,6 +457,7 @@ void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
   auto cur_start = CURRENT_TIME;
   std::cout << "Current time of start for current conv = " << cur_start
             << std::endl;
+  const gemini::CtIOStats ct_stats_start = cheetah_linear->io_stats();
   ConvStartTime = cur_start; // Added by Tanjina to calculate the duration/execution time
 #endif
 
@@ -376,32 +515,15 @@ void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
   signedIntType newH = (((H + (zPadHLeft + zPadHRight) - FH) / strideH) + 1);
   signedIntType newW = (((W + (zPadWLeft + zPadWRight) - FW) / strideW) + 1);
 
-  gemini::CheetahLinear::ConvMeta meta;
-  meta.ishape = gemini::TensorShape({CI, H, W});
-  meta.fshape = gemini::TensorShape({CI, FH, FW});
-  meta.n_filters = CO;
-
-  std::vector<gemini::Tensor<intType>> filters(CO);
-  for (auto &f : filters) {
-    f.Reshape(meta.fshape);
-  }
-
-  for (int i = 0; i < FH; i++) {
-    for (int j = 0; j < FW; j++) {
-      for (int k = 0; k < CI; k++) {
-        for (int p = 0; p < CO; p++) {
-          filters.at(p)(k, i, j) =
-              getRingElt(Arr4DIdxRowM(filterArr, FH, FW, CI, CO, i, j, k, p));
-        }
-      }
-    }
+  const auto meta =
+      MakeConv2DMeta(H, W, CI, FH, FW, CO, zPadHLeft, zPadHRight, zPadWLeft,
+                     zPadWRight, strideH);
+  const size_t layer = conv_layer_counter++;
+  std::shared_ptr<const gemini::ConvFilterCache::Encoded> encoded_filters;
+  if (cheetah_linear->party() == SERVER) {
+    encoded_filters = GetConv2DFilters(layer, meta, filterArr);
   }
 
-  const int npads = zPadHLeft + zPadHRight + zPadWLeft + zPadWRight;
-  meta.padding = npads == 0 ? gemini::Padding::VALID : gemini::Padding::SAME;
-  meta.stride = strideH;
-  meta.is_shared_input = kIsSharedInput;
-
   // printf(
   //     "HomConv #%d called N=%ld, H=%ld, W=%ld, CI=%ld, FH=%ld, FW=%ld, "
   //     "CO=%ld, S=%ld, Padding %s (%d %d %d %d)\n",
@@ -434,7 +556,7 @@ void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
     }
 
     gemini::Tensor<intType> out_tensor;
-    cheetah_linear->conv2d(image, filters, meta, out_tensor);
+    cheetah_linear->conv2d(image, encoded_filters.get(), meta, out_tensor);
 
     for (int j = 0; j < newH; j++) {
       for (int k = 0; k < newW; k++) {
@@ -457,6 +579,7 @@ void Conv2DWrapper(signedIntType N, signedIntType H, signedIntType W,
   uint64_t curComm;
   FIND_ALL_IO_TILL_NOW(curComm);
   ConvCommSent += curComm;
+  PrintCtIOStats(cheetah_linear->io_stats() - ct_stats_start);
 #endif
 
 #ifdef VERIFY_LAYERWISE
@@ -634,8 +757,10 @@ void BatchNorm(int32_t B, int32_t H, int32_t W, int32_t C,
   * false: stop collecting the power usage
 **/
 // static bool monitor_power = false; // Added by Tanjina
+  OTPoolRefillScope refill_ot_pools;
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("BatchNorm");
   INIT_TIMER;
 
   // Add by Eloise
@@ -643,6 +768,7 @@ void BatchNorm(int32_t B, int32_t H, int32_t W, int32_t C,
   auto cur_start = CURRENT_TIME;
   std::cout << "Current time of start for current BN1 = " << cur_start
             << std::endl;
+  const gemini::CtIOStats ct_stats_start = cheetah_linear->io_stats();
   BatchNormStartTime = cur_start; // Added by Tanjina to calculate the duration/execution time
 #endif
 /** 
@@ -739,6 +865,7 @@ void BatchNorm(int32_t B, int32_t H, int32_t W, int32_t C,
   uint64_t curComm;
   FIND_ALL_IO_TILL_NOW(curComm);
   BatchNormCommSent += curComm;
+  PrintCtIOStats(cheetah_linear->io_stats() - ct_stats_start);
   std::cout << "Time in sec for current BN1 = [" << (temp / 1000.0) << "] sent ["
             << (curComm / 1024. / 1024.) << "] MB" << std::endl;
 
@@ -775,14 +902,17 @@ void ElemWiseActModelVectorMult(int32_t size, intType *inArr,
   * false: stop collecting the power usage
 **/
 // static bool monitor_power = false; // Added by Tanjina
+  OTPoolRefillScope refill_ot_pools;
 #ifdef LOG_LAYERWISE
   INIT_ALL_IO_DATA_SENT;
+  IOScope io_scope("BatchNorm");
   INIT_TIMER;
   // Add by Eloise >> Tanjina-Note: I moved them here. I could still found them in the log before when it was residing outside of this #ifdef LOG_LAYERWISE block, but to be consistent I placed them here!
   std::cout << "*******************" << std::endl;
   auto cur_start = CURRENT_TIME;
   std::cout << "Current time of start for current BN2 = " << cur_start
             << std::endl; 
+  const gemini::CtIOStats ct_stats_start = cheetah_linear->io_stats();
   BatchNormStartTime = cur_start; // Added by Tanjina to calculate the duration/execution time
 #endif
 
@@ -870,6 +1000,7 @@ void ElemWiseActModelVectorMult(int32_t size, intType *inArr,
   uint64_t curComm;
   FIND_ALL_IO_TILL_NOW(curComm);
   BatchNormCommSent += curComm;
+  PrintCtIOStats(cheetah_linear->io_stats() - ct_stats_start);
 #endif
 
 #ifdef VERIFY_LAYERWISE
@@ -0,0 +1,118 @@
+#ifndef SCI_ARENA_H__
+#define SCI_ARENA_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace sci {
+
+// Bump allocator for the scratch buffers of one protocol instance. It is not
+// thread-safe; each thread owns its own protocol instances and hence arenas.
+// Buffers are released together when the enclosing Scope ends. If the arena
+// had to grow during a call, its chunks are merged into one once it is empty
+// again, so repeated calls of the same size make no allocations.
+class Arena {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  explicit Arena(size_t initial_bytes = 0) {
+    if (initial_bytes > 0) add_chunk(initial_bytes);
+  }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Uninitialized storage for n objects of T.
+  template <typename T>
+  T *alloc(size_t n) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "Arena never runs destructors");
+    return reinterpret_cast<T *>(alloc_bytes(n * sizeof(T)));
+  }
+
+  // Releases everything allocated from the arena during its lifetime.
+  class Scope {
+   public:
+    explicit Scope(Arena &arena)
+        : arena_(arena), chunk_(arena.cur_), offset_(arena.offset_) {}
+
+    ~Scope() { arena_.rewind(chunk_, offset_); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    Arena &arena_;
+    size_t chunk_;
+    size_t offset_;
+  };
+
+  size_t capacity() const {
+    size_t total = 0;
+    for (const auto &c : chunks_) total += c.size;
+    return total;
+  }
+
+  // Number of times the arena went to the system allocator.
+  uint64_t num_chunk_allocs() const { return num_chunk_allocs_; }
+
+ private:
+  struct Chunk {
+    std::unique_ptr<uint8_t[]> raw;
+    uint8_t *base;
+    size_t size;
+  };
+
+  static size_t round_up(size_t bytes) {
+    return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+  }
+
+  void add_chunk(size_t bytes) {
+    Chunk c;
+    c.size = round_up(bytes);
+    c.raw.reset(new uint8_t[c.size + kAlignment]);
+    uintptr_t addr = reinterpret_cast<uintptr_t>(c.raw.get());
+    c.base = c.raw.get() + (round_up(addr) - addr);
+    chunks_.push_back(std::move(c));
+    ++num_chunk_allocs_;
+  }
+
+  void *alloc_bytes(size_t bytes) {
+    bytes = round_up(std::max<size_t>(bytes, 1));
+    for (; cur_ < chunks_.size(); ++cur_, offset_ = 0) {
+      if (offset_ + bytes <= chunks_[cur_].size) {
+        void *ptr = chunks_[cur_].base + offset_;
+        offset_ += bytes;
+        return ptr;
+      }
+    }
+    // Grow geometrically so that a call needs few chunks.
+    add_chunk(std::max(bytes, capacity()));
+    cur_ = chunks_.size() - 1;
+    offset_ = bytes;
+    return chunks_[cur_].base;
+  }
+
+  void rewind(size_t chunk, size_t offset) {
+    cur_ = chunk;
+    offset_ = offset;
+    if (cur_ == 0 && offset_ == 0 && chunks_.size() > 1) {
+      size_t total = capacity();
+      chunks_.clear();
+      add_chunk(total);
+    }
+  }
+
+  std::vector<Chunk> chunks_;
+  size_t cur_{0};
+  size_t offset_{0};
+  uint64_t num_chunk_allocs_{0};
+};
+
+}  // namespace sci
+
+#endif  // SCI_ARENA_H__
@@ -29,31 +29,71 @@ Modified by Deevashwer Rathee
 #define IO_CHANNEL_H__
 #include "utils/block.h"
 #include "utils/group.h"
+#include <chrono>
 #include <memory> // std::align
 
+// Direction of the last transfer; a change of direction starts a new round.
+enum class LastCall { None, Send, Recv };
+
 /** @addtogroup IO
   @{
  */
 
 namespace sci {
+// Traffic of a channel so far, see IOChannel::stats().
+struct IOStats {
+  uint64_t bytes_sent = 0;
+  uint64_t bytes_recv = 0;
+  uint64_t rounds = 0;
+  uint64_t send_ns = 0; // in send_data
+  uint64_t recv_ns = 0; // in recv_data, mostly waiting for the peer
+};
+
 template <typename T> class IOChannel {
 public:
     uint64_t counter = 0;
-  void send_data(const void *data, int nbyte) {
+  uint64_t recv_counter = 0;
+  // Time spent in send_data and recv_data, measured only with track_time.
+  uint64_t send_ns = 0;
+  uint64_t recv_ns = 0;
+  bool track_time = false;
+
+  void send_data(const void *data, size_t nbyte) {
       counter += nbyte;
+    if (!track_time)
+      return derived().send_data_internal(data, nbyte);
+    auto start = std::chrono::steady_clock::now();
     derived().send_data_internal(data, nbyte);
+    send_ns += elapsed_ns(start);
+  }
+  void recv_data(void *data, size_t nbyte) {
+    recv_counter += nbyte;
+    if (!track_time)
+      return derived().recv_data_internal(data, nbyte);
+    auto start = std::chrono::steady_clock::now();
+    derived().recv_data_internal(data, nbyte);
+    recv_ns += elapsed_ns(start);
   }
-  void recv_data(void *data, int nbyte) { derived().recv_data_internal(data, nbyte); }
 
-  void send_block(const block128 *data, int nblock) {
+  IOStats stats() {
+    IOStats s;
+    s.bytes_sent = counter;
+    s.bytes_recv = recv_counter;
+    s.rounds = derived().num_rounds;
+    s.send_ns = send_ns;
+    s.recv_ns = recv_ns;
+    return s;
+  }
+
+  void send_block(const block128 *data, size_t nblock) {
     send_data(data, nblock * sizeof(block128));
   }
 
-  void send_block(const block256 *data, int nblock) {
+  void send_block(const block256 *data, size_t nblock) {
     send_data(data, nblock * sizeof(block256));
   }
 
-  void recv_block(block128 *data, int nblock) {
+  void recv_block(block128 *data, size_t nblock) {
     recv_data(data, nblock * sizeof(block128));
   }
 
@@ -150,6 +190,12 @@ public:
 
 private:
   T &derived() { return *static_cast<T *>(this); }
+
+  static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
 };
 /**@}*/
 } // namespace sci
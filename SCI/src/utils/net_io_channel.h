@@ -26,89 +26,523 @@ Enquiries about further applications and development opportunities are welcome.
 #define NETWORK_IO_CHANNEL
 
 #include "utils/io_channel.h"
+#include "utils/net_mux.h"
+#include "utils/shm_io_channel.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <thread>
+#include <vector>
 #include <memory> // std::align
 using std::string;
 
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-enum class LastCall { None, Send, Recv };
-
 namespace sci {
 /** @addtogroup IO
   @{
  */
 
+// Talks to the socket directly. Sends smaller than the send buffer are
+// batched in it; larger ones go out together with the pending batch in one
+// writev, and payloads of at least zerocopy_threshold bytes are sent with
+// MSG_ZEROCOPY where the kernel supports it. Receives read the requested
+// bytes and whatever else is already available in one recvmsg.
+//
+// Constructed on a MuxConnection, the channel is one of the logical channels
+// of that connection instead and owns no socket. Constructed on a ShmIO, it
+// passes all transfers through to that shared memory channel.
+//
+// After start_async_send(), a dedicated thread does the writes: a send only
+// copies the data into a queue and returns, so the caller computes the next
+// batch while the previous one is on the wire. At most max_queued bytes wait
+// in the queue; a send beyond that blocks until the thread catches up.
+// flush() is a barrier that returns once everything queued is written.
 class NetIO : public IOChannel<NetIO> {
 public:
   bool is_server;
-  int mysocket = -1;
   int consocket = -1;
-  FILE *stream = nullptr;
-  char *buffer = nullptr;
-  bool has_sent = false;
+  MuxConnection *mux = nullptr;
+  int channel = 0;
+  ShmIO *shm = nullptr;
   string addr;
   int port;
   uint64_t num_rounds = 0;
   LastCall last_call = LastCall::None;
+  // Payloads of at least this many bytes skip the copy into the kernel;
+  // SIZE_MAX disables MSG_ZEROCOPY.
+  size_t zerocopy_threshold = SIZE_MAX;
+
   NetIO(const char *address, int port, bool quiet = false) {
     this->port = port;
     is_server = (address == nullptr);
-    if (address == nullptr) {
-      struct sockaddr_in dest;
-      struct sockaddr_in serv;
-      socklen_t socksize = sizeof(struct sockaddr_in);
-      memset(&serv, 0, sizeof(serv));
-      serv.sin_family = AF_INET;
-      serv.sin_addr.s_addr =
-          htonl(INADDR_ANY);       /* set our address to any interface */
-      serv.sin_port = htons(port); /* set the server port number */
-      mysocket = socket(AF_INET, SOCK_STREAM, 0);
-      int reuse = 1;
-      setsockopt(mysocket, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse,
-                 sizeof(reuse));
-      if (::bind(mysocket, (struct sockaddr *)&serv, sizeof(struct sockaddr)) <
-          0) {
-        perror("error: bind");
-        exit(1);
+    if (address != nullptr)
+      addr = string(address);
+    consocket = net_connect(address, port);
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    const int one = 1;
+    if (setsockopt(consocket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+      zerocopy_threshold = 1 << 20;
+#endif
+    send_buffer = new char[NETWORK_BUFFER_SIZE];
+    recv_buffer = new char[NETWORK_BUFFER_SIZE];
+    register_channel();
+    if (!quiet)
+      std::cout << "connected\n";
+  }
+
+  // Both parties have to use the same channel number.
+  NetIO(MuxConnection *mux, int channel) : mux(mux), channel(channel) {
+    is_server = mux->is_server;
+    port = -1;
+    send_buffer = new char[NETWORK_BUFFER_SIZE];
+    register_channel();
+  }
+
+  // Takes ownership of shm.
+  NetIO(ShmIO *shm) : shm(shm) {
+    is_server = shm->is_server;
+    port = shm->port;
+    register_channel();
+  }
+
+  void sync() {
+    int tmp = 0;
+    if (is_server) {
+      send_data_internal(&tmp, 1);
+      recv_data_internal(&tmp, 1);
+    } else {
+      recv_data_internal(&tmp, 1);
+      send_data_internal(&tmp, 1);
+      flush();
+    }
+  }
+
+  ~NetIO() {
+    unregister_channel();
+    stop_async_send();
+    flush();
+    if (consocket >= 0)
+      close(consocket);
+    delete shm;
+    delete[] send_buffer;
+    delete[] recv_buffer;
+  }
+
+  void set_nodelay() {
+    if (mux != nullptr)
+      return mux->set_nodelay(true);
+    if (shm != nullptr)
+      return;
+    const int one = 1;
+    setsockopt(consocket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  void set_delay() {
+    if (mux != nullptr)
+      return mux->set_nodelay(false);
+    if (shm != nullptr)
+      return;
+    const int zero = 0;
+    setsockopt(consocket, IPPROTO_TCP, TCP_NODELAY, &zero, sizeof(zero));
+  }
+
+  void start_async_send(size_t max_queued = 1 << 26) {
+    // Shared memory sends do not block on the kernel to begin with.
+    if (async != nullptr || shm != nullptr)
+      return;
+    flush();
+    async = new AsyncSend();
+    async->max_queued = max_queued;
+    async->thread = std::thread(&NetIO::run_async_send, this);
+  }
+
+  void stop_async_send() {
+    if (async == nullptr)
+      return;
+    flush();
+    {
+      std::lock_guard<std::mutex> lk(async->mtx);
+      async->stop = true;
+    }
+    async->cv.notify_all();
+    async->thread.join();
+    for (auto &item : async->free_buffers)
+      delete[] item.data;
+    delete async;
+    async = nullptr;
+  }
+
+  void flush() {
+    if (shm != nullptr)
+      return shm->flush();
+    if (async == nullptr)
+      return send_iov(nullptr, 0);
+    push_pending();
+    std::unique_lock<std::mutex> lk(async->mtx);
+    async->done_cv.wait(lk,
+                        [&] { return async->items.empty() && !async->busy; });
+  }
+
+  void send_data_internal(const void *data, size_t len) {
+    if (last_call != LastCall::Send) {
+      num_rounds++;
+      last_call = LastCall::Send;
+    }
+    if (shm != nullptr)
+      return shm->send_data_internal(data, len);
+    if (len <= NETWORK_BUFFER_SIZE - send_len) {
+      memcpy(send_buffer + send_len, data, len);
+      send_len += len;
+    } else if (async != nullptr) {
+      queue_send(data, len);
+    } else if (len < zerocopy_threshold) {
+      send_iov(data, len);
+    } else {
+      flush();
+      send_zerocopy(data, len);
+    }
+  }
+
+  void recv_data_internal(void *data, size_t len) {
+    if (last_call != LastCall::Recv) {
+      num_rounds++;
+      last_call = LastCall::Recv;
+    }
+    if (shm != nullptr)
+      return shm->recv_data_internal(data, len);
+    // The peer may be waiting for the pending sends, but only their order
+    // matters: the async thread can still be writing while we receive.
+    if (async != nullptr)
+      push_pending();
+    else
+      flush();
+    if (mux != nullptr)
+      return mux->recv(channel, data, len);
+    size_t got = std::min(len, recv_len - recv_pos);
+    memcpy(data, recv_buffer + recv_pos, got);
+    recv_pos += got;
+    if (got == len)
+      return;
+    // The buffer is drained: read the rest straight into data and refill
+    // the buffer with anything that arrived behind it.
+    recv_pos = recv_len = 0;
+    while (got < len) {
+      struct iovec iov[2];
+      iov[0].iov_base = (char *)data + got;
+      iov[0].iov_len = len - got;
+      iov[1].iov_base = recv_buffer;
+      iov[1].iov_len = NETWORK_BUFFER_SIZE;
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = 2;
+      ssize_t res = recvmsg(consocket, &msg, 0);
+      if (res < 0 && errno == EINTR)
+        continue;
+      if (res == 0)
+        net_closed("error: net_recv_data");
+      if (res < 0)
+        net_error("error: net_recv_data");
+      if ((size_t)res > len - got) {
+        recv_len = res - (len - got);
+        got = len;
+      } else {
+        got += res;
       }
-      if (listen(mysocket, 1) < 0) {
-        perror("error: listen");
-        exit(1);
+    }
+  }
+
+private:
+  char *send_buffer = nullptr;
+  size_t send_len = 0;
+  char *recv_buffer = nullptr;
+  size_t recv_pos = 0;
+  size_t recv_len = 0;
+  uint32_t zerocopy_sent = 0;
+  uint32_t zerocopy_done = 0;
+
+  struct SendItem {
+    char *data;
+    size_t len;
+    size_t capacity;
+  };
+
+  struct AsyncSend {
+    std::mutex mtx;
+    std::condition_variable cv;      // items queued or stop
+    std::condition_variable done_cv; // items written
+    std::deque<SendItem> items;
+    // Written buffers for reuse, up to max_queued bytes of them.
+    std::vector<SendItem> free_buffers;
+    size_t free_bytes = 0;
+    size_t queued = 0;
+    size_t max_queued = 0;
+    bool busy = false;
+    bool stop = false;
+    std::thread thread;
+  };
+  AsyncSend *async = nullptr;
+
+  // Writes iov[0, cnt) completely; modifies iov.
+  void write_iov(struct iovec *iov, int cnt) {
+    if (mux != nullptr)
+      return mux->send(channel, iov, cnt);
+    struct iovec *cur = iov;
+    size_t left = 0;
+    for (int i = 0; i < cnt; i++)
+      left += iov[i].iov_len;
+    while (left > 0) {
+      ssize_t res = writev(consocket, cur, std::min(cnt, IOV_MAX));
+      if (res < 0 && errno == EINTR)
+        continue;
+      if (res < 0)
+        net_error("error: net_send_data");
+      left -= res;
+      while (cnt > 0 && (size_t)res >= cur->iov_len) {
+        res -= cur->iov_len;
+        cur++;
+        cnt--;
       }
-      consocket = accept(mysocket, (struct sockaddr *)&dest, &socksize);
-      close(mysocket);
-    } else {
-      addr = string(address);
+      if (cnt > 0) {
+        cur->iov_base = (char *)cur->iov_base + res;
+        cur->iov_len -= res;
+      }
+    }
+  }
+
+  // Writes the pending batch followed by data[0, len).
+  void send_iov(const void *data, size_t len) {
+    struct iovec iov[2];
+    iov[0].iov_base = send_buffer;
+    iov[0].iov_len = send_len;
+    iov[1].iov_base = const_cast<void *>(data);
+    iov[1].iov_len = len;
+    write_iov(iov, 2);
+    send_len = 0;
+  }
+
+  // MSG_ZEROCOPY pins data instead of copying it, so the call only returns
+  // once the kernel has released every page and the caller may reuse data.
+  void send_zerocopy(const void *data, size_t len) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    size_t sent = 0;
+    while (sent < len) {
+      ssize_t res = send(consocket, (const char *)data + sent, len - sent,
+                         MSG_ZEROCOPY);
+      if (res < 0 && errno == EINTR)
+        continue;
+      if (res < 0 && errno == ENOBUFS) {
+        // Out of optmem for pinned pages, fall back to a plain copy.
+        send_iov((const char *)data + sent, len - sent);
+        break;
+      }
+      if (res < 0)
+        net_error("error: net_send_data");
+      sent += res;
+      zerocopy_sent++;
+    }
+    while ((int32_t)(zerocopy_sent - zerocopy_done) > 0)
+      reap_zerocopy();
+#else
+    send_iov(data, len);
+#endif
+  }
 
-      struct sockaddr_in dest;
-      memset(&dest, 0, sizeof(dest));
-      dest.sin_family = AF_INET;
-      dest.sin_addr.s_addr = inet_addr(address);
-      dest.sin_port = htons(port);
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  // Reads one completion notification off the socket error queue. Each
+  // covers the range [ee_info, ee_data] of zerocopy sends.
+  void reap_zerocopy() {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(consocket, &msg, MSG_ERRQUEUE) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        struct pollfd pfd = {consocket, 0, 0};
+        poll(&pfd, 1, -1);
+        return;
+      }
+      net_error("error: net_send_data");
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err *serr =
+          (struct sock_extended_err *)CMSG_DATA(cm);
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      zerocopy_done = serr->ee_data + 1;
+      // The kernel copied anyway (e.g. loopback), so pinning only costs.
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        zerocopy_threshold = SIZE_MAX;
+    }
+  }
+#endif
 
-      while (1) {
-        consocket = socket(AF_INET, SOCK_STREAM, 0);
+  // Queues the pending batch followed by a copy of data[0, len), which does
+  // not fit into the batch.
+  void queue_send(const void *data, size_t len) {
+    push_pending();
+    if (len <= NETWORK_BUFFER_SIZE) {
+      memcpy(send_buffer, data, len);
+      send_len = len;
+      return;
+    }
+    std::unique_lock<std::mutex> lk(async->mtx);
+    async->done_cv.wait(lk,
+                        [&] { return async->queued < async->max_queued; });
+    SendItem item = take_buffer(len);
+    lk.unlock();
+    memcpy(item.data, data, len);
+    item.len = len;
+    lk.lock();
+    async->items.push_back(item);
+    async->queued += len;
+    async->cv.notify_one();
+  }
 
-        if (connect(consocket, (struct sockaddr *)&dest,
-                    sizeof(struct sockaddr)) == 0) {
-          break;
-        }
+  // Returns a free buffer of at least len bytes; needs async->mtx.
+  SendItem take_buffer(size_t len) {
+    auto &free_buffers = async->free_buffers;
+    for (size_t i = 0; i < free_buffers.size(); i++) {
+      if (free_buffers[i].capacity >= len) {
+        SendItem item = free_buffers[i];
+        free_buffers[i] = free_buffers.back();
+        free_buffers.pop_back();
+        async->free_bytes -= item.capacity;
+        return item;
+      }
+    }
+    return {new char[len], 0, len};
+  }
+
+  // Hands the pending batch to the async thread. If that thread is idle
+  // with nothing queued, writing here saves the wakeup on the round trip.
+  void push_pending() {
+    if (send_len == 0)
+      return;
+    std::unique_lock<std::mutex> lk(async->mtx);
+    if (async->items.empty() && !async->busy) {
+      lk.unlock();
+      return send_iov(nullptr, 0);
+    }
+    async->done_cv.wait(lk,
+                        [&] { return async->queued < async->max_queued; });
+    async->items.push_back({send_buffer, send_len, NETWORK_BUFFER_SIZE});
+    async->queued += send_len;
+    async->cv.notify_one();
+    send_buffer = take_buffer(NETWORK_BUFFER_SIZE).data;
+    send_len = 0;
+  }
 
-        close(consocket);
-        usleep(1000);
+  void run_async_send() {
+    std::vector<SendItem> batch;
+    std::vector<struct iovec> iov;
+    std::unique_lock<std::mutex> lk(async->mtx);
+    while (true) {
+      async->cv.wait(lk, [&] { return !async->items.empty() || async->stop; });
+      if (async->items.empty())
+        return;
+      size_t n = std::min<size_t>(async->items.size(), IOV_MAX);
+      batch.assign(async->items.begin(), async->items.begin() + n);
+      async->items.erase(async->items.begin(), async->items.begin() + n);
+      async->busy = true;
+      lk.unlock();
+      iov.resize(n);
+      for (size_t i = 0; i < n; i++) {
+        iov[i].iov_base = batch[i].data;
+        iov[i].iov_len = batch[i].len;
+      }
+      write_iov(iov.data(), n);
+      lk.lock();
+      for (auto &item : batch) {
+        async->queued -= item.len;
+        if (async->free_bytes + item.capacity <= async->max_queued) {
+          async->free_buffers.push_back(item);
+          async->free_bytes += item.capacity;
+        } else {
+          delete[] item.data;
+        }
       }
+      async->busy = false;
+      async->done_cv.notify_all();
     }
-    set_nodelay();
+  }
+
+  // Like the FILE* stream it replaced, every open channel writes out its
+  // pending sends when the process exits.
+  struct Registry {
+    std::mutex mtx;
+    std::set<NetIO *> channels;
+  };
+
+  static Registry &registry() {
+    // Never destroyed, so that it outlives the exit handler.
+    static Registry *r = [] {
+      Registry *r = new Registry();
+      std::atexit(flush_all);
+      return r;
+    }();
+    return *r;
+  }
+
+  static void flush_all() {
+    if (net_failed())
+      return;
+    std::lock_guard<std::mutex> lk(registry().mtx);
+    for (NetIO *io : registry().channels)
+      io->flush();
+  }
+
+  void register_channel() {
+    std::lock_guard<std::mutex> lk(registry().mtx);
+    registry().channels.insert(this);
+  }
+
+  void unregister_channel() {
+    std::lock_guard<std::mutex> lk(registry().mtx);
+    registry().channels.erase(this);
+  }
+};
+
+// The original transport: the socket wrapped in a FILE* stream with a
+// NETWORK_BUFFER_SIZE stdio buffer. Kept for comparison with NetIO.
+class StdioNetIO : public IOChannel<StdioNetIO> {
+public:
+  bool is_server;
+  int consocket = -1;
+  FILE *stream = nullptr;
+  char *buffer = nullptr;
+  bool has_sent = false;
+  string addr;
+  int port;
+  uint64_t num_rounds = 0;
+  LastCall last_call = LastCall::None;
+  StdioNetIO(const char *address, int port, bool quiet = false) {
+    this->port = port;
+    is_server = (address == nullptr);
+    if (address != nullptr)
+      addr = string(address);
+    consocket = net_connect(address, port);
     stream = fdopen(consocket, "wb+");
     buffer = new char[NETWORK_BUFFER_SIZE];
     memset(buffer, 0, NETWORK_BUFFER_SIZE);
@@ -130,7 +564,7 @@ public:
     }
   }
 
-  ~NetIO() {
+  ~StdioNetIO() {
     fflush(stream);
     close(consocket);
     delete[] buffer;
@@ -148,23 +582,23 @@ public:
 
   void flush() { fflush(stream); }
 
-  void send_data_internal(const void *data, int len) {
+  void send_data_internal(const void *data, size_t len) {
     if (last_call != LastCall::Send) {
       num_rounds++;
       last_call = LastCall::Send;
     }
-    int sent = 0;
+    size_t sent = 0;
     while (sent < len) {
-      int res = fwrite(sent + (char *)data, 1, len - sent, stream);
-      if (res >= 0)
+      size_t res = fwrite(sent + (char *)data, 1, len - sent, stream);
+      if (res > 0)
         sent += res;
       else
-        fprintf(stderr, "error: net_send_data %d\n", res);
+        fprintf(stderr, "error: net_send_data %zu\n", res);
     }
     has_sent = true;
   }
 
-  void recv_data_internal(void *data, int len) {
+  void recv_data_internal(void *data, size_t len) {
     if (last_call != LastCall::Recv) {
       num_rounds++;
       last_call = LastCall::Recv;
@@ -172,13 +606,13 @@ public:
     if (has_sent)
       fflush(stream);
     has_sent = false;
-    int sent = 0;
+    size_t sent = 0;
     while (sent < len) {
-      int res = fread(sent + (char *)data, 1, len - sent, stream);
-      if (res >= 0)
+      size_t res = fread(sent + (char *)data, 1, len - sent, stream);
+      if (res > 0)
         sent += res;
       else
-        fprintf(stderr, "error: net_send_data %d\n", res);
+        fprintf(stderr, "error: net_send_data %zu\n", res);
     }
   }
 };
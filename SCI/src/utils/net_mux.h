@@ -0,0 +1,313 @@
+#ifndef NET_MUX_H__
+#define NET_MUX_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace sci {
+/** @addtogroup IO
+  @{
+ */
+
+// Set once a transport failed, so that exit handlers leave the broken
+// connections alone.
+inline std::atomic<bool> &net_failed() {
+  static std::atomic<bool> failed{false};
+  return failed;
+}
+
+inline void net_error(const char *msg) {
+  net_failed() = true;
+  perror(msg);
+  exit(1);
+}
+
+// The peer shut the connection down; errno says nothing about it.
+inline void net_closed(const char *msg) {
+  net_failed() = true;
+  fprintf(stderr, "%s: connection closed\n", msg);
+  exit(1);
+}
+
+// Opens the TCP connection of a channel: the server (address == nullptr)
+// accepts one connection on port, the client retries until it connects.
+inline int net_connect(const char *address, int port) {
+  int consocket = -1;
+  if (address == nullptr) {
+    struct sockaddr_in dest;
+    struct sockaddr_in serv;
+    socklen_t socksize = sizeof(struct sockaddr_in);
+    memset(&serv, 0, sizeof(serv));
+    serv.sin_family = AF_INET;
+    serv.sin_addr.s_addr =
+        htonl(INADDR_ANY);       /* set our address to any interface */
+    serv.sin_port = htons(port); /* set the server port number */
+    int mysocket = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(mysocket, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse,
+               sizeof(reuse));
+    if (::bind(mysocket, (struct sockaddr *)&serv, sizeof(struct sockaddr)) <
+        0) {
+      perror("error: bind");
+      exit(1);
+    }
+    if (listen(mysocket, 1) < 0) {
+      perror("error: listen");
+      exit(1);
+    }
+    consocket = accept(mysocket, (struct sockaddr *)&dest, &socksize);
+    close(mysocket);
+  } else {
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr(address);
+    dest.sin_port = htons(port);
+
+    while (1) {
+      consocket = socket(AF_INET, SOCK_STREAM, 0);
+
+      if (connect(consocket, (struct sockaddr *)&dest,
+                  sizeof(struct sockaddr)) == 0) {
+        break;
+      }
+
+      close(consocket);
+      usleep(1000);
+    }
+  }
+  const int one = 1;
+  setsockopt(consocket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return consocket;
+}
+
+// Carries any number of logical channels over num_sockets TCP connections
+// (on port, port + 1, ...); channel c uses socket c % num_sockets. Data is
+// framed as (channel, length, payload) and a reader thread per socket queues
+// the frames on their channel. Every channel has its own flow control: a
+// sender may have at most window bytes that the receiving channel has not
+// consumed yet, and the receiver hands the consumed bytes back as credit.
+// Hence the reader threads never block on a slow channel.
+class MuxConnection {
+public:
+  bool is_server;
+
+  MuxConnection(const char *address, int port, int num_sockets = 1,
+                size_t window = 1 << 22)
+      : is_server(address == nullptr), window(window) {
+    assert(num_sockets > 0 && window >= 2 * kMaxFrame);
+    for (int i = 0; i < num_sockets; i++) {
+      sockets.emplace_back(new Socket());
+      sockets[i]->fd = net_connect(address, port + i);
+    }
+    for (int i = 0; i < num_sockets; i++) {
+      readers.emplace_back(&MuxConnection::read_frames, this, i);
+    }
+  }
+
+  // Both parties have to close the connection: each reader exits once the
+  // peer has shut down its side.
+  ~MuxConnection() {
+    for (auto &s : sockets) shutdown(s->fd, SHUT_WR);
+    for (auto &t : readers) t.join();
+    for (auto &s : sockets) {
+      close(s->fd);
+      delete s;
+    }
+  }
+
+  int num_sockets() const { return sockets.size(); }
+
+  void set_nodelay(bool nodelay) {
+    const int flag = nodelay;
+    for (auto &s : sockets)
+      setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  }
+
+  // Sends the concatenation of iov[0, iovcnt) on channel c.
+  void send(int c, const struct iovec *iov, int iovcnt) {
+    Channel &ch = channel(c);
+    Socket &s = *sockets[c % sockets.size()];
+    for (int i = 0; i < iovcnt; i++) {
+      const char *data = (const char *)iov[i].iov_base;
+      size_t len = iov[i].iov_len;
+      while (len > 0) {
+        size_t n = std::min(len, kMaxFrame);
+        {
+          std::unique_lock<std::mutex> lk(ch.mtx);
+          ch.cv.wait(lk, [&] { return ch.credit >= n || closed; });
+          if (ch.credit < n) {
+            errno = EPIPE;
+            net_error("error: net_send_data");
+          }
+          ch.credit -= n;
+        }
+        write_frame(s, c, n, data);
+        data += n;
+        len -= n;
+      }
+    }
+  }
+
+  void recv(int c, void *data, size_t len) {
+    Channel &ch = channel(c);
+    std::unique_lock<std::mutex> lk(ch.mtx);
+    size_t got = 0;
+    while (got < len) {
+      ch.cv.wait(lk, [&] { return !ch.frames.empty() || closed; });
+      if (ch.frames.empty())
+        net_closed("error: net_recv_data");
+      std::vector<char> &frame = ch.frames.front();
+      size_t n = std::min(len - got, frame.size() - ch.frame_pos);
+      memcpy((char *)data + got, frame.data() + ch.frame_pos, n);
+      got += n;
+      ch.frame_pos += n;
+      if (ch.frame_pos == frame.size()) {
+        ch.frames.pop_front();
+        ch.frame_pos = 0;
+      }
+      ch.consumed += n;
+      if (ch.consumed >= window / 2) {
+        size_t credit = ch.consumed;
+        ch.consumed = 0;
+        lk.unlock();
+        write_frame(*sockets[c % sockets.size()], c, credit | kCreditFlag,
+                    nullptr);
+        lk.lock();
+      }
+    }
+  }
+
+private:
+  static constexpr size_t kMaxFrame = 1 << 18;
+  static constexpr uint64_t kCreditFlag = 1ULL << 63;
+
+  struct Socket {
+    int fd = -1;
+    std::mutex send_mtx;
+  };
+
+  struct Channel {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::vector<char>> frames;
+    size_t frame_pos = 0;
+    size_t consumed = 0;
+    size_t credit = 0;
+  };
+
+  struct FrameHeader {
+    uint32_t channel;
+    uint64_t len;  // payload bytes, or returned credit with kCreditFlag
+  } __attribute__((packed));
+
+  size_t window;
+  std::vector<Socket *> sockets;
+  std::vector<std::thread> readers;
+  // A deque keeps the channels in place while it grows.
+  std::deque<Channel> channels;
+  std::mutex channels_mtx;
+  std::atomic<bool> closed{false};
+
+  Channel &channel(int c) {
+    std::lock_guard<std::mutex> lk(channels_mtx);
+    while ((int)channels.size() <= c) {
+      channels.emplace_back();
+      channels.back().credit = window;
+    }
+    return channels[c];
+  }
+
+  void write_frame(Socket &s, int c, uint64_t len, const char *data) {
+    FrameHeader hdr{(uint32_t)c, len};
+    struct iovec iov[2];
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = const_cast<char *>(data);
+    iov[1].iov_len = (len & kCreditFlag) ? 0 : len;
+    struct iovec *cur = iov;
+    int cnt = 2;
+    size_t left = iov[0].iov_len + iov[1].iov_len;
+    std::lock_guard<std::mutex> lk(s.send_mtx);
+    while (left > 0) {
+      ssize_t res = writev(s.fd, cur, cnt);
+      if (res < 0 && errno == EINTR)
+        continue;
+      if (res < 0)
+        net_error("error: net_send_data");
+      left -= res;
+      while (cnt > 0 && (size_t)res >= cur->iov_len) {
+        res -= cur->iov_len;
+        cur++;
+        cnt--;
+      }
+      if (cnt > 0) {
+        cur->iov_base = (char *)cur->iov_base + res;
+        cur->iov_len -= res;
+      }
+    }
+  }
+
+  static bool read_full(int fd, void *data, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+      ssize_t res = ::recv(fd, (char *)data + got, len - got, 0);
+      if (res < 0 && errno == EINTR)
+        continue;
+      if (res <= 0)
+        return false;
+      got += res;
+    }
+    return true;
+  }
+
+  void read_frames(int i) {
+    int fd = sockets[i]->fd;
+    FrameHeader hdr;
+    while (read_full(fd, &hdr, sizeof(hdr))) {
+      Channel &ch = channel(hdr.channel);
+      if (hdr.len & kCreditFlag) {
+        std::lock_guard<std::mutex> lk(ch.mtx);
+        ch.credit += hdr.len & ~kCreditFlag;
+        ch.cv.notify_all();
+        continue;
+      }
+      std::vector<char> frame(hdr.len);
+      if (!read_full(fd, frame.data(), hdr.len))
+        break;
+      std::lock_guard<std::mutex> lk(ch.mtx);
+      ch.frames.push_back(std::move(frame));
+      ch.cv.notify_all();
+    }
+    // The peer is gone: wake up whoever still waits on it.
+    std::lock_guard<std::mutex> lk(channels_mtx);
+    closed = true;
+    for (auto &ch : channels) {
+      std::lock_guard<std::mutex> chl(ch.mtx);
+      ch.cv.notify_all();
+    }
+  }
+};
+/**@}*/
+
+} // namespace sci
+#endif // NET_MUX_H__
@@ -0,0 +1,302 @@
+#ifndef SHM_IO_CHANNEL_H__
+#define SHM_IO_CHANNEL_H__
+
+#include "utils/io_channel.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <errno.h>
+#include <iostream>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <fcntl.h>
+#include <immintrin.h>
+#include <linux/futex.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sci {
+/** @addtogroup IO
+  @{
+ */
+
+// Connects two processes on the same host through a POSIX shared memory
+// segment named after the port, holding one single-producer single-consumer
+// ring per direction. Data is copied straight into the peer's ring, so no
+// kernel copies are involved. A party waiting on the other side spins
+// briefly and then sleeps on a futex in the segment.
+//
+// The interface mirrors NetIO: the server (address == nullptr) creates the
+// segment and waits for the client, the client retries until it appears.
+class ShmIO : public IOChannel<ShmIO> {
+public:
+  bool is_server;
+  int port;
+  uint64_t num_rounds = 0;
+  LastCall last_call = LastCall::None;
+
+  ShmIO(const char *address, int port, bool quiet = false,
+        size_t ring_size = 1 << 22) {
+    this->port = port;
+    is_server = (address == nullptr);
+    std::string name = "/sci_shm_" + std::to_string(port);
+    if (is_server)
+      create(name, ring_size);
+    else
+      attach(name);
+    Ring *rings[2] = {ring(0), ring(1)};
+    out = rings[is_server ? 0 : 1];
+    in = rings[is_server ? 1 : 0];
+    if (!quiet)
+      std::cout << "connected\n";
+  }
+
+  ~ShmIO() {
+    flush();
+    munmap(segment, segment_size);
+  }
+
+  void sync() {
+    int tmp = 0;
+    if (is_server) {
+      send_data_internal(&tmp, 1);
+      recv_data_internal(&tmp, 1);
+    } else {
+      recv_data_internal(&tmp, 1);
+      send_data_internal(&tmp, 1);
+      flush();
+    }
+  }
+
+  void set_nodelay() {}
+
+  void set_delay() {}
+
+  void flush() {
+    if (tail == published)
+      return;
+    out->tail.store(tail, std::memory_order_release);
+    wake(out->tail_seq, out->reader_waiting);
+    published = tail;
+  }
+
+  void send_data_internal(const void *data, size_t len) {
+    if (last_call != LastCall::Send) {
+      num_rounds++;
+      last_call = LastCall::Send;
+    }
+    const char *src = (const char *)data;
+    while (len > 0) {
+      uint64_t head = out->head.load(std::memory_order_acquire);
+      if (tail - head == capacity) {
+        flush();
+        wait(out->head_seq, out->writer_waiting,
+             [&] { return tail - out->head.load() < capacity; });
+        continue;
+      }
+      size_t n = std::min<size_t>(len, capacity - (tail - head));
+      copy_in(out, tail, src, n);
+      tail += n;
+      src += n;
+      len -= n;
+    }
+    if (tail - published >= kPublishBatch)
+      flush();
+  }
+
+  void recv_data_internal(void *data, size_t len) {
+    if (last_call != LastCall::Recv) {
+      num_rounds++;
+      last_call = LastCall::Recv;
+    }
+    flush();
+    char *dst = (char *)data;
+    while (len > 0) {
+      uint64_t in_tail = in->tail.load(std::memory_order_acquire);
+      if (in_tail == head) {
+        wait(in->tail_seq, in->reader_waiting,
+             [&] { return in->tail.load() != head; });
+        continue;
+      }
+      size_t n = std::min<size_t>(len, in_tail - head);
+      copy_out(in, head, dst, n);
+      head += n;
+      in->head.store(head, std::memory_order_release);
+      wake(in->head_seq, in->writer_waiting);
+      dst += n;
+      len -= n;
+    }
+  }
+
+private:
+  // Positions count bytes since the start and never wrap; the ring index is
+  // position % capacity. Producer and consumer fields sit on separate cache
+  // lines.
+  struct Ring {
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> tail_seq;
+    std::atomic<uint32_t> reader_waiting;
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> head_seq;
+    std::atomic<uint32_t> writer_waiting;
+  };
+
+  struct Header {
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> attached;
+    pid_t server_pid;
+    pid_t client_pid;
+    uint64_t capacity;
+  };
+
+  static constexpr size_t kHeaderSize = 4096;
+  static constexpr int kSpins = 1 << 8;
+  // Sends become visible to the peer in batches of this many bytes, or
+  // earlier on flush() and before a receive.
+  static constexpr uint64_t kPublishBatch = 1 << 12;
+
+  char *segment = nullptr;
+  size_t segment_size = 0;
+  uint64_t capacity = 0;
+  Ring *out = nullptr;
+  Ring *in = nullptr;
+  uint64_t tail = 0;      // written to out
+  uint64_t published = 0; // visible to the peer
+  uint64_t head = 0;      // read from in
+  pid_t peer_pid = 0;
+
+  Header *header() { return (Header *)segment; }
+
+  Ring *ring(int i) {
+    return (Ring *)(segment + kHeaderSize + i * (sizeof(Ring) + capacity));
+  }
+
+  char *ring_data(Ring *r) { return (char *)r + sizeof(Ring); }
+
+  void map(int fd) {
+    segment = (char *)mmap(nullptr, segment_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+      perror("error: shm mmap");
+      exit(1);
+    }
+  }
+
+  // The name is unlinked once the client has mapped the segment, so nothing
+  // is left behind in /dev/shm.
+  void create(const std::string &name, size_t ring_size) {
+    assert(ring_size % 64 == 0);
+    capacity = ring_size;
+    segment_size = kHeaderSize + 2 * (sizeof(Ring) + capacity);
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, segment_size) < 0) {
+      perror("error: shm_open");
+      exit(1);
+    }
+    map(fd);
+    // ftruncate zero-fills, which is the initial state of the rings.
+    header()->server_pid = getpid();
+    header()->capacity = capacity;
+    header()->ready.store(1, std::memory_order_release);
+    wait_until([&] { return header()->attached.load() != 0; });
+    shm_unlink(name.c_str());
+    peer_pid = header()->client_pid;
+  }
+
+  void attach(const std::string &name) {
+    while (true) {
+      int fd = shm_open(name.c_str(), O_RDWR, 0600);
+      struct stat st;
+      if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size > kHeaderSize) {
+        segment_size = st.st_size;
+        map(fd);
+        // Skip segments left behind by a server that is gone.
+        if (header()->ready.load(std::memory_order_acquire) &&
+            kill(header()->server_pid, 0) == 0)
+          break;
+        munmap(segment, segment_size);
+      } else if (fd >= 0) {
+        close(fd);
+      }
+      usleep(1000);
+    }
+    capacity = header()->capacity;
+    peer_pid = header()->server_pid;
+    header()->client_pid = getpid();
+    header()->attached.store(1, std::memory_order_release);
+  }
+
+  void copy_in(Ring *r, uint64_t pos, const char *src, size_t n) {
+    size_t idx = pos % capacity;
+    size_t first = std::min<size_t>(n, capacity - idx);
+    memcpy(ring_data(r) + idx, src, first);
+    memcpy(ring_data(r), src + first, n - first);
+  }
+
+  void copy_out(Ring *r, uint64_t pos, char *dst, size_t n) {
+    size_t idx = pos % capacity;
+    size_t first = std::min<size_t>(n, capacity - idx);
+    memcpy(dst, ring_data(r) + idx, first);
+    memcpy(dst + first, ring_data(r), n - first);
+  }
+
+  static void futex(std::atomic<uint32_t> &word, int op, uint32_t val,
+                    const struct timespec *timeout = nullptr) {
+    syscall(SYS_futex, (uint32_t *)&word, op, val, timeout, nullptr, 0);
+  }
+
+  template <typename Ready> static void wait_until(Ready ready) {
+    while (!ready())
+      usleep(1000);
+  }
+
+  // Called after publishing a new position. The fence pairs with the one in
+  // wait(): either the waiter sees the new position, or we see its flag, and
+  // then bumping seq makes its futex wait return.
+  static void wake(std::atomic<uint32_t> &seq,
+                   std::atomic<uint32_t> &waiting) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed) && waiting.exchange(0)) {
+      seq.fetch_add(1);
+      futex(seq, FUTEX_WAKE, INT32_MAX);
+    }
+  }
+
+  // Checks once a second that the peer is still there.
+  template <typename Ready>
+  void wait(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting,
+            Ready ready) {
+    const struct timespec timeout = {1, 0};
+    for (int i = 0; i < kSpins; i++) {
+      if (ready())
+        return;
+      _mm_pause();
+    }
+    while (true) {
+      uint32_t s = seq.load();
+      waiting.store(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready())
+        return;
+      futex(seq, FUTEX_WAIT, s, &timeout);
+      if (!ready() && kill(peer_pid, 0) != 0) {
+        fprintf(stderr, "error: shm channel: peer is gone\n");
+        exit(1);
+      }
+    }
+  }
+};
+/**@}*/
+
+} // namespace sci
+#endif // SHM_IO_CHANNEL_H__
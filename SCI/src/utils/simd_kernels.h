@@ -0,0 +1,543 @@
+#ifndef SCI_SIMD_KERNELS_H__
+#define SCI_SIMD_KERNELS_H__
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#define SCI_TARGET_AVX2 __attribute__((target("avx2")))
+#define SCI_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+// Local (communication-free) kernels of the ReLU and Millionaire protocols.
+// Each kernel has a scalar reference and AVX2/AVX-512 versions that are
+// selected at runtime from the CPU features. All versions give bit-identical
+// results.
+namespace sci {
+namespace kernels {
+
+enum class SIMDLevel { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+inline const char *simd_level_name(SIMDLevel level) {
+  switch (level) {
+    case SIMDLevel::AVX512:
+      return "avx512";
+    case SIMDLevel::AVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+inline bool simd_level_supported(SIMDLevel level) {
+#ifdef __x86_64__
+  switch (level) {
+    case SIMDLevel::AVX512:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw");
+    case SIMDLevel::AVX2:
+      return __builtin_cpu_supports("avx2");
+    default:
+      return true;
+  }
+#else
+  return level == SIMDLevel::Scalar;
+#endif
+}
+
+// Best level supported by the CPU. The environment variable SCI_SIMD
+// (scalar, avx2 or avx512) caps it.
+inline SIMDLevel simd_level() {
+  static const SIMDLevel level = [] {
+    SIMDLevel cap = SIMDLevel::AVX512;
+    if (const char *env = std::getenv("SCI_SIMD")) {
+      std::string s(env);
+      if (s == "scalar")
+        cap = SIMDLevel::Scalar;
+      else if (s == "avx2")
+        cap = SIMDLevel::AVX2;
+    }
+    for (int l = static_cast<int>(cap); l > 0; --l) {
+      if (simd_level_supported(static_cast<SIMDLevel>(l)))
+        return static_cast<SIMDLevel>(l);
+    }
+    return SIMDLevel::Scalar;
+  }();
+  return level;
+}
+
+/**************************************************************************
+ *                          Scalar reference
+ **************************************************************************/
+namespace scalar {
+
+// msb[i] = share[i] >> (l - 1)
+// cmp[i] = share[i] & cut_mask, or rhs - (share[i] & cut_mask) if negate
+template <typename T>
+inline void relu_prepare(uint8_t *msb, uint64_t *cmp, const T *share, int n,
+                         int l, T cut_mask, T rhs, bool negate) {
+  for (int i = 0; i < n; i++) {
+    msb[i] = (uint8_t)(share[i] >> (l - 1));
+    T x = share[i] & cut_mask;
+    cmp[i] = 0ULL + (negate ? (T)(rhs - x) : x);
+  }
+}
+
+// a[i] = (a[i] + b[i]) mod 2
+inline void add_mod2(uint8_t *a, const uint8_t *b, int n) {
+  for (int i = 0; i < n; i++) a[i] = (a[i] ^ b[i]) & 1;
+}
+
+// digits[i] = (data[i] >> shift) & mask
+inline void extract_digits(uint8_t *digits, const uint64_t *data, int n,
+                           int shift, uint8_t mask) {
+  for (int i = 0; i < n; i++) digits[i] = (uint8_t)(data[i] >> shift) & mask;
+}
+
+// Row i of out (at out + i * stride) gets the N leaf OT messages of digits[i]:
+// ((digit > k) ^ mask_cmp[i]) for k < N, or (digit < k) if !greater_than.
+// If eq, each message is shifted left by one and carries
+// (digit == k) ^ mask_eq[i] in the LSB.
+inline void leaf_ot_messages(uint8_t *out, int stride, const uint8_t *digits,
+                             const uint8_t *mask_cmp, const uint8_t *mask_eq,
+                             int n, int N, bool greater_than, bool eq) {
+  for (int i = 0; i < n; i++) {
+    uint8_t *msg = out + (size_t)i * stride;
+    uint8_t digit = digits[i];
+    for (int k = 0; k < N; k++) {
+      msg[k] = (greater_than ? (digit > k) : (digit < k)) ^ mask_cmp[i];
+      if (eq) msg[k] = (msg[k] << 1) | ((digit == k) ^ mask_eq[i]);
+    }
+  }
+}
+
+// First step of num_ANDs Beaver ANDs on bit-packed triples:
+// ei = ai ^ pack(xi), fi = bi ^ pack(yi).
+inline void and_step_1(uint8_t *ei, uint8_t *fi, const uint8_t *xi,
+                       const uint8_t *yi, const uint8_t *ai, const uint8_t *bi,
+                       int num_ANDs) {
+  for (int i = 0; i < num_ANDs; i += 8) {
+    uint8_t x = 0, y = 0;
+    for (int k = 0; k < 8; k++) {
+      x |= (xi[i + k] != 0) << k;
+      y |= (yi[i + k] != 0) << k;
+    }
+    ei[i / 8] = ai[i / 8] ^ x;
+    fi[i / 8] = bi[i / 8] ^ y;
+  }
+}
+
+// Second step: zi = unpack([e & f] ^ (f & ai) ^ (e & bi) ^ ci), where the
+// bracketed term is only added by ALICE.
+inline void and_step_2(uint8_t *zi, const uint8_t *e, const uint8_t *f,
+                       const uint8_t *ai, const uint8_t *bi, const uint8_t *ci,
+                       int num_ANDs, bool alice) {
+  for (int i = 0; i < num_ANDs; i += 8) {
+    uint8_t z = alice ? (e[i / 8] & f[i / 8]) : 0;
+    z ^= (f[i / 8] & ai[i / 8]) ^ (e[i / 8] & bi[i / 8]) ^ ci[i / 8];
+    for (int k = 0; k < 8; k++) zi[i + k] = (z >> k) & 1;
+  }
+}
+
+}  // namespace scalar
+
+#ifdef __x86_64__
+/**************************************************************************
+ *                                AVX2
+ **************************************************************************/
+namespace avx2 {
+
+// The low bytes of the 16 uint64 lanes of a, b, c, d. Lanes must be < 256.
+SCI_TARGET_AVX2 inline __m128i pack_low_bytes(__m256i a, __m256i b, __m256i c,
+                                              __m256i d) {
+  const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  __m128i xa = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(a, idx));
+  __m128i xb = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(b, idx));
+  __m128i xc = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(c, idx));
+  __m128i xd = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(d, idx));
+  return _mm_packus_epi16(_mm_packus_epi32(xa, xb), _mm_packus_epi32(xc, xd));
+}
+
+template <typename T>
+SCI_TARGET_AVX2 inline void relu_prepare(uint8_t *msb, uint64_t *cmp,
+                                         const T *share, int n, int l,
+                                         T cut_mask, T rhs, bool negate) {
+  int i = 0;
+  if constexpr (std::is_same<T, uint64_t>::value) {
+    const __m128i cnt = _mm_cvtsi32_si128(l - 1);
+    const __m256i low = _mm256_set1_epi64x(0xFF);
+    const __m256i cut = _mm256_set1_epi64x(cut_mask);
+    const __m256i r = _mm256_set1_epi64x(rhs);
+    for (; i + 16 <= n; i += 16) {
+      __m256i v[4], m[4];
+      for (int k = 0; k < 4; k++) {
+        v[k] = _mm256_loadu_si256((const __m256i *)(share + i + 4 * k));
+        m[k] = _mm256_and_si256(_mm256_srl_epi64(v[k], cnt), low);
+        v[k] = _mm256_and_si256(v[k], cut);
+        if (negate) v[k] = _mm256_sub_epi64(r, v[k]);
+        _mm256_storeu_si256((__m256i *)(cmp + i + 4 * k), v[k]);
+      }
+      _mm_storeu_si128((__m128i *)(msb + i),
+                       pack_low_bytes(m[0], m[1], m[2], m[3]));
+    }
+  }
+  scalar::relu_prepare(msb + i, cmp + i, share + i, n - i, l, cut_mask, rhs,
+                       negate);
+}
+
+SCI_TARGET_AVX2 inline void add_mod2(uint8_t *a, const uint8_t *b, int n) {
+  const __m256i one = _mm256_set1_epi8(1);
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+    _mm256_storeu_si256((__m256i *)(a + i),
+                        _mm256_and_si256(_mm256_xor_si256(x, y), one));
+  }
+  scalar::add_mod2(a + i, b + i, n - i);
+}
+
+SCI_TARGET_AVX2 inline void extract_digits(uint8_t *digits,
+                                           const uint64_t *data, int n,
+                                           int shift, uint8_t mask) {
+  const __m128i cnt = _mm_cvtsi32_si128(shift);
+  const __m256i vmask = _mm256_set1_epi64x(mask);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i v[4];
+    for (int k = 0; k < 4; k++) {
+      v[k] = _mm256_loadu_si256((const __m256i *)(data + i + 4 * k));
+      v[k] = _mm256_and_si256(_mm256_srl_epi64(v[k], cnt), vmask);
+    }
+    _mm_storeu_si128((__m128i *)(digits + i),
+                     pack_low_bytes(v[0], v[1], v[2], v[3]));
+  }
+  scalar::extract_digits(digits + i, data + i, n - i, shift, mask);
+}
+
+// Leaf messages of the 32 (digit, k) pairs in d and k.
+SCI_TARGET_AVX2 inline __m256i leaf_messages(__m256i d, __m256i k, __m256i mc,
+                                             __m256i me, bool greater_than,
+                                             bool eq) {
+  const __m256i one = _mm256_set1_epi8(1);
+  // d > k iff min(d, k) != d, and d < k iff max(d, k) != d
+  __m256i ext = greater_than ? _mm256_min_epu8(d, k) : _mm256_max_epu8(d, k);
+  __m256i cmp = _mm256_andnot_si256(_mm256_cmpeq_epi8(ext, d), one);
+  cmp = _mm256_xor_si256(cmp, mc);
+  if (!eq) return cmp;
+  __m256i e = _mm256_and_si256(_mm256_cmpeq_epi8(d, k), one);
+  return _mm256_or_si256(_mm256_add_epi8(cmp, cmp), _mm256_xor_si256(e, me));
+}
+
+SCI_TARGET_AVX2 inline void leaf_ot_messages(uint8_t *out, int stride,
+                                             const uint8_t *digits,
+                                             const uint8_t *mask_cmp,
+                                             const uint8_t *mask_eq, int n,
+                                             int N, bool greater_than,
+                                             bool eq) {
+  const __m256i iota =
+      _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                       16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
+                       30, 31);
+  int i = 0;
+  if (N == 16) {
+    // Two rows per register
+    const __m256i k = _mm256_permute2x128_si256(iota, iota, 0x00);
+    for (; i + 2 <= n; i += 2) {
+      __m256i d = _mm256_setr_m128i(_mm_set1_epi8(digits[i]),
+                                    _mm_set1_epi8(digits[i + 1]));
+      __m256i mc = _mm256_setr_m128i(_mm_set1_epi8(mask_cmp[i]),
+                                     _mm_set1_epi8(mask_cmp[i + 1]));
+      __m256i me = eq ? _mm256_setr_m128i(_mm_set1_epi8(mask_eq[i]),
+                                          _mm_set1_epi8(mask_eq[i + 1]))
+                      : _mm256_setzero_si256();
+      __m256i msg = leaf_messages(d, k, mc, me, greater_than, eq);
+      _mm_storeu_si128((__m128i *)(out + (size_t)i * stride),
+                       _mm256_castsi256_si128(msg));
+      _mm_storeu_si128((__m128i *)(out + (size_t)(i + 1) * stride),
+                       _mm256_extracti128_si256(msg, 1));
+    }
+  } else if (N % 32 == 0) {
+    for (; i < n; i++) {
+      __m256i d = _mm256_set1_epi8(digits[i]);
+      __m256i mc = _mm256_set1_epi8(mask_cmp[i]);
+      __m256i me = eq ? _mm256_set1_epi8(mask_eq[i]) : _mm256_setzero_si256();
+      for (int k0 = 0; k0 < N; k0 += 32) {
+        __m256i k = _mm256_add_epi8(iota, _mm256_set1_epi8(k0));
+        _mm256_storeu_si256(
+            (__m256i *)(out + (size_t)i * stride + k0),
+            leaf_messages(d, k, mc, me, greater_than, eq));
+      }
+    }
+  }
+  scalar::leaf_ot_messages(out + (size_t)i * stride, stride, digits + i,
+                           mask_cmp + i, eq ? mask_eq + i : nullptr, n - i, N,
+                           greater_than, eq);
+}
+
+SCI_TARGET_AVX2 inline void and_step_1(uint8_t *ei, uint8_t *fi,
+                                       const uint8_t *xi, const uint8_t *yi,
+                                       const uint8_t *ai, const uint8_t *bi,
+                                       int num_ANDs) {
+  const __m256i zero = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 32 <= num_ANDs; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(xi + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(yi + i));
+    uint32_t xb = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, zero));
+    uint32_t yb = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(y, zero));
+    uint32_t a, b;
+    std::memcpy(&a, ai + i / 8, 4);
+    std::memcpy(&b, bi + i / 8, 4);
+    a ^= xb;
+    b ^= yb;
+    std::memcpy(ei + i / 8, &a, 4);
+    std::memcpy(fi + i / 8, &b, 4);
+  }
+  scalar::and_step_1(ei + i / 8, fi + i / 8, xi + i, yi + i, ai + i / 8,
+                     bi + i / 8, num_ANDs - i);
+}
+
+SCI_TARGET_AVX2 inline void and_step_2(uint8_t *zi, const uint8_t *e,
+                                       const uint8_t *f, const uint8_t *ai,
+                                       const uint8_t *bi, const uint8_t *ci,
+                                       int num_ANDs, bool alice) {
+  // Byte k of the output takes bit (k % 8) of source byte (k / 8)
+  const __m256i spread =
+      _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2,
+                       2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i bits = _mm256_set1_epi64x(0x8040201008040201ULL);
+  const __m256i one = _mm256_set1_epi8(1);
+  int i = 0;
+  for (; i + 32 <= num_ANDs; i += 32) {
+    uint32_t ev, fv, av, bv, cv;
+    std::memcpy(&ev, e + i / 8, 4);
+    std::memcpy(&fv, f + i / 8, 4);
+    std::memcpy(&av, ai + i / 8, 4);
+    std::memcpy(&bv, bi + i / 8, 4);
+    std::memcpy(&cv, ci + i / 8, 4);
+    uint32_t z = (alice ? (ev & fv) : 0) ^ (fv & av) ^ (ev & bv) ^ cv;
+    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(z), spread);
+    v = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(v, bits), bits),
+                         one);
+    _mm256_storeu_si256((__m256i *)(zi + i), v);
+  }
+  scalar::and_step_2(zi + i, e + i / 8, f + i / 8, ai + i / 8, bi + i / 8,
+                     ci + i / 8, num_ANDs - i, alice);
+}
+
+}  // namespace avx2
+
+/**************************************************************************
+ *                               AVX-512
+ **************************************************************************/
+namespace avx512 {
+
+template <typename T>
+SCI_TARGET_AVX512 inline void relu_prepare(uint8_t *msb, uint64_t *cmp,
+                                           const T *share, int n, int l,
+                                           T cut_mask, T rhs, bool negate) {
+  int i = 0;
+  if constexpr (std::is_same<T, uint64_t>::value) {
+    const __m128i cnt = _mm_cvtsi32_si128(l - 1);
+    const __m512i cut = _mm512_set1_epi64(cut_mask);
+    const __m512i r = _mm512_set1_epi64(rhs);
+    for (; i + 8 <= n; i += 8) {
+      __m512i v = _mm512_loadu_si512((const void *)(share + i));
+      _mm_storel_epi64((__m128i *)(msb + i),
+                       _mm512_cvtepi64_epi8(_mm512_srl_epi64(v, cnt)));
+      v = _mm512_and_si512(v, cut);
+      if (negate) v = _mm512_sub_epi64(r, v);
+      _mm512_storeu_si512((void *)(cmp + i), v);
+    }
+  }
+  scalar::relu_prepare(msb + i, cmp + i, share + i, n - i, l, cut_mask, rhs,
+                       negate);
+}
+
+SCI_TARGET_AVX512 inline void add_mod2(uint8_t *a, const uint8_t *b, int n) {
+  const __m512i one = _mm512_set1_epi8(1);
+  int i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(a + i));
+    __m512i y = _mm512_loadu_si512((const void *)(b + i));
+    _mm512_storeu_si512((void *)(a + i),
+                        _mm512_and_si512(_mm512_xor_si512(x, y), one));
+  }
+  avx2::add_mod2(a + i, b + i, n - i);
+}
+
+SCI_TARGET_AVX512 inline void extract_digits(uint8_t *digits,
+                                             const uint64_t *data, int n,
+                                             int shift, uint8_t mask) {
+  const __m128i cnt = _mm_cvtsi32_si128(shift);
+  const __m512i vmask = _mm512_set1_epi64(mask);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i v = _mm512_loadu_si512((const void *)(data + i));
+    v = _mm512_and_si512(_mm512_srl_epi64(v, cnt), vmask);
+    _mm_storel_epi64((__m128i *)(digits + i), _mm512_cvtepi64_epi8(v));
+  }
+  scalar::extract_digits(digits + i, data + i, n - i, shift, mask);
+}
+
+// Byte r of p[0..3] repeated over the r-th 128-bit lane
+SCI_TARGET_AVX512 inline __m512i spread_rows(const uint8_t *p) {
+  const __m512i rows = _mm512_set_epi32(
+      0x03030303, 0x03030303, 0x03030303, 0x03030303, 0x02020202, 0x02020202,
+      0x02020202, 0x02020202, 0x01010101, 0x01010101, 0x01010101, 0x01010101,
+      0, 0, 0, 0);
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return _mm512_shuffle_epi8(_mm512_set1_epi32(v), rows);
+}
+
+SCI_TARGET_AVX512 inline void leaf_ot_messages(uint8_t *out, int stride,
+                                               const uint8_t *digits,
+                                               const uint8_t *mask_cmp,
+                                               const uint8_t *mask_eq, int n,
+                                               int N, bool greater_than,
+                                               bool eq) {
+  if (N != 16) {
+    avx2::leaf_ot_messages(out, stride, digits, mask_cmp, mask_eq, n, N,
+                           greater_than, eq);
+    return;
+  }
+  // Four rows per register
+  const __m512i k = _mm512_broadcast_i32x4(
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  const __m512i one = _mm512_set1_epi8(1);
+  alignas(64) uint8_t buf[64];
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m512i d = spread_rows(digits + i);
+    __m512i ext = greater_than ? _mm512_min_epu8(d, k) : _mm512_max_epu8(d, k);
+    __m512i msg = _mm512_xor_si512(
+        _mm512_maskz_mov_epi8(~_mm512_cmpeq_epi8_mask(ext, d), one),
+        spread_rows(mask_cmp + i));
+    if (eq) {
+      __m512i e = _mm512_xor_si512(
+          _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(d, k), one),
+          spread_rows(mask_eq + i));
+      msg = _mm512_or_si512(_mm512_add_epi8(msg, msg), e);
+    }
+    if (stride == 16) {
+      _mm512_storeu_si512((void *)(out + (size_t)i * stride), msg);
+    } else {
+      _mm512_store_si512((void *)buf, msg);
+      for (int r = 0; r < 4; r++)
+        std::memcpy(out + (size_t)(i + r) * stride, buf + 16 * r, 16);
+    }
+  }
+  avx2::leaf_ot_messages(out + (size_t)i * stride, stride, digits + i,
+                         mask_cmp + i, eq ? mask_eq + i : nullptr, n - i, N,
+                         greater_than, eq);
+}
+
+SCI_TARGET_AVX512 inline void and_step_1(uint8_t *ei, uint8_t *fi,
+                                         const uint8_t *xi, const uint8_t *yi,
+                                         const uint8_t *ai, const uint8_t *bi,
+                                         int num_ANDs) {
+  int i = 0;
+  for (; i + 64 <= num_ANDs; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(xi + i));
+    __m512i y = _mm512_loadu_si512((const void *)(yi + i));
+    uint64_t xb = _mm512_test_epi8_mask(x, x);
+    uint64_t yb = _mm512_test_epi8_mask(y, y);
+    uint64_t a, b;
+    std::memcpy(&a, ai + i / 8, 8);
+    std::memcpy(&b, bi + i / 8, 8);
+    a ^= xb;
+    b ^= yb;
+    std::memcpy(ei + i / 8, &a, 8);
+    std::memcpy(fi + i / 8, &b, 8);
+  }
+  avx2::and_step_1(ei + i / 8, fi + i / 8, xi + i, yi + i, ai + i / 8,
+                   bi + i / 8, num_ANDs - i);
+}
+
+SCI_TARGET_AVX512 inline void and_step_2(uint8_t *zi, const uint8_t *e,
+                                         const uint8_t *f, const uint8_t *ai,
+                                         const uint8_t *bi, const uint8_t *ci,
+                                         int num_ANDs, bool alice) {
+  const __m512i one = _mm512_set1_epi8(1);
+  int i = 0;
+  for (; i + 64 <= num_ANDs; i += 64) {
+    uint64_t ev, fv, av, bv, cv;
+    std::memcpy(&ev, e + i / 8, 8);
+    std::memcpy(&fv, f + i / 8, 8);
+    std::memcpy(&av, ai + i / 8, 8);
+    std::memcpy(&bv, bi + i / 8, 8);
+    std::memcpy(&cv, ci + i / 8, 8);
+    uint64_t z = (alice ? (ev & fv) : 0) ^ (fv & av) ^ (ev & bv) ^ cv;
+    _mm512_storeu_si512((void *)(zi + i), _mm512_maskz_mov_epi8(z, one));
+  }
+  avx2::and_step_2(zi + i, e + i / 8, f + i / 8, ai + i / 8, bi + i / 8,
+                   ci + i / 8, num_ANDs - i, alice);
+}
+
+}  // namespace avx512
+#endif  // __x86_64__
+
+/**************************************************************************
+ *                              Dispatch
+ **************************************************************************/
+#ifdef __x86_64__
+#define SCI_KERNEL_DISPATCH(fn, ...)             \
+  switch (simd_level()) {                        \
+    case SIMDLevel::AVX512:                      \
+      return avx512::fn(__VA_ARGS__);            \
+    case SIMDLevel::AVX2:                        \
+      return avx2::fn(__VA_ARGS__);              \
+    default:                                     \
+      return scalar::fn(__VA_ARGS__);            \
+  }
+#else
+#define SCI_KERNEL_DISPATCH(fn, ...) return scalar::fn(__VA_ARGS__);
+#endif
+
+template <typename T>
+inline void relu_prepare(uint8_t *msb, uint64_t *cmp, const T *share, int n,
+                         int l, T cut_mask, T rhs, bool negate) {
+  SCI_KERNEL_DISPATCH(relu_prepare, msb, cmp, share, n, l, cut_mask, rhs,
+                      negate);
+}
+
+inline void add_mod2(uint8_t *a, const uint8_t *b, int n) {
+  SCI_KERNEL_DISPATCH(add_mod2, a, b, n);
+}
+
+inline void extract_digits(uint8_t *digits, const uint64_t *data, int n,
+                           int shift, uint8_t mask) {
+  SCI_KERNEL_DISPATCH(extract_digits, digits, data, n, shift, mask);
+}
+
+inline void leaf_ot_messages(uint8_t *out, int stride, const uint8_t *digits,
+                             const uint8_t *mask_cmp, const uint8_t *mask_eq,
+                             int n, int N, bool greater_than, bool eq) {
+  SCI_KERNEL_DISPATCH(leaf_ot_messages, out, stride, digits, mask_cmp, mask_eq,
+                      n, N, greater_than, eq);
+}
+
+inline void and_step_1(uint8_t *ei, uint8_t *fi, const uint8_t *xi,
+                       const uint8_t *yi, const uint8_t *ai, const uint8_t *bi,
+                       int num_ANDs) {
+  SCI_KERNEL_DISPATCH(and_step_1, ei, fi, xi, yi, ai, bi, num_ANDs);
+}
+
+inline void and_step_2(uint8_t *zi, const uint8_t *e, const uint8_t *f,
+                       const uint8_t *ai, const uint8_t *bi, const uint8_t *ci,
+                       int num_ANDs, bool alice) {
+  SCI_KERNEL_DISPATCH(and_step_2, zi, e, f, ai, bi, ci, num_ANDs, alice);
+}
+
+#undef SCI_KERNEL_DISPATCH
+
+}  // namespace kernels
+}  // namespace sci
+
+#endif  // SCI_SIMD_KERNELS_H__
@@ -20,6 +20,8 @@ SOFTWARE.
 */
 
 #include "NonLinear/argmax.h"
+#include <algorithm>
+#include <vector>
 
 using namespace std;
 using namespace sci;
@@ -30,6 +32,7 @@ int num_threads = 1;
 int port = 32000;
 string address = "127.0.0.1";
 int num_argmax = 1000;
+int top_k = 1;
 
 int main(int argc, char **argv) {
   ArgMapping amap;
@@ -37,12 +40,18 @@ int main(int argc, char **argv) {
   amap.arg("p", port, "Port Number");
   amap.arg("l", bitlength, "Bitlength of inputs");
   amap.arg("N", num_argmax, "Number of elements");
+  amap.arg("k", top_k, "Number of largest elements (top-k)");
   amap.arg("ip", address, "IP Address of server (ALICE)");
 
   amap.parse(argc, argv);
 
   NetIO *io = new NetIO(party == ALICE ? nullptr : "127.0.0.1", port);
-  uint64_t magnitude_bound = (1 << (bitlength - 3));
+  // The inputs are the sums of two shares in (-magnitude_bound,
+  // magnitude_bound). Arg max needs the differences of the inputs in l bits,
+  // i.e., the inputs in (-2^(l-2), 2^(l-2)). Top-k also pushes each winner
+  // down by 2^(l-2) (val -= 2^(l-2) * onehot), which needs the inputs in
+  // [-2^(l-3), 2^(l-3)).
+  uint64_t magnitude_bound = 1ULL << (bitlength - (top_k > 1 ? 4 : 3));
   uint64_t mask_l = -1ULL;
   if (bitlength != 64) {
     mask_l = (1ULL << bitlength) - 1ULL;
@@ -58,16 +67,17 @@ int main(int argc, char **argv) {
   input_share2 = new uint64_t[num_argmax];
   input_share_sign = new uint8_t[num_argmax];
 
-  uint64_t *argmax_output_protocol = new uint64_t[1];
-  uint64_t *argmax_output_protocol_share_other = new uint64_t[1];
-  uint64_t *argmax_output_protocol_arg = new uint64_t[1];
-  uint64_t *argmax_output_protocol_share_other_arg = new uint64_t[1];
+  uint64_t *argmax_output_protocol = new uint64_t[top_k];
+  uint64_t *argmax_output_protocol_share_other = new uint64_t[top_k];
+  uint64_t *argmax_output_protocol_arg = new uint64_t[top_k];
+  uint64_t *argmax_output_protocol_share_other_arg = new uint64_t[top_k];
   uint64_t *argmax_output_actual = new uint64_t[1];
   switch (party) {
   case ALICE: {
     prg.random_data(input_share_uncorrected, sizeof(uint64_t) * num_argmax);
     prg.random_data(input_share_sign, num_argmax);
     uint64_t comm_start = io->counter;
+    uint64_t rounds_start = io->num_rounds;
     auto start = clock_start();
     for (int i = 0; i < num_argmax; i++) {
       input_share_uncorrected[i] %= magnitude_bound;
@@ -79,9 +89,15 @@ int main(int argc, char **argv) {
         input_share1[i] = input_share_uncorrected[i];
       }
     }
-    argmax_oracle.ArgMaxMPC(num_argmax, input_share1,
-                            argmax_output_protocol_arg, true,
+    if (top_k > 1) {
+      argmax_oracle.TopKMPC(1, num_argmax, top_k, input_share1,
+                            argmax_output_protocol_arg,
                             argmax_output_protocol);
+    } else {
+      argmax_oracle.ArgMaxMPC(num_argmax, input_share1,
+                              argmax_output_protocol_arg, true,
+                              argmax_output_protocol);
+    }
 
     long long t = time_from(start);
     uint64_t comm_end = io->counter;
@@ -90,10 +106,13 @@ int main(int argc, char **argv) {
     cout << "ALICE communication\t" << BLUE
          << ((double)(comm_end - comm_start) * 8) / (bitlength * num_argmax)
          << "*" << bitlength << " bits/ArgMax" << RESET << endl;
+    cout << "ALICE rounds\t" << BLUE << (io->num_rounds - rounds_start)
+         << RESET << endl;
     std::cout << "ALICE: Done MaxPool protocol execution" << std::endl;
     io->recv_data(input_share2, sizeof(uint64_t) * num_argmax);
-    io->recv_data(argmax_output_protocol_share_other, sizeof(uint64_t) * 1);
-    io->recv_data(argmax_output_protocol_share_other_arg, sizeof(uint64_t) * 1);
+    io->recv_data(argmax_output_protocol_share_other, sizeof(uint64_t) * top_k);
+    io->recv_data(argmax_output_protocol_share_other_arg,
+                  sizeof(uint64_t) * top_k);
 
     cout << "Checking correctness of ArgMax now..." << endl;
     argmax_output_protocol[0] =
@@ -122,6 +141,33 @@ int main(int argc, char **argv) {
 
     assert(argmax_output_actual[0] == argmax_output_protocol[0] &&
            "ArgMax output is incorrect");
+    assert(((input_share1[argmax_output_protocol_arg[0]] -
+             argmax_output_protocol[0]) & mask_l) == 0 &&
+           "ArgMax index is incorrect");
+
+    if (top_k > 1) {
+      // The k largest elements in decreasing order, at distinct indices
+      vector<int64_t> sorted_input(num_argmax);
+      for (int i = 0; i < num_argmax; i++) {
+        sorted_input[i] = signed_val(input_share1[i], bitlength);
+      }
+      sort(sorted_input.rbegin(), sorted_input.rend());
+      vector<bool> picked(num_argmax, false);
+      picked[argmax_output_protocol_arg[0]] = true;
+      for (int j = 1; j < top_k; j++) {
+        uint64_t val = (argmax_output_protocol[j] +
+                        argmax_output_protocol_share_other[j]) &
+                       mask_l;
+        uint64_t arg = (argmax_output_protocol_arg[j] +
+                        argmax_output_protocol_share_other_arg[j]) &
+                       mask_l;
+        assert(signed_val(val, bitlength) == sorted_input[j] &&
+               arg < (uint64_t)num_argmax && !picked[arg] &&
+               ((input_share1[arg] - val) & mask_l) == 0 &&
+               "Top-k output is incorrect");
+        picked[arg] = true;
+      }
+    }
 
     cout << "ArgMax answer is: " << GREEN << "CORRECT!" << RESET << endl;
     break;
@@ -142,9 +188,15 @@ int main(int argc, char **argv) {
         input_share2[i] = input_share_uncorrected[i];
       }
     }
-    argmax_oracle.ArgMaxMPC(num_argmax, input_share2,
-                            argmax_output_protocol_arg, true,
+    if (top_k > 1) {
+      argmax_oracle.TopKMPC(1, num_argmax, top_k, input_share2,
+                            argmax_output_protocol_arg,
                             argmax_output_protocol);
+    } else {
+      argmax_oracle.ArgMaxMPC(num_argmax, input_share2,
+                              argmax_output_protocol_arg, true,
+                              argmax_output_protocol);
+    }
 
     uint64_t comm_end = io->counter;
     cout << "BOB communication\t" << BLUE
@@ -153,8 +205,8 @@ int main(int argc, char **argv) {
 
     std::cout << "BOB: Done MaxPool protocol execution" << std::endl;
     io->send_data(input_share2, sizeof(uint64_t) * num_argmax);
-    io->send_data(argmax_output_protocol, sizeof(uint64_t) * 1);
-    io->send_data(argmax_output_protocol_arg, sizeof(uint64_t) * 1);
+    io->send_data(argmax_output_protocol, sizeof(uint64_t) * top_k);
+    io->send_data(argmax_output_protocol_arg, sizeof(uint64_t) * top_k);
     break;
   }
   }
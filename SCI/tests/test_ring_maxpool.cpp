@@ -67,6 +67,79 @@ void ring_maxpool_thread(int tid, uint64_t *z, uint64_t *x, int lnum_rows, int l
   return;
 }
 
+// Signed value of an l-bit ring element
+int64_t signed_val(uint64_t x, uint64_t mask_l) {
+  x &= mask_l;
+  return x >= (1ULL << (l - 1)) ? (int64_t)(x - mask_l - 1) : (int64_t)x;
+}
+
+// Checks funcMaxPool2D on num_planes secret-shared imgH x imgW planes of
+// signed values against the cleartext max over the zero-padded windows.
+void test_maxpool2d(MaxPoolProtocol<NetIO, uint64_t> *maxpool_oracle,
+                    int num_planes, int imgH, int imgW, int ksizeH, int ksizeW,
+                    int zPadHLeft, int zPadHRight, int zPadWLeft,
+                    int zPadWRight, int strideH, int strideW) {
+  uint64_t mask_l = (l == 64) ? -1 : (1ULL << l) - 1;
+  uint64_t bound_l = 1ULL << (l - 3);
+  int outH = (imgH + zPadHLeft + zPadHRight - ksizeH) / strideH + 1;
+  int outW = (imgW + zPadWLeft + zPadWRight - ksizeW) / strideW + 1;
+  int num_in = num_planes * imgH * imgW;
+  int num_out = num_planes * outH * outW;
+
+  PRG128 prg;
+  std::vector<uint64_t> x(num_in), z(num_out);
+  prg.random_data(x.data(), sizeof(uint64_t) * num_in);
+  if (party == sci::ALICE) {
+    for (auto &v : x) v &= mask_l;
+    ioArr[0]->send_data(x.data(), sizeof(uint64_t) * num_in);
+  } else {
+    std::vector<uint64_t> x_alice(num_in);
+    ioArr[0]->recv_data(x_alice.data(), sizeof(uint64_t) * num_in);
+    for (int i = 0; i < num_in; i++) {
+      x[i] = ((x[i] % (2 * bound_l)) - bound_l - x_alice[i]) & mask_l;
+    }
+  }
+
+  maxpool_oracle->funcMaxPool2D(num_planes, imgH, imgW, ksizeH, ksizeW,
+                                zPadHLeft, zPadHRight, zPadWLeft, zPadWRight,
+                                strideH, strideW, x.data(), z.data());
+
+  if (party == sci::ALICE) {
+    ioArr[0]->send_data(x.data(), sizeof(uint64_t) * num_in);
+    ioArr[0]->send_data(z.data(), sizeof(uint64_t) * num_out);
+    return;
+  }
+  std::vector<uint64_t> xi(num_in), zi(num_out);
+  ioArr[0]->recv_data(xi.data(), sizeof(uint64_t) * num_in);
+  ioArr[0]->recv_data(zi.data(), sizeof(uint64_t) * num_out);
+  for (int c = 0; c < num_planes; c++) {
+    for (int oh = 0; oh < outH; oh++) {
+      for (int ow = 0; ow < outW; ow++) {
+        int64_t expected = INT64_MIN;
+        for (int fh = 0; fh < ksizeH; fh++) {
+          for (int fw = 0; fw < ksizeW; fw++) {
+            int h = oh * strideH + fh - zPadHLeft;
+            int w = ow * strideW + fw - zPadWLeft;
+            int64_t v = 0;
+            if (h >= 0 && h < imgH && w >= 0 && w < imgW) {
+              int idx = (c * imgH + h) * imgW + w;
+              v = signed_val(xi[idx] + x[idx], mask_l);
+            }
+            expected = std::max(expected, v);
+          }
+        }
+        int idx = (c * outH + oh) * outW + ow;
+        if (signed_val(zi[idx] + z[idx], mask_l) != expected) {
+          assert(0 && "MaxPool2D output is incorrect");
+        }
+      }
+    }
+  }
+  cout << "MaxPool2D " << ksizeH << "x" << ksizeW << " stride " << strideH
+       << "x" << strideW << " pad (" << zPadHLeft << " " << zPadHRight << " "
+       << zPadWLeft << " " << zPadWRight << ") Tests Passed" << endl;
+}
+
 int main(int argc, char **argv) {
   /************* Argument Parsing  ************/
   /********************************************/
@@ -122,6 +195,20 @@ int main(int argc, char **argv) {
   }
   std::cout << "All Base OTs Done" << std::endl;
 
+  // Secret-share signed values in [-2^(l-3), 2^(l-3)), so that the pairwise
+  // differences taken by the tournament do not wrap around
+  uint64_t bound_l = 1ULL << (l - 3);
+  if (party == sci::ALICE) {
+    ioArr[0]->send_data(x, sizeof(uint64_t) * num_rows * num_cols);
+  } else {
+    uint64_t *x_alice = new uint64_t[num_rows * num_cols];
+    ioArr[0]->recv_data(x_alice, sizeof(uint64_t) * num_rows * num_cols);
+    for (int i = 0; i < num_rows * num_cols; i++) {
+      x[i] = ((x[i] % (2 * bound_l)) - bound_l - x_alice[i]) & mask_l;
+    }
+    delete[] x_alice;
+  }
+
   /************** Fork Threads ****************/
   /********************************************/
 
@@ -171,7 +258,9 @@ int main(int argc, char **argv) {
 
       uint64_t maxpool_output = xi[i * num_cols];
       for (int c = 1; c < num_cols; c++) {
-        maxpool_output = ((maxpool_output - xi[i * num_cols + c]) & mask_l) >= (1ULL << (l - 1)) ? xi[i * num_cols + c] : maxpool_output;
+        uint64_t cur = xi[i * num_cols + c];
+        assert(((cur + bound_l) & mask_l) < 2 * bound_l);
+        maxpool_output = ((maxpool_output - cur) & mask_l) >= (1ULL << (l - 1)) ? cur : maxpool_output;
       }
 
       if (zi[i] != maxpool_output) {
@@ -187,6 +276,26 @@ int main(int argc, char **argv) {
   delete[] x;
   delete[] z;
 
+  /*********** Overlapping Windows ************/
+  /********************************************/
+
+  // Overlapping windows share the comparisons of the range maxima
+  typedef MaxPoolProtocol<NetIO, uint64_t> MaxPool;
+  assert(MaxPool::sliding_max_cmps(16, 7, 1) < 10 * 6);
+  assert(MaxPool::sliding_max_cmps(16, 3, 1) <= 14 * 2);
+  assert(MaxPool::sliding_max_cmps(16, 3, 3) == 5 * 2);
+
+  MaxPool *maxpool_oracle =
+      new MaxPool(party, RING, ioArr[0], l, b, 0, otpackArr[0]);
+  test_maxpool2d(maxpool_oracle, 3, 9, 10, 3, 3, 0, 0, 0, 0, 1, 1);
+  test_maxpool2d(maxpool_oracle, 3, 9, 10, 3, 3, 0, 0, 0, 0, 2, 2);
+  test_maxpool2d(maxpool_oracle, 3, 9, 10, 3, 3, 1, 1, 1, 1, 1, 1);
+  test_maxpool2d(maxpool_oracle, 3, 9, 10, 3, 3, 0, 1, 0, 1, 2, 2);
+  test_maxpool2d(maxpool_oracle, 2, 8, 8, 2, 2, 0, 0, 0, 0, 2, 2);
+  test_maxpool2d(maxpool_oracle, 2, 3, 16, 1, 7, 0, 0, 0, 0, 1, 1);
+  test_maxpool2d(maxpool_oracle, 2, 7, 7, 5, 5, 2, 2, 2, 2, 1, 1);
+  delete maxpool_oracle;
+
   cout << "Number of Maxpool rows (num_cols=" << num_cols << ")/s:\t"
        << (double(num_rows) / t) * 1e6 << std::endl;
   cout << "Maxpool Time (l=" << l << "; b=" << b << ")\t" << t << " mus"
@@ -0,0 +1,156 @@
+#include "utils/emp-tool.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace sci;
+using namespace std;
+
+int party, port = 32000;
+string address = "127.0.0.1";
+size_t total_bytes = 1ULL << 28;
+int pingpongs = 10000;
+int mux_channels = 4;
+
+double elapsed_us(chrono::high_resolution_clock::time_point start) {
+  return chrono::duration<double, micro>(chrono::high_resolution_clock::now() -
+                                         start)
+      .count();
+}
+
+// ALICE streams total_bytes in messages of msg_size bytes, BOB checks them.
+// The closing acknowledgement makes ALICE's clock cover the delivery.
+template <typename IO>
+double stream(IO *io, size_t msg_size) {
+  size_t num_msgs = max<size_t>(1, total_bytes / msg_size);
+  vector<uint8_t> msg(msg_size);
+  uint8_t ack = 0;
+  io->sync();
+  auto start = chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < num_msgs; i++) {
+    if (party == ALICE) {
+      msg[0] = msg[msg_size - 1] = uint8_t(i);
+      io->send_data(msg.data(), msg_size);
+    } else {
+      io->recv_data(msg.data(), msg_size);
+      assert(msg[0] == uint8_t(i) && msg[msg_size - 1] == uint8_t(i));
+    }
+  }
+  if (party == ALICE) {
+    io->recv_data(&ack, 1);
+  } else {
+    io->send_data(&ack, 1);
+    io->flush();
+  }
+  return (num_msgs * msg_size) / elapsed_us(start);
+}
+
+// Round trips of one 8-byte message each way.
+template <typename IO>
+double pingpong(IO *io) {
+  uint64_t x = 0;
+  io->sync();
+  auto start = chrono::high_resolution_clock::now();
+  for (int i = 0; i < pingpongs; i++) {
+    if (party == ALICE) {
+      io->send_data(&x, sizeof(x));
+      io->recv_data(&x, sizeof(x));
+    } else {
+      io->recv_data(&x, sizeof(x));
+      x++;
+      io->send_data(&x, sizeof(x));
+      io->flush();
+    }
+  }
+  if (party == ALICE) assert(x == uint64_t(pingpongs));
+  return elapsed_us(start) / pingpongs;
+}
+
+// ALICE generates batches of batch_size random bytes and sends each one, as
+// a protocol computing and sending its messages would; BOB receives them.
+template <typename IO>
+double compute_and_send(IO *io, size_t batch_size) {
+  size_t num_batches = max<size_t>(1, total_bytes / batch_size / 4);
+  vector<uint8_t> batch(batch_size);
+  uint8_t ack = 0;
+  PRG128 prg;
+  io->sync();
+  auto start = chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < num_batches; i++) {
+    if (party == ALICE) {
+      prg.random_data(batch.data(), batch_size);
+      io->send_data(batch.data(), batch_size);
+    } else {
+      io->recv_data(batch.data(), batch_size);
+    }
+  }
+  if (party == ALICE) {
+    io->recv_data(&ack, 1);
+  } else {
+    io->send_data(&ack, 1);
+    io->flush();
+  }
+  return (num_batches * batch_size) / elapsed_us(start);
+}
+
+template <typename IO> void bench(const string &name, IO *io) {
+  for (size_t msg_size : {8, 64, 1 << 10, 1 << 14, 1 << 17, 1 << 20, 1 << 24}) {
+    double mbps = stream(io, msg_size);
+    cout << name << "\tmsg " << msg_size << " B\t" << mbps << " MB/s" << endl;
+  }
+  for (size_t batch_size : {1 << 14, 1 << 20}) {
+    double mbps = compute_and_send(io, batch_size);
+    cout << name << "\tcompute+send " << batch_size << " B\t" << mbps
+         << " MB/s" << endl;
+  }
+  cout << name << "\tround trip\t" << pingpong(io) << " us" << endl;
+  delete io;
+}
+
+// Every channel of one MuxConnection streams on its own thread, so the frames
+// of all of them interleave on the shared sockets; stream() checks that each
+// channel still gets its own messages in order.
+void bench_mux(MuxConnection *mux) {
+  vector<double> mbps(mux_channels);
+  vector<thread> threads;
+  size_t saved_total = total_bytes;
+  total_bytes = max<size_t>(1, total_bytes / mux_channels);
+  for (int c = 0; c < mux_channels; c++) {
+    threads.emplace_back([&, c] {
+      NetIO io(mux, c);
+      mbps[c] = stream(&io, 1 << 14);
+    });
+  }
+  for (auto &t : threads) t.join();
+  total_bytes = saved_total;
+  double sum = 0;
+  for (double x : mbps) sum += x;
+  cout << "MuxConnection	" << mux_channels << " channels over "
+       << mux->num_sockets() << " sockets	" << sum << " MB/s" << endl;
+  delete mux;
+}
+
+int main(int argc, char **argv) {
+  ArgMapping amap;
+  amap.arg("r", party, "Role of party: ALICE = 1; BOB = 2");
+  amap.arg("p", port, "Port Number");
+  amap.arg("ip", address, "IP Address of server (ALICE)");
+  amap.arg("N", pingpongs, "Number of round trips");
+  amap.arg("nt", mux_channels, "Channels on the MuxConnection (0 skips it)");
+  amap.parse(argc, argv);
+
+  const char *server = party == ALICE ? nullptr : address.c_str();
+  bench("NetIO", new NetIO(server, port, true));
+  NetIO *async_io = new NetIO(server, port + 1, true);
+  async_io->start_async_send();
+  bench("NetIO async", async_io);
+  bench("StdioNetIO", new StdioNetIO(server, port + 2, true));
+  bench("ShmIO", new ShmIO(server, port + 3, true));
+  if (mux_channels > 0) {
+    MuxConnection *mux = new MuxConnection(server, port + 4, 2);
+    bench("NetIO mux", new NetIO(mux, 0));
+    bench_mux(mux);
+  }
+  cout << "NetIO Tests Passed" << endl;
+}
@@ -20,6 +20,7 @@ SOFTWARE.
 */
 
 #include "Math/math-functions.h"
+#include "NonLinear/relu-ring.h"
 #include <fstream>
 #include <iostream>
 #include <thread>
@@ -37,6 +38,8 @@ bool six_comparison = true;
 int dim = 1ULL << 16;
 int bw_x = 32;
 int s_x = 28;
+// Truncate the ReLU outputs by sf bits with the fused relu_truncate
+int sf = 0;
 
 uint64_t mask_x = (bw_x == 64 ? -1 : ((1ULL << bw_x) - 1));
 
@@ -50,7 +53,13 @@ void relu_thread(int tid, uint64_t *x, uint64_t *y, int num_ops, uint64_t six) {
   } else {
     math = new MathFunctions(party, ioArr[tid], otpackArr[tid]);
   }
-  math->ReLU(num_ops, x, y, bw_x, six);
+  if (sf > 0) {
+    ReLURingProtocol<NetIO, uint64_t> relu(math->party, RING, ioArr[tid], bw_x,
+                                           MILL_PARAM, otpackArr[tid]);
+    relu.relu_truncate(y, x, num_ops, sf);
+  } else {
+    math->ReLU(num_ops, x, y, bw_x, six);
+  }
 
   delete math;
 }
@@ -64,6 +73,7 @@ int main(int argc, char **argv) {
   amap.arg("N", dim, "Number of ReLU operations");
   amap.arg("nt", num_threads, "Number of threads");
   amap.arg("six", six_comparison, "ReLU6?");
+  amap.arg("sf", sf, "Truncate the ReLU outputs by sf bits (no ReLU6)");
   amap.arg("ip", address, "IP Address of server (ALICE)");
 
   amap.parse(argc, argv);
@@ -95,7 +105,7 @@ int main(int argc, char **argv) {
     x[i] &= mask_x;
   }
   uint64_t six;
-  if (six_comparison)
+  if (six_comparison && sf == 0)
     six = (6ULL << s_x);
   else
     six = 0;
@@ -153,11 +163,21 @@ int main(int argc, char **argv) {
         if (X > int64_t(six))
           expectedY = six;
       }
+      expectedY >>= sf;
       // cout << X << "\t" << Y << "\t" << expectedY << endl;
-      assert(Y == expectedY);
+      if (sf > 0 && !ReLURingProtocol<NetIO, uint64_t>::kExactTruncation) {
+        // The approximate truncation may be off by one
+        assert(std::abs(Y - expectedY) <= 1);
+      } else {
+        assert(Y == expectedY);
+      }
     }
 
-    cout << "ReLU" << (six == 0 ? "" : "6") << " Tests Passed" << endl;
+    cout << "ReLU" << (six == 0 ? "" : "6");
+    if (sf > 0) {
+      cout << " with truncation by " << sf << " bits";
+    }
+    cout << " Tests Passed" << endl;
 
     delete[] x0;
     delete[] y0;
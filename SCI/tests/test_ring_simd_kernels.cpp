@@ -0,0 +1,189 @@
+#include "utils/emp-tool.h"
+#include "utils/simd_kernels.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace sci;
+using namespace sci::kernels;
+using namespace std;
+
+int dim = 1 << 20;
+int reps = 20;
+int bitlength = 37;
+int radix_base = 4;
+
+// Runs fn(level) on every supported level, checks that out matches the scalar
+// result after each run and prints the time per call.
+template <typename Fn>
+void bench(const string &name, Fn fn, const vector<uint8_t *> &out,
+           const vector<size_t> &out_bytes) {
+  vector<vector<uint8_t>> expected(out.size());
+  double scalar_time = 0;
+  for (int lvl = 0; lvl <= static_cast<int>(SIMDLevel::AVX512); lvl++) {
+    SIMDLevel level = static_cast<SIMDLevel>(lvl);
+    if (!simd_level_supported(level)) continue;
+    fn(level);  // warm up
+    auto start = chrono::high_resolution_clock::now();
+    for (int r = 0; r < reps; r++) fn(level);
+    double t = chrono::duration<double, micro>(
+                   chrono::high_resolution_clock::now() - start)
+                   .count() /
+               reps;
+
+    for (size_t j = 0; j < out.size(); j++) {
+      if (level == SIMDLevel::Scalar) {
+        expected[j].assign(out[j], out[j] + out_bytes[j]);
+      } else {
+        assert(memcmp(expected[j].data(), out[j], out_bytes[j]) == 0 &&
+               "SIMD kernel does not match the scalar reference");
+      }
+    }
+    if (level == SIMDLevel::Scalar) scalar_time = t;
+    cout << name << "\t" << simd_level_name(level) << "\t" << t << " us\t"
+         << scalar_time / t << "x" << endl;
+  }
+}
+
+int main(int argc, char **argv) {
+  ArgMapping amap;
+  amap.arg("N", dim, "Number of elements");
+  amap.arg("reps", reps, "Repetitions per kernel");
+  amap.arg("l", bitlength, "Bitlength of ReLU inputs");
+  amap.arg("beta", radix_base, "Radix of the Millionaire leaves");
+  amap.parse(argc, argv);
+  assert(dim % 8 == 0);
+
+  cout << "Dispatched SIMD level: " << simd_level_name(simd_level()) << endl;
+
+  PRG128 prg;
+  uint64_t mask_l = (bitlength == 64 ? -1 : ((1ULL << bitlength) - 1));
+  uint64_t cut_mask = (1ULL << (bitlength - 1)) - 1;
+  int N = 1 << radix_base;
+
+  vector<uint64_t> share(dim), cmp(dim), data(dim);
+  vector<uint8_t> msb(dim), wrap(dim), digits(dim), mask_cmp(dim),
+      mask_eq(dim), leaf(size_t(dim) * N), xi(dim), yi(dim), zi(dim),
+      ei(dim / 8), fi(dim / 8), e(dim / 8), f(dim / 8), ai(dim / 8),
+      bi(dim / 8), ci(dim / 8);
+  prg.random_data(share.data(), dim * sizeof(uint64_t));
+  prg.random_data(data.data(), dim * sizeof(uint64_t));
+  for (int i = 0; i < dim; i++) share[i] &= mask_l;
+  prg.random_bool((bool *)wrap.data(), dim);
+  prg.random_bool((bool *)mask_cmp.data(), dim);
+  prg.random_bool((bool *)mask_eq.data(), dim);
+  prg.random_bool((bool *)xi.data(), dim);
+  prg.random_bool((bool *)yi.data(), dim);
+  for (auto *v : {&e, &f, &ai, &bi, &ci}) prg.random_data(v->data(), dim / 8);
+  extract_digits(digits.data(), data.data(), dim, 0, N - 1);
+
+  bench(
+      "relu_prepare",
+      [&](SIMDLevel level) {
+        switch (level) {
+          case SIMDLevel::AVX512:
+            return avx512::relu_prepare<uint64_t>(msb.data(), cmp.data(),
+                                                  share.data(), dim, bitlength,
+                                                  cut_mask, cut_mask, true);
+          case SIMDLevel::AVX2:
+            return avx2::relu_prepare<uint64_t>(msb.data(), cmp.data(),
+                                                share.data(), dim, bitlength,
+                                                cut_mask, cut_mask, true);
+          default:
+            return scalar::relu_prepare<uint64_t>(msb.data(), cmp.data(),
+                                                  share.data(), dim, bitlength,
+                                                  cut_mask, cut_mask, true);
+        }
+      },
+      {msb.data(), (uint8_t *)cmp.data()},
+      {size_t(dim), dim * sizeof(uint64_t)});
+
+  vector<uint8_t> msb_copy(msb);
+  bench(
+      "add_mod2",
+      [&](SIMDLevel level) {
+        memcpy(msb.data(), msb_copy.data(), dim);
+        switch (level) {
+          case SIMDLevel::AVX512:
+            return avx512::add_mod2(msb.data(), wrap.data(), dim);
+          case SIMDLevel::AVX2:
+            return avx2::add_mod2(msb.data(), wrap.data(), dim);
+          default:
+            return scalar::add_mod2(msb.data(), wrap.data(), dim);
+        }
+      },
+      {msb.data()}, {size_t(dim)});
+
+  bench(
+      "extract_digits",
+      [&](SIMDLevel level) {
+        switch (level) {
+          case SIMDLevel::AVX512:
+            return avx512::extract_digits(digits.data(), data.data(), dim,
+                                          radix_base, N - 1);
+          case SIMDLevel::AVX2:
+            return avx2::extract_digits(digits.data(), data.data(), dim,
+                                        radix_base, N - 1);
+          default:
+            return scalar::extract_digits(digits.data(), data.data(), dim,
+                                          radix_base, N - 1);
+        }
+      },
+      {digits.data()}, {size_t(dim)});
+
+  bench(
+      "leaf_ot_messages",
+      [&](SIMDLevel level) {
+        switch (level) {
+          case SIMDLevel::AVX512:
+            return avx512::leaf_ot_messages(leaf.data(), N, digits.data(),
+                                            mask_cmp.data(), mask_eq.data(),
+                                            dim, N, true, true);
+          case SIMDLevel::AVX2:
+            return avx2::leaf_ot_messages(leaf.data(), N, digits.data(),
+                                          mask_cmp.data(), mask_eq.data(), dim,
+                                          N, true, true);
+          default:
+            return scalar::leaf_ot_messages(leaf.data(), N, digits.data(),
+                                            mask_cmp.data(), mask_eq.data(),
+                                            dim, N, true, true);
+        }
+      },
+      {leaf.data()}, {leaf.size()});
+
+  bench(
+      "and_step_1",
+      [&](SIMDLevel level) {
+        switch (level) {
+          case SIMDLevel::AVX512:
+            return avx512::and_step_1(ei.data(), fi.data(), xi.data(),
+                                      yi.data(), ai.data(), bi.data(), dim);
+          case SIMDLevel::AVX2:
+            return avx2::and_step_1(ei.data(), fi.data(), xi.data(), yi.data(),
+                                    ai.data(), bi.data(), dim);
+          default:
+            return scalar::and_step_1(ei.data(), fi.data(), xi.data(),
+                                      yi.data(), ai.data(), bi.data(), dim);
+        }
+      },
+      {ei.data(), fi.data()}, {size_t(dim / 8), size_t(dim / 8)});
+
+  bench(
+      "and_step_2",
+      [&](SIMDLevel level) {
+        switch (level) {
+          case SIMDLevel::AVX512:
+            return avx512::and_step_2(zi.data(), e.data(), f.data(), ai.data(),
+                                      bi.data(), ci.data(), dim, true);
+          case SIMDLevel::AVX2:
+            return avx2::and_step_2(zi.data(), e.data(), f.data(), ai.data(),
+                                    bi.data(), ci.data(), dim, true);
+          default:
+            return scalar::and_step_2(zi.data(), e.data(), f.data(), ai.data(),
+                                      bi.data(), ci.data(), dim, true);
+        }
+      },
+      {zi.data()}, {size_t(dim)});
+
+  cout << "SIMD Kernel Tests Passed" << endl;
+}
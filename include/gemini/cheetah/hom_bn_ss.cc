@@ -11,6 +11,7 @@
 #include "gemini/core/util/ThreadPool.h"
 #include "gemini/core/util/math.h"
 #include "gemini/core/util/timer.h"
+#include "gemini/core/util/work_stealing.h"
 
 namespace gemini {
 
@@ -30,34 +31,6 @@ void truncate_for_decryption(seal::Ciphertext &ct,
                              const seal::Evaluator &evaluator,
                              const seal::SEALContext &context);
 
-static Code LaunchWorks(
-    ThreadPool &tpool, size_t num_works,
-    std::function<Code(long wid, size_t start, size_t end)> program) {
-  if (num_works == 0) return Code::OK;
-  const long pool_sze = tpool.pool_size();
-  if (pool_sze <= 1L) {
-    return program(0, 0, num_works);
-  } else {
-    Code code;
-    std::vector<std::future<Code>> futures;
-    size_t work_load = (num_works + pool_sze - 1) / pool_sze;
-    for (long wid = 0; wid < pool_sze; ++wid) {
-      size_t start = wid * work_load;
-      size_t end = std::min(start + work_load, num_works);
-      futures.push_back(tpool.enqueue(program, wid, start, end));
-    }
-
-    code = Code::OK;
-    for (auto &&work : futures) {
-      Code c = work.get();
-      if (code == Code::OK && c != Code::OK) {
-        code = c;
-      }
-    }
-    return code;
-  }
-}
-
 TensorShape getSplitBN(const TensorShape &ishape, size_t N) {
   // NOTE(wen-jie) current implementation does not split along the C-axis
   int64_t n = static_cast<int64_t>(std::sqrt(N));
@@ -260,8 +233,8 @@ Code HomBNSS::encryptVector(
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, out.size(), encrypt_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, out.size(), encrypt_prg, 0, nthreads);
 
   /// Single thread version
   //  for (size_t i = 0; i < nCRT; ++i) {
@@ -319,8 +292,8 @@ Code HomBNSS::encodeVector(const Tensor<uint64_t> &in_vec, const Meta &meta,
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, out.size(), encode_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, out.size(), encode_prg, 0, nthreads);
 }
 
 Code HomBNSS::encodeScales(const Tensor<uint64_t> &scales, const Meta &meta,
@@ -370,21 +343,21 @@ Code HomBNSS::bn(const std::vector<seal::Ciphertext> &vec_share0,
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  (void)LaunchWorks(tpool, n_ct, bn_prg);
-  return addMask(out_share0, out_share1, meta, tpool);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  (void)LaunchWorks(*tpool, n_ct, bn_prg, 0, nthreads);
+  return addMask(out_share0, out_share1, meta, *tpool, nthreads);
 }
 
 Code HomBNSS::addMaskPrimeField(std::vector<seal::Ciphertext> &cts,
                                 Tensor<uint64_t> &mask, const Meta &meta,
-                                ThreadPool &tpool) const {
+                                ThreadPool &tpool, size_t nthreads) const {
   // TODO Not implemented yet.
   return Code::ERR_INTERNAL;
 }
 
 Code HomBNSS::addMaskRing(std::vector<seal::Ciphertext> &cts,
                           Tensor<uint64_t> &mask, const Meta &meta,
-                          ThreadPool &tpool) const {
+                          ThreadPool &tpool, size_t nthreads) const {
   TensorShape split_shape = getSplit(meta);
   const size_t nCRT = split_shape.dim_size(0);
   const size_t sub_vec_len = split_shape.dim_size(1);
@@ -448,16 +421,16 @@ Code HomBNSS::addMaskRing(std::vector<seal::Ciphertext> &cts,
     return Code::OK;
   };
 
-  return LaunchWorks(tpool, n_ct, mask_prg);
+  return LaunchWorks(tpool, n_ct, mask_prg, 0, nthreads);
 }
 
 Code HomBNSS::addMask(std::vector<seal::Ciphertext> &cts,
                       Tensor<uint64_t> &mask, const Meta &meta,
-                      ThreadPool &tpool) const {
+                      ThreadPool &tpool, size_t nthreads) const {
   if (IsTwoPower(target_base_mod_)) {
-    return addMaskRing(cts, mask, meta, tpool);
+    return addMaskRing(cts, mask, meta, tpool, nthreads);
   } else {
-    return addMaskPrimeField(cts, mask, meta, tpool);
+    return addMaskPrimeField(cts, mask, meta, tpool, nthreads);
   }
 }
 
@@ -510,8 +483,8 @@ Code HomBNSS::decryptToVector(const std::vector<seal::Ciphertext> &in_vec,
     seal::util::seal_memzero(pt.data(), pt.coeff_count() * sizeof(uint64_t));
     return Code::OK;
   };
-  ThreadPool tpool(nthreads);
-  (void)LaunchWorks(tpool, n_ct, decrypt_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  (void)LaunchWorks(*tpool, n_ct, decrypt_prg, 0, nthreads);
 
   auto kcontext = crt_context_->key_context_data();
   ENSURE_OR_RETURN(kcontext != nullptr, Code::ERR_INTERNAL);
@@ -638,8 +611,8 @@ Code HomBNSS::encodeTensor(const Tensor<uint64_t> &in_tensor, const Meta &meta,
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, n_pt, encode_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, n_pt, encode_prg, 0, nthreads);
 }
 
 Code HomBNSS::encryptTensor(
@@ -694,8 +667,8 @@ Code HomBNSS::encryptTensor(
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, n_pt, encrypt_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, n_pt, encrypt_prg, 0, nthreads);
 }
 
 Code HomBNSS::bn_direct(const std::vector<seal::Ciphertext> &tensor_share0,
@@ -812,16 +785,16 @@ Code HomBNSS::bn_direct(const std::vector<seal::Ciphertext> &tensor_share0,
   };
 
   Code code;
-  ThreadPool tpool(nthreads);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
   // Step 1: add over mod 2^k to reconstruct the encrypted shares
-  code = LaunchWorks(tpool, n_ct, add_prg);
+  code = LaunchWorks(*tpool, n_ct, add_prg, 0, nthreads);
   if (code != Code::OK) {
     LOG(WARNING) << CodeMessage(code);
     return Code::ERR_INTERNAL;
   }
 
   // Step 2: multiply with the weight
-  code = LaunchWorks(tpool, scales.length(), mul_prog);
+  code = LaunchWorks(*tpool, scales.length(), mul_prog, 0, nthreads);
   if (code != Code::OK) {
     LOG(WARNING) << CodeMessage(code);
     return Code::ERR_INTERNAL;
@@ -851,7 +824,7 @@ Code HomBNSS::bn_direct(const std::vector<seal::Ciphertext> &tensor_share0,
     return Code::ERR_INTERNAL;
   }
 
-  code = LaunchWorks(tpool, rnd.size(), mask_prog);
+  code = LaunchWorks(*tpool, rnd.size(), mask_prog, 0, nthreads);
   if (code != Code::OK) {
     LOG(WARNING) << CodeMessage(code);
     return Code::ERR_INTERNAL;
@@ -908,8 +881,8 @@ Code HomBNSS::decryptToTensor(const std::vector<seal::Ciphertext> &cts,
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, n_ct, decrypt_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, n_ct, decrypt_prg, 0, nthreads);
 }
 
 }  // namespace gemini
@@ -8,6 +8,7 @@
 
 #include "gemini/cheetah/tensor.h"
 #include "gemini/cheetah/tensor_shape.h"
+#include "gemini/core/util/seal.h"
 
 // Forward
 namespace seal {
@@ -27,7 +28,7 @@ class HomBNSS {
 #ifdef HOM_CONV2D_SS_MAX_THREADS
   static constexpr size_t kMaxThreads = HOM_CONV2D_SS_MAX_THREADS;
 #else
-  static constexpr size_t kMaxThreads = 16;
+  static constexpr size_t kMaxThreads = 0;  // no cap
 #endif
   static constexpr int64_t kStatBits = 40;  // statistical distance
 
@@ -57,6 +58,9 @@ class HomBNSS {
 
   uint64_t plain_modulus() const;
 
+  // Run the works on `pool` instead of spawning threads in every call.
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool) { tpool_ = pool; }
+
   Code encryptVector(const Tensor<uint64_t> &in_vec, const Meta &meta,
                      std::vector<seal::Serializable<seal::Ciphertext>> &out,
                      size_t nthreads = 1) const;
@@ -98,7 +102,9 @@ class HomBNSS {
                        size_t nthreads = 1) const;
 
   template <class IO, class CtVecType>
-  Code sendEncryptVector(IO *io, const CtVecType &ct, const Meta &meta) const {
+  Code sendEncryptVector(IO *io, const CtVecType &ct, const Meta &meta,
+                         const CtCompression &compr = CtCompression(),
+                         CtIOStats *stats = nullptr) const {
     TensorShape split_shape = getSplit(meta);
     const size_t nCRT = split_shape.dim_size(0);
     const size_t sub_vec_len = split_shape.dim_size(1);
@@ -115,13 +121,7 @@ class HomBNSS {
     for (size_t i = 0; i < nCRT; ++i) {
       for (size_t j = 0; j < n_sub_vecs; ++j) {
         size_t cid = i * n_sub_vecs + j;
-        std::stringstream os;
-        uint64_t ct_size;
-        ct.at(cid).save(os);
-        ct_size = os.tellp();
-        std::string ct_ser = os.str();
-        io->send_data(&ct_size, sizeof(uint64_t));
-        io->send_data(ct_ser.c_str(), ct_ser.size());
+        send_seal_object(io, ct.at(cid), compr, stats);
       }
     }
     return Code::OK;
@@ -129,7 +129,7 @@ class HomBNSS {
 
   template <class IO>
   Code recvEncryptVector(IO *io, std::vector<seal::Ciphertext> &ct,
-                         const Meta &meta) const {
+                         const Meta &meta, CtIOStats *stats = nullptr) const {
     TensorShape split_shape = getSplit(meta);
     const size_t nCRT = split_shape.dim_size(0);
     const size_t sub_vec_len = split_shape.dim_size(1);
@@ -148,18 +148,11 @@ class HomBNSS {
     for (size_t i = 0; i < nCRT; ++i) {
       for (size_t j = 0; j < n_sub_vecs; ++j) {
         size_t cid = i * n_sub_vecs + j;
-
-        std::stringstream is;
-        uint64_t ct_size;
-        io->recv_data(&ct_size, sizeof(uint64_t));
-        char *c_enc_result = new char[ct_size];
-        io->recv_data(c_enc_result, ct_size);
-        is.write(c_enc_result, ct_size);
-        ct.at(cid).unsafe_load(*contexts_[i], is);
+        recv_ciphertext(io, *contexts_[i], ct.at(cid), /*is_truncated*/ true,
+                        stats);
         if (!seal::is_valid_for(ct[cid], *contexts_[i])) {
           LOG(WARNING) << "bn recvEncryptVector invalid ciphertext";
         }
-        delete[] c_enc_result;
       }
     }
 
@@ -171,11 +164,11 @@ class HomBNSS {
 
   Code addMaskPrimeField(std::vector<seal::Ciphertext> &ct,
                          Tensor<uint64_t> &mask, const Meta &meta,
-                         ThreadPool &) const;
+                         ThreadPool &, size_t nthreads) const;
   Code addMaskRing(std::vector<seal::Ciphertext> &ct, Tensor<uint64_t> &mask,
-                   const Meta &meta, ThreadPool &) const;
+                   const Meta &meta, ThreadPool &, size_t nthreads) const;
   Code addMask(std::vector<seal::Ciphertext> &ct, Tensor<uint64_t> &mask,
-               const Meta &meta, ThreadPool &) const;
+               const Meta &meta, ThreadPool &, size_t nthreads) const;
 
   Code initPtx(seal::Plaintext &pt,
                seal::parms_id_type pid = seal::parms_id_zero) const;
@@ -203,6 +196,8 @@ class HomBNSS {
   std::vector<std::shared_ptr<seal::Evaluator>> evaluators_;
   std::vector<std::shared_ptr<seal::Encryptor>> encryptors_;
   std::vector<std::shared_ptr<seal::Encryptor>> pk_encryptors_;
+
+  std::shared_ptr<ThreadPool> tpool_{nullptr};
 };
 
 }  // namespace gemini
@@ -11,6 +11,7 @@
 #include "gemini/cheetah/tensor_encoder.h"
 #include "gemini/core/logging.h"
 #include "gemini/core/util/ThreadPool.h"
+#include "gemini/core/util/work_stealing.h"
 
 #define BFV_TRUNCATE_LARGE 1
 #define BFV_TRUNCATE_SMALL 1
@@ -28,34 +29,6 @@ static TensorShape GetConv2DOutShape(const HomConv2DSS::Meta &meta) {
   return *o;
 }
 
-static Code LaunchWorks(
-    ThreadPool &tpool, size_t num_works,
-    std::function<Code(long wid, size_t start, size_t end)> program) {
-  if (num_works == 0) return Code::OK;
-  const long pool_sze = tpool.pool_size();
-  if (pool_sze <= 1L) {
-    return program(0, 0, num_works);
-  } else {
-    Code code;
-    std::vector<std::future<Code>> futures;
-    size_t work_load = (num_works + pool_sze - 1) / pool_sze;
-    for (long wid = 0; wid < pool_sze; ++wid) {
-      size_t start = wid * work_load;
-      size_t end = std::min(start + work_load, num_works);
-      futures.push_back(tpool.enqueue(program, wid, start, end));
-    }
-
-    code = Code::OK;
-    for (auto &&work : futures) {
-      Code c = work.get();
-      if (code == Code::OK && c != Code::OK) {
-        code = c;
-      }
-    }
-    return code;
-  }
-}
-
 static inline uint64_t make_bits_mask(int n_low_zeros) {
   n_low_zeros = std::max(0, n_low_zeros);
   n_low_zeros = std::min(63, n_low_zeros);
@@ -508,7 +481,7 @@ Code HomConv2DSS::encryptImage(
                                         /*to_ntt*/ false, polys),
             "encryptImage");
 
-  ThreadPool tpool(std::min(std::max(1UL, nthreads), kMaxThreads));
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
   seal::Serializable<seal::Ciphertext> dummy = encryptor_->encrypt_zero();
   encrypted_img.resize(polys.size(), dummy);
   auto encrypt_program = [&](long wid, size_t start, size_t end) {
@@ -518,7 +491,7 @@ Code HomConv2DSS::encryptImage(
     return Code::OK;
   };
 
-  return LaunchWorks(tpool, polys.size(), encrypt_program);
+  return LaunchWorks(*tpool, polys.size(), encrypt_program, 0, nthreads);
 }
 
 Code HomConv2DSS::encodeImage(const Tensor<uint64_t> &img, const Meta &meta,
@@ -556,66 +529,41 @@ Code HomConv2DSS::encodeFilters(
     return Code::OK;
   };
 
-  ThreadPool tpool(std::min(std::max(1UL, nthreads), kMaxThreads));
-  return LaunchWorks(tpool, M, encode_program);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, M, encode_program, 0, nthreads);
 }
 
-size_t HomConv2DSS::conv2DOneFilter(const std::vector<seal::Ciphertext> &image,
-                                    const std::vector<seal::Plaintext> &filter,
-                                    const Meta &meta,
-                                    seal::Ciphertext *out_buff,
-                                    size_t out_buff_sze) const {
-  if (!evaluator_) {
-    LOG(WARNING) << "conv2DOneFilter: evaluator is absent";
-    return size_t(-1);
-  }
-
-  size_t nnz = std::accumulate(filter.cbegin(), filter.cend(), 0,
-                               [](size_t nnz, const seal::Plaintext &f) {
-                                 return nnz + (f.is_zero() ? 0 : 1);
-                               });
-  if (nnz == 0) {
-    LOG(WARNING) << "conv2DOneFilter: filter with all zero is not supported";
-    return size_t(-1);
-  }
-
-  const size_t out_size = image.size() / filter.size();
-  if (out_size < 1) {
-    return size_t(-1);
-  }
-
-  if (out_size > out_buff_sze || !out_buff) {
-    LOG(WARNING) << "conv2DOneFilter: require a larger out_buff";
-    return size_t(-1);
-  }
-
-  const size_t accum_cnt = filter.size();
-  for (size_t i = 0; i < out_size; ++i) {
-    out_buff[i].release();
-  }
-
-  for (size_t c = 0; c < accum_cnt; ++c) {
+Code HomConv2DSS::conv2DOneSlice(const std::vector<seal::Ciphertext> &image,
+                                 const std::vector<seal::Plaintext> &filter,
+                                 const Meta &meta, size_t sid,
+                                 seal::Ciphertext &out) const {
+  ENSURE_OR_RETURN(evaluator_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(!filter.empty(), Code::ERR_INVALID_ARG);
+  const size_t n_slices = image.size() / filter.size();
+  ENSURE_OR_RETURN(sid < n_slices, Code::ERR_OUT_BOUND);
+
+  out.release();
+  for (size_t c = 0; c < filter.size(); ++c) {
     // filter on the margin might be all-zero
     if (filter[c].is_zero()) {
       continue;
     }
 
-    for (size_t i = 0; i < out_size; ++i) {
-      size_t ii = c * out_size + i;
-      size_t o = ii % out_size;
-
-      if (out_buff[o].size() > 0) {
-        // TODO Use FMA. out_buf[o] += tensor[ii] * filter[c];
-        auto cpy_ct{image.at(ii)};
-        evaluator_->multiply_plain_inplace(cpy_ct, filter.at(c));
-        evaluator_->add_inplace(out_buff[o], cpy_ct);
-      } else {
-        evaluator_->multiply_plain(image.at(ii), filter.at(c), out_buff[o]);
-      }
+    const auto &ct = image.at(c * n_slices + sid);
+    if (out.size() > 0) {
+      auto cpy_ct{ct};
+      evaluator_->multiply_plain_inplace(cpy_ct, filter[c]);
+      evaluator_->add_inplace(out, cpy_ct);
+    } else {
+      evaluator_->multiply_plain(ct, filter[c], out);
     }
   }
 
-  return out_size;
+  if (out.size() == 0) {
+    LOG(WARNING) << "conv2DOneSlice: filter with all zero is not supported";
+    return Code::ERR_INVALID_ARG;
+  }
+  return Code::OK;
 }
 
 Code HomConv2DSS::conv2DSS(
@@ -664,10 +612,10 @@ Code HomConv2DSS::conv2DSS(
     return Code::OK;
   };
 
-  ThreadPool tpool(std::min(std::max(1UL, nthreads), kMaxThreads));
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
   if (meta.is_shared_input) {
     image.resize(img_share0.size(), seal::Ciphertext(tl_pool));
-    CHECK_ERR(LaunchWorks(tpool, image.size(), add_program), "add");
+    CHECK_ERR(LaunchWorks(*tpool, image.size(), add_program, 0, nthreads), "add");
   }
 
   const size_t N = poly_degree();
@@ -676,20 +624,20 @@ Code HomConv2DSS::conv2DSS(
   const size_t n_one_channel = indexer.slice_size(1) * indexer.slice_size(2);
   const size_t n_out_ct = meta.n_filters * n_one_channel;
   out_share0.resize(n_out_ct);
+  // One work per (filter, slice) so that the cores stay busy even when there
+  // are fewer filters than threads.
   auto conv_program = [&](long wid, size_t start, size_t end) {
-    for (size_t m = start; m < end; ++m) {
-      seal::Ciphertext *ct_start = &out_share0.at(m * n_one_channel);
-      size_t used = conv2DOneFilter(meta.is_shared_input ? image : img_share0,
-                                    filters[m], meta, ct_start, n_one_channel);
-      if (used == (size_t)-1 || used != n_one_channel) {
-        return Code::ERR_INTERNAL;
-      }
-    };
-
+    for (size_t w = start; w < end; ++w) {
+      const size_t m = w / n_one_channel;
+      const size_t sid = w % n_one_channel;
+      CHECK_ERR(conv2DOneSlice(meta.is_shared_input ? image : img_share0,
+                               filters[m], meta, sid, out_share0[w]),
+                "conv2DOneSlice");
+    }
     return Code::OK;
   };
 
-  CHECK_ERR(LaunchWorks(tpool, meta.n_filters, conv_program), "conv2D");
+  CHECK_ERR(LaunchWorks(*tpool, n_out_ct, conv_program, 0, nthreads), "conv2D");
 
   out_share1.Reshape(out_shape);
   addRandomMask(out_share0, out_share1, meta, nthreads);
@@ -702,7 +650,7 @@ Code HomConv2DSS::conv2DSS(
       return Code::OK;
     };
 
-    CHECK_ERR(LaunchWorks(tpool, out_share0.size(), truncate_program),
+    CHECK_ERR(LaunchWorks(*tpool, out_share0.size(), truncate_program, 0, nthreads),
               "conv2D");
   }
 
@@ -749,49 +697,41 @@ Code HomConv2DSS::addRandomMask(std::vector<seal::Ciphertext> &enc_tensor,
     return Code::ERR_INTERNAL;
   }
 
+  std::vector<OutSlice> slices;
+  CHECK_ERR(getOutSlices(meta, /*for_extract*/ false, slices), "getOutSlices");
+
   mask_tensor.Reshape(GetConv2DOutShape(meta));
+  // One work per ciphertext, i.e., per (filter, slice).
   auto mask_program = [&](long wid, size_t start, size_t end) {
     RLWEPt mask;
-    TensorShape slice_shape;
-    std::vector<size_t> targets;
     std::vector<U64> coeffs(poly_degree());
 
     auto prng =
         context_->first_context_data()->parms().random_generator()->create();
-    for (size_t m = start; m < end; ++m) {
-      size_t cid = m * n_one_channel;
-      for (int sh = 0, hoffset = 0; sh < indexer.slice_size(1); ++sh) {
-        for (int sw = 0, woffset = 0; sw < indexer.slice_size(2); ++sw) {
-          CHECK_ERR(indexer.Get({sh, sw}, slice_shape, targets), "Get");
-
-          if (slice_shape.height() * slice_shape.width() != targets.size()) {
-            return Code::ERR_DIM_MISMATCH;
-          }
-          auto &this_ct = enc_tensor.at(cid++);
-
-          flood_ciphertext(this_ct, prng, *context_, *pk_, *evaluator_);
-          CHECK_ERR(
-              sampleRandomMask(targets, coeffs.data(), coeffs.size(), mask,
-                               this_ct.parms_id(), prng, this_ct.is_ntt_form()),
-              "RandomMaskPoly");
-          internal::sub_poly_inplace(this_ct, mask, *context_, *evaluator_);
-
-          auto coeff_ptr = coeffs.data();
-          for (long h = 0; h < slice_shape.height(); ++h) {
-            for (long w = 0; w < slice_shape.width(); ++w) {
-              mask_tensor(m, hoffset + h, woffset + w) = *coeff_ptr++;
-            }
-          }
-          woffset += slice_shape.width();
+    for (size_t cid = start; cid < end; ++cid) {
+      const size_t m = cid / n_one_channel;
+      const auto &slice = slices[cid % n_one_channel];
+      auto &this_ct = enc_tensor.at(cid);
+
+      flood_ciphertext(this_ct, prng, *context_, *pk_, *evaluator_);
+      CHECK_ERR(sampleRandomMask(slice.indices, coeffs.data(), coeffs.size(),
+                                 mask, this_ct.parms_id(), prng,
+                                 this_ct.is_ntt_form()),
+                "RandomMaskPoly");
+      internal::sub_poly_inplace(this_ct, mask, *context_, *evaluator_);
+
+      auto coeff_ptr = coeffs.data();
+      for (long h = 0; h < slice.shape.height(); ++h) {
+        for (long w = 0; w < slice.shape.width(); ++w) {
+          mask_tensor(m, slice.hoffset + h, slice.woffset + w) = *coeff_ptr++;
         }
-        hoffset += slice_shape.height();
       }
     }
     return Code::OK;
   };
 
-  ThreadPool tpool(std::min(std::max(1UL, nthreads), kMaxThreads));
-  return LaunchWorks(tpool, meta.n_filters, mask_program);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, enc_tensor.size(), mask_program, 0, nthreads);
 }
 
 // In our Cheetah paper, we export the needed coefficients using the Extract
@@ -884,60 +824,308 @@ Code HomConv2DSS::decryptToTensor(
     return Code::ERR_INTERNAL;
   }
 
+  std::vector<OutSlice> slices;
+  CHECK_ERR(getOutSlices(meta, /*for_extract*/ false, slices), "getOutSlices");
+
   out_tensor.Reshape(out_shape);
   const bool need_ntt_form_ct = scheme() == seal::scheme_type::ckks;
   seal::Decryptor decryptor(*context_, *sk_);
+  // One work per ciphertext, i.e., per (filter, slice).
   auto decrypt_program = [&](long wid, size_t start, size_t end) {
     RLWEPt pt;
-    TensorShape slice_shape;
     std::vector<size_t> indices;
     std::vector<U64> coeffs(N);
 
+    for (size_t cid = start; cid < end; ++cid) {
+      const size_t m = cid / n_one_channel;
+      const auto &slice = slices[cid % n_one_channel];
+
+      if (need_ntt_form_ct == enc_tensor[cid].is_ntt_form()) {
+        decryptor.decrypt(enc_tensor[cid], pt);
+      } else {
+        RLWECt cpy{enc_tensor[cid]};
+        if (need_ntt_form_ct) {
+          evaluator_->transform_to_ntt_inplace(cpy);
+        } else {
+          evaluator_->transform_from_ntt_inplace(cpy);
+        }
+        decryptor.decrypt(cpy, pt);
+      }
+
+      // decrypt then take the needed coefficients
+      indices = slice.indices;
+      CHECK_ERR(postProcessInplace(pt, indices, coeffs.data(), coeffs.size()),
+                "ConvertThenModSwitch");
+
+      auto coeff_ptr = coeffs.cbegin();
+      for (long h = 0; h < slice.shape.height(); ++h) {
+        for (long w = 0; w < slice.shape.width(); ++w) {
+          out_tensor(m, slice.hoffset + h, slice.woffset + w) = *coeff_ptr++;
+        }
+      }
+    }
+
+    return Code::OK;
+  };
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, enc_tensor.size(), decrypt_program, 0, nthreads);
+}
+
+size_t HomConv2DSS::numSlices(const Meta &meta) const {
+  ConvCoeffIndexCalculator indexer(poly_degree(), meta.ishape, meta.fshape,
+                                   meta.padding, meta.stride);
+  return indexer.slice_size(1) * indexer.slice_size(2);
+}
+
+// The indexers of removeUnusedCoeffs (for_extract) and addRandomMask.
+static std::optional<ConvCoeffIndexCalculator> GetOutIndexer(
+    const HomConv2DSS::Meta &meta, size_t N, bool for_extract) {
+  TensorShape strided_ishape;
+  std::array<int, 2> pads{0};
+  std::array<int, 3> slice_width{0};
+  if (!shape_inference::Conv2D(meta.ishape, meta.fshape, N, meta.padding,
+                               meta.stride, strided_ishape, pads,
+                               slice_width)) {
+    LOG(WARNING) << "GetOutIndexer: shape inference failed";
+    return std::nullopt;
+  }
+
+  bool is_input_compressed =
+      for_extract ||
+      strided_ishape.num_elements() < meta.ishape.num_elements();
+
+  return ConvCoeffIndexCalculator(
+      N, is_input_compressed ? strided_ishape : meta.ishape, meta.fshape,
+      is_input_compressed ? Padding::VALID : meta.padding,
+      is_input_compressed ? 1 : meta.stride);
+}
+
+Code HomConv2DSS::getOutSlices(const Meta &meta, bool for_extract,
+                               std::vector<OutSlice> &slices) const {
+  auto indexer = GetOutIndexer(meta, poly_degree(), for_extract);
+  ENSURE_OR_RETURN(indexer, Code::ERR_INTERNAL);
+
+  slices.resize(indexer->slice_size(1) * indexer->slice_size(2));
+  auto slice = slices.begin();
+  for (int sh = 0, hoffset = 0; sh < indexer->slice_size(1); ++sh) {
+    TensorShape slice_shape;
+    for (int sw = 0, woffset = 0; sw < indexer->slice_size(2); ++sw) {
+      CHECK_ERR(indexer->Get({sh, sw}, slice_shape, slice->indices), "Get");
+      if (slice_shape.height() * slice_shape.width() !=
+          slice->indices.size()) {
+        return Code::ERR_DIM_MISMATCH;
+      }
+      slice->shape = slice_shape;
+      slice->hoffset = hoffset;
+      slice->woffset = woffset;
+      ++slice;
+      woffset += slice_shape.width();
+    }
+    hoffset += slice_shape.height();
+  }
+  return Code::OK;
+}
+
+Code HomConv2DSS::getOutSlice(const Meta &meta, size_t sid, bool for_extract,
+                              TensorShape &slice_shape,
+                              std::vector<size_t> &indices, long &hoffset,
+                              long &woffset) const {
+  std::vector<OutSlice> slices;
+  CHECK_ERR(getOutSlices(meta, for_extract, slices), "getOutSlices");
+  ENSURE_OR_RETURN(sid < slices.size(), Code::ERR_OUT_BOUND);
+  slice_shape = slices[sid].shape;
+  indices = std::move(slices[sid].indices);
+  hoffset = slices[sid].hoffset;
+  woffset = slices[sid].woffset;
+  return Code::OK;
+}
+
+Code HomConv2DSS::encodeImageToEncrypt(
+    const Tensor<uint64_t> &img, const Meta &meta,
+    std::vector<seal::Plaintext> &encoded_img) const {
+  ENSURE_OR_RETURN(context_ && encryptor_ && tencoder_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(img.shape().IsSameSize(meta.ishape), Code::ERR_DIM_MISMATCH);
+
+  CHECK_ERR(tencoder_->EncodeImageShare(TensorEncoder::Role::none, img,
+                                        meta.fshape, meta.padding, meta.stride,
+                                        /*to_ntt*/ false, encoded_img),
+            "encodeImageToEncrypt");
+  return Code::OK;
+}
+
+Code HomConv2DSS::encryptImageSlice(
+    const std::vector<seal::Plaintext> &polys, const Meta &meta, size_t sid,
+    std::vector<seal::Serializable<seal::Ciphertext>> &encrypted_slice,
+    size_t nthreads) const {
+  ENSURE_OR_RETURN(context_ && encryptor_, Code::ERR_CONFIG);
+  const size_t n_slices = numSlices(meta);
+  ENSURE_OR_RETURN(n_slices > 0 && sid < n_slices, Code::ERR_OUT_BOUND);
+  ENSURE_OR_RETURN(polys.size() % n_slices == 0, Code::ERR_DIM_MISMATCH);
+
+  const size_t n_groups = polys.size() / n_slices;
+  seal::Serializable<seal::Ciphertext> dummy = encryptor_->encrypt_zero();
+  encrypted_slice.resize(n_groups, dummy);
+  auto encrypt_program = [&](long wid, size_t start, size_t end) {
+    for (size_t c = start; c < end; ++c) {
+      encrypted_slice[c] =
+          encryptor_->encrypt_symmetric(polys[c * n_slices + sid]);
+    }
+    return Code::OK;
+  };
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, n_groups, encrypt_program, 0, nthreads);
+}
+
+Code HomConv2DSS::conv2DSSSlice(
+    const std::vector<seal::Ciphertext> &img_share0,
+    const std::vector<seal::Plaintext> &img_share1,
+    const std::vector<std::vector<seal::Plaintext>> &filters, const Meta &meta,
+    size_t sid, std::vector<seal::Ciphertext> &out_share0,
+    Tensor<uint64_t> &out_share1, size_t nthreads) const {
+  ENSURE_OR_RETURN(context_ && evaluator_ && pk_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(filters.size() == meta.n_filters, Code::ERR_DIM_MISMATCH);
+  ENSURE_OR_RETURN(!img_share0.empty(), Code::ERR_INVALID_ARG);
+  if (meta.is_shared_input) {
+    ENSURE_OR_RETURN(img_share0.size() == img_share1.size(),
+                     Code::ERR_DIM_MISMATCH);
+  }
+  for (const auto &f : filters) {
+    ENSURE_OR_RETURN(f.size() == img_share0.size(), Code::ERR_DIM_MISMATCH);
+  }
+
+  TensorShape out_shape = GetConv2DOutShape(meta);
+  if (out_shape.num_elements() == 0) {
+    LOG(WARNING) << "conv2DSSSlice: empty out_shape";
+    return Code::ERR_CONFIG;
+  }
+  if (!out_share1.shape().IsSameSize(out_shape)) {
+    out_share1.Reshape(out_shape);
+  }
+
+  TensorShape slice_shape;
+  std::vector<size_t> targets, used_indices;
+  long hoffset, woffset;
+  CHECK_ERR(getOutSlice(meta, sid, /*for_extract*/ true, slice_shape,
+                        used_indices, hoffset, woffset),
+            "getOutSlice");
+  CHECK_ERR(getOutSlice(meta, sid, /*for_extract*/ false, slice_shape, targets,
+                        hoffset, woffset),
+            "getOutSlice");
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  std::vector<seal::Ciphertext> image;
+  if (meta.is_shared_input) {
+    image.resize(img_share0.size());
+    auto add_program = [&](long wid, size_t start, size_t end) {
+      for (size_t i = start; i < end; ++i) {
+        try {
+          evaluator_->add_plain(img_share0[i], img_share1[i], image[i]);
+        } catch (std::logic_error e) {
+          LOG(WARNING) << "SEAL ERROR: " << e.what();
+          return Code::ERR_INTERNAL;
+        }
+      }
+      return Code::OK;
+    };
+    CHECK_ERR(LaunchWorks(*tpool, image.size(), add_program, 0, nthreads), "add");
+  }
+  const auto &img = meta.is_shared_input ? image : img_share0;
+
+  out_share0.resize(meta.n_filters);
+  auto conv_program = [&](long wid, size_t start, size_t end) {
+    RLWEPt mask;
+    std::vector<U64> coeffs(poly_degree());
+    auto prng =
+        context_->first_context_data()->parms().random_generator()->create();
     for (size_t m = start; m < end; ++m) {
-      size_t cid = m * n_one_channel;
-      for (int sh = 0, hoffset = 0; sh < indexer.slice_size(1); ++sh) {
-        for (int sw = 0, woffset = 0; sw < indexer.slice_size(2); ++sw) {
-          CHECK_ERR(indexer.Get({sh, sw}, slice_shape, indices), "Get");
-          if (slice_shape.height() * slice_shape.width() != indices.size()) {
-            return Code::ERR_DIM_MISMATCH;
-          }
-
-          if (need_ntt_form_ct == enc_tensor[cid].is_ntt_form()) {
-            decryptor.decrypt(enc_tensor[cid], pt);
-          } else {
-            RLWECt cpy{enc_tensor[cid]};
-            if (need_ntt_form_ct) {
-              evaluator_->transform_to_ntt_inplace(cpy);
-            } else {
-              evaluator_->transform_from_ntt_inplace(cpy);
-            }
-            decryptor.decrypt(cpy, pt);
-          }
-          ++cid;
-
-          // decrypt then take the needed coefficients
-          CHECK_ERR(
-              postProcessInplace(pt, indices, coeffs.data(), coeffs.size()),
-              "ConvertThenModSwitch");
-
-          auto coeff_ptr = coeffs.cbegin();
-          for (long h = 0; h < slice_shape.height(); ++h) {
-            for (long w = 0; w < slice_shape.width(); ++w) {
-              out_tensor(m, hoffset + h, woffset + w) = *coeff_ptr++;
-            }
-          }
-
-          woffset += slice_shape.width();
+      // `img` holds one slice only
+      CHECK_ERR(conv2DOneSlice(img, filters[m], meta, /*sid*/ 0, out_share0[m]),
+                "conv2DOneSlice");
+
+      auto &this_ct = out_share0[m];
+      flood_ciphertext(this_ct, prng, *context_, *pk_, *evaluator_);
+      CHECK_ERR(
+          sampleRandomMask(targets, coeffs.data(), coeffs.size(), mask,
+                           this_ct.parms_id(), prng, this_ct.is_ntt_form()),
+          "RandomMaskPoly");
+      internal::sub_poly_inplace(this_ct, mask, *context_, *evaluator_);
+
+      auto coeff_ptr = coeffs.data();
+      for (long h = 0; h < slice_shape.height(); ++h) {
+        for (long w = 0; w < slice_shape.width(); ++w) {
+          out_share1(m, hoffset + h, woffset + w) = *coeff_ptr++;
         }
-        hoffset += slice_shape.height();
       }
+
+      if (scheme() == seal::scheme_type::bfv) {
+        truncate_for_decryption(this_ct, *evaluator_, *context_);
+      }
+      remove_unused_coeffs(this_ct, *evaluator_, used_indices);
     }
+    return Code::OK;
+  };
+
+  return LaunchWorks(*tpool, meta.n_filters, conv_program, 0, nthreads);
+}
+
+Code HomConv2DSS::decryptSliceToTensor(
+    const std::vector<seal::Ciphertext> &enc_slice, const Meta &meta,
+    size_t sid, Tensor<uint64_t> &out_tensor, size_t nthreads) const {
+  if (!sk_) {
+    LOG(FATAL) << "decrypt without sk";
+  }
+  ENSURE_OR_RETURN(context_ && sk_ && evaluator_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(enc_slice.size() == meta.n_filters, Code::ERR_DIM_MISMATCH);
+
+  TensorShape out_shape = GetConv2DOutShape(meta);
+  ENSURE_OR_RETURN(out_shape.num_elements() > 0, Code::ERR_INVALID_ARG);
+  if (!out_tensor.shape().IsSameSize(out_shape)) {
+    out_tensor.Reshape(out_shape);
+  }
+
+  TensorShape slice_shape;
+  std::vector<size_t> indices;
+  long hoffset, woffset;
+  CHECK_ERR(getOutSlice(meta, sid, /*for_extract*/ false, slice_shape, indices,
+                        hoffset, woffset),
+            "getOutSlice");
+
+  const bool need_ntt_form_ct = scheme() == seal::scheme_type::ckks;
+  seal::Decryptor decryptor(*context_, *sk_);
+  auto decrypt_program = [&](long wid, size_t start, size_t end) {
+    RLWEPt pt;
+    std::vector<size_t> targets(indices);
+    std::vector<U64> coeffs(poly_degree());
+    for (size_t m = start; m < end; ++m) {
+      if (need_ntt_form_ct == enc_slice[m].is_ntt_form()) {
+        decryptor.decrypt(enc_slice[m], pt);
+      } else {
+        RLWECt cpy{enc_slice[m]};
+        if (need_ntt_form_ct) {
+          evaluator_->transform_to_ntt_inplace(cpy);
+        } else {
+          evaluator_->transform_from_ntt_inplace(cpy);
+        }
+        decryptor.decrypt(cpy, pt);
+      }
+
+      CHECK_ERR(postProcessInplace(pt, targets, coeffs.data(), coeffs.size()),
+                "ConvertThenModSwitch");
 
+      auto coeff_ptr = coeffs.cbegin();
+      for (long h = 0; h < slice_shape.height(); ++h) {
+        for (long w = 0; w < slice_shape.width(); ++w) {
+          out_tensor(m, hoffset + h, woffset + w) = *coeff_ptr++;
+        }
+      }
+    }
     return Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, meta.n_filters, decrypt_program);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, meta.n_filters, decrypt_program, 0, nthreads);
 }
 
 Code HomConv2DSS::postProcessInplace(seal::Plaintext &pt,
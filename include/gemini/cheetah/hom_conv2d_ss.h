@@ -23,13 +23,14 @@ class Evaluator;
 namespace gemini {
 
 class TensorEncoder;
+class ThreadPool;
 
 class HomConv2DSS {
  public:
 #ifdef HOM_CONV2D_SS_MAX_THREADS
   static constexpr size_t kMaxThreads = HOM_CONV2D_SS_MAX_THREADS;
 #else
-  static constexpr size_t kMaxThreads = 16;
+  static constexpr size_t kMaxThreads = 0;  // no cap
 #endif
 
   struct Meta {
@@ -55,6 +56,9 @@ class HomConv2DSS {
 
   uint64_t plain_modulus() const;
 
+  // Run the works on `pool` instead of spawning threads in every call.
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool) { tpool_ = pool; }
+
   Code encryptImage(
       const Tensor<uint64_t> &in_tensor_share, const Meta &meta,
       std::vector<seal::Serializable<seal::Ciphertext>> &encrypted_share,
@@ -79,15 +83,62 @@ class HomConv2DSS {
                        const Meta &meta, Tensor<uint64_t> &out,
                        size_t nthreads = 1) const;
 
+  // Streaming HomConv. The encrypted image is split into numSlices(meta)
+  // spatial slices. The sid-th slice consists of the ciphertexts
+  // {c * numSlices(meta) + sid} over all the channel groups c. Each slice is
+  // encrypted, evaluated and decrypted independently of the others.
+  size_t numSlices(const Meta &meta) const;
+
+  // Encode the image share for encryptImageSlice.
+  Code encodeImageToEncrypt(const Tensor<uint64_t> &in_tensor_share,
+                            const Meta &meta,
+                            std::vector<seal::Plaintext> &encoded_share) const;
+
+  Code encryptImageSlice(
+      const std::vector<seal::Plaintext> &encoded_share, const Meta &meta,
+      size_t sid,
+      std::vector<seal::Serializable<seal::Ciphertext>> &encrypted_slice,
+      size_t nthreads = 1) const;
+
+  // Evaluate all the filters on the sid-th slice. Writes n_filters ciphertexts
+  // to `out_share0` and the masks to the sid-th slice of `out_share1`.
+  Code conv2DSSSlice(const std::vector<seal::Ciphertext> &img_slice0,
+                     const std::vector<seal::Plaintext> &img_slice1,
+                     const std::vector<std::vector<seal::Plaintext>> &filters,
+                     const Meta &meta, size_t sid,
+                     std::vector<seal::Ciphertext> &out_share0,
+                     Tensor<uint64_t> &out_share1, size_t nthreads = 1) const;
+
+  Code decryptSliceToTensor(const std::vector<seal::Ciphertext> &enc_slice,
+                            const Meta &meta, size_t sid,
+                            Tensor<uint64_t> &out, size_t nthreads = 1) const;
+
   Code idealFunctionality(const Tensor<uint64_t> &in_tensor,
                           const std::vector<Tensor<uint64_t>> &filters,
                           const Meta &meta, Tensor<uint64_t> &out_tensor) const;
 
  protected:
-  size_t conv2DOneFilter(const std::vector<seal::Ciphertext> &enc_tensor,
-                         const std::vector<seal::Plaintext> &filter,
-                         const Meta &meta, seal::Ciphertext *out_buff,
-                         size_t out_buff_sze) const;
+  struct OutSlice {
+    TensorShape shape;
+    std::vector<size_t> indices;
+    long hoffset, woffset;
+  };
+
+  // The shape, coefficient indices and output offsets of all the slices.
+  Code getOutSlices(const Meta &meta, bool for_extract,
+                    std::vector<OutSlice> &slices) const;
+
+  // The shape, coefficient indices and output offsets of the sid-th slice.
+  // `for_extract` selects the indexer used by removeUnusedCoeffs.
+  Code getOutSlice(const Meta &meta, size_t sid, bool for_extract,
+                   TensorShape &slice_shape, std::vector<size_t> &indices,
+                   long &hoffset, long &woffset) const;
+
+  // out = sum_c enc_tensor[c * n_slices + sid] * filter[c]
+  Code conv2DOneSlice(const std::vector<seal::Ciphertext> &enc_tensor,
+                      const std::vector<seal::Plaintext> &filter,
+                      const Meta &meta, size_t sid,
+                      seal::Ciphertext &out) const;
 
   Code sampleRandomMask(const std::vector<size_t> &targets,
                         uint64_t *coeffs_buff, size_t buff_size,
@@ -112,6 +163,8 @@ class HomConv2DSS {
   std::shared_ptr<seal::PublicKey> pk_{nullptr};
 
   std::optional<seal::SecretKey> sk_{std::nullopt};
+
+  std::shared_ptr<ThreadPool> tpool_{nullptr};
 };
 
 };      // namespace gemini
@@ -10,6 +10,7 @@
 
 #include "gemini/core/logging.h"
 #include "gemini/core/util/ThreadPool.h"
+#include "gemini/core/util/work_stealing.h"
 
 namespace gemini {
 
@@ -49,31 +50,85 @@ static TensorShape getSplit(const HomFCSS::Meta &meta, size_t N) {
   return TensorShape({ret[0], ret[1]});
 }
 
-static Code LaunchWorks(
-    ThreadPool &tpool, size_t num_works,
-    std::function<Code(long wid, size_t start, size_t end)> program) {
-  if (num_works == 0) return Code::OK;
-  const long pool_sze = tpool.pool_size();
-  if (pool_sze <= 1L) {
-    return program(0, 0, num_works);
-  } else {
-    Code code;
-    std::vector<std::future<Code>> futures;
-    size_t work_load = (num_works + pool_sze - 1) / pool_sze;
-    for (long wid = 0; wid < pool_sze; ++wid) {
-      size_t start = wid * work_load;
-      size_t end = std::min(start + work_load, num_works);
-      futures.push_back(tpool.enqueue(program, wid, start, end));
+// For the batched HomFC, `nb` input rows are packed into one ciphertext and
+// the weight matrix is split into (d0 x d1) sub-matrices with nb * d0 * d1 <=
+// N. The b-th row is placed at the offset b * d0 * d1 so that the products of
+// different rows do not overlap.
+struct BatchSplit {
+  size_t nb;
+  TensorShape shape;
+};
+
+static BatchSplit getBatchSplit(const HomFCSS::Meta &meta, size_t batch,
+                                size_t N) {
+  BatchSplit ret{1, getSplit(meta, N)};
+  if (batch <= 1) {
+    return ret;
+  }
+
+  const size_t nrows = meta.weight_shape.rows();
+  const size_t ncols = meta.weight_shape.cols();
+  size_t min_cost = batch * (CeilDiv<size_t>(ncols, ret.shape.cols()) +
+                             CeilDiv<size_t>(nrows, ret.shape.rows()));
+  for (size_t nb = 2; nb <= std::min(batch, N); ++nb) {
+    for (size_t d0 = 1; d0 <= std::min(N / nb, nrows); ++d0) {
+      size_t d1 = std::min(N / (nb * d0), ncols);
+      size_t cost = CeilDiv<size_t>(batch, nb) *
+                    (CeilDiv<size_t>(ncols, d1) + CeilDiv<size_t>(nrows, d0));
+      if (cost < min_cost) {
+        min_cost = cost;
+        ret.nb = nb;
+        ret.shape = TensorShape({(int64_t)d0, (int64_t)d1});
+      }
+    }
+  }
+  return ret;
+}
+
+// The coefficients that carry the inner products in the output ciphertext of
+// a group with `n_rows` input rows and a row block with `row_extent` rows.
+static std::vector<size_t> getBatchTargets(const BatchSplit &split,
+                                           size_t n_rows, size_t row_extent) {
+  const size_t d0 = split.shape.rows();
+  const size_t d1 = split.shape.cols();
+  std::vector<size_t> targets;
+  targets.reserve(n_rows * row_extent);
+  for (size_t b = 0; b < n_rows; ++b) {
+    for (size_t r = 0; r < row_extent; ++r) {
+      targets.push_back(b * d0 * d1 + r * d1);
     }
+  }
+  return targets;
+}
 
-    code = Code::OK;
-    for (auto &&work : futures) {
-      Code c = work.get();
-      if (code == Code::OK && c != Code::OK) {
-        code = c;
+// Pack the rows of the `group`-th group restricted to the `col_blk`-th column
+// block. Each row uses the reversed ordering, i.e., x_0 - sum_j x_j X^{N - j},
+// shifted by its offset.
+static void packInputRows(const Tensor<uint64_t> &input_matrix,
+                          const BatchSplit &split, size_t group,
+                          size_t col_blk, uint64_t plain,
+                          std::vector<uint64_t> &poly) {
+  const size_t N = poly.size();
+  const size_t d0 = split.shape.rows();
+  const size_t d1 = split.shape.cols();
+  const size_t nrows = input_matrix.rows();
+  const size_t ncols = input_matrix.cols();
+  const size_t col_bgn = col_blk * d1;
+  const size_t col_end = std::min(ncols, col_bgn + d1);
+
+  std::fill(poly.begin(), poly.end(), 0);
+  for (size_t b = 0; b < split.nb; ++b) {
+    const size_t row = group * split.nb + b;
+    if (row >= nrows) break;
+    const size_t offset = b * d0 * d1;
+    for (size_t j = 0; j < col_end - col_bgn; ++j) {
+      uint64_t u = input_matrix(row, col_bgn + j);
+      if (offset >= j) {
+        poly[offset - j] = u;
+      } else {
+        poly[N + offset - j] = u > 0 ? plain - u : 0;
       }
     }
-    return code;
   }
 }
 
@@ -96,6 +151,11 @@ Code sample_random_mask(const std::vector<size_t> &targets,
                         std::shared_ptr<seal::UniformRandomGenerator> prng,
                         const seal::SEALContext &context);
 
+// defined in hom_conv2d_ss.cc
+void remove_unused_coeffs(seal::Ciphertext &ct,
+                          const seal::Evaluator &evaluator,
+                          std::vector<size_t> used_indices);
+
 namespace internal {
 void sub_poly_inplace(seal::Ciphertext &ct, const seal::Plaintext &pt,
                       const seal::SEALContext &context,
@@ -320,12 +380,33 @@ Code HomFCSS::encodeInputVector(const Tensor<uint64_t> &input_vector,
     return is_failed ? Code::ERR_INTERNAL : Code::OK;
   };
 
-  gemini::ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, nout, encode_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, nout, encode_prg, 0, nthreads);
+}
+
+Code HomFCSS::encodeWeightMatrix(
+    const Tensor<uint64_t> &weight_matrix, const Meta &meta,
+    std::vector<std::vector<seal::Plaintext>> &encoded_share,
+    size_t nthreads) const {
+  ENSURE_OR_RETURN(context_, Code::ERR_CONFIG);
+  return encodeWeightMatrix(weight_matrix, meta, getSplit(meta, poly_degree()),
+                            encoded_share, nthreads);
+}
+
+Code HomFCSS::encodeWeightMatrix(
+    const Tensor<uint64_t> &weight_matrix, const Meta &meta, size_t batch,
+    std::vector<std::vector<seal::Plaintext>> &encoded_share,
+    size_t nthreads) const {
+  ENSURE_OR_RETURN(context_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(batch > 0, Code::ERR_INVALID_ARG);
+  auto split = getBatchSplit(meta, batch, poly_degree());
+  return encodeWeightMatrix(weight_matrix, meta, split.shape, encoded_share,
+                            nthreads);
 }
 
 Code HomFCSS::encodeWeightMatrix(
     const Tensor<uint64_t> &weight_matrix, const Meta &meta,
+    const TensorShape &split_shape,
     std::vector<std::vector<seal::Plaintext>> &encoded_share,
     size_t nthreads) const {
   ENSURE_OR_RETURN(context_, Code::ERR_CONFIG);
@@ -334,7 +415,6 @@ Code HomFCSS::encodeWeightMatrix(
   const size_t nrows = meta.weight_shape.rows();
   const size_t ncols = meta.weight_shape.cols();
 
-  auto split_shape = getSplit(meta, poly_degree());
   if (split_shape.num_elements() > poly_degree()) {
     LOG(FATAL) << "BUG";
   }
@@ -387,8 +467,8 @@ Code HomFCSS::encodeWeightMatrix(
     return is_failed ? Code::ERR_INTERNAL : Code::OK;
   };
 
-  ThreadPool tpool(nthreads);
-  return LaunchWorks(tpool, n_row_blks, encode_prg);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, n_row_blks, encode_prg, 0, nthreads);
 }
 
 Code HomFCSS::matVecMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
@@ -425,7 +505,7 @@ Code HomFCSS::matVecMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
     return Code::ERR_DIM_MISMATCH;
   }
 
-  ThreadPool tpool(nthreads);
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
 
   std::vector<seal::Ciphertext> input;
   if (meta.is_shared_input) {
@@ -436,7 +516,7 @@ Code HomFCSS::matVecMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
       }
       return Code::OK;
     };
-    (void)LaunchWorks(tpool, n_ct_in, add_prg);
+    (void)LaunchWorks(*tpool, n_ct_in, add_prg, 0, nthreads);
   }
 
   out_share0.resize(n_ct_out);
@@ -455,9 +535,9 @@ Code HomFCSS::matVecMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
     }
     return Code::OK;
   };
-  (void)LaunchWorks(tpool, n_ct_out, fma_prg);
+  (void)LaunchWorks(*tpool, n_ct_out, fma_prg, 0, nthreads);
 
-  addRandomMask(out_share0, out_share1, meta, tpool);
+  addRandomMask(out_share0, out_share1, meta, *tpool, nthreads);
 
   if (scheme() == seal::scheme_type::bfv) {
     for (auto &c : out_share0) {
@@ -472,7 +552,7 @@ Code HomFCSS::matVecMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
 
 Code HomFCSS::addRandomMask(std::vector<seal::Ciphertext> &cts,
                             Tensor<uint64_t> &mask_vector, const Meta &meta,
-                            gemini::ThreadPool &tpool) const {
+                            gemini::ThreadPool &tpool, size_t nthreads) const {
   ENSURE_OR_RETURN(pk_, Code::ERR_CONFIG);
   TensorShape split_shape = getSplit(meta, poly_degree());
   const size_t n_ct_out =
@@ -516,7 +596,7 @@ Code HomFCSS::addRandomMask(std::vector<seal::Ciphertext> &cts,
     return Code::OK;
   };
 
-  return LaunchWorks(tpool, n_ct_out, mask_prg);
+  return LaunchWorks(tpool, n_ct_out, mask_prg, 0, nthreads);
 }
 
 // In our Cheetah paper, we export the needed coefficients using the Extract
@@ -601,6 +681,242 @@ Code HomFCSS::decryptToVector(const std::vector<seal::Ciphertext> &enc_vector,
   return Code::OK;
 }
 
+Code HomFCSS::encryptInputMatrix(
+    const Tensor<uint64_t> &input_matrix, const Meta &meta,
+    std::vector<seal::Serializable<seal::Ciphertext>> &encrypted_share,
+    size_t nthreads) const {
+  ENSURE_OR_RETURN(context_ && encryptor_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(scheme() == seal::scheme_type::bfv, Code::ERR_INTERNAL);
+  ENSURE_OR_RETURN(input_matrix.dims() == 2 && input_matrix.rows() > 0 &&
+                       input_matrix.cols() == meta.input_shape.length(),
+                   Code::ERR_DIM_MISMATCH);
+
+  const size_t batch = input_matrix.rows();
+  auto split = getBatchSplit(meta, batch, poly_degree());
+  const size_t n_groups = CeilDiv<size_t>(batch, split.nb);
+  const size_t n_col_blks =
+      CeilDiv<size_t>(input_matrix.cols(), split.shape.cols());
+
+  encrypted_share.resize(n_groups * n_col_blks, encryptor_->encrypt_zero());
+  auto encrypt_prg = [&](long wid, size_t start, size_t end) {
+    seal::Plaintext pt;
+    std::vector<uint64_t> tmp(poly_degree());
+    bool is_failed = false;
+    for (size_t i = start; i < end && !is_failed; ++i) {
+      packInputRows(input_matrix, split, i / n_col_blks, i % n_col_blks,
+                    plain_modulus(), tmp);
+      if (Code::OK != vec2Poly(tmp.data(), tmp.size(), pt, Role::none)) {
+        is_failed = true;
+        break;
+      }
+      try {
+        encrypted_share.at(i) = encryptor_->encrypt_symmetric(pt);
+      } catch (const std::logic_error &e) {
+        is_failed = true;
+      }
+    }
+    // erase the sensitive data
+    seal::util::seal_memzero(tmp.data(), sizeof(uint64_t) * tmp.size());
+    seal::util::seal_memzero(pt.data(), sizeof(uint64_t) * pt.coeff_count());
+    return is_failed ? Code::ERR_INTERNAL : Code::OK;
+  };
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, encrypted_share.size(), encrypt_prg, 0, nthreads);
+}
+
+Code HomFCSS::encodeInputMatrix(const Tensor<uint64_t> &input_matrix,
+                                const Meta &meta,
+                                std::vector<seal::Plaintext> &encoded_share,
+                                size_t nthreads) const {
+  ENSURE_OR_RETURN(context_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(scheme() == seal::scheme_type::bfv, Code::ERR_INTERNAL);
+  ENSURE_OR_RETURN(input_matrix.dims() == 2 && input_matrix.rows() > 0 &&
+                       input_matrix.cols() == meta.input_shape.length(),
+                   Code::ERR_DIM_MISMATCH);
+
+  const size_t batch = input_matrix.rows();
+  auto split = getBatchSplit(meta, batch, poly_degree());
+  const size_t n_groups = CeilDiv<size_t>(batch, split.nb);
+  const size_t n_col_blks =
+      CeilDiv<size_t>(input_matrix.cols(), split.shape.cols());
+
+  encoded_share.resize(n_groups * n_col_blks);
+  auto encode_prg = [&](long wid, size_t start, size_t end) {
+    std::vector<uint64_t> tmp(poly_degree());
+    bool is_failed = false;
+    for (size_t i = start; i < end && !is_failed; ++i) {
+      packInputRows(input_matrix, split, i / n_col_blks, i % n_col_blks,
+                    plain_modulus(), tmp);
+      if (Code::OK != vec2Poly(tmp.data(), tmp.size(), encoded_share.at(i),
+                               Role::none)) {
+        is_failed = true;
+      }
+    }
+    seal::util::seal_memzero(tmp.data(), sizeof(uint64_t) * tmp.size());
+    return is_failed ? Code::ERR_INTERNAL : Code::OK;
+  };
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, encoded_share.size(), encode_prg, 0, nthreads);
+}
+
+Code HomFCSS::matMatMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
+                        const std::vector<seal::Ciphertext> &mat_share0,
+                        const std::vector<seal::Plaintext> &mat_share1,
+                        const Meta &meta, size_t batch,
+                        std::vector<seal::Ciphertext> &out_share0,
+                        Tensor<uint64_t> &out_share1, size_t nthreads) const {
+  ENSURE_OR_RETURN(context_ && evaluator_ && pk_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(batch > 0, Code::ERR_INVALID_ARG);
+
+  auto split = getBatchSplit(meta, batch, poly_degree());
+  const size_t d0 = split.shape.rows();
+  const size_t nrows = meta.weight_shape.rows();
+  const size_t n_groups = CeilDiv<size_t>(batch, split.nb);
+  const size_t n_col_blks =
+      CeilDiv<size_t>(meta.input_shape.length(), split.shape.cols());
+  const size_t n_row_blks = CeilDiv<size_t>(nrows, d0);
+
+  ENSURE_OR_RETURN(mat_share0.size() == n_groups * n_col_blks,
+                   Code::ERR_INVALID_ARG);
+  ENSURE_OR_RETURN(matrix.size() == n_row_blks, Code::ERR_INVALID_ARG);
+  for (const auto &rows : matrix) {
+    ENSURE_OR_RETURN(rows.size() == n_col_blks, Code::ERR_INVALID_ARG);
+    for (const auto &submat : rows) {
+      if (submat.is_zero()) {
+        LOG(WARNING) << "matMatMul: sub-matrix with all zero is not supported";
+        return Code::ERR_INVALID_ARG;
+      }
+    }
+  }
+
+  if (meta.is_shared_input && mat_share1.size() != mat_share0.size()) {
+    return Code::ERR_DIM_MISMATCH;
+  }
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+
+  std::vector<seal::Ciphertext> input;
+  if (meta.is_shared_input) {
+    input.resize(mat_share0.size());
+    auto add_prg = [&](long wid, size_t start, size_t end) {
+      for (size_t i = start; i < end; ++i) {
+        evaluator_->add_plain(mat_share0[i], mat_share1[i], input[i]);
+      }
+      return Code::OK;
+    };
+    CHECK_ERR(LaunchWorks(*tpool, input.size(), add_prg, 0, nthreads), "add");
+  }
+  const auto &in_ct = meta.is_shared_input ? input : mat_share0;
+
+  out_share0.resize(n_groups * n_row_blks);
+  auto fma_prg = [&](long wid, size_t start, size_t end) {
+    seal::Ciphertext tmp;
+    for (size_t o = start; o < end; ++o) {
+      const size_t g = o / n_row_blks;
+      const size_t r_blk = o % n_row_blks;
+      evaluator_->multiply_plain(in_ct[g * n_col_blks], matrix[r_blk][0],
+                                 out_share0[o]);
+      for (size_t c = 1; c < n_col_blks; ++c) {
+        evaluator_->multiply_plain(in_ct[g * n_col_blks + c], matrix[r_blk][c],
+                                   tmp);
+        evaluator_->add_inplace(out_share0[o], tmp);
+      }
+    }
+    return Code::OK;
+  };
+  CHECK_ERR(LaunchWorks(*tpool, out_share0.size(), fma_prg, 0, nthreads), "fma");
+
+  out_share1.Reshape(TensorShape({(int64_t)batch, (int64_t)nrows}));
+  auto mask_prg = [&](long wid, size_t start, size_t end) {
+    RLWEPt mask;
+    std::vector<U64> coeffs(poly_degree());
+    auto prng =
+        context_->first_context_data()->parms().random_generator()->create();
+    for (size_t o = start; o < end; ++o) {
+      const size_t g = o / n_row_blks;
+      const size_t r_blk = o % n_row_blks;
+      const size_t row_bgn = g * split.nb;
+      const size_t n_rows = std::min(split.nb, batch - row_bgn);
+      const size_t col_bgn = r_blk * d0;
+      const size_t row_extent = std::min(d0, nrows - col_bgn);
+      auto targets = getBatchTargets(split, n_rows, row_extent);
+
+      auto &this_ct = out_share0[o];
+      flood_ciphertext(this_ct, prng, *context_, *pk_, *evaluator_);
+      CHECK_ERR(
+          sampleRandomMask(targets, coeffs.data(), coeffs.size(), mask,
+                           this_ct.parms_id(), prng, this_ct.is_ntt_form()),
+          "RandomMaskPoly");
+      internal::sub_poly_inplace(this_ct, mask, *context_, *evaluator_);
+
+      auto coeff_ptr = coeffs.data();
+      for (size_t b = 0; b < n_rows; ++b) {
+        for (size_t r = 0; r < row_extent; ++r) {
+          out_share1(row_bgn + b, col_bgn + r) = *coeff_ptr++;
+        }
+      }
+
+      if (scheme() == seal::scheme_type::bfv) {
+        truncate_for_decryption(this_ct, *evaluator_, *context_);
+      }
+      // Post-processing for compressing out_ct volume.
+      remove_unused_coeffs(this_ct, *evaluator_, targets);
+    }
+
+    seal::util::seal_memzero(coeffs.data(), sizeof(uint64_t) * coeffs.size());
+    seal::util::seal_memzero(mask.data(),
+                             sizeof(uint64_t) * mask.coeff_count());
+    return Code::OK;
+  };
+
+  return LaunchWorks(*tpool, out_share0.size(), mask_prg, 0, nthreads);
+}
+
+Code HomFCSS::decryptToMatrix(const std::vector<seal::Ciphertext> &enc_matrix,
+                              const Meta &meta, size_t batch,
+                              Tensor<uint64_t> &out, size_t nthreads) const {
+  ENSURE_OR_RETURN(context_ && evaluator_ && sk_, Code::ERR_CONFIG);
+  ENSURE_OR_RETURN(batch > 0, Code::ERR_INVALID_ARG);
+
+  auto split = getBatchSplit(meta, batch, poly_degree());
+  const size_t d0 = split.shape.rows();
+  const size_t nrows = meta.weight_shape.rows();
+  const size_t n_groups = CeilDiv<size_t>(batch, split.nb);
+  const size_t n_row_blks = CeilDiv<size_t>(nrows, d0);
+  ENSURE_OR_RETURN(enc_matrix.size() == n_groups * n_row_blks,
+                   Code::ERR_INVALID_ARG);
+
+  out.Reshape(TensorShape({(int64_t)batch, (int64_t)nrows}));
+  seal::Decryptor decryptor(*context_, *sk_);
+  auto decrypt_prg = [&](long wid, size_t start, size_t end) {
+    seal::Plaintext pt;
+    for (size_t o = start; o < end; ++o) {
+      const size_t g = o / n_row_blks;
+      const size_t r_blk = o % n_row_blks;
+      const size_t row_bgn = g * split.nb;
+      const size_t n_rows = std::min(split.nb, batch - row_bgn);
+      const size_t col_bgn = r_blk * d0;
+      const size_t row_extent = std::min(d0, nrows - col_bgn);
+
+      decryptor.decrypt(enc_matrix.at(o), pt);
+      auto targets = getBatchTargets(split, n_rows, row_extent);
+      auto target = targets.cbegin();
+      for (size_t b = 0; b < n_rows; ++b) {
+        for (size_t r = 0; r < row_extent; ++r, ++target) {
+          out(row_bgn + b, col_bgn + r) =
+              *target >= pt.coeff_count() ? 0 : pt[*target];
+        }
+      }
+    }
+    return Code::OK;
+  };
+
+  auto tpool = AcquireThreadPool(tpool_, nthreads, kMaxThreads);
+  return LaunchWorks(*tpool, enc_matrix.size(), decrypt_prg, 0, nthreads);
+}
+
 Code HomFCSS::idealFunctionality(const Tensor<uint64_t> &input_matrix,
                                  const Tensor<uint64_t> &weight_matrix,
                                  const Meta &meta,
@@ -29,7 +29,7 @@ class HomFCSS {
 #ifdef HOM_CONV2D_SS_MAX_THREADS
   static constexpr size_t kMaxThreads = HOM_CONV2D_SS_MAX_THREADS;
 #else
-  static constexpr size_t kMaxThreads = 16;
+  static constexpr size_t kMaxThreads = 0;  // no cap
 #endif
   struct Meta {
     TensorShape input_shape;
@@ -51,6 +51,9 @@ class HomFCSS {
 
   uint64_t plain_modulus() const;
 
+  // Run the works on `pool` instead of spawning threads in every call.
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool) { tpool_ = pool; }
+
   Code encryptInputVector(
       const Tensor<uint64_t> &vector, const Meta &meta,
       std::vector<seal::Serializable<seal::Ciphertext>> &encrypted_share,
@@ -76,6 +79,37 @@ class HomFCSS {
                        const Meta &meta, Tensor<uint64_t> &out,
                        size_t nthreads = 1) const;
 
+  // Batched HomFC. The rows of the (batch x ncols) input matrix are packed into
+  // the same ciphertexts so that the whole matrix product is evaluated in one
+  // exchange. `meta.input_shape` is the shape of one row. The weight matrix
+  // should be encoded with the same `batch`. With batch = 1, the encodings are
+  // the same as the vector versions.
+  Code encryptInputMatrix(
+      const Tensor<uint64_t> &input_matrix, const Meta &meta,
+      std::vector<seal::Serializable<seal::Ciphertext>> &encrypted_share,
+      size_t nthreads = 1) const;
+
+  Code encodeInputMatrix(const Tensor<uint64_t> &input_matrix,
+                         const Meta &meta,
+                         std::vector<seal::Plaintext> &encoded_share,
+                         size_t nthreads = 1) const;
+
+  Code encodeWeightMatrix(
+      const Tensor<uint64_t> &weight_matrix, const Meta &meta, size_t batch,
+      std::vector<std::vector<seal::Plaintext>> &encoded_share,
+      size_t nthreads = 1) const;
+
+  Code matMatMul(const std::vector<std::vector<seal::Plaintext>> &matrix,
+                 const std::vector<seal::Ciphertext> &mat_share0,
+                 const std::vector<seal::Plaintext> &mat_share1,
+                 const Meta &meta, size_t batch,
+                 std::vector<seal::Ciphertext> &out_mat_share0,
+                 Tensor<uint64_t> &out_mat_share1, size_t nthreads = 1) const;
+
+  Code decryptToMatrix(const std::vector<seal::Ciphertext> &enc_matrix,
+                       const Meta &meta, size_t batch, Tensor<uint64_t> &out,
+                       size_t nthreads = 1) const;
+
   Code idealFunctionality(const Tensor<uint64_t> &weight_matrix,
                           const Tensor<uint64_t> &vector, const Meta &meta,
                           Tensor<uint64_t> &out) const;
@@ -106,11 +140,17 @@ class HomFCSS {
 
   Code addRandomMask(std::vector<seal::Ciphertext> &enc_tensor,
                      Tensor<uint64_t> &mask_tensor, const Meta &meta,
-                     gemini::ThreadPool &tp) const;
+                     gemini::ThreadPool &tp, size_t nthreads) const;
 
   Code removeUnusedCoeffs(std::vector<seal::Ciphertext> &ct, const Meta &meta,
                           double *density = nullptr) const;
 
+  Code encodeWeightMatrix(
+      const Tensor<uint64_t> &weight_matrix, const Meta &meta,
+      const TensorShape &split_shape,
+      std::vector<std::vector<seal::Plaintext>> &encoded_share,
+      size_t nthreads) const;
+
  private:
   std::shared_ptr<seal::SEALContext> context_;
   std::shared_ptr<seal::Evaluator> evaluator_{nullptr};
@@ -118,6 +158,8 @@ class HomFCSS {
   std::shared_ptr<seal::PublicKey> pk_{nullptr};
 
   std::optional<seal::SecretKey> sk_{std::nullopt};
+
+  std::shared_ptr<ThreadPool> tpool_{nullptr};
 };
 }  // namespace gemini
 
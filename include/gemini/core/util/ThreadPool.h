@@ -21,12 +21,19 @@ freely, subject to the following restrictions:
 
    3. This notice may not be removed or altered from any source
    distribution.
+
+Modified for gemini: optional CPU affinity of the workers and the queue depth
+statistics.
 */
 
 #ifndef GEMINI_THREAD_POOL_H
 #define GEMINI_THREAD_POOL_H
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstdio>
+#include <cstring>
 #include <functional>
 #include <future>
 #include <memory>
@@ -36,16 +43,41 @@ freely, subject to the following restrictions:
 #include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace gemini {
 class ThreadPool {
  public:
-  ThreadPool(size_t);
+  // The i-th worker is pinned to cpus[i % cpus.size()] if `cpus` is given.
+  ThreadPool(size_t, const std::vector<int>& cpus = {});
   template <class F, class... Args>
       auto enqueue(F&& f, Args&&... args)
       -> std::future<typename std::result_of<F(Args...)>::type>;
   ~ThreadPool();
 
   inline size_t pool_size() const { return workers.size(); }
+
+  // #tasks waiting in the queue now.
+  size_t queue_depth() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    return tasks.size();
+  }
+
+  // The largest queue_depth() seen so far.
+  size_t max_queue_depth() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    return max_depth;
+  }
+
+  // #tasks ever enqueued.
+  size_t num_enqueued() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    return n_enqueued;
+  }
+
  private:
   // need to keep track of threads so we can join them
   std::vector<std::thread> workers;
@@ -56,11 +88,16 @@ class ThreadPool {
   std::mutex queue_mutex;
   std::condition_variable condition;
   bool stop;
+
+  // statistics, guarded by queue_mutex
+  size_t max_depth = 0;
+  size_t n_enqueued = 0;
 };
 
 // the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads) : stop(false) {
-  for (size_t i = 0; i < threads; ++i)
+inline ThreadPool::ThreadPool(size_t threads, const std::vector<int>& cpus)
+    : stop(false) {
+  for (size_t i = 0; i < threads; ++i) {
     workers.emplace_back([this] {
       for (;;) {
         std::function<void()> task;
@@ -77,6 +114,22 @@ inline ThreadPool::ThreadPool(size_t threads) : stop(false) {
         task();
       }
     });
+
+#ifdef __linux__
+    if (!cpus.empty()) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(cpus[i % cpus.size()], &cpuset);
+      int err = pthread_setaffinity_np(workers.back().native_handle(),
+                                       sizeof(cpu_set_t), &cpuset);
+      static std::atomic<bool> warned{false};
+      if (err != 0 && !warned.exchange(true)) {
+        std::fprintf(stderr, "ThreadPool: cannot pin a worker to CPU %d: %s\n",
+                     cpus[i % cpus.size()], std::strerror(err));
+      }
+    }
+#endif
+  }
 }
 
 // add new work item to the pool
@@ -96,6 +149,8 @@ template <class F, class... Args>
     if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
 
     tasks.emplace([task]() { (*task)(); });
+    max_depth = std::max(max_depth, tasks.size());
+    ++n_enqueued;
   }
   condition.notify_one();
   return res;
@@ -111,5 +166,22 @@ inline ThreadPool::~ThreadPool() {
   for (std::thread& worker : workers) worker.join();
 }
 
+// The pool to run one call with `nthreads` threads. If nthreads <= 1, one
+// process-wide pool without workers, i.e., the works run inline. Otherwise the
+// `shared` pool if any, or a pool that lives for this call only. The shared
+// pool may have more workers than nthreads: pass nthreads as the max_workers
+// of LaunchWorks.
+inline std::shared_ptr<ThreadPool> AcquireThreadPool(
+    const std::shared_ptr<ThreadPool>& shared, size_t nthreads,
+    size_t max_threads) {
+  static const std::shared_ptr<ThreadPool> inline_pool =
+      std::make_shared<ThreadPool>(0);
+  if (nthreads <= 1) return inline_pool;
+  if (shared) return shared;
+  // max_threads = 0 means no cap.
+  return std::make_shared<ThreadPool>(
+      max_threads > 0 ? std::min(nthreads, max_threads) : nthreads);
+}
+
 }
 #endif
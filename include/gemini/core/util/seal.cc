@@ -5,6 +5,13 @@
 #include <seal/context.h>
 #include <seal/galoiskeys.h>
 #include <seal/util/polyarithsmallmod.h>
+#include <zstd.h>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "gemini/core/logging.h"
 
 namespace gemini {
 
@@ -397,4 +404,96 @@ Code apply_galois_inplace(::seal::Ciphertext &encrypted, uint32_t galois_elt,
   return ok;
 }
 
+seal::seal_byte *serialization_buffer(size_t nbytes, int slot) {
+  thread_local std::array<std::vector<seal::seal_byte>, 2> buffers;
+  auto &buffer = buffers.at(slot);
+  if (buffer.size() < nbytes) {
+    buffer.resize(nbytes);
+  }
+  return buffer.data();
+}
+
+Code zstd_compress_buffer(const seal::seal_byte *src, size_t nbytes, int level,
+                          seal::seal_byte **dst, size_t *compr_nbytes) {
+  *compr_nbytes = 0;
+  const size_t bound = ZSTD_compressBound(nbytes);
+  *dst = serialization_buffer(bound, 1);
+  size_t ret = ZSTD_compress(*dst, bound, src, nbytes, level);
+  if (ZSTD_isError(ret)) {
+    LOG(WARNING) << "zstd_compress_buffer: " << ZSTD_getErrorName(ret);
+    return Code::ERR_INTERNAL;
+  }
+  *compr_nbytes = ret;
+  return Code::OK;
+}
+
+Code zstd_decompress_buffer(const seal::seal_byte *src, size_t nbytes,
+                            size_t max_raw_nbytes, seal::seal_byte **dst,
+                            size_t *raw_nbytes) {
+  *raw_nbytes = 0;
+  // SEAL's own serialization starts with the SEALHeader magic instead.
+  unsigned int magic{0};
+  if (nbytes < sizeof(magic)) return Code::OK;
+  std::memcpy(&magic, src, sizeof(magic));
+  if (magic != ZSTD_MAGICNUMBER) return Code::OK;
+
+  unsigned long long content_nbytes = ZSTD_getFrameContentSize(src, nbytes);
+  if (content_nbytes == ZSTD_CONTENTSIZE_ERROR ||
+      content_nbytes == ZSTD_CONTENTSIZE_UNKNOWN) {
+    return Code::ERR_INVALID_ARG;
+  }
+  if (content_nbytes > max_raw_nbytes) {
+    return Code::ERR_OUT_BOUND;
+  }
+  *dst = serialization_buffer(content_nbytes, 1);
+  size_t ret = ZSTD_decompress(*dst, content_nbytes, src, nbytes);
+  if (ZSTD_isError(ret)) {
+    return Code::ERR_INVALID_ARG;
+  }
+  *raw_nbytes = ret;
+  return Code::OK;
+}
+
+size_t max_ciphertext_nbytes(const seal::SEALContext &context) {
+  // At most three polynomials over the largest modulus, plus the SEALHeader
+  // and the ciphertext's metadata.
+  constexpr size_t kMaxCtSize = 3;
+  constexpr size_t kMetaNbytes = 1024;
+  const auto &parms = context.key_context_data()->parms();
+  return kMaxCtSize * parms.poly_modulus_degree() *
+             parms.coeff_modulus().size() * sizeof(uint64_t) +
+         kMetaNbytes;
+}
+
+size_t max_ciphertext_wire_nbytes(const seal::SEALContext &context) {
+  // zstd's bound is the looser one of the compressors SEAL and we use.
+  return ZSTD_compressBound(max_ciphertext_nbytes(context));
+}
+
+bool parse_ct_compression(const std::string &spec, CtCompression &compr) {
+  using Type = CtCompression::Type;
+  if (spec.empty() || spec == "seal") {
+    compr = {Type::seal_default, 0};
+  } else if (spec == "none") {
+    compr = {Type::none, 0};
+  } else if (spec == "low-latency") {
+    compr = {Type::low_latency, CtCompression::kLowLatencyLevel};
+  } else if (spec.rfind("zstd", 0) == 0) {
+    int level = 3;  // zstd's default level
+    if (spec.size() > 4) {
+      if (spec[4] != ':') return false;
+      try {
+        level = std::stoi(spec.substr(5));
+      } catch (const std::exception &) {
+        return false;
+      }
+      if (level < 1 || level > 19) return false;
+    }
+    compr = {Type::zstd, level};
+  } else {
+    return false;
+  }
+  return true;
+}
+
 }  // namespace gemini
@@ -2,12 +2,182 @@
 #ifndef GEMINI_CORE_UTIL_SEAL_H
 #define GEMINI_CORE_UTIL_SEAL_H
 
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
 #include "gemini/core/types.h"
+#include "gemini/core/util/timer.h"
 
 namespace gemini {
 Code apply_galois_inplace(seal::Ciphertext &encrypted, uint32_t galois_elt,
                           const seal::GaloisKeys &galois_keys,
                           const seal::SEALContext &context);
 
+// How the ciphertexts are compressed on the wire.
+struct CtCompression {
+  enum class Type {
+    seal_default,  // SEAL's built-in compr_mode
+    none,
+    zstd,         // zstd at `level` in [1, 19]
+    low_latency,  // zstd in its fast (negative level) mode
+  };
+
+  // zstd level of the low_latency mode.
+  static constexpr int kLowLatencyLevel = -5;
+
+  Type type{Type::seal_default};
+  int level{0};
+};
+
+// Accumulated by send_seal_object and recv_ciphertext.
+struct CtIOStats {
+  uint64_t raw_bytes{0};   // the uncompressed SEAL serialization of sent cts
+  uint64_t sent_bytes{0};  // what was handed to the IO channel
+  uint64_t recv_bytes{0};
+  double compress_ms{0.};  // save() + compression
+  double decompress_ms{0.};  // decompression + load()
+
+  CtIOStats operator-(const CtIOStats &oth) const {
+    CtIOStats ret(*this);
+    ret.raw_bytes -= oth.raw_bytes;
+    ret.sent_bytes -= oth.sent_bytes;
+    ret.recv_bytes -= oth.recv_bytes;
+    ret.compress_ms -= oth.compress_ms;
+    ret.decompress_ms -= oth.decompress_ms;
+    return ret;
+  }
+};
+
+// Parse "seal", "none", "zstd", "zstd:<level>" or "low-latency".
+bool parse_ct_compression(const std::string &spec, CtCompression &compr);
+
+// Per-thread byte buffers that are reused by the ciphertext (de)serialization
+// below. Slot 0 holds the SEAL serialization and slot 1 the zstd frame. They
+// only grow.
+seal::seal_byte *serialization_buffer(size_t nbytes, int slot = 0);
+
+// Compress into serialization_buffer(.., 1) and set `compr_nbytes` to the
+// compressed size. Returns ERR_INTERNAL if zstd fails.
+Code zstd_compress_buffer(const seal::seal_byte *src, size_t nbytes, int level,
+                          seal::seal_byte **dst, size_t *compr_nbytes);
+
+// Decompress a zstd frame into serialization_buffer(.., 1). `raw_nbytes` is
+// set to 0 if `src` is not a zstd frame. The frame comes from the peer, so it
+// is rejected with ERR_OUT_BOUND if it holds more than `max_raw_nbytes`, and
+// with ERR_INVALID_ARG if it is malformed.
+Code zstd_decompress_buffer(const seal::seal_byte *src, size_t nbytes,
+                            size_t max_raw_nbytes, seal::seal_byte **dst,
+                            size_t *raw_nbytes);
+
+// Upper bound of the uncompressed serialization of a ciphertext of `context`.
+size_t max_ciphertext_nbytes(const seal::SEALContext &context);
+
+// Upper bound of what send_seal_object sends for such a ciphertext, under any
+// CtCompression.
+size_t max_ciphertext_wire_nbytes(const seal::SEALContext &context);
+
+// Send a SEAL object as [uint64 nbytes][bytes]. The object is saved into the
+// pooled buffer and handed to `io` as it is, i.e., no std::stringstream.
+template <class IO, class SEALObj>
+void send_seal_object(IO *io, const SEALObj &obj,
+                      const CtCompression &compr = CtCompression(),
+                      CtIOStats *stats = nullptr) {
+  using Type = CtCompression::Type;
+  const seal::compr_mode_type seal_compr =
+      compr.type == Type::seal_default ? seal::Serialization::compr_mode_default
+                                       : seal::compr_mode_type::none;
+  double elapsed{0.};
+  uint64_t nbytes{0};
+  seal::seal_byte *buff{nullptr};
+  {
+    MSecTimer timer(&elapsed);
+    const size_t max_nbytes = static_cast<size_t>(obj.save_size(seal_compr));
+    buff = serialization_buffer(max_nbytes);
+    nbytes = static_cast<uint64_t>(obj.save(buff, max_nbytes, seal_compr));
+    if (stats) {
+      stats->raw_bytes += compr.type == Type::seal_default
+                              ? obj.save_size(seal::compr_mode_type::none)
+                              : nbytes;
+    }
+
+    if (compr.type == Type::zstd || compr.type == Type::low_latency) {
+      const int level = compr.type == Type::low_latency
+                            ? CtCompression::kLowLatencyLevel
+                            : std::max(1, std::min(19, compr.level));
+      seal::seal_byte *frame{nullptr};
+      size_t frame_nbytes{0};
+      if (zstd_compress_buffer(buff, nbytes, level, &frame, &frame_nbytes) ==
+          Code::OK) {
+        buff = frame;
+        nbytes = frame_nbytes;
+      } else {
+        // The receiver tells the zstd frames apart, so SEAL's own
+        // compression does as well.
+        const size_t seal_nbytes = static_cast<size_t>(
+            obj.save_size(seal::Serialization::compr_mode_default));
+        buff = serialization_buffer(seal_nbytes);
+        nbytes = static_cast<uint64_t>(obj.save(
+            buff, seal_nbytes, seal::Serialization::compr_mode_default));
+      }
+    }
+  }
+
+  io->send_data(&nbytes, sizeof(uint64_t));
+  io->send_data(buff, nbytes);
+  if (stats) {
+    stats->sent_bytes += nbytes;
+    stats->compress_ms += elapsed;
+  }
+}
+
+// Receive a ciphertext sent by send_seal_object and load it in place from the
+// pooled buffer. The truncated ciphertexts need the unsafe_load. The zstd
+// frames are detected by their magic number, so that the receiver does not
+// need to know the sender's CtCompression.
+template <class IO>
+void recv_ciphertext(IO *io, const seal::SEALContext &context,
+                     seal::Ciphertext &ct, bool is_truncated = false,
+                     CtIOStats *stats = nullptr) {
+  uint64_t nbytes{0};
+  io->recv_data(&nbytes, sizeof(uint64_t));
+  // The size comes from the peer: bound it before allocating.
+  if (nbytes > max_ciphertext_wire_nbytes(context)) {
+    throw std::runtime_error("recv_ciphertext: " + std::to_string(nbytes) +
+                             " bytes exceed a ciphertext");
+  }
+  seal::seal_byte *buff = serialization_buffer(nbytes);
+  io->recv_data(buff, nbytes);
+
+  double elapsed{0.};
+  {
+    MSecTimer timer(&elapsed);
+    seal::seal_byte *raw{nullptr};
+    size_t raw_nbytes{0};
+    Code code = zstd_decompress_buffer(
+        buff, nbytes, max_ciphertext_nbytes(context), &raw, &raw_nbytes);
+    if (code != Code::OK) {
+      throw std::runtime_error("recv_ciphertext: bad zstd frame [" +
+                               CodeMessage(code) + "]");
+    }
+    if (raw_nbytes > 0) {
+      buff = raw;
+    } else {
+      raw_nbytes = nbytes;
+    }
+
+    if (is_truncated) {
+      ct.unsafe_load(context, buff, raw_nbytes);
+    } else {
+      ct.load(context, buff, raw_nbytes);
+    }
+  }
+
+  if (stats) {
+    stats->recv_bytes += nbytes;
+    stats->decompress_ms += elapsed;
+  }
+}
+
 }  // namespace gemini
 #endif  // GEMINI_CORE_UTIL_SEAL_H
@@ -0,0 +1,103 @@
+#include "gemini/core/util/work_stealing.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "gemini/core/util/ThreadPool.h"
+
+namespace gemini {
+
+namespace {
+// The works [begin, end) left to one worker.
+struct WorkRange {
+  std::mutex lock;
+  size_t begin{0};
+  size_t end{0};
+};
+}  // namespace
+
+Code LaunchWorks(ThreadPool &tpool, size_t num_works,
+                 std::function<Code(long wid, size_t start, size_t end)> program,
+                 size_t grain, size_t max_workers) {
+  if (num_works == 0) return Code::OK;
+  long pool_sze = tpool.pool_size();
+  if (max_workers > 0) {
+    pool_sze = std::min(pool_sze, static_cast<long>(max_workers));
+  }
+  if (pool_sze <= 1L) {
+    return program(0, 0, num_works);
+  }
+
+  if (grain == 0) {
+    grain = std::max<size_t>(1, num_works / (8 * pool_sze));
+  }
+
+  std::vector<WorkRange> ranges(pool_sze);
+  const size_t work_load = (num_works + pool_sze - 1) / pool_sze;
+  for (long wid = 0; wid < pool_sze; ++wid) {
+    ranges[wid].begin = std::min(wid * work_load, num_works);
+    ranges[wid].end = std::min(ranges[wid].begin + work_load, num_works);
+  }
+
+  // Take the next grain from the front of the own range.
+  auto pop_front = [&](long wid, size_t &start, size_t &end) {
+    auto &range = ranges[wid];
+    std::lock_guard<std::mutex> guard(range.lock);
+    if (range.begin >= range.end) return false;
+    start = range.begin;
+    end = std::min(start + grain, range.end);
+    range.begin = end;
+    return true;
+  };
+
+  // Move the back half of a victim's range to the own (empty) range.
+  auto steal = [&](long wid) {
+    for (long k = 1; k < pool_sze; ++k) {
+      auto &victim = ranges[(wid + k) % pool_sze];
+      size_t start, end;
+      {
+        std::lock_guard<std::mutex> guard(victim.lock);
+        const size_t remain = victim.end - victim.begin;
+        if (victim.begin >= victim.end) continue;
+        end = victim.end;
+        start = end - std::max<size_t>(1, remain / 2);
+        victim.end = start;
+      }
+
+      auto &own = ranges[wid];
+      std::lock_guard<std::mutex> guard(own.lock);
+      own.begin = start;
+      own.end = end;
+      return true;
+    }
+    return false;
+  };
+
+  auto worker = [&](long wid) {
+    size_t start, end;
+    for (;;) {
+      while (pop_front(wid, start, end)) {
+        Code code = program(wid, start, end);
+        if (code != Code::OK) return code;
+      }
+      if (!steal(wid)) return Code::OK;
+    }
+  };
+
+  std::vector<std::future<Code>> futures;
+  for (long wid = 0; wid < pool_sze; ++wid) {
+    futures.push_back(tpool.enqueue(worker, wid));
+  }
+
+  Code code = Code::OK;
+  for (auto &&work : futures) {
+    Code c = work.get();
+    if (code == Code::OK && c != Code::OK) {
+      code = c;
+    }
+  }
+  return code;
+}
+
+}  // namespace gemini
@@ -0,0 +1,29 @@
+#ifndef GEMINI_CORE_UTIL_WORK_STEALING_H
+#define GEMINI_CORE_UTIL_WORK_STEALING_H
+
+#include <functional>
+
+#include "gemini/core/types.h"
+
+namespace gemini {
+
+class ThreadPool;
+
+// Run `program` over [0, num_works) on the workers of `tpool`.
+//
+// Each worker starts with an equal share of the works and runs it in grains
+// of `grain` works, i.e., `program` is called once per grain. A worker that
+// has finished its share steals the back half of the remaining works of
+// another worker, so that the uneven works do not leave cores idle. The
+// default grain gives about 8 grains per worker.
+//
+// At most `max_workers` workers of the pool take part, all of them if 0.
+//
+// Returns the first non-OK code. A worker stops at its first error while the
+// others run to completion.
+Code LaunchWorks(ThreadPool &tpool, size_t num_works,
+                 std::function<Code(long wid, size_t start, size_t end)> program,
+                 size_t grain = 0, size_t max_workers = 0);
+
+}  // namespace gemini
+#endif  // GEMINI_CORE_UTIL_WORK_STEALING_H
@@ -7508,6 +7508,24 @@ int main(int argc, char** argv)
   amap.arg("ell", bitlength, "Uniform Bitwidth");
   amap.arg("N", nImages, "Number of Images");
   amap.arg("k", kScale, "scale");
+#if USE_CHEETAH
+  amap.arg("fcw", fc_weight_store_path, "File of the pre-encoded FC weights (SERVER)");
+  amap.arg("stream", conv_streaming, "Stream the HomConv ciphertexts slice by slice");
+  amap.arg("compr", ct_compression, "Ciphertext compression: seal, none, zstd[:1-19], low-latency");
+  amap.arg("cpus", cheetah_cpu_affinity, "CPUs for the HE worker threads, e.g., 0-7");
+  amap.arg("het", cheetah_he_threads, "Number of HE worker threads (0 for nt)");
+  amap.arg("keydir", cheetah_key_dir, "Directory to persist the SEAL keys across sessions");
+  amap.arg("cid", cheetah_client_id, "Client id of the persisted keys (CLIENT)");
+  amap.arg("rotate", cheetah_rotate_keys, "Discard the persisted keys and generate new ones (CLIENT)");
+  amap.arg("warm", warm_start_dir, "Directory of the warm-start snapshot");
+  amap.arg("otpool", ot_pool_size, "Silent OTs pre-generated per thread and direction (-1: by the last run)");
+  amap.arg("millfan", mill_fan_in, "Round-reduced Millionaire with AND fan-in up to 4 (0: off)");
+  amap.arg("rtt", mill_rtt_ms, "RTT in ms for the round-reduced Millionaire (-1: measure)");
+  amap.arg("bw", mill_bandwidth_mbps, "Bandwidth in Mbps for the round-reduced Millionaire");
+#endif
+  amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+  amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+  amap.arg("async", async_send, "Send from a dedicated thread per channel");
   amap.parse(argc, argv);
 
   assert(party == SERVER || party == CLIENT);
@@ -7691,17 +7709,12 @@ int main(int argc, char** argv)
   ClearMemSecret4(nImages, (int32_t)28, (int32_t)28, (int32_t)32, tmp12);
   ClearMemSecret1((int32_t)32, tmp2);
 
-  uint64_t* tmp18 =
-      make_array<uint64_t>(nImages, (int32_t)14, (int32_t)14, (int32_t)32);
-  MaxPool(nImages, (int32_t)14, (int32_t)14, (int32_t)32, (int32_t)2,
-          (int32_t)2, (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)0,
-          (int32_t)2, (int32_t)2, nImages, (int32_t)28, (int32_t)28,
-          (int32_t)32, tmp15, tmp18);
-  ClearMemSecret4(nImages, (int32_t)28, (int32_t)28, (int32_t)32, tmp15);
-
   uint64_t* tmp20 = make_array<uint64_t>(nImages, (int32_t)14, (int32_t)14, (int32_t)32);
-  Relu4(nImages, (int32_t)14, (int32_t)14, (int32_t)32, tmp18, tmp20, kScale, kDoExtractTruncate);
-  ClearMemSecret4(nImages, (int32_t)14, (int32_t)14, (int32_t)32, tmp18);
+  MaxPoolRelu(nImages, (int32_t)14, (int32_t)14, (int32_t)32, (int32_t)2,
+              (int32_t)2, (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)0,
+              (int32_t)2, (int32_t)2, nImages, (int32_t)28, (int32_t)28,
+              (int32_t)32, tmp15, tmp20, kScale, kDoExtractTruncate);
+  ClearMemSecret4(nImages, (int32_t)28, (int32_t)28, (int32_t)32, tmp15);
 
   uint64_t* tmp22 = make_array<uint64_t>(nImages, (int32_t)14, (int32_t)14, (int32_t)64);
   Conv2DWrapper(nImages, (int32_t)14, (int32_t)14, (int32_t)32, (int32_t)5,
@@ -7725,16 +7738,12 @@ int main(int argc, char** argv)
   ClearMemSecret4(nImages, (int32_t)14, (int32_t)14, (int32_t)64, tmp22);
   ClearMemSecret1((int32_t)64, tmp4);
 
-  uint64_t* tmp28 = make_array<uint64_t>(nImages, (int32_t)7, (int32_t)7, (int32_t)64);
-  MaxPool(nImages, (int32_t)7, (int32_t)7, (int32_t)64, (int32_t)2, (int32_t)2,
-          (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)2,
-          (int32_t)2, nImages, (int32_t)14, (int32_t)14, (int32_t)64, tmp25,
-          tmp28);
-  ClearMemSecret4(nImages, (int32_t)14, (int32_t)14, (int32_t)64, tmp25);
-
   uint64_t* tmp30 = make_array<uint64_t>(nImages, (int32_t)7, (int32_t)7, (int32_t)64);
-  Relu4(nImages, (int32_t)7, (int32_t)7, (int32_t)64, tmp28, tmp30, kScale, kDoExtractTruncate);
-  ClearMemSecret4(nImages, (int32_t)7, (int32_t)7, (int32_t)64, tmp28);
+  MaxPoolRelu(nImages, (int32_t)7, (int32_t)7, (int32_t)64, (int32_t)2, (int32_t)2,
+              (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)0, (int32_t)2,
+              (int32_t)2, nImages, (int32_t)14, (int32_t)14, (int32_t)64, tmp25,
+              tmp30, kScale, kDoExtractTruncate);
+  ClearMemSecret4(nImages, (int32_t)14, (int32_t)14, (int32_t)64, tmp25);
 
   int64_t* tmp32 = make_array<int64_t>((int32_t)2);
   Arr1DIdxRowM(tmp32, (int32_t)2, (int64_t)0) = (int32_t)-1;
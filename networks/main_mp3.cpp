@@ -7633,6 +7633,24 @@ amap.arg("nt", num_threads, "Number of Threads");
 amap.arg("ell", bitlength, "Uniform Bitwidth");
 amap.arg("k", kScale, "scaling factor");
 
+#if USE_CHEETAH
+amap.arg("fcw", fc_weight_store_path, "File of the pre-encoded FC weights (SERVER)");
+amap.arg("stream", conv_streaming, "Stream the HomConv ciphertexts slice by slice");
+amap.arg("compr", ct_compression, "Ciphertext compression: seal, none, zstd[:1-19], low-latency");
+amap.arg("cpus", cheetah_cpu_affinity, "CPUs for the HE worker threads, e.g., 0-7");
+amap.arg("het", cheetah_he_threads, "Number of HE worker threads (0 for nt)");
+amap.arg("keydir", cheetah_key_dir, "Directory to persist the SEAL keys across sessions");
+amap.arg("cid", cheetah_client_id, "Client id of the persisted keys (CLIENT)");
+amap.arg("rotate", cheetah_rotate_keys, "Discard the persisted keys and generate new ones (CLIENT)");
+amap.arg("warm", warm_start_dir, "Directory of the warm-start snapshot");
+amap.arg("otpool", ot_pool_size, "Silent OTs pre-generated per thread and direction (-1: by the last run)");
+amap.arg("millfan", mill_fan_in, "Round-reduced Millionaire with AND fan-in up to 4 (0: off)");
+amap.arg("rtt", mill_rtt_ms, "RTT in ms for the round-reduced Millionaire (-1: measure)");
+amap.arg("bw", mill_bandwidth_mbps, "Bandwidth in Mbps for the round-reduced Millionaire");
+#endif
+amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+amap.arg("async", async_send, "Send from a dedicated thread per channel");
 amap.parse(argc, argv);
 
 assert(party==SERVER || party==CLIENT);
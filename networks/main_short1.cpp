@@ -7640,6 +7640,24 @@ amap.arg("ell", bitlength, "Uniform Bitwidth");
 // Add
 amap.arg("k", kScale, "scaling factor");
 
+#if USE_CHEETAH
+amap.arg("fcw", fc_weight_store_path, "File of the pre-encoded FC weights (SERVER)");
+amap.arg("stream", conv_streaming, "Stream the HomConv ciphertexts slice by slice");
+amap.arg("compr", ct_compression, "Ciphertext compression: seal, none, zstd[:1-19], low-latency");
+amap.arg("cpus", cheetah_cpu_affinity, "CPUs for the HE worker threads, e.g., 0-7");
+amap.arg("het", cheetah_he_threads, "Number of HE worker threads (0 for nt)");
+amap.arg("keydir", cheetah_key_dir, "Directory to persist the SEAL keys across sessions");
+amap.arg("cid", cheetah_client_id, "Client id of the persisted keys (CLIENT)");
+amap.arg("rotate", cheetah_rotate_keys, "Discard the persisted keys and generate new ones (CLIENT)");
+amap.arg("warm", warm_start_dir, "Directory of the warm-start snapshot");
+amap.arg("otpool", ot_pool_size, "Silent OTs pre-generated per thread and direction (-1: by the last run)");
+amap.arg("millfan", mill_fan_in, "Round-reduced Millionaire with AND fan-in up to 4 (0: off)");
+amap.arg("rtt", mill_rtt_ms, "RTT in ms for the round-reduced Millionaire (-1: measure)");
+amap.arg("bw", mill_bandwidth_mbps, "Bandwidth in Mbps for the round-reduced Millionaire");
+#endif
+amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+amap.arg("async", async_send, "Send from a dedicated thread per channel");
 amap.parse(argc, argv);
 
 assert(party==SERVER || party==CLIENT);
@@ -7744,6 +7762,11 @@ std::cout << "Current time of before StartComputation = " << cur_start
 std::cout << "*******************" << std::endl;
 
 StartComputation();
+#if USE_CHEETAH
+/* Encode the conv filters once, ahead of the inference */
+Conv2DCacheFilters( (int32_t)0,  (int32_t)28,  (int32_t)28,  (int32_t)1,  (int32_t)5,  (int32_t)5,  (int32_t)20,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)1,  (int32_t)1, tmp5);
+Conv2DCacheFilters( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)5,  (int32_t)5,  (int32_t)20,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)1,  (int32_t)1, tmp4);
+#endif
 
 // Add by Eloise
 std::cout << "*******************" << std::endl;
@@ -7770,26 +7793,18 @@ Conv2DWrapper( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)1,  (int32_t)5,
 ClearMemSecret4( (int32_t)5,  (int32_t)5,  (int32_t)1,  (int32_t)20, tmp5);
 ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)1, tmp0);
 
-uint64_t* tmp9 = make_array<uint64_t>( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20);
-MaxPool( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6, tmp9);
-ClearMemSecret4( (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6);
-
 uint64_t* tmp11 = make_array<uint64_t>( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20);
-Relu4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20, tmp9, tmp11,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20, tmp9);
+MaxPoolRelu( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6, tmp11, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)24,  (int32_t)24,  (int32_t)20, tmp6);
 
 uint64_t* tmp13 = make_array<uint64_t>( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20);
 Conv2DWrapper( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20,  (int32_t)5,  (int32_t)5,  (int32_t)20,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)1,  (int32_t)1, tmp11, tmp4, tmp13);
 ClearMemSecret4( (int32_t)5,  (int32_t)5,  (int32_t)20,  (int32_t)20, tmp4);
 ClearMemSecret4( (int32_t)1,  (int32_t)12,  (int32_t)12,  (int32_t)20, tmp11);
 
-uint64_t* tmp16 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20);
-MaxPool( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13, tmp16);
-ClearMemSecret4( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13);
-
 uint64_t* tmp18 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20);
-Relu4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20, tmp16, tmp18,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20, tmp16);
+MaxPoolRelu( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)20,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13, tmp18, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)8,  (int32_t)8,  (int32_t)20, tmp13);
 
 uint64_t* tmp20 = make_array<uint64_t>( (int32_t)1,  (int32_t)320);
 
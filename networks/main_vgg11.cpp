@@ -7525,7 +7525,7 @@ Arr4DIdxRowM(out,s1,s2,s3,s4,i,j,k,l) = Arr1DIdxRowM(inpCopy,size,(((((((((i * s
 }
 }
 }
-
+
 
 int main(int argc, char** argv)
 {
@@ -7535,6 +7535,24 @@ amap.arg("port", port, "Port Number");
 amap.arg("ip", address, "IP Address of server (ALICE)");
 amap.arg("nt", num_threads, "Number of Threads");
 amap.arg("ell", bitlength, "Uniform Bitwidth");
+#if USE_CHEETAH
+amap.arg("fcw", fc_weight_store_path, "File of the pre-encoded FC weights (SERVER)");
+amap.arg("stream", conv_streaming, "Stream the HomConv ciphertexts slice by slice");
+amap.arg("compr", ct_compression, "Ciphertext compression: seal, none, zstd[:1-19], low-latency");
+amap.arg("cpus", cheetah_cpu_affinity, "CPUs for the HE worker threads, e.g., 0-7");
+amap.arg("het", cheetah_he_threads, "Number of HE worker threads (0 for nt)");
+amap.arg("keydir", cheetah_key_dir, "Directory to persist the SEAL keys across sessions");
+amap.arg("cid", cheetah_client_id, "Client id of the persisted keys (CLIENT)");
+amap.arg("rotate", cheetah_rotate_keys, "Discard the persisted keys and generate new ones (CLIENT)");
+amap.arg("warm", warm_start_dir, "Directory of the warm-start snapshot");
+amap.arg("otpool", ot_pool_size, "Silent OTs pre-generated per thread and direction (-1: by the last run)");
+amap.arg("millfan", mill_fan_in, "Round-reduced Millionaire with AND fan-in up to 4 (0: off)");
+amap.arg("rtt", mill_rtt_ms, "RTT in ms for the round-reduced Millionaire (-1: measure)");
+amap.arg("bw", mill_bandwidth_mbps, "Bandwidth in Mbps for the round-reduced Millionaire");
+#endif
+amap.arg("shm", use_shm, "Shared memory channel (same host only)");
+amap.arg("mux", mux_sockets, "Connections to carry all thread channels (0: one per thread)");
+amap.arg("async", async_send, "Send from a dedicated thread per channel");
 amap.parse(argc, argv);
 
 assert(party==SERVER || party==CLIENT);
@@ -7584,6 +7602,17 @@ Arr1DIdxRowM(tmp2, (int32_t)64,i0) = (party == SERVER) ? __tmp_in_tmp2 : 0;
 }
 StartComputation();
 #if USE_CHEETAH
+/* Encode the conv filters once, ahead of the inference */
+Conv2DCacheFilters( (int32_t)0,  (int32_t)112,  (int32_t)112,  (int32_t)3,  (int32_t)3,  (int32_t)3,  (int32_t)64,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp1);
+Conv2DCacheFilters( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64,  (int32_t)3,  (int32_t)3,  (int32_t)128,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp13);
+Conv2DCacheFilters( (int32_t)2,  (int32_t)28,  (int32_t)28,  (int32_t)128,  (int32_t)3,  (int32_t)3,  (int32_t)256,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp25);
+Conv2DCacheFilters( (int32_t)3,  (int32_t)28,  (int32_t)28,  (int32_t)256,  (int32_t)3,  (int32_t)3,  (int32_t)256,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp35);
+Conv2DCacheFilters( (int32_t)4,  (int32_t)14,  (int32_t)14,  (int32_t)256,  (int32_t)3,  (int32_t)3,  (int32_t)512,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp47);
+Conv2DCacheFilters( (int32_t)5,  (int32_t)14,  (int32_t)14,  (int32_t)512,  (int32_t)3,  (int32_t)3,  (int32_t)512,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp57);
+Conv2DCacheFilters( (int32_t)6,  (int32_t)7,  (int32_t)7,  (int32_t)512,  (int32_t)3,  (int32_t)3,  (int32_t)512,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp69);
+Conv2DCacheFilters( (int32_t)7,  (int32_t)7,  (int32_t)7,  (int32_t)512,  (int32_t)3,  (int32_t)3,  (int32_t)512,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1,  (int32_t)1, tmp79);
+#endif
+#if USE_CHEETAH
 kIsSharedInput = false;
 #endif
 uint64_t* tmp3 = make_array<uint64_t>( (int32_t)1,  (int32_t)112,  (int32_t)112,  (int32_t)64);
@@ -7608,13 +7637,9 @@ Arr4DIdxRowM(tmp6, (int32_t)1, (int32_t)112, (int32_t)112, (int32_t)64,i0,i1,i2,
 ClearMemSecret4( (int32_t)1,  (int32_t)112,  (int32_t)112,  (int32_t)64, tmp3);
 ClearMemSecret1( (int32_t)64, tmp2);
 
-uint64_t* tmp9 = make_array<uint64_t>( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64);
-MaxPool( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)112,  (int32_t)112,  (int32_t)64, tmp6, tmp9);
-ClearMemSecret4( (int32_t)1,  (int32_t)112,  (int32_t)112,  (int32_t)64, tmp6);
-
 uint64_t* tmp11 = make_array<uint64_t>( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64);
-Relu4( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64, tmp9, tmp11,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64, tmp9);
+MaxPoolRelu( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)64,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)112,  (int32_t)112,  (int32_t)64, tmp6, tmp11, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)112,  (int32_t)112,  (int32_t)64, tmp6);
 
 uint64_t* tmp13 = make_array<uint64_t>( (int32_t)3,  (int32_t)3,  (int32_t)64,  (int32_t)128);
 /* Variable to read the clear value corresponding to the input variable tmp13 at (8993,1-8993,46) */
@@ -7661,13 +7686,9 @@ Arr4DIdxRowM(tmp18, (int32_t)1, (int32_t)56, (int32_t)56, (int32_t)128,i0,i1,i2,
 ClearMemSecret4( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)128, tmp15);
 ClearMemSecret1( (int32_t)128, tmp14);
 
-uint64_t* tmp21 = make_array<uint64_t>( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)128);
-MaxPool( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)128,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)128, tmp18, tmp21);
-ClearMemSecret4( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)128, tmp18);
-
 uint64_t* tmp23 = make_array<uint64_t>( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)128);
-Relu4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)128, tmp21, tmp23,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)128, tmp21);
+MaxPoolRelu( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)128,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)128, tmp18, tmp23, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)56,  (int32_t)56,  (int32_t)128, tmp18);
 
 uint64_t* tmp25 = make_array<uint64_t>( (int32_t)3,  (int32_t)3,  (int32_t)128,  (int32_t)256);
 /* Variable to read the clear value corresponding to the input variable tmp25 at (9048,1-9048,47) */
@@ -7763,13 +7784,9 @@ Arr4DIdxRowM(tmp40, (int32_t)1, (int32_t)28, (int32_t)28, (int32_t)256,i0,i1,i2,
 ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)256, tmp37);
 ClearMemSecret1( (int32_t)256, tmp36);
 
-uint64_t* tmp43 = make_array<uint64_t>( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)256);
-MaxPool( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)256,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)256, tmp40, tmp43);
-ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)256, tmp40);
-
 uint64_t* tmp45 = make_array<uint64_t>( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)256);
-Relu4( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)256, tmp43, tmp45,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)256, tmp43);
+MaxPoolRelu( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)256,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)256, tmp40, tmp45, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)28,  (int32_t)28,  (int32_t)256, tmp40);
 
 uint64_t* tmp47 = make_array<uint64_t>( (int32_t)3,  (int32_t)3,  (int32_t)256,  (int32_t)512);
 /* Variable to read the clear value corresponding to the input variable tmp47 at (9150,1-9150,47) */
@@ -7865,13 +7882,9 @@ Arr4DIdxRowM(tmp62, (int32_t)1, (int32_t)14, (int32_t)14, (int32_t)512,i0,i1,i2,
 ClearMemSecret1( (int32_t)512, tmp58);
 ClearMemSecret4( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)512, tmp59);
 
-uint64_t* tmp65 = make_array<uint64_t>( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512);
-MaxPool( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)512, tmp62, tmp65);
-ClearMemSecret4( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)512, tmp62);
-
 uint64_t* tmp67 = make_array<uint64_t>( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512);
-Relu4( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp65, tmp67,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp65);
+MaxPoolRelu( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)0,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)512, tmp62, tmp67, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)14,  (int32_t)14,  (int32_t)512, tmp62);
 
 uint64_t* tmp69 = make_array<uint64_t>( (int32_t)3,  (int32_t)3,  (int32_t)512,  (int32_t)512);
 /* Variable to read the clear value corresponding to the input variable tmp69 at (9252,1-9252,47) */
@@ -7967,13 +7980,9 @@ Arr4DIdxRowM(tmp84, (int32_t)1, (int32_t)7, (int32_t)7, (int32_t)512,i0,i1,i2,i3
 ClearMemSecret1( (int32_t)512, tmp80);
 ClearMemSecret4( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp81);
 
-uint64_t* tmp87 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)512);
-MaxPool( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)512,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)1,  (int32_t)0,  (int32_t)1,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp84, tmp87);
-ClearMemSecret4( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp84);
-
 uint64_t* tmp89 = make_array<uint64_t>( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)512);
-Relu4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)512, tmp87, tmp89,  (int32_t)12, 1);
-ClearMemSecret4( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)512, tmp87);
+MaxPoolRelu( (int32_t)1,  (int32_t)4,  (int32_t)4,  (int32_t)512,  (int32_t)2,  (int32_t)2,  (int32_t)0,  (int32_t)1,  (int32_t)0,  (int32_t)1,  (int32_t)2,  (int32_t)2,  (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp84, tmp89, (int32_t)12, 1);
+ClearMemSecret4( (int32_t)1,  (int32_t)7,  (int32_t)7,  (int32_t)512, tmp84);
 
 int32_t* tmp91 = make_array<int32_t>( (int32_t)2);
 Arr1DIdxRowM(tmp91, (int32_t)2, (int64_t)0) =  (int32_t)-1;
@@ -52,5 +52,13 @@ SERVER_PORT=12345
 FXP_SCALE=12
 # secret sharing bit length
 SS_BITLEN=37
-# number of threads (should <= 4 for the SCI)
+# number of threads; each thread talks over its own channel, which is its own
+# connection on SERVER_PORT + i unless USE_MUX > 0
 NUM_THREADS=4
+# 1 to talk through shared memory instead of TCP (server and client on one host)
+USE_SHM=0
+# > 0 to multiplex the channels of all threads over that many connections
+# (SERVER_PORT, SERVER_PORT + 1, ...) instead of one connection per thread
+USE_MUX=0
+# 1 to send from a dedicated thread per channel, overlapping sends with compute
+USE_ASYNC=0
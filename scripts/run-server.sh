@@ -18,6 +18,6 @@ else
   mkdir -p data
   ls -lh pretrained/$2_model_scale12.inp
   echo -e "Runing ${GREEN}build/bin/$2-$1${NC}, which might take a while...."
-  cat pretrained/$2_model_scale12.inp | build/bin/$2-$1 r=1 k=$FXP_SCALE ell=$SS_BITLEN nt=$NUM_THREADS p=$SERVER_PORT #1>$1-$2_server.log
+  cat pretrained/$2_model_scale12.inp | build/bin/$2-$1 r=1 k=$FXP_SCALE ell=$SS_BITLEN nt=$NUM_THREADS p=$SERVER_PORT shm=$USE_SHM mux=$USE_MUX async=$USE_ASYNC #1>$1-$2_server.log
   echo -e "Computation done, check out the log file ${GREEN}$1-$2_server.log${NC}"
 fi